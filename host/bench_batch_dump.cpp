@@ -0,0 +1,188 @@
+// Runs batch mode against a queue of synthetic titles, the way braindump does with a queue file on the
+// SD card, and writes the summary report. The batch is dumped three ways:
+// - "batch": one TitleDumper for all titles, reusing its buffers, threads and tuned read sizes
+// - "separate": a new TitleDumper per title, like relaunching braindump for each title
+// - "concurrent": two TitleDumpers on separate threads, each dumping half of the queue
+// All runs must produce identical files, which checks that the dump engine doesn't depend on global state.
+//
+// Usage: bench_batch_dump <output directory> [number of titles] [read latency in us]
+
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include <sys/stat.h>
+
+#include "batch_dump.h"
+#include "output_file.h"
+#include "synthetic_title.h"
+
+using Clock = std::chrono::steady_clock;
+
+// Title ID of a queue entry that can't be accessed, to exercise error reporting
+static const uint64_t inaccessible_title_id = 0x00040000DEADBEEFull;
+
+static std::unique_ptr<OutputFile> OpenOutput(const std::string& path, bool keep_contents, uint64_t* existing_size) {
+    std::unique_ptr<StdioOutputFile> output(new StdioOutputFile);
+    if (!output->Open(path, keep_contents))
+        std::cerr << "Couldn't open \"" << path << "\" for writing" << std::endl;
+    *existing_size = output->GetSize();
+    return std::move(output);
+}
+
+static void MakeDirectory(const std::string& path) {
+    mkdir(path.c_str(), 0755);
+}
+
+// Synthetic titles get RomFS sizes between 1 and 32 MiB, depending on their title ID
+static std::unique_ptr<TitleArchive> OpenSyntheticTitle(const BatchEntry& entry, unsigned read_latency_us) {
+    if (entry.title_id == inaccessible_title_id)
+        return nullptr;
+
+    SyntheticTitleConfig config;
+    config.romfs_size = (1ull << (entry.title_id % 6)) * 1024 * 1024;
+    config.read_latency_us = read_latency_us;
+    config.seed = entry.title_id;
+    return std::unique_ptr<TitleArchive>(new SyntheticTitleArchive(config));
+}
+
+static bool FilesEqual(const std::string& path1, const std::string& path2) {
+    FILE* file1 = fopen(path1.c_str(), "rb");
+    FILE* file2 = fopen(path2.c_str(), "rb");
+    bool equal = file1 && file2;
+    std::vector<char> buffer1(0x10000), buffer2(0x10000);
+    while (equal) {
+        size_t size1 = fread(buffer1.data(), 1, buffer1.size(), file1);
+        size_t size2 = fread(buffer2.data(), 1, buffer2.size(), file2);
+        equal = size1 == size2 && memcmp(buffer1.data(), buffer2.data(), size1) == 0;
+        if (size1 == 0)
+            break;
+    }
+    if (file1)
+        fclose(file1);
+    if (file2)
+        fclose(file2);
+    return equal;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <output directory> [number of titles] [read latency in us]" << std::endl;
+        return 1;
+    }
+
+    const std::string output_dir = argv[1];
+    const unsigned num_titles = (argc > 2) ? std::atoi(argv[2]) : 6;
+    const unsigned read_latency_us = (argc > 3) ? std::atoi(argv[3]) : 0;
+
+    // Write and parse a queue file, like the one braindump reads from the SD card
+    MakeDirectory(output_dir);
+    const std::string queue_path = output_dir + "/queue.txt";
+    if (FILE* file = fopen(queue_path.c_str(), "w")) {
+        fprintf(file, "# title_id media_type\n");
+        for (unsigned index = 0; index < num_titles; ++index)
+            fprintf(file, "%016" PRIx64 " %u\n", uint64_t{0x0004000000100000} + index * 0x100 + index, 1 + index % 2);
+        fprintf(file, "%016" PRIx64 " 2\n", inaccessible_title_id);
+        fclose(file);
+    }
+    std::vector<BatchEntry> queue;
+    if (!ReadBatchQueue(queue_path, &queue)) {
+        std::cerr << "Couldn't read " << queue_path << std::endl;
+        return 1;
+    }
+
+    DumpOptions options;
+    options.standalone_romfs = true;
+    options.resumable = false;
+    DumpEnvironment environment;
+    environment.open_output = OpenOutput;
+    environment.make_directory = MakeDirectory;
+    auto open_title = [read_latency_us](const BatchEntry& entry) {
+        return OpenSyntheticTitle(entry, read_latency_us);
+    };
+
+    struct Run {
+        const char* name;
+        std::string dir;
+        double seconds;
+    };
+    std::vector<Run> runs = { { "batch", output_dir + "/batch", 0 }, { "separate", output_dir + "/separate", 0 }, { "concurrent", output_dir + "/concurrent", 0 } };
+    for (auto& run : runs)
+        MakeDirectory(run.dir);
+
+    // One dumper for the whole queue
+    auto begin = Clock::now();
+    std::vector<BatchResult> results;
+    {
+        TitleDumper dumper(options, environment);
+        results = RunBatch(dumper, queue, runs[0].dir, open_title, nullptr, nullptr);
+    }
+    runs[0].seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+
+    // A new dumper for each title
+    begin = Clock::now();
+    for (auto& entry : queue) {
+        TitleDumper dumper(options, environment);
+        RunBatch(dumper, { entry }, runs[1].dir, open_title, nullptr, nullptr);
+    }
+    runs[1].seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+
+    // Two dumpers running at the same time
+    begin = Clock::now();
+    {
+        std::vector<BatchEntry> halves[2];
+        for (size_t index = 0; index < queue.size(); ++index)
+            halves[index % 2].push_back(queue[index]);
+
+        std::thread threads[2];
+        for (unsigned index = 0; index < 2; ++index) {
+            auto& half = halves[index];
+            threads[index] = std::thread([&, index] {
+                TitleDumper dumper(options, environment);
+                RunBatch(dumper, half, runs[2].dir, open_title, nullptr, nullptr);
+            });
+        }
+        for (auto& thread : threads)
+            thread.join();
+    }
+    runs[2].seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+
+    const std::string report_path = output_dir + "/batch_report.txt";
+    bool all_ok = WriteBatchReport(report_path, results);
+    if (FILE* file = fopen(report_path.c_str(), "r")) {
+        char line[256];
+        while (fgets(line, sizeof(line), file))
+            std::fputs(line, stdout);
+        fclose(file);
+    }
+    std::printf("\n");
+
+    // Check the results: All accessible titles must have been dumped, identically by all runs
+    for (auto& result : results) {
+        bool expected_success = result.entry.title_id != inaccessible_title_id;
+        all_ok &= result.result.success == expected_success;
+    }
+
+    std::printf("%12s %10s %12s\n", "mode", "seconds", "outputs");
+    for (auto& run : runs) {
+        bool identical = true;
+        for (auto& result : results) {
+            if (!result.result.success)
+                continue;
+
+            char name[32];
+            snprintf(name, sizeof(name), "/%016" PRIx64, result.entry.title_id);
+            for (auto suffix : { ".cxi", "/romfs.bin" })
+                identical &= FilesEqual(runs[0].dir + name + suffix, run.dir + name + suffix);
+        }
+        all_ok &= identical;
+        std::printf("%12s %10.3f %12s\n", run.name, run.seconds, identical ? "identical" : "DIFFERENT");
+    }
+
+    return all_ok ? 0 : 1;
+}
@@ -0,0 +1,295 @@
+// Measures BLZ compression and in-place decompression of the ExeFS .code section at sizes ranging from
+// small eShop titles to large retail games. The .code data is generated to resemble real code: ARM
+// instructions drawn from a limited set of patterns, branches and literal pools, followed by strings and
+// tables. Decompression is compared against a straightforward byte-by-byte decoder, which must produce
+// the same output, both for these and for thousands of buffers mixing random data, runs and repeats. Finally, DumpExeFS must report the exact decompressed size of a compressed .code section,
+// and detect uncompressed ones.
+//
+// Usage: bench_blz [.code sizes in KiB, comma-separated] [repetitions]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <cstring>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "blz.h"
+#include "dump_engine.h"
+#include "output_file.h"
+#include "synthetic_title.h"
+
+using Clock = std::chrono::steady_clock;
+
+static double SecondsSince(Clock::time_point begin) {
+    return std::chrono::duration<double>(Clock::now() - begin).count();
+}
+
+// Generate "size" bytes resembling a decompressed .code section: Text, read-only data and data, each starting on a page
+static std::vector<uint8_t> GenerateCode(size_t size, uint64_t seed) {
+    std::mt19937_64 rng(seed);
+    std::vector<uint8_t> code;
+    code.reserve(size);
+    auto append_word = [&code](uint32_t word) {
+        code.insert(code.end(), reinterpret_cast<const uint8_t*>(&word), reinterpret_cast<const uint8_t*>(&word) + sizeof(word));
+    };
+    auto pad_to_page = [&code, size] {
+        code.resize(std::min<size_t>(size, (code.size() + 0xFFF) & ~size_t{0xFFF}));
+    };
+
+    // Text: Compilers use a small set of instruction patterns, varied by registers and immediates
+    std::vector<uint32_t> patterns(512);
+    for (auto& pattern : patterns)
+        pattern = 0xE0000000 | (rng() & 0x0FFFFFFF);
+    while (code.size() < size * 7 / 10) {
+        unsigned kind = rng() % 100;
+        if (kind < 8) {
+            append_word(0xEB000000 | (static_cast<uint32_t>(static_cast<int32_t>(rng() % 0x20000) - 0x10000) & 0xFFFFFF)); // bl
+        } else if (kind < 12) {
+            append_word(0x00100000 + static_cast<uint32_t>(rng() % size)); // Literal pool
+        } else {
+            uint32_t word = patterns[std::min(rng() % patterns.size(), rng() % patterns.size())];
+            if (rng() % 4 == 0)
+                word ^= (rng() % 16) << (4 * (rng() % 4)); // Different register or immediate
+            append_word(word);
+        }
+    }
+    pad_to_page();
+
+    // Read-only data: Strings made up of a common vocabulary, and constant tables
+    std::vector<std::string> vocabulary(300);
+    for (auto& word : vocabulary) {
+        for (unsigned length = 3 + rng() % 8; length > 0; --length)
+            word += static_cast<char>('a' + rng() % 26);
+    }
+    while (code.size() < size * 9 / 10) {
+        if (rng() % 4 == 0) {
+            for (unsigned index = 0; index < 16; ++index)
+                append_word(static_cast<uint32_t>(rng() % 1024) << 20);
+            continue;
+        }
+        std::string string;
+        for (unsigned words = 1 + rng() % 4; words > 0; --words)
+            string += vocabulary[std::min(rng() % vocabulary.size(), rng() % vocabulary.size())] + (words > 1 ? "_" : "");
+        code.insert(code.end(), string.begin(), string.end() + 1);
+        code.resize((code.size() + 3) & ~size_t{3});
+    }
+    pad_to_page();
+
+    // Data: Mostly zeros and small integers, and some pointers
+    while (code.size() < size) {
+        unsigned kind = rng() % 10;
+        append_word(kind < 6 ? 0 : kind < 9 ? static_cast<uint32_t>(rng() % 256) : 0x00100000 + static_cast<uint32_t>(rng() % size));
+    }
+    code.resize(size);
+    return code;
+}
+
+// Byte-by-byte decoder checking every token, as a reference for BlzDecompress
+static bool ReferenceDecompress(uint8_t* buffer, uint32_t size, uint32_t capacity) {
+    BlzFooter footer;
+    if (size < sizeof(footer))
+        return false;
+    memcpy(&footer, buffer + size - sizeof(footer), sizeof(footer));
+    uint32_t decompressed_size = BlzDecompressedSize(footer, size);
+    if (decompressed_size == 0 || decompressed_size > capacity)
+        return false;
+
+    uint8_t* in = buffer + size - (footer.top_and_bottom >> 24);
+    uint8_t* in_begin = buffer + size - (footer.top_and_bottom & 0xFFFFFF);
+    uint8_t* out = buffer + decompressed_size;
+    while (in > in_begin) {
+        uint8_t flags = *--in;
+        for (unsigned token = 0; token < 8 && in > in_begin; ++token, flags <<= 1) {
+            if (!(flags & 0x80)) {
+                if (out == in_begin)
+                    return false;
+                *--out = *--in;
+                continue;
+            }
+            if (in - in_begin < 2)
+                return false;
+            uint32_t value = *--in << 8;
+            value |= *--in;
+            uint32_t distance = (value & 0xFFF) + 3;
+            uint32_t length = (value >> 12) + 3;
+            if (out - in_begin < length || buffer + decompressed_size - out < distance)
+                return false;
+            for (uint8_t* match = out + distance; length > 0; --length)
+                *--out = *--match;
+        }
+    }
+    return out == in_begin;
+}
+
+// Generate "size" bytes mixing incompressible data, runs and repeats of earlier data. Compressing this leaves little
+// slack between the input and the output when decompressing in place, which the decoder's fast path must handle.
+static std::vector<uint8_t> GenerateMixed(size_t size, uint64_t seed) {
+    std::mt19937_64 rng(seed);
+    std::vector<uint8_t> data;
+    data.reserve(size);
+    while (data.size() < size) {
+        size_t length = std::min<size_t>(size - data.size(), 1 + rng() % 256);
+        unsigned kind = rng() % 3;
+        if (kind == 0 || data.size() < 3) {
+            while (length--)
+                data.push_back(static_cast<uint8_t>(rng()));
+        } else if (kind == 1) {
+            data.insert(data.end(), length, static_cast<uint8_t>(rng()));
+        } else {
+            size_t distance = 1 + rng() % std::min<size_t>(data.size(), 0x1100);
+            for (size_t source = data.size() - distance; length--; ++source)
+                data.push_back(data[source]);
+        }
+    }
+    return data;
+}
+
+// Round-trip "code" through the compressor and both decoders. Data that doesn't compress is skipped.
+static bool CheckRoundTrip(BlzCompressor& compressor, const std::vector<uint8_t>& code, bool* compressible) {
+    std::vector<uint8_t> buffer(code.size());
+    size_t compressed_size = compressor.Compress(code.data(), code.size(), buffer.data(), buffer.size());
+    *compressible = compressed_size != 0;
+    if (!*compressible)
+        return true;
+
+    std::vector<uint8_t> reference = buffer;
+    const uint32_t size = static_cast<uint32_t>(compressed_size);
+    const uint32_t capacity = static_cast<uint32_t>(code.size());
+    return ReferenceDecompress(reference.data(), size, capacity) && reference == code &&
+           BlzDecompress(buffer.data(), size, capacity) && buffer == code;
+}
+
+// Memory-backed ArchiveFile
+class MemoryArchiveFile : public ArchiveFile {
+public:
+    explicit MemoryArchiveFile(const std::vector<uint8_t>& data) : data(data) {
+    }
+
+    Result GetSize(uint64_t* size) override {
+        *size = data.size();
+        return 0;
+    }
+
+    Result Read(uint64_t offset, void* buffer, uint32_t size, uint32_t* bytes_read) override {
+        if (offset > data.size())
+            return -1;
+        *bytes_read = static_cast<uint32_t>(std::min<uint64_t>(size, data.size() - offset));
+        memcpy(buffer, data.data() + offset, *bytes_read);
+        return 0;
+    }
+
+private:
+    const std::vector<uint8_t>& data;
+};
+
+// Synthetic title with the given .code section
+class CodeTitleArchive : public TitleArchive {
+public:
+    CodeTitleArchive(TitleArchive& title, const std::vector<uint8_t>& code) : title(title), code(code) {
+    }
+
+    Result OpenExeFSSection(const std::string& name, std::unique_ptr<ArchiveFile>* file) override {
+        if (name != ".code")
+            return title.OpenExeFSSection(name, file);
+        file->reset(new MemoryArchiveFile(code));
+        return 0;
+    }
+
+    Result OpenRomFS(std::unique_ptr<ArchiveFile>* file) override {
+        return title.OpenRomFS(file);
+    }
+
+private:
+    TitleArchive& title;
+    const std::vector<uint8_t>& code;
+};
+
+class NullOutputFile : public OutputFile {
+public:
+    bool WriteAt(uint64_t, const void*, size_t) override {
+        return true;
+    }
+};
+
+// Dump the ExeFS of "title" and check the decompressed .code size and compression reported by DumpExeFS
+static bool CheckDumpExeFS(TitleArchive& title, uint32_t expected_size, bool expected_compressed) {
+    NullOutputFile file;
+    OutputSink out(file);
+    bool compressed = !expected_compressed;
+    return DumpExeFS(title, out, nullptr, nullptr, nullptr, nullptr, PrintTo(std::cerr), nullptr, &compressed) == expected_size && compressed == expected_compressed;
+}
+
+int main(int argc, char** argv) {
+    std::vector<size_t> sizes;
+    std::stringstream size_list((argc > 1) ? argv[1] : "256,1024,2048,4096,8192,12288");
+    for (std::string size; std::getline(size_list, size, ','); )
+        sizes.push_back(std::strtoull(size.c_str(), nullptr, 10) * 1024);
+    const unsigned repetitions = (argc > 2) ? std::atoi(argv[2]) : 5;
+
+    bool all_ok = true;
+    BlzCompressor compressor;
+    std::printf("%10s %14s %8s %12s %14s %14s %8s\n", "code_kib", "compressed_kib", "ratio", "compress_s", "decompress_mib_s", "reference_mib_s", "result");
+    for (size_t size : sizes) {
+        auto code = GenerateCode(size, size);
+
+        std::vector<uint8_t> compressed(size);
+        auto begin = Clock::now();
+        size_t compressed_size = compressor.Compress(code.data(), code.size(), compressed.data(), compressed.size());
+        double compress_seconds = SecondsSince(begin);
+        bool ok = compressed_size != 0;
+        compressed.resize(compressed_size);
+
+        // Keep the fastest run of each decoder
+        std::vector<uint8_t> buffer(size);
+        double best[2] = {};
+        for (unsigned run = 0; ok && run < 2 * repetitions; ++run) {
+            bool reference = (run % 2 == 1);
+            std::fill(buffer.begin(), buffer.end(), 0xCC);
+            std::copy(compressed.begin(), compressed.end(), buffer.begin());
+            begin = Clock::now();
+            ok &= reference ? ReferenceDecompress(buffer.data(), static_cast<uint32_t>(compressed_size), static_cast<uint32_t>(buffer.size()))
+                            : BlzDecompress(buffer.data(), static_cast<uint32_t>(compressed_size), static_cast<uint32_t>(buffer.size()));
+            double seconds = SecondsSince(begin);
+            ok &= (buffer == code);
+            if (run < 2 || seconds < best[reference])
+                best[reference] = seconds;
+        }
+
+        SyntheticTitleArchive synthetic_title(SyntheticTitleConfig{});
+        CodeTitleArchive title(synthetic_title, compressed);
+        ok &= CheckDumpExeFS(title, static_cast<uint32_t>(size), true);
+        all_ok &= ok;
+
+        std::printf("%10zu %14zu %8.3f %12.3f %14.1f %14.1f %8s\n", size / 1024, compressed_size / 1024, static_cast<double>(compressed_size) / size,
+                    compress_seconds, size / (1024.0 * 1024.0) / best[0], size / (1024.0 * 1024.0) / best[1], ok ? "ok" : "FAILED");
+    }
+
+    // Round trips of data compressing unevenly, with many streams that barely fit in place
+    const unsigned fuzz_seeds = 3000;
+    unsigned compressible = 0, fuzz_failures = 0;
+    for (unsigned seed = 0; seed < fuzz_seeds; ++seed) {
+        bool seed_compressible;
+        auto data = GenerateMixed(16 + std::mt19937_64(seed)() % 0x10000, seed);
+        if (!CheckRoundTrip(compressor, data, &seed_compressible)) {
+            std::printf("Round trip failed for seed %u\n", seed);
+            ++fuzz_failures;
+        }
+        compressible += seed_compressible;
+    }
+    std::printf("Round trips: %u of %u buffers compressed, %u failed\n", compressible, fuzz_seeds, fuzz_failures);
+    all_ok &= (fuzz_failures == 0);
+
+    // Synthetic titles have random .code data, which doesn't compress and thus is stored uncompressed
+    SyntheticTitleConfig config;
+    SyntheticTitleArchive uncompressed_title(config);
+    bool uncompressed_ok = CheckDumpExeFS(uncompressed_title, config.code_size, false);
+    std::printf("Uncompressed .code: %s\n", uncompressed_ok ? "ok" : "FAILED");
+    all_ok &= uncompressed_ok;
+
+    return all_ok ? 0 : 1;
+}
@@ -0,0 +1,144 @@
+// Runs the RomFS copy pipeline with the chunk size autotuner against simulated media, whose read latency
+// depends on the chunk size. Reads advance a simulated clock rather than sleeping, so results are exact
+// and reproducible. For each scenario, the chunk size picked by the tuner is compared against the best
+// fixed chunk size, and the simulated read time against the previous fixed 1 MiB chunks.
+//
+// Usage: bench_chunk_autotune [config file for the round-trip check]
+
+#include <atomic>
+#include <cstdio>
+#include <vector>
+
+#include "chunk_autotuner.h"
+#include "dump_pipeline.h"
+#include "output_sink.h"
+
+// Read latency model: fixed per-request overhead plus transfer time. Requests larger than "knee"
+// transfer the excess at a reduced rate, modelling e.g. cartridge controllers that split large requests.
+struct LatencyCurve {
+    const char* name;
+    double overhead_us;
+    double mib_per_s;
+    uint32_t knee;
+    double penalty; // Extra transfer time factor for the part above the knee
+
+    uint64_t LatencyNs(uint32_t size) const {
+        double transfer = size + ((size > knee) ? (size - knee) * penalty : 0.0);
+        return static_cast<uint64_t>(overhead_us * 1000.0 + transfer / (mib_per_s * 1024 * 1024) * 1e9);
+    }
+};
+
+static std::atomic<uint64_t> simulated_ns{0};
+
+// Archive file reading from simulated media, switching from one latency curve to another at "switch_offset"
+class SimulatedArchiveFile : public ArchiveFile {
+public:
+    SimulatedArchiveFile(uint64_t size, const LatencyCurve& before, const LatencyCurve& after, uint64_t switch_offset)
+        : size(size), before(before), after(after), switch_offset(switch_offset) {
+    }
+
+    Result GetSize(uint64_t* size) override {
+        *size = this->size;
+        return 0;
+    }
+
+    Result Read(uint64_t offset, void* buffer, uint32_t size, uint32_t* bytes_read) override {
+        auto& curve = (offset < switch_offset) ? before : after;
+        simulated_ns += curve.LatencyNs(size);
+        *bytes_read = size;
+        return 0;
+    }
+
+private:
+    uint64_t size;
+    const LatencyCurve& before;
+    const LatencyCurve& after;
+    uint64_t switch_offset;
+};
+
+class NullOutputFile : public OutputFile {
+public:
+    bool WriteAt(uint64_t, const void*, size_t) override {
+        return true;
+    }
+};
+
+struct Scenario {
+    const char* name;
+    LatencyCurve before;
+    LatencyCurve after;
+    uint64_t switch_offset;
+    uint64_t size;
+};
+
+struct RunResult {
+    uint32_t chunk_size;
+    unsigned num_probes;
+    uint64_t read_ns;
+};
+
+// Copy the scenario's data using the autotuner, or fixed chunks if "fixed_chunk_size" is non-zero
+static RunResult Run(const Scenario& scenario, uint32_t fixed_chunk_size) {
+    SimulatedArchiveFile source(scenario.size, scenario.before, scenario.after, scenario.switch_offset);
+    NullOutputFile null_output;
+    OutputSink out(null_output);
+
+    ChunkAutotuner autotuner(ChunkAutotuner::Config{}, [] { return simulated_ns.load(); });
+    PipelineConfig config;
+    config.num_buffers = 4;
+    if (fixed_chunk_size)
+        config.chunk_size = fixed_chunk_size;
+    else
+        config.autotuner = &autotuner;
+
+    simulated_ns = 0;
+    CopyPipelined(source, scenario.size, out, config, nullptr, nullptr);
+    return RunResult{ fixed_chunk_size ? fixed_chunk_size : autotuner.BestChunkSize(), autotuner.NumProbes(), simulated_ns.load() };
+}
+
+int main(int argc, char** argv) {
+    const uint64_t MiB = 1024 * 1024;
+    const LatencyCurve cartridge = { "cartridge", 3000, 16, 0x40000, 0.5 };
+    const LatencyCurve sd = { "sd", 500, 40, 0xFFFFFFFF, 0 };
+    const LatencyCurve slow_sd = { "slow sd", 8000, 10, 0x80000, 1.0 };
+    const Scenario scenarios[] = {
+        { "cartridge", cartridge, cartridge, UINT64_MAX, 256 * MiB },
+        { "sd", sd, sd, UINT64_MAX, 256 * MiB },
+        { "slow sd", slow_sd, slow_sd, UINT64_MAX, 256 * MiB },
+        { "sd -> cartridge", sd, cartridge, 64 * MiB, 256 * MiB },
+    };
+
+    bool all_ok = true;
+    std::printf("%-16s %10s %10s %7s %8s %12s %12s %12s %s\n", "scenario", "tuned", "best fixed", "probes", "repeat",
+                "tuned s", "best s", "1 MiB s", "result");
+    for (auto& scenario : scenarios) {
+        // Find the best fixed chunk size for the final latency curve
+        RunResult best = { 0, 0, UINT64_MAX };
+        for (uint32_t chunk_size : ChunkAutotuner::Config{}.candidates) {
+            Scenario steady = { scenario.name, scenario.after, scenario.after, UINT64_MAX, scenario.size };
+            RunResult result = Run(steady, chunk_size);
+            if (result.read_ns < best.read_ns)
+                best = result;
+        }
+
+        RunResult tuned = Run(scenario, 0);
+        RunResult repeated = Run(scenario, 0);
+        RunResult default_chunks = Run(scenario, 0x100000);
+        bool deterministic = tuned.chunk_size == repeated.chunk_size && tuned.read_ns == repeated.read_ns;
+        bool ok = deterministic && tuned.chunk_size == best.chunk_size;
+        all_ok &= ok;
+
+        std::printf("%-16s %9uK %9uK %7u %8s %12.3f %12.3f %12.3f %s\n", scenario.name, tuned.chunk_size / 1024,
+                    best.chunk_size / 1024, tuned.num_probes, deterministic ? "same" : "DIFFERS", tuned.read_ns / 1e9,
+                    best.read_ns / 1e9, default_chunks.read_ns / 1e9, ok ? "ok" : "MISMATCH");
+    }
+
+    // Check that tuned sizes survive a round trip through the config file
+    const char* config_path = (argc > 1) ? argv[1] : "autotune.cfg";
+    bool config_ok = SaveTunedChunkSize(config_path, 0, 0x40000) && SaveTunedChunkSize(config_path, 2, 0x200000) &&
+                     SaveTunedChunkSize(config_path, 0, 0x80000) && LoadTunedChunkSize(config_path, 0) == 0x80000 &&
+                     LoadTunedChunkSize(config_path, 2) == 0x200000 && LoadTunedChunkSize(config_path, 1) == 0;
+    std::printf("config file round trip: %s\n", config_ok ? "ok" : "FAILED");
+
+    return (all_ok && config_ok) ? 0 : 1;
+}
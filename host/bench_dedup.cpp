@@ -0,0 +1,231 @@
+// Dumps a small library of synthetic titles into a shared chunk store and reports how well it deduplicates:
+// A base title, a regional variant of it (larger .code section, shifting the RomFS within the image, plus a few
+// modified RomFS blocks), a second dump of the base title, and an unrelated title. Each image is reassembled from
+// the store and compared to a plain dump of the same title.
+//
+// Usage: bench_dedup <output directory> [RomFS size in MiB] [read latency in us]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+
+#include "chunk_store.h"
+#include "output_file.h"
+#include "synthetic_title.h"
+#include "title_dumper.h"
+
+using Clock = std::chrono::steady_clock;
+
+// Title whose RomFS differs from another one in a few 4 KiB blocks
+class PatchedTitleArchive : public TitleArchive {
+public:
+    PatchedTitleArchive(TitleArchive& title, const std::vector<uint64_t>& patched_offsets) : title(title), patched_offsets(patched_offsets) {
+    }
+
+    Result OpenExeFSSection(const std::string& name, std::unique_ptr<ArchiveFile>* file) override {
+        return title.OpenExeFSSection(name, file);
+    }
+
+    Result OpenRomFS(std::unique_ptr<ArchiveFile>* file) override {
+        Result ret = title.OpenRomFS(file);
+        if (ret == 0)
+            file->reset(new PatchedFile(std::move(*file), patched_offsets));
+        return ret;
+    }
+
+private:
+    class PatchedFile : public ArchiveFile {
+    public:
+        PatchedFile(std::unique_ptr<ArchiveFile> file, const std::vector<uint64_t>& patched_offsets)
+            : file(std::move(file)), patched_offsets(patched_offsets) {
+        }
+
+        Result GetSize(uint64_t* size) override {
+            return file->GetSize(size);
+        }
+
+        Result Read(uint64_t offset, void* buffer, uint32_t size, uint32_t* bytes_read) override {
+            Result ret = file->Read(offset, buffer, size, bytes_read);
+            for (auto patched : patched_offsets) {
+                for (uint64_t pos = patched; pos < patched + 0x1000; pos += 0x100) {
+                    if (pos >= offset && pos < offset + *bytes_read)
+                        static_cast<uint8_t*>(buffer)[pos - offset] ^= 0xA5;
+                }
+            }
+            return ret;
+        }
+
+    private:
+        std::unique_ptr<ArchiveFile> file;
+        const std::vector<uint64_t>& patched_offsets;
+    };
+
+    TitleArchive& title;
+    std::vector<uint64_t> patched_offsets;
+};
+
+static std::unique_ptr<OutputFile> OpenOutput(const std::string& path, bool keep_contents, uint64_t* existing_size) {
+    std::unique_ptr<StdioOutputFile> output(new StdioOutputFile);
+    if (!output->Open(path, keep_contents))
+        std::fprintf(stderr, "Couldn't open \"%s\" for writing\n", path.c_str());
+    *existing_size = output->GetSize();
+    return std::move(output);
+}
+
+static bool FilesEqual(const std::string& path_a, const std::string& path_b) {
+    FILE* a = fopen(path_a.c_str(), "rb");
+    FILE* b = fopen(path_b.c_str(), "rb");
+    bool equal = a && b;
+    std::vector<uint8_t> buffer_a(0x100000), buffer_b(0x100000);
+    while (equal) {
+        size_t size_a = fread(buffer_a.data(), 1, buffer_a.size(), a);
+        size_t size_b = fread(buffer_b.data(), 1, buffer_b.size(), b);
+        equal = size_a == size_b && memcmp(buffer_a.data(), buffer_b.data(), size_a) == 0;
+        if (size_a == 0)
+            break;
+    }
+    if (a)
+        fclose(a);
+    if (b)
+        fclose(b);
+    return equal;
+}
+
+// Throughput of finding cut points alone, and including the SHA-256 hash identifying each chunk
+static void MeasureThroughput() {
+    std::vector<uint8_t> buffer(0x4000000);
+    uint64_t state = 0x2545F4914F6CDD1D;
+    for (auto& byte : buffer) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        byte = static_cast<uint8_t>(state);
+    }
+
+    for (bool hash : { false, true }) {
+        ContentChunker chunker(ContentChunker::Config{});
+        auto begin = Clock::now();
+        size_t num_chunks = 0;
+        uint8_t digest[Sha256::digest_size];
+        for (size_t offset = 0; offset < buffer.size(); ) {
+            bool cut;
+            size_t size = chunker.Scan(buffer.data() + offset, buffer.size() - offset, &cut);
+            if (hash)
+                Sha256::Hash(buffer.data() + offset, size, digest);
+            offset += size;
+            ++num_chunks;
+        }
+        double seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+        std::printf("%-24s %8.1f MiB/s (%zu chunks, %zu KiB on average)\n", hash ? "chunking and SHA-256:" : "chunking:",
+                    buffer.size() / (1024.0 * 1024.0) / seconds, num_chunks, buffer.size() / num_chunks / 1024);
+    }
+    std::printf("\n");
+}
+
+static void RemoveStore(const std::string& path) {
+    remove((path + "/chunks.pack").c_str());
+    remove((path + "/chunks.index").c_str());
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::fprintf(stderr, "Usage: %s <output directory> [RomFS size in MiB] [read latency in us]\n", argv[0]);
+        return 1;
+    }
+
+    MeasureThroughput();
+
+    const std::string output_dir = argv[1];
+    mkdir(output_dir.c_str(), 0755);
+    const std::string store_path = output_dir + "/chunks";
+    RemoveStore(store_path);
+
+    SyntheticTitleConfig base_config;
+    base_config.romfs_size = ((argc > 2) ? std::atoi(argv[2]) : 128) * uint64_t{1024 * 1024};
+    base_config.read_latency_us = (argc > 3) ? std::atoi(argv[3]) : 0;
+    SyntheticTitleArchive base(base_config);
+
+    SyntheticTitleConfig variant_config = base_config;
+    variant_config.code_size += 0x3000;
+    SyntheticTitleArchive variant_source(variant_config);
+    std::vector<uint64_t> patched_offsets;
+    for (uint64_t offset = 0x123000; offset < base_config.romfs_size; offset += base_config.romfs_size / 6)
+        patched_offsets.push_back(offset);
+    PatchedTitleArchive variant(variant_source, patched_offsets);
+
+    SyntheticTitleConfig other_config = base_config;
+    other_config.seed = 1;
+    SyntheticTitleArchive other(other_config);
+
+    struct Step {
+        const char* name;
+        const char* file_name;
+        TitleArchive* title;
+        uint64_t title_id;
+    } steps[] = {
+        { "base title", "base", &base, 0x0004000000100000 },
+        { "regional variant", "variant", &variant, 0x0004000000100100 },
+        { "base title again", "base_again", &base, 0x0004000000100000 },
+        { "unrelated title", "other", &other, 0x0004000000200000 },
+    };
+
+    DumpEnvironment environment;
+    environment.open_output = OpenOutput;
+    environment.make_directory = [](const std::string& path) {
+        mkdir(path.c_str(), 0755);
+    };
+
+    bool all_ok = true;
+    uint64_t total_image_size = 0;
+    uint64_t total_stored = 0;
+    std::printf("%18s %12s %12s %10s %10s %8s\n", "title", "image_kib", "stored_kib", "ratio", "seconds", "result");
+
+    // All titles are dumped with a single dumper, like a batch dump would
+    DumpOptions options;
+    options.resumable = false;
+    options.chunk_store_path = store_path;
+    TitleDumper dumper(options, environment);
+    for (auto& step : steps) {
+        TitleDumpRequest request;
+        request.title_id = step.title_id;
+        request.base_path = output_dir + "/" + step.file_name;
+
+        auto begin = Clock::now();
+        auto result = dumper.Dump(*step.title, request);
+        double seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+
+        // Plain dump for reference, and the image reassembled from the store
+        DumpOptions plain_options;
+        plain_options.resumable = false;
+        TitleDumpRequest plain_request = request;
+        plain_request.base_path = output_dir + "/reference";
+        {
+            TitleDumper plain_dumper(plain_options, environment);
+            plain_dumper.Dump(*step.title, plain_request);
+        }
+
+        ChunkStoreReader reader;
+        StdioOutputFile reassembled;
+        bool ok = result.success && reader.Open(store_path) && reassembled.Open(output_dir + "/reassembled.cxi") &&
+                  ReassembleImage(request.base_path + ".cxi.recipe", reader, reassembled);
+        reassembled.Close();
+        ok &= FilesEqual(output_dir + "/reassembled.cxi", plain_request.base_path + ".cxi");
+        all_ok &= ok;
+
+        total_image_size += result.image_size;
+        total_stored += result.stored_bytes;
+        // Titles that were stored entirely already have an infinite ratio, which is shown as 0
+        std::printf("%18s %12llu %12llu %10.2f %10.3f %8s\n", step.name, static_cast<unsigned long long>(result.image_size / 1024),
+                    static_cast<unsigned long long>(result.stored_bytes / 1024),
+                    result.stored_bytes ? static_cast<double>(result.image_size) / result.stored_bytes : 0.0, seconds, ok ? "ok" : "FAILED");
+    }
+    std::printf("%18s %12llu %12llu %10.2f\n", "library", static_cast<unsigned long long>(total_image_size / 1024),
+                static_cast<unsigned long long>(total_stored / 1024), static_cast<double>(total_image_size) / std::max<uint64_t>(total_stored, 1));
+
+    return all_ok ? 0 : 1;
+}
@@ -0,0 +1,130 @@
+// Dumps a series of synthetic titles of varying sizes with a single TitleDumper drawing its buffers from a
+// malloc-backed DumpArena, the way braindump uses one reserved from linear memory. After each title, the arena
+// must be back to holding just the output buffer, and no buffer may have fallen back to the heap. The series
+// is then dumped again with an undersized arena, which must fall back to the heap and produce identical images.
+// Empty buffers must take no memory at all.
+//
+// Usage: bench_dump_arena <output directory> [number of titles]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+
+#include "dump_arena.h"
+#include "output_file.h"
+#include "synthetic_title.h"
+#include "title_dumper.h"
+
+using Clock = std::chrono::steady_clock;
+
+static std::unique_ptr<OutputFile> OpenOutput(const std::string& path, bool keep_contents, uint64_t* existing_size) {
+    std::unique_ptr<StdioOutputFile> output(new StdioOutputFile);
+    if (!output->Open(path, keep_contents))
+        std::fprintf(stderr, "Couldn't open \"%s\" for writing\n", path.c_str());
+    *existing_size = output->GetSize();
+    return std::move(output);
+}
+
+static bool FilesEqual(const std::string& path_a, const std::string& path_b) {
+    FILE* a = fopen(path_a.c_str(), "rb");
+    FILE* b = fopen(path_b.c_str(), "rb");
+    bool equal = a && b;
+    std::vector<uint8_t> buffer_a(0x100000), buffer_b(0x100000);
+    while (equal) {
+        size_t size_a = fread(buffer_a.data(), 1, buffer_a.size(), a);
+        size_t size_b = fread(buffer_b.data(), 1, buffer_b.size(), b);
+        equal = size_a == size_b && memcmp(buffer_a.data(), buffer_b.data(), size_a) == 0;
+        if (size_a == 0)
+            break;
+    }
+    if (a)
+        fclose(a);
+    if (b)
+        fclose(b);
+    return equal;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::fprintf(stderr, "Usage: %s <output directory> [number of titles]\n", argv[0]);
+        return 1;
+    }
+
+    const std::string output_dir = argv[1];
+    mkdir(output_dir.c_str(), 0755);
+    const unsigned num_titles = (argc > 2) ? std::atoi(argv[2]) : 6;
+
+    // Sizes vary from title to title, such that buffers of different sizes are taken in each phase
+    std::vector<SyntheticTitleConfig> configs(num_titles);
+    for (unsigned index = 0; index < num_titles; ++index) {
+        configs[index].code_size = 0x80000 + index * 0x3F123;
+        configs[index].romfs_size = (uint64_t{1} << (index % 5)) * 4 * 1024 * 1024 + index * 0x1234;
+        configs[index].seed = index;
+    }
+
+    struct Run {
+        const char* name;
+        size_t arena_size;
+        bool expect_heap_fallback;
+    } runs[] = {
+        { "arena", TitleDumper::arena_size, false },
+        { "undersized", 0x100000, true },
+    };
+
+    bool all_ok = true;
+    std::printf("%12s %6s %10s %12s %12s %10s %8s\n", "run", "title", "seconds", "peak_kib", "used_kib", "fallbacks", "result");
+    for (auto& run : runs) {
+        DumpArena arena;
+        if (!arena.Reserve(run.arena_size, false)) {
+            std::fprintf(stderr, "Couldn't reserve the arena\n");
+            return 1;
+        }
+
+        DumpEnvironment environment;
+        environment.open_output = OpenOutput;
+        environment.arena = &arena;
+
+        DumpOptions options;
+        options.resumable = false;
+
+        TitleDumper dumper(options, environment);
+        const size_t baseline = arena.Used(); // The output buffer, which the dumper keeps
+        for (unsigned index = 0; index < num_titles; ++index) {
+            SyntheticTitleArchive title(configs[index]);
+            TitleDumpRequest request;
+            request.title_id = 0x0004000000100000 + index;
+            request.base_path = output_dir + "/" + run.name + std::to_string(index);
+
+            auto begin = Clock::now();
+            auto result = dumper.Dump(title, request);
+            double seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+
+            bool ok = result.success && arena.Used() == baseline && arena.HighWaterMark() <= arena.Capacity() &&
+                      (arena.FailedAllocations() != 0) == run.expect_heap_fallback;
+            if (&run != &runs[0])
+                ok &= FilesEqual(output_dir + "/" + runs[0].name + std::to_string(index) + ".cxi", request.base_path + ".cxi");
+            all_ok &= ok;
+
+            std::printf("%12s %6u %10.3f %12llu %12llu %10u %8s\n", run.name, index, seconds,
+                        static_cast<unsigned long long>(arena.HighWaterMark() / 1024), static_cast<unsigned long long>(arena.Used() / 1024),
+                        arena.FailedAllocations(), ok ? "ok" : "FAILED");
+        }
+    }
+
+    // Empty buffers must neither touch the heap nor count as falling back to it, even with the arena exhausted
+    DumpArena full_arena;
+    bool empty_ok = full_arena.Reserve(DumpArena::alignment, false) && full_arena.Allocate(DumpArena::alignment) != nullptr;
+    {
+        ArenaBuffer empty(&full_arena, 0), no_arena(nullptr, 0);
+        empty_ok &= empty.Data() == nullptr && no_arena.Data() == nullptr && full_arena.FailedAllocations() == 0;
+    }
+    std::printf("Empty buffers: %s\n", empty_ok ? "ok" : "FAILED");
+    all_ok &= empty_ok;
+
+    return all_ok ? 0 : 1;
+}
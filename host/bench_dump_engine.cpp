@@ -0,0 +1,98 @@
+// Drives the dump engine (DumpExeFS/DumpRomFS) against synthetic titles of various sizes, laid out
+// the same way braindump lays out the full NCCH image, and reports per-phase timings and memory use.
+//
+// Usage: bench_dump_engine <output> [RomFS sizes in MiB, comma-separated] [read latency in us] [.code size in KiB]
+//
+// Peak memory is the peak resident set size of the process so far, so runs should be ordered by increasing size.
+// Detailed telemetry of the last run is written to "<output>.perf.json".
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <sys/resource.h>
+
+#include "dump_engine.h"
+#include "output_file.h"
+#include "output_sink.h"
+#include "perf_telemetry.h"
+#include "synthetic_title.h"
+
+using Clock = std::chrono::steady_clock;
+
+static double SecondsSince(Clock::time_point begin) {
+    return std::chrono::duration<double>(Clock::now() - begin).count();
+}
+
+static double PeakMemoryMiB() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss / 1024.0; // ru_maxrss is in KiB on Linux
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <output> [RomFS sizes in MiB, comma-separated] [read latency in us] [.code size in KiB]" << std::endl;
+        return 1;
+    }
+
+    std::vector<uint64_t> romfs_sizes;
+    std::stringstream sizes_ss((argc > 2) ? argv[2] : "1,16,256");
+    for (std::string size; std::getline(sizes_ss, size, ',');)
+        romfs_sizes.push_back(std::strtoull(size.c_str(), nullptr, 0) * 1024 * 1024);
+
+    SyntheticTitleConfig config;
+    config.read_latency_us = (argc > 3) ? std::atoi(argv[3]) : 0;
+    if (argc > 4)
+        config.code_size = std::atoi(argv[4]) * 1024;
+
+    // Silence the progress output of the dump engine
+    auto cout_buffer = std::cout.rdbuf(nullptr);
+
+    std::printf("%10s %8s %10s %10s %10s %10s %10s %9s\n", "RomFS MiB", "status", "ExeFS s", "RomFS s", "flush s", "total s", "MiB/s", "peak MiB");
+    for (uint64_t romfs_size : romfs_sizes) {
+        config.romfs_size = romfs_size;
+        SyntheticTitleArchive synthetic_title(config);
+        PerfTelemetry perf;
+        InstrumentedTitleArchive title(synthetic_title, perf);
+
+        StdioOutputFile file;
+        if (!file.Open(argv[1])) {
+            std::cerr << "Couldn't open " << argv[1] << std::endl;
+            return 1;
+        }
+        InstrumentedOutputFile instrumented_file(file, perf);
+        OutputSink out(instrumented_file);
+
+        auto begin = Clock::now();
+        out.FillZero(0x200 + 0x800); // NCCH header and ExHeader placeholders
+
+        auto phase_begin = Clock::now();
+        bool success = DumpExeFS(title, out, nullptr, nullptr, &perf, nullptr, PrintTo(std::cerr), nullptr, nullptr) != 0;
+        double exefs_seconds = SecondsSince(phase_begin);
+        PadToNextMediaUnit(out, 0);
+
+        phase_begin = Clock::now();
+        success &= DumpRomFS(title, out, nullptr, nullptr, &perf, nullptr, nullptr, PrintTo(std::cerr), nullptr, nullptr);
+        double romfs_seconds = SecondsSince(phase_begin);
+        PadToNextMediaUnit(out, 0);
+
+        phase_begin = Clock::now();
+        success &= out.Flush();
+        double flush_seconds = SecondsSince(phase_begin);
+        double total_seconds = SecondsSince(begin);
+
+        std::printf("%10.0f %8s %10.3f %10.3f %10.3f %10.3f %10.2f %9.1f\n", romfs_size / (1024.0 * 1024.0), success ? "ok" : "FAILED",
+                    exefs_seconds, romfs_seconds, flush_seconds, total_seconds, out.Tell() / (1024.0 * 1024.0) / total_seconds, PeakMemoryMiB());
+        std::fflush(stdout);
+
+        perf.WriteJson(std::string(argv[1]) + ".perf.json", 0);
+    }
+
+    std::cout.rdbuf(cout_buffer);
+    return 0;
+}
@@ -0,0 +1,121 @@
+// Dumps a synthetic title whose RomFS holds a real file system, extracts the resulting image with
+// extract_cxi's engine using an increasing number of threads, and checks every extracted file against
+// the title contents.
+//
+// Usage: bench_extract <output directory> [RomFS size in MiB] [number of RomFS files]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/stat.h>
+
+#include "cxi_extractor.h"
+#include "output_file.h"
+#include "synthetic_title.h"
+#include "title_dumper.h"
+
+static std::unique_ptr<OutputFile> OpenOutput(const std::string& path, bool keep_contents, uint64_t* existing_size) {
+    std::unique_ptr<StdioOutputFile> output(new StdioOutputFile);
+    if (!output->Open(path, keep_contents))
+        std::fprintf(stderr, "Couldn't open \"%s\" for writing\n", path.c_str());
+    *existing_size = output->GetSize();
+    return std::move(output);
+}
+
+// Compare the file at "path" to the given range of an archive file
+static bool CheckFile(const std::string& path, ArchiveFile& source, uint64_t offset, uint64_t size) {
+    FILE* file = fopen(path.c_str(), "rb");
+    if (file == nullptr)
+        return false;
+
+    std::vector<uint8_t> expected(0x100000), actual(0x100000);
+    bool equal = true;
+    for (uint64_t done = 0; equal && done < size; ) {
+        uint32_t chunk = static_cast<uint32_t>(std::min<uint64_t>(expected.size(), size - done));
+        uint32_t bytes_read = 0;
+        equal = source.Read(offset + done, expected.data(), chunk, &bytes_read) == 0 && bytes_read == chunk &&
+                fread(actual.data(), 1, chunk, file) == chunk && memcmp(expected.data(), actual.data(), chunk) == 0;
+        done += chunk;
+    }
+    equal &= (fgetc(file) == EOF);
+    fclose(file);
+    return equal;
+}
+
+static bool CheckExtractedFiles(SyntheticTitleArchive& title, const std::string& dir) {
+    const struct {
+        const char* section;
+        const char* file;
+    } sections[] = { { ".code", "code.bin" }, { "banner", "banner.bin" }, { "icon", "icon.bin" }, { "logo", "logo.bin" } };
+
+    bool success = true;
+    for (auto& section : sections) {
+        std::unique_ptr<ArchiveFile> source;
+        uint64_t size = 0;
+        success &= title.OpenExeFSSection(section.section, &source) == 0 && source->GetSize(&size) == 0 &&
+                   CheckFile(dir + "/exefs/" + section.file, *source, 0, size);
+    }
+
+    std::unique_ptr<ArchiveFile> romfs;
+    if (title.OpenRomFS(&romfs) != 0)
+        return false;
+    for (auto& file : title.RomFSFiles()) {
+        if (!CheckFile(dir + "/romfs/" + file.path, *romfs, file.offset, file.size)) {
+            std::printf("Mismatch in romfs/%s\n", file.path.c_str());
+            success = false;
+        }
+    }
+    return success;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::fprintf(stderr, "Usage: %s <output directory> [RomFS size in MiB] [number of RomFS files]\n", argv[0]);
+        return 1;
+    }
+
+    const std::string output_dir = argv[1];
+    mkdir(output_dir.c_str(), 0755);
+
+    SyntheticTitleConfig config;
+    config.romfs_size = ((argc > 2) ? std::atoi(argv[2]) : 256) * uint64_t{1024 * 1024};
+    config.romfs_num_files = (argc > 3) ? std::atoi(argv[3]) : 2000;
+    SyntheticTitleArchive title(config);
+
+    DumpOptions options;
+    options.resumable = false;
+    DumpEnvironment environment;
+    environment.open_output = OpenOutput;
+    TitleDumpRequest request;
+    request.title_id = 0x0004000000100000;
+    request.base_path = output_dir + "/0004000000100000";
+    {
+        TitleDumper dumper(options, environment);
+        if (!dumper.Dump(title, request).success) {
+            std::printf("Couldn't dump the synthetic title\n");
+            return 1;
+        }
+    }
+
+    bool all_ok = true;
+    std::printf("%8s %10s %10s %8s\n", "threads", "seconds", "MiB/s", "files");
+    const unsigned max_threads = std::max(4u, std::thread::hardware_concurrency());
+    for (unsigned num_threads = 1; num_threads <= max_threads; num_threads *= 2) {
+        const std::string extract_dir = output_dir + "/extracted_" + std::to_string(num_threads);
+        auto begin = std::chrono::steady_clock::now();
+        ExtractStats stats;
+        bool success = ExtractImage(request.base_path + ".cxi", extract_dir, num_threads, &stats);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+        success &= stats.num_files == 4 + title.RomFSFiles().size() && CheckExtractedFiles(title, extract_dir);
+        all_ok &= success;
+        std::printf("%8u %10.3f %10.1f %8s\n", num_threads, seconds, stats.bytes / (1024.0 * 1024.0) / seconds, success ? "ok" : "FAILED");
+    }
+
+    return all_ok ? 0 : 1;
+}
@@ -0,0 +1,226 @@
+// Runs the FCRAM dump pipeline against a mock DMA backend, which emulates an address space with
+// mapped, unmapped and zero-filled regions along with DMA and SD card transfer times.
+//
+// The pipelined dumper (large transfers, several buffers, only mapped regions, zero blocks skipped) is
+// compared against the previous approach (64 KiB transfers, one at a time, copying the whole range).
+// Both outputs are checked against the emulated memory contents.
+//
+// Usage: bench_fcram_dump <output> [emulated FCRAM size in MiB] [DMA MiB/s] [SD MiB/s]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "fcram_dump.h"
+#include "output_file.h"
+
+using Clock = std::chrono::steady_clock;
+
+static void SleepFor(double seconds) {
+    std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+}
+
+// SplitMix64 finalizer, used to generate memory contents
+static uint64_t Mix(uint64_t value) {
+    value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ull;
+    value = (value ^ (value >> 27)) * 0x94D049BB133111EBull;
+    return value ^ (value >> 31);
+}
+
+class MockDmaBackend : public DmaBackend {
+public:
+    // Emulate "size" bytes of memory at "base". Regions are laid out at fixed fractions of the size.
+    MockDmaBackend(uint32_t base, uint32_t size, double dma_mib_per_s) : base(base), memory(size), dma_mib_per_s(dma_mib_per_s) {
+        const uint32_t unit = size / 16;
+        const uint32_t rw = 3, read_only = 1;
+        AddRegion(0, 4 * unit, rw, 1);
+        // 4 * unit: unmapped
+        AddRegion(6 * unit, 2 * unit, read_only, 2);
+        AddRegion(8 * unit, 1 * unit, 0, 3); // Mapped, but not readable
+        AddRegion(9 * unit, 3 * unit, rw, 1, true);
+        AddRegion(15 * unit, 1 * unit, rw, 1);
+    }
+
+    // Report the whole range as a single readable region, like the dumper used to assume
+    bool map_everything = false;
+
+    const std::vector<uint8_t>& Memory() const {
+        return memory;
+    }
+
+    bool QueryRegion(uint32_t address, MemoryRegion* region) override {
+        if (address < base || address - base >= memory.size())
+            return false;
+
+        if (map_everything) {
+            *region = MemoryRegion{ base, static_cast<uint32_t>(memory.size()), 3, 1 };
+            return true;
+        }
+
+        // Find the region containing "address", or the gap up to the next region
+        uint32_t gap_begin = base;
+        uint32_t gap_end = base + static_cast<uint32_t>(memory.size());
+        for (auto& mapped : regions) {
+            if (address >= mapped.address && address - mapped.address < mapped.size) {
+                *region = mapped;
+                return true;
+            }
+            if (mapped.address + mapped.size <= address)
+                gap_begin = std::max(gap_begin, mapped.address + mapped.size);
+            else
+                gap_end = std::min(gap_end, mapped.address);
+        }
+        *region = MemoryRegion{ gap_begin, gap_end - gap_begin, 0, 0 };
+        return true;
+    }
+
+    bool IsDumpable(const MemoryRegion& region) override {
+        return region.state != 0 && (region.permission & 1);
+    }
+
+    uint8_t* AllocateBuffer(uint32_t size) override {
+        return new uint8_t[size];
+    }
+
+    void FreeBuffer(uint8_t* buffer) override {
+        delete[] buffer;
+    }
+
+    bool StartTransfer(uint32_t address, uint8_t* buffer, uint32_t size) override {
+        if (address < base || address - base + uint64_t{ size } > memory.size())
+            return false;
+
+        pending_source = address - base;
+        transfer_end = Clock::now() + std::chrono::duration_cast<Clock::duration>(
+                                          std::chrono::duration<double>(20e-6 + size / (dma_mib_per_s * 1024 * 1024)));
+        return true;
+    }
+
+    bool FinishTransfer(uint8_t* buffer, uint32_t size) override {
+        std::this_thread::sleep_until(transfer_end);
+        memcpy(buffer, memory.data() + pending_source, size);
+        return true;
+    }
+
+private:
+    void AddRegion(uint32_t offset, uint32_t size, uint32_t permission, uint32_t state, bool zero_filled = false) {
+        regions.push_back(MemoryRegion{ base + offset, size, permission, state });
+        if (zero_filled || !(permission & 1))
+            return;
+
+        for (uint32_t pos = 0; pos < size; pos += sizeof(uint64_t)) {
+            uint64_t word = Mix(offset + pos);
+            memcpy(memory.data() + offset + pos, &word, sizeof(word));
+        }
+    }
+
+    uint32_t base;
+    std::vector<uint8_t> memory;
+    std::vector<MemoryRegion> regions;
+    double dma_mib_per_s;
+
+    uint32_t pending_source = 0;
+    Clock::time_point transfer_end;
+};
+
+// OutputFile emulating the transfer time of an SD card
+class ThrottledOutputFile : public OutputFile {
+public:
+    ThrottledOutputFile(OutputFile& file, double mib_per_s) : file(file), mib_per_s(mib_per_s) {
+    }
+
+    bool WriteAt(uint64_t offset, const void* data, size_t size) override {
+        SleepFor(size / (mib_per_s * 1024 * 1024));
+        return file.WriteAt(offset, data, size);
+    }
+
+    bool Flush() override {
+        return file.Flush();
+    }
+
+    bool SetSize(uint64_t size) override {
+        return file.SetSize(size);
+    }
+
+    bool ZeroFillsGaps() const override {
+        return file.ZeroFillsGaps();
+    }
+
+private:
+    OutputFile& file;
+    double mib_per_s;
+};
+
+static bool Verify(const char* path, const std::vector<uint8_t>& expected) {
+    FILE* file = fopen(path, "rb");
+    if (file == nullptr)
+        return false;
+
+    std::vector<uint8_t> data(expected.size() + 1);
+    size_t size = fread(data.data(), 1, data.size(), file);
+    fclose(file);
+    return size == expected.size() && memcmp(data.data(), expected.data(), size) == 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::fprintf(stderr, "Usage: %s <output> [emulated FCRAM size in MiB] [DMA MiB/s] [SD MiB/s]\n", argv[0]);
+        return 1;
+    }
+
+    const uint32_t base = 0x14000000;
+    const uint32_t size = ((argc > 2) ? std::atoi(argv[2]) : 64) * 1024 * 1024;
+    const double dma_mib_per_s = (argc > 3) ? std::atof(argv[3]) : 100.0;
+    const double sd_mib_per_s = (argc > 4) ? std::atof(argv[4]) : 8.0;
+
+    MockDmaBackend backend(base, size, dma_mib_per_s);
+
+    // Memory contents as they should appear in the dump: non-readable regions can't be dumped, so they read as zero
+    const auto& expected = backend.Memory();
+
+    struct {
+        const char* name;
+        bool pipelined;
+    } modes[] = { { "serial", false }, { "pipelined", true } };
+
+    bool all_ok = true;
+    std::printf("%10s %8s %8s %10s %10s %10s %8s\n", "mode", "regions", "copied", "written", "seconds", "MiB/s", "verify");
+    for (auto& mode : modes) {
+        StdioOutputFile file;
+        if (!file.Open(argv[1])) {
+            std::fprintf(stderr, "Couldn't open %s\n", argv[1]);
+            return 1;
+        }
+        ThrottledOutputFile throttled(file, sd_mib_per_s);
+        SparseOutputFile sparse(throttled);
+
+        FcramDumpConfig config;
+        if (!mode.pipelined) {
+            config.transfer_size = 0x10000;
+            config.num_buffers = 1;
+        }
+        backend.map_everything = !mode.pipelined;
+
+        auto begin = Clock::now();
+        auto result = DumpFcram(backend, base, base + size, mode.pipelined ? static_cast<OutputFile&>(sparse) : throttled, config, nullptr);
+        double seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+
+        uint64_t written = mode.pipelined ? sparse.WrittenBytes() : result.bytes_copied;
+        bool ok = result.Succeeded() && Verify(argv[1], expected);
+        all_ok &= ok;
+        std::printf("%10s %8zu %7.1fM %9.1fM %10.3f %10.2f %8s\n", mode.name, result.regions.size(), result.bytes_copied / (1024.0 * 1024.0),
+                    written / (1024.0 * 1024.0), seconds, size / (1024.0 * 1024.0) / seconds, ok ? "ok" : "FAILED");
+        std::fflush(stdout);
+
+        if (mode.pipelined) {
+            std::string index_path = std::string(argv[1]) + ".regions";
+            all_ok &= WriteRegionIndex(index_path, result.regions);
+            std::printf("Region index written to %s\n", index_path.c_str());
+        }
+    }
+
+    return all_ok ? 0 : 1;
+}
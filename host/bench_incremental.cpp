@@ -0,0 +1,192 @@
+// Compares incremental re-dumps against full dumps. A synthetic title is dumped once, then dumped again
+// unchanged and with a few scattered RomFS blocks modified (as a title update would), each time patching
+// the previous image in place. The patched images must be identical to fresh dumps of the same title, and
+// the checksum manifests written along with them must match the images.
+//
+// Usage: bench_incremental <output directory> [RomFS size in MiB] [modified blocks] [read latency in us]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+
+#include "checksum_manifest.h"
+#include "dump_verifier.h"
+#include "output_file.h"
+#include "stdio_archive_file.h"
+#include "synthetic_title.h"
+#include "title_dumper.h"
+
+using Clock = std::chrono::steady_clock;
+
+// Title whose RomFS differs from another one in a few 4 KiB blocks
+class PatchedTitleArchive : public TitleArchive {
+public:
+    PatchedTitleArchive(TitleArchive& title, const std::vector<uint64_t>& patched_offsets) : title(title), patched_offsets(patched_offsets) {
+    }
+
+    Result OpenExeFSSection(const std::string& name, std::unique_ptr<ArchiveFile>* file) override {
+        return title.OpenExeFSSection(name, file);
+    }
+
+    Result OpenRomFS(std::unique_ptr<ArchiveFile>* file) override {
+        Result ret = title.OpenRomFS(file);
+        if (ret == 0)
+            file->reset(new PatchedFile(std::move(*file), patched_offsets));
+        return ret;
+    }
+
+private:
+    class PatchedFile : public ArchiveFile {
+    public:
+        PatchedFile(std::unique_ptr<ArchiveFile> file, const std::vector<uint64_t>& patched_offsets)
+            : file(std::move(file)), patched_offsets(patched_offsets) {
+        }
+
+        Result GetSize(uint64_t* size) override {
+            return file->GetSize(size);
+        }
+
+        Result Read(uint64_t offset, void* buffer, uint32_t size, uint32_t* bytes_read) override {
+            Result ret = file->Read(offset, buffer, size, bytes_read);
+            for (auto patched : patched_offsets) {
+                for (uint64_t pos = patched; pos < patched + 0x1000; pos += 0x100) {
+                    if (pos >= offset && pos < offset + *bytes_read)
+                        static_cast<uint8_t*>(buffer)[pos - offset] ^= 0xA5;
+                }
+            }
+            return ret;
+        }
+
+    private:
+        std::unique_ptr<ArchiveFile> file;
+        const std::vector<uint64_t>& patched_offsets;
+    };
+
+    TitleArchive& title;
+    std::vector<uint64_t> patched_offsets;
+};
+
+static std::unique_ptr<OutputFile> OpenOutput(const std::string& path, bool keep_contents, uint64_t* existing_size) {
+    std::unique_ptr<StdioOutputFile> output(new StdioOutputFile);
+    if (!output->Open(path, keep_contents))
+        std::fprintf(stderr, "Couldn't open \"%s\" for writing\n", path.c_str());
+    *existing_size = output->GetSize();
+    return std::move(output);
+}
+
+static std::unique_ptr<ArchiveFile> OpenInput(const std::string& path) {
+    std::unique_ptr<StdioArchiveFile> input(new StdioArchiveFile);
+    if (!input->Open(path))
+        return nullptr;
+    return std::move(input);
+}
+
+static bool FilesEqual(const std::string& path_a, const std::string& path_b) {
+    FILE* a = fopen(path_a.c_str(), "rb");
+    FILE* b = fopen(path_b.c_str(), "rb");
+    bool equal = a && b;
+    std::vector<uint8_t> buffer_a(0x100000), buffer_b(0x100000);
+    while (equal) {
+        size_t size_a = fread(buffer_a.data(), 1, buffer_a.size(), a);
+        size_t size_b = fread(buffer_b.data(), 1, buffer_b.size(), b);
+        equal = size_a == size_b && memcmp(buffer_a.data(), buffer_b.data(), size_a) == 0;
+        if (size_a == 0)
+            break;
+    }
+    if (a)
+        fclose(a);
+    if (b)
+        fclose(b);
+    return equal;
+}
+
+// Check that the manifest written next to an image describes it
+static bool ManifestMatches(const std::string& base_path) {
+    ChecksumManifest manifest;
+    StdioArchiveFile image;
+    return manifest.Read(base_path + ".checksums") && image.Open(base_path + ".cxi") && VerifyManifest(image, manifest, nullptr, PrintTo(std::cerr)).success;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::fprintf(stderr, "Usage: %s <output directory> [RomFS size in MiB] [modified blocks] [read latency in us]\n", argv[0]);
+        return 1;
+    }
+
+    const std::string output_dir = argv[1];
+    mkdir(output_dir.c_str(), 0755);
+
+    SyntheticTitleConfig config;
+    config.romfs_size = ((argc > 2) ? std::atoi(argv[2]) : 256) * uint64_t{1024 * 1024};
+    const unsigned num_patched = (argc > 3) ? std::atoi(argv[3]) : 8;
+    config.read_latency_us = (argc > 4) ? std::atoi(argv[4]) : 0;
+    SyntheticTitleArchive original(config);
+
+    std::vector<uint64_t> patched_offsets;
+    for (unsigned index = 0; index < num_patched; ++index)
+        patched_offsets.push_back((config.romfs_size / num_patched * index + 0x12345) / 0x1000 * 0x1000);
+    PatchedTitleArchive updated(original, patched_offsets);
+
+    DumpEnvironment environment;
+    environment.open_output = OpenOutput;
+    environment.open_input = OpenInput;
+
+    const std::string incremental_base = output_dir + "/0004000000100000";
+    const std::string reference_base = output_dir + "/reference";
+    remove((incremental_base + ".checksums").c_str());
+    remove((incremental_base + ".cxi").c_str());
+
+    struct Step {
+        const char* name;
+        TitleArchive* title;
+    } steps[] = {
+        { "initial dump", &original },
+        { "unchanged title", &original },
+        { "updated title", &updated },
+    };
+
+    bool all_ok = true;
+    std::printf("%16s %12s %12s %14s %12s %8s\n", "step", "full_s", "incr_s", "written_kib", "same_kib", "result");
+    for (auto& step : steps) {
+        TitleDumpRequest request;
+        request.title_id = 0x0004000000100000;
+
+        // Fresh dump for reference
+        DumpOptions options;
+        options.resumable = false;
+        request.base_path = reference_base;
+        auto begin = Clock::now();
+        TitleDumpResult reference;
+        {
+            TitleDumper dumper(options, environment);
+            reference = dumper.Dump(*step.title, request);
+        }
+        double full_seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+
+        options.incremental = true;
+        request.base_path = incremental_base;
+        begin = Clock::now();
+        TitleDumpResult result;
+        {
+            TitleDumper dumper(options, environment);
+            result = dumper.Dump(*step.title, request);
+        }
+        double incremental_seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+
+        bool ok = reference.success && result.success && FilesEqual(reference_base + ".cxi", incremental_base + ".cxi") &&
+                  ManifestMatches(incremental_base);
+        all_ok &= ok;
+        uint64_t written = result.image_size - result.unchanged_bytes;
+        std::printf("%16s %12.3f %12.3f %14llu %12llu %8s\n", step.name, full_seconds, incremental_seconds,
+                    static_cast<unsigned long long>(written / 1024), static_cast<unsigned long long>(result.unchanged_bytes / 1024),
+                    ok ? "ok" : "FAILED");
+    }
+
+    return all_ok ? 0 : 1;
+}
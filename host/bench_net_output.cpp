@@ -0,0 +1,63 @@
+// Compares writing a dump to a local file (standing in for the SD card) against streaming it to
+// net_receiver over TCP. Start net_receiver first, e.g. "net_receiver /tmp/received 5000".
+//
+// Usage: bench_net_output <output> <receiver address> [port] [size in MiB]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "output_file.h"
+#include "output_sink.h"
+#include "socket_output_file.h"
+
+template<typename Func>
+static void RunBenchmark(const char* name, uint64_t size, Func&& func) {
+    auto begin = std::chrono::steady_clock::now();
+    bool success = func();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+    std::printf("%-20s %s %8.3f s %9.2f MiB/s\n", name, success ? "ok    " : "FAILED", seconds,
+                size / (1024.0 * 1024.0) / seconds);
+}
+
+// Write "data" in chunks the size of the RomFS pipeline buffers, then patch the header like main does
+static bool WriteImage(OutputFile& file, const std::vector<uint8_t>& data) {
+    const size_t chunk_size = 0x100000;
+    OutputSink sink(file);
+    sink.FillZero(0x200);
+    for (size_t offset = 0x200; offset < data.size(); offset += chunk_size)
+        sink.Write(data.data() + offset, std::min(chunk_size, data.size() - offset));
+    sink.Patch(0, data.data(), 0x200);
+    return sink.Flush();
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0] << " <output> <receiver address> [port] [size in MiB]" << std::endl;
+        return 1;
+    }
+
+    uint16_t port = (argc > 3) ? std::atoi(argv[3]) : 5000;
+    uint64_t size = ((argc > 4) ? std::atoi(argv[4]) : 256) * uint64_t { 1024 * 1024 };
+
+    std::vector<uint8_t> data(size);
+    std::mt19937 rng(0);
+    std::generate(data.begin(), data.end(), [&rng] { return static_cast<uint8_t>(rng()); });
+
+    RunBenchmark("local file", size, [&] {
+        StdioOutputFile file;
+        return file.Open(argv[1]) && WriteImage(file, data);
+    });
+
+    RunBenchmark("socket", size, [&] {
+        SocketOutputFile file;
+        return file.Open(argv[2], port, "bench_net_output.bin") && WriteImage(file, data);
+    });
+
+    return 0;
+}
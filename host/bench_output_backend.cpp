@@ -0,0 +1,194 @@
+// Compares output backends for dumping a synthetic title: The stdio path (newlib's sdmc: devoptab on the 3DS),
+// plain pwrite, pwrite with the images preallocated using posix_fallocate, and pwrite with preallocation that leaves
+// stale data in the reserved space (the stand-in for FSOutputFile with FSFILE_SetSize). The full image and standalone
+// ExeFS and RomFS images are produced; timings include committing the files to the disk. All backends must produce
+// identical files of the predicted sizes. Zero-filled blocks must be skipped by all backends except the stale one,
+// which has them written instead.
+//
+// Usage: bench_output_backend <output directory> [RomFS size in MiB] [repetitions]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "dump_engine.h"
+#include "output_file.h"
+#include "posix_output_file.h"
+#include "synthetic_title.h"
+#include "title_dumper.h"
+
+using Clock = std::chrono::steady_clock;
+
+// pwrite backend without preallocation
+class UnallocatedOutputFile : public PosixOutputFile {
+public:
+    bool Preallocate(uint64_t size) override {
+        return false;
+    }
+};
+
+// pwrite backend whose preallocated space holds stale data, like clusters reserved by FSFILE_SetSize
+class StaleOutputFile : public PosixOutputFile {
+public:
+    bool Preallocate(uint64_t size) override {
+        std::vector<uint8_t> stale(0x10000, 0xA5);
+        for (uint64_t offset = GetSize(); offset < size; offset += stale.size()) {
+            if (!WriteAt(offset, stale.data(), std::min<uint64_t>(stale.size(), size - offset)))
+                return false;
+        }
+        return true;
+    }
+
+    bool ZeroFillsGaps() const override {
+        return false;
+    }
+};
+
+template<typename File>
+static std::unique_ptr<OutputFile> OpenOutput(const std::string& path, bool keep_contents, uint64_t* existing_size) {
+    std::unique_ptr<File> output(new File);
+    if (!output->Open(path, keep_contents))
+        std::fprintf(stderr, "Couldn't open \"%s\" for writing\n", path.c_str());
+    *existing_size = output->GetSize();
+    return std::move(output);
+}
+
+static bool SyncFile(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    bool success = fd >= 0 && fsync(fd) == 0;
+    if (fd >= 0)
+        close(fd);
+    return success;
+}
+
+static uint64_t FileSize(const std::string& path) {
+    struct stat st;
+    return stat(path.c_str(), &st) == 0 ? st.st_size : 0;
+}
+
+static bool FilesEqual(const std::string& path_a, const std::string& path_b) {
+    FILE* a = fopen(path_a.c_str(), "rb");
+    FILE* b = fopen(path_b.c_str(), "rb");
+    bool equal = a && b;
+    std::vector<uint8_t> buffer_a(0x100000), buffer_b(0x100000);
+    while (equal) {
+        size_t size_a = fread(buffer_a.data(), 1, buffer_a.size(), a);
+        size_t size_b = fread(buffer_b.data(), 1, buffer_b.size(), b);
+        equal = size_a == size_b && memcmp(buffer_a.data(), buffer_b.data(), size_a) == 0;
+        if (size_a == 0)
+            break;
+    }
+    if (a)
+        fclose(a);
+    if (b)
+        fclose(b);
+    return equal;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::fprintf(stderr, "Usage: %s <output directory> [RomFS size in MiB] [repetitions]\n", argv[0]);
+        return 1;
+    }
+
+    const std::string output_dir = argv[1];
+    mkdir(output_dir.c_str(), 0755);
+
+    SyntheticTitleConfig config;
+    config.romfs_size = ((argc > 2) ? std::atoi(argv[2]) : 256) * uint64_t{1024 * 1024};
+    const unsigned repetitions = (argc > 3) ? std::atoi(argv[3]) : 3;
+    SyntheticTitleArchive title(config);
+
+    ImageLayout layout;
+    if (!PredictImageLayout(title, &layout)) {
+        std::fprintf(stderr, "Couldn't query the title's sizes\n");
+        return 1;
+    }
+
+    struct Backend {
+        const char* name;
+        std::function<std::unique_ptr<OutputFile>(const std::string&, bool, uint64_t*)> open_output;
+        bool skips_zeros;
+    } backends[] = {
+        { "stdio", OpenOutput<StdioOutputFile>, true },
+        { "pwrite", OpenOutput<UnallocatedOutputFile>, true },
+        { "pwrite+fallocate", OpenOutput<PosixOutputFile>, true },
+        { "pwrite+stale", OpenOutput<StaleOutputFile>, false },
+    };
+
+    DumpOptions options;
+    options.resumable = false;
+    options.standalone_exefs = true;
+    options.standalone_romfs = true;
+
+    bool all_ok = true;
+    std::string reference_base;
+    std::printf("%18s %10s %10s %10s %12s %12s %8s\n", "backend", "dump_s", "sync_s", "mib_s", "alloc_kib", "skipped_kib", "result");
+    for (auto& backend : backends) {
+        const std::string base_path = output_dir + "/" + backend.name;
+        if (reference_base.empty())
+            reference_base = base_path;
+
+        DumpEnvironment environment;
+        environment.open_output = backend.open_output;
+        environment.make_directory = [](const std::string& path) {
+            mkdir(path.c_str(), 0755);
+        };
+
+        // Keep the fastest run, to reduce noise from other disk activity
+        double best_dump = 0, best_sync = 0;
+        uint64_t skipped_bytes = 0;
+        bool ok = true;
+        for (unsigned run = 0; run < repetitions; ++run) {
+            for (auto suffix : { ".cxi", "/exefs.bin", "/romfs.bin" })
+                remove((base_path + suffix).c_str());
+
+            TitleDumpRequest request;
+            request.title_id = 0x0004000000100000;
+            request.base_path = base_path;
+
+            auto begin = Clock::now();
+            TitleDumpResult result;
+            {
+                TitleDumper dumper(options, environment);
+                result = dumper.Dump(title, request);
+            }
+            auto dumped = Clock::now();
+            for (auto suffix : { ".cxi", "/exefs.bin", "/romfs.bin" })
+                ok &= SyncFile(base_path + suffix);
+            auto synced = Clock::now();
+
+            ok &= result.success && result.image_size == layout.image_size && (result.skipped_bytes != 0) == backend.skips_zeros;
+            skipped_bytes = result.skipped_bytes;
+            double dump_seconds = std::chrono::duration<double>(dumped - begin).count();
+            double sync_seconds = std::chrono::duration<double>(synced - dumped).count();
+            if (run == 0 || dump_seconds + sync_seconds < best_dump + best_sync) {
+                best_dump = dump_seconds;
+                best_sync = sync_seconds;
+            }
+        }
+
+        ok &= FileSize(base_path + ".cxi") == layout.image_size && FileSize(base_path + "/exefs.bin") == layout.exefs_size &&
+              FileSize(base_path + "/romfs.bin") == layout.romfs_size;
+        for (auto suffix : { ".cxi", "/exefs.bin", "/romfs.bin" })
+            ok &= FilesEqual(reference_base + suffix, base_path + suffix);
+        all_ok &= ok;
+
+        struct stat st;
+        uint64_t allocated = (stat((base_path + ".cxi").c_str(), &st) == 0) ? st.st_blocks * uint64_t{512} : 0;
+        std::printf("%18s %10.3f %10.3f %10.1f %12llu %12llu %8s\n", backend.name, best_dump, best_sync,
+                    layout.image_size / (1024.0 * 1024.0) / (best_dump + best_sync), static_cast<unsigned long long>(allocated / 1024),
+                    static_cast<unsigned long long>(skipped_bytes / 1024), ok ? "ok" : "FAILED");
+    }
+
+    return all_ok ? 0 : 1;
+}
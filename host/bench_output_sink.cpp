@@ -0,0 +1,90 @@
+// Compares writing ExeFS-like data through std::ofstream (one put() per byte, as braindump used to do)
+// against bulk ofstream writes and against OutputSink.
+//
+// Usage: bench_output_sink <output> [section size in KiB]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <vector>
+
+#include "output_file.h"
+#include "output_sink.h"
+
+// Simulated ExeFS layout: header placeholder, then each section padded to the media unit size
+static const unsigned num_sections = 4;
+
+static uint32_t RoundUpToMediaUnit(uint32_t value) {
+    return (value + 0x1FF) / 0x200 * 0x200;
+}
+
+template<typename Func>
+static void RunBenchmark(const char* name, uint64_t size, Func&& func) {
+    auto begin = std::chrono::steady_clock::now();
+    bool success = func();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+    std::printf("%-20s %s %8.3f s %9.2f MiB/s\n", name, success ? "ok    " : "FAILED", seconds,
+                size / (1024.0 * 1024.0) / seconds);
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <output> [section size in KiB]" << std::endl;
+        return 1;
+    }
+
+    uint32_t section_size = ((argc > 2) ? std::atoi(argv[2]) : 8192) * 1024 + 123;
+    std::vector<uint8_t> section(section_size);
+    std::generate(section.begin(), section.end(), [n = 0u]() mutable { return static_cast<uint8_t>(n++ * 7); });
+
+    uint64_t total_size = 0x200 + num_sections * RoundUpToMediaUnit(section_size);
+
+    RunBenchmark("ofstream per-byte", total_size, [&] {
+        std::ofstream file(argv[1], std::ios_base::binary | std::ios_base::out | std::ios_base::trunc);
+        std::generate_n(std::ostream_iterator<uint8_t>(file), 0x200, [] { return 0; });
+        for (unsigned i = 0; i < num_sections; ++i) {
+            std::copy(section.begin(), section.end(), std::ostream_iterator<uint8_t>(file));
+            std::generate_n(std::ostream_iterator<char>(file), RoundUpToMediaUnit(section_size) - section_size, [] { return 0; });
+        }
+        file.seekp(0);
+        file.write(reinterpret_cast<const char*>(section.data()), 0x200);
+        file.flush();
+        return file.good();
+    });
+
+    RunBenchmark("ofstream bulk", total_size, [&] {
+        std::ofstream file(argv[1], std::ios_base::binary | std::ios_base::out | std::ios_base::trunc);
+        std::vector<char> zeros(0x200);
+        file.write(zeros.data(), 0x200);
+        for (unsigned i = 0; i < num_sections; ++i) {
+            file.write(reinterpret_cast<const char*>(section.data()), section.size());
+            file.write(zeros.data(), RoundUpToMediaUnit(section_size) - section_size);
+        }
+        file.seekp(0);
+        file.write(reinterpret_cast<const char*>(section.data()), 0x200);
+        file.flush();
+        return file.good();
+    });
+
+    RunBenchmark("OutputSink", total_size, [&] {
+        StdioOutputFile file;
+        if (!file.Open(argv[1]))
+            return false;
+        OutputSink sink(file);
+        sink.FillZero(0x200);
+        for (unsigned i = 0; i < num_sections; ++i) {
+            uint64_t section_begin = sink.Tell();
+            sink.Write(section.data(), section.size());
+            sink.PadTo(0x200, section_begin);
+        }
+        sink.Patch(0, section.data(), 0x200);
+        return sink.Flush();
+    });
+
+    return 0;
+}
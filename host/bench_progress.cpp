@@ -0,0 +1,167 @@
+// Measures how much the dump loop is slowed down by printing progress to the console. The dump engine
+// is run against a synthetic title three times:
+// - "inline": progress is printed from the dumping thread after every write, like braindump used to
+// - "vblank": progress is rendered by a separate thread at most once per display refresh
+// - "none": progress isn't printed at all
+//
+// The libctru console renders text in software, which is much slower than a terminal on the host. The console
+// is emulated by busy-waiting for a configurable time per character printed (the default is an assumption,
+// not a measurement).
+//
+// Each mode is run several times, interleaved with the other modes, and the fastest run is reported.
+//
+// Usage: bench_progress <output> [RomFS size in MiB] [read latency in us] [console cost per character in us] [runs]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <streambuf>
+#include <type_traits>
+
+#include "dump_engine.h"
+#include "dump_progress.h"
+#include "output_file.h"
+#include "output_sink.h"
+#include "perf_telemetry.h"
+#include "synthetic_title.h"
+
+using Clock = std::chrono::steady_clock;
+
+// Stream buffer that discards its output after spending the given time per character
+class EmulatedConsoleBuffer : public std::streambuf {
+public:
+    explicit EmulatedConsoleBuffer(double us_per_char) : us_per_char(us_per_char) {
+    }
+
+protected:
+    int_type overflow(int_type ch) override {
+        Render(1);
+        return traits_type::not_eof(ch);
+    }
+
+    std::streamsize xsputn(const char*, std::streamsize count) override {
+        Render(count);
+        return count;
+    }
+
+private:
+    void Render(std::streamsize count) {
+        auto end = Clock::now() + std::chrono::duration<double, std::micro>(us_per_char * count);
+        while (Clock::now() < end) {
+        }
+    }
+
+    double us_per_char;
+};
+
+// OutputFile rendering progress after every write, i.e. on the critical path of the dump
+class RenderingOutputFile : public OutputFile {
+public:
+    RenderingOutputFile(OutputFile& file, ProgressRenderer& renderer) : file(file), renderer(renderer) {
+    }
+
+    bool WriteAt(uint64_t offset, const void* data, size_t size) override {
+        bool result = file.WriteAt(offset, data, size);
+        renderer.Render();
+        return result;
+    }
+
+    bool Flush() override {
+        return file.Flush();
+    }
+
+private:
+    OutputFile& file;
+    ProgressRenderer& renderer;
+};
+
+enum class Mode { Inline, VBlank, None };
+
+struct RunResult {
+    bool success;
+    double seconds;
+    double console_seconds;
+    uint64_t bytes;
+};
+
+static RunResult Run(Mode mode, const SyntheticTitleConfig& config, const char* output_path, std::ostream& console) {
+    SyntheticTitleArchive title(config);
+    PerfTelemetry perf;
+    DumpProgress progress;
+    DumpProgress* progress_ptr = (mode == Mode::None) ? nullptr : &progress;
+
+    StdioOutputFile file;
+    if (!file.Open(output_path))
+        return RunResult{ false, 0, 0, 0 };
+
+    ProgressRenderer renderer(progress, console, &perf);
+    RenderingOutputFile rendering_file(file, renderer);
+    OutputSink out((mode == Mode::Inline) ? static_cast<OutputFile&>(rendering_file) : file);
+    ProgressDisplay display(progress, console, &perf);
+
+    auto begin = Clock::now();
+    if (mode == Mode::VBlank)
+        display.Start();
+
+    out.FillZero(0x200 + 0x800); // NCCH header and ExHeader placeholders
+    bool success = DumpExeFS(title, out, nullptr, nullptr, &perf, progress_ptr, PrintTo(std::cerr), nullptr, nullptr) != 0;
+    PadToNextMediaUnit(out, 0);
+    success &= DumpRomFS(title, out, nullptr, nullptr, &perf, nullptr, progress_ptr, PrintTo(std::cerr), nullptr, nullptr);
+    PadToNextMediaUnit(out, 0);
+    success &= out.Flush();
+
+    if (mode == Mode::VBlank)
+        display.Stop();
+    double seconds = std::chrono::duration<double>(Clock::now() - begin).count();
+
+    double console_seconds = static_cast<double>(perf.TotalTicks(PerfTelemetry::Operation::ConsoleOutput)) / ticks_per_second;
+    return RunResult{ success, seconds, console_seconds, out.Tell() };
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <output> [RomFS size in MiB] [read latency in us] [console cost per character in us] [runs]" << std::endl;
+        return 1;
+    }
+
+    SyntheticTitleConfig config;
+    config.romfs_size = ((argc > 2) ? std::strtoull(argv[2], nullptr, 0) : 64) * 1024 * 1024;
+    config.read_latency_us = (argc > 3) ? std::atoi(argv[3]) : 0;
+    double us_per_char = (argc > 4) ? std::atof(argv[4]) : 20.0;
+    unsigned num_runs = (argc > 5) ? std::max(1, std::atoi(argv[5])) : 3;
+
+    EmulatedConsoleBuffer console_buffer(us_per_char);
+    std::ostream console(&console_buffer);
+
+    // Silence the error output of the dump engine
+    auto cout_buffer = std::cout.rdbuf(nullptr);
+
+    static const struct {
+        Mode mode;
+        const char* name;
+    } modes[] = { { Mode::Inline, "inline" }, { Mode::VBlank, "vblank" }, { Mode::None, "none" } };
+
+    const unsigned num_modes = std::extent<decltype(modes)>::value;
+    RunResult fastest[num_modes];
+    bool all_ok = true;
+    for (unsigned run = 0; run < num_runs; ++run) {
+        for (unsigned index = 0; index < num_modes; ++index) {
+            auto result = Run(modes[index].mode, config, argv[1], console);
+            all_ok &= result.success;
+            if (run == 0 || result.seconds < fastest[index].seconds)
+                fastest[index] = result;
+        }
+    }
+
+    std::printf("%8s %8s %10s %10s %10s %12s\n", "mode", "status", "total s", "console s", "MiB/s", "vs inline s");
+    for (unsigned index = 0; index < num_modes; ++index) {
+        auto& result = fastest[index];
+        std::printf("%8s %8s %10.3f %10.3f %10.2f %12.3f\n", modes[index].name, all_ok ? "ok" : "FAILED", result.seconds,
+                    result.console_seconds, result.bytes / (1024.0 * 1024.0) / result.seconds, result.seconds - fastest[0].seconds);
+    }
+
+    std::cout.rdbuf(cout_buffer);
+    return all_ok ? 0 : 1;
+}
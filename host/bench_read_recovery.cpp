@@ -0,0 +1,209 @@
+// Measures the cost of recovering from RomFS read errors. A synthetic title is dumped with transient read errors
+// at various rates and with a few permanently unreadable media units, as with flaky cartridge contacts or a damaged
+// card. Dumps must succeed regardless: With transient errors only, the image must match a dump without errors.
+// With bad units, it must match a dump of the title with those units zeroed, and <titleid>.bad_ranges must list
+// exactly those units. The same must hold for a dump with bad units that is interrupted and then resumed.
+//
+// Usage: bench_read_recovery <output directory> [RomFS size in MiB] [read latency in us]
+
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+
+#include "faulty_title_archive.h"
+#include "output_file.h"
+#include "synthetic_title.h"
+#include "title_dumper.h"
+
+using Clock = std::chrono::steady_clock;
+
+static std::unique_ptr<OutputFile> OpenOutput(const std::string& path, bool keep_contents, uint64_t* existing_size) {
+    std::unique_ptr<StdioOutputFile> output(new StdioOutputFile);
+    if (!output->Open(path, keep_contents))
+        std::fprintf(stderr, "Couldn't open \"%s\" for writing\n", path.c_str());
+    *existing_size = output->GetSize();
+    return std::move(output);
+}
+
+// Output file that fails all writes from the given offset on, interrupting the dump
+class InterruptedOutputFile : public StdioOutputFile {
+public:
+    static uint64_t fail_from;
+
+    bool WriteAt(uint64_t offset, const void* data, size_t size) override {
+        return offset + size <= fail_from && StdioOutputFile::WriteAt(offset, data, size);
+    }
+};
+
+uint64_t InterruptedOutputFile::fail_from = 0;
+
+static std::unique_ptr<OutputFile> OpenInterruptedOutput(const std::string& path, bool keep_contents, uint64_t* existing_size) {
+    std::unique_ptr<InterruptedOutputFile> output(new InterruptedOutputFile);
+    if (!output->Open(path, keep_contents))
+        std::fprintf(stderr, "Couldn't open \"%s\" for writing\n", path.c_str());
+    *existing_size = output->GetSize();
+    return std::move(output);
+}
+
+static bool FilesEqual(const std::string& path_a, const std::string& path_b) {
+    FILE* a = fopen(path_a.c_str(), "rb");
+    FILE* b = fopen(path_b.c_str(), "rb");
+    bool equal = a && b;
+    std::vector<uint8_t> buffer_a(0x100000), buffer_b(0x100000);
+    while (equal) {
+        size_t size_a = fread(buffer_a.data(), 1, buffer_a.size(), a);
+        size_t size_b = fread(buffer_b.data(), 1, buffer_b.size(), b);
+        equal = size_a == size_b && memcmp(buffer_a.data(), buffer_b.data(), size_a) == 0;
+        if (size_a == 0)
+            break;
+    }
+    if (a)
+        fclose(a);
+    if (b)
+        fclose(b);
+    return equal;
+}
+
+// Check that the bad range map at "path" lists exactly the given units (in level 3 offsets), adjacent ones merged
+static bool BadRangesMatch(const std::string& path, std::vector<uint64_t> units) {
+    std::vector<std::pair<uint64_t, uint64_t>> expected;
+    std::sort(units.begin(), units.end());
+    for (auto unit : units) {
+        if (!expected.empty() && expected.back().first + expected.back().second == unit)
+            expected.back().second += FaultyTitleArchive::unit_size;
+        else
+            expected.emplace_back(unit, FaultyTitleArchive::unit_size);
+    }
+
+    FILE* file = fopen(path.c_str(), "r");
+    if (file == nullptr)
+        return expected.empty();
+
+    std::vector<std::pair<uint64_t, uint64_t>> listed;
+    char line[256];
+    while (fgets(line, sizeof(line), file)) {
+        uint64_t image_offset, size, level3_offset;
+        if (line[0] != '#' && sscanf(line, "%" SCNx64 " %" SCNx64 " %" SCNx64, &image_offset, &size, &level3_offset) == 3)
+            listed.emplace_back(level3_offset, size);
+    }
+    fclose(file);
+    return listed == expected;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::fprintf(stderr, "Usage: %s <output directory> [RomFS size in MiB] [read latency in us]\n", argv[0]);
+        return 1;
+    }
+
+    const std::string output_dir = argv[1];
+    mkdir(output_dir.c_str(), 0755);
+
+    SyntheticTitleConfig config;
+    config.romfs_size = ((argc > 2) ? std::atoi(argv[2]) : 64) * uint64_t{1024 * 1024};
+    config.read_latency_us = (argc > 3) ? std::atoi(argv[3]) : 0;
+    SyntheticTitleArchive title(config);
+
+    // A few scattered bad units, including a run of adjacent ones
+    std::vector<uint64_t> bad_units;
+    for (unsigned index = 0; index < 4; ++index)
+        bad_units.push_back(config.romfs_size / 5 * (index + 1) / FaultyTitleArchive::unit_size * FaultyTitleArchive::unit_size);
+    bad_units.push_back(bad_units.back() + FaultyTitleArchive::unit_size);
+    bad_units.push_back(bad_units.back() + FaultyTitleArchive::unit_size);
+
+    struct Scenario {
+        const char* name;
+        double transient_error_rate;
+        bool bad_units;
+    } scenarios[] = {
+        { "no errors", 0.0, false },
+        { "transient 1%", 0.01, false },
+        { "transient 10%", 0.1, false },
+        { "bad units", 0.0, true },
+        { "bad units + 5%", 0.05, true },
+    };
+
+    DumpEnvironment environment;
+    environment.open_output = OpenOutput;
+
+    DumpOptions options;
+    options.resumable = false;
+
+    auto dump = [&](TitleArchive& title, const std::string& base_path, TitleDumpResult* result) {
+        TitleDumpRequest request;
+        request.title_id = 0x0004000000100000;
+        request.base_path = base_path;
+        TitleDumper dumper(options, environment);
+        auto begin = Clock::now();
+        *result = dumper.Dump(title, request);
+        return std::chrono::duration<double>(Clock::now() - begin).count();
+    };
+
+    // References: A dump without any errors, and one with the bad units zeroed
+    const std::string clean_base = output_dir + "/clean";
+    const std::string zeroed_base = output_dir + "/zeroed";
+    TitleDumpResult clean_result, zeroed_result;
+    dump(title, clean_base, &clean_result);
+    FaultConfig zeroed_config;
+    zeroed_config.bad_units = bad_units;
+    zeroed_config.zero_bad_units = true;
+    FaultyTitleArchive zeroed_title(title, zeroed_config);
+    dump(zeroed_title, zeroed_base, &zeroed_result);
+
+    bool all_ok = clean_result.success && zeroed_result.success;
+    std::printf("%16s %10s %10s %10s %14s %8s\n", "scenario", "seconds", "errors", "retries", "unreadable_b", "result");
+    for (auto& scenario : scenarios) {
+        FaultConfig fault_config;
+        fault_config.transient_error_rate = scenario.transient_error_rate;
+        if (scenario.bad_units)
+            fault_config.bad_units = bad_units;
+        fault_config.seed = 1;
+        FaultyTitleArchive faulty_title(title, fault_config);
+
+        const std::string base_path = output_dir + "/faulty";
+        TitleDumpResult result;
+        double seconds = dump(faulty_title, base_path, &result);
+
+        bool ok = result.success && FilesEqual((scenario.bad_units ? zeroed_base : clean_base) + ".cxi", base_path + ".cxi") &&
+                  BadRangesMatch(base_path + ".bad_ranges", scenario.bad_units ? bad_units : std::vector<uint64_t>{});
+        all_ok &= ok;
+        std::printf("%16s %10.3f %10llu %10u %14llu %8s\n", scenario.name, seconds, static_cast<unsigned long long>(faulty_title.InjectedErrors()),
+                    result.retried_reads, static_cast<unsigned long long>(result.unreadable_bytes), ok ? "ok" : "FAILED");
+    }
+
+    // Interrupt a dump with bad units past the first few of them, then resume it. The bad units from before the last
+    // checkpoint are only known from the journal then.
+    {
+        FaultConfig fault_config;
+        fault_config.bad_units = bad_units;
+        FaultyTitleArchive faulty_title(title, fault_config);
+
+        const std::string base_path = output_dir + "/resumed";
+        for (auto suffix : { ".cxi", ".journal", ".bad_ranges" })
+            remove((base_path + suffix).c_str());
+
+        options.resumable = true;
+        environment.open_output = OpenInterruptedOutput;
+        InterruptedOutputFile::fail_from = config.romfs_size * 7 / 10;
+        TitleDumpResult interrupted_result, result;
+        double seconds = dump(faulty_title, base_path, &interrupted_result);
+        environment.open_output = OpenOutput;
+        seconds += dump(faulty_title, base_path, &result);
+
+        bool ok = !interrupted_result.success && result.success && result.resumed &&
+                  FilesEqual(zeroed_base + ".cxi", base_path + ".cxi") && BadRangesMatch(base_path + ".bad_ranges", bad_units);
+        all_ok &= ok;
+        std::printf("%16s %10.3f %10llu %10u %14llu %8s\n", "resumed dump", seconds, static_cast<unsigned long long>(faulty_title.InjectedErrors()),
+                    interrupted_result.retried_reads + result.retried_reads, static_cast<unsigned long long>(result.unreadable_bytes),
+                    ok ? "ok" : "FAILED");
+    }
+
+    return all_ok ? 0 : 1;
+}
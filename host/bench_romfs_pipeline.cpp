@@ -0,0 +1,103 @@
+// Compares the sequential RomFS copy loop braindump used to have against the pipelined one,
+// and measures the overhead of generating the IVFC hash tree on top.
+//
+// Usage: bench_romfs_pipeline <input> <output> [read latency in us] [write latency in us]
+//
+// The latencies are injected per read and write request and emulate the cartridge and SD card respectively.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "dump_pipeline.h"
+#include "romfs_image.h"
+#include "host_archive_file.h"
+
+// OutputFile that sleeps for a fixed time on every write before forwarding it
+class ThrottledOutputFile : public OutputFile {
+public:
+    ThrottledOutputFile(OutputFile& target, unsigned latency_us) : target(target), latency_us(latency_us) {}
+
+    bool WriteAt(uint64_t offset, const void* data, size_t size) override {
+        if (latency_us)
+            std::this_thread::sleep_for(std::chrono::microseconds(latency_us));
+        return target.WriteAt(offset, data, size);
+    }
+
+    bool Flush() override {
+        return target.Flush();
+    }
+
+private:
+    OutputFile& target;
+    unsigned latency_us;
+};
+
+static bool CopySequential(ArchiveFile& source, uint64_t size, OutputSink& dest) {
+    std::vector<char> read_buffer(1024 * 1024);
+    uint64_t offset = 0;
+    while (offset != size) {
+        uint32_t bytes_read;
+        Result ret = source.Read(offset, read_buffer.data(), read_buffer.size(), &bytes_read);
+        if (ret != 0 || bytes_read == 0)
+            return false;
+        if (!dest.Write(read_buffer.data(), bytes_read))
+            return false;
+        offset += bytes_read;
+    }
+    return true;
+}
+
+template<typename Func>
+static void RunBenchmark(const char* name, uint64_t size, Func&& func) {
+    auto begin = std::chrono::steady_clock::now();
+    bool success = func();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+    std::printf("%-12s %s %8.3f s %9.2f MiB/s\n", name, success ? "ok    " : "FAILED", seconds,
+                size / (1024.0 * 1024.0) / seconds);
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0] << " <input> <output> [read latency in us] [write latency in us]" << std::endl;
+        return 1;
+    }
+
+    unsigned read_latency_us = (argc > 3) ? std::atoi(argv[3]) : 0;
+    unsigned write_latency_us = (argc > 4) ? std::atoi(argv[4]) : 0;
+
+    HostArchiveFile source(argv[1], read_latency_us);
+    uint64_t size;
+    if (!source.IsOpen() || source.GetSize(&size) != 0 || size == 0) {
+        std::cerr << "Couldn't open " << argv[1] << std::endl;
+        return 1;
+    }
+
+    RunBenchmark("sequential", size, [&] {
+        StdioOutputFile file;
+        ThrottledOutputFile throttled(file, write_latency_us);
+        OutputSink out(throttled);
+        return file.Open(argv[2]) && CopySequential(source, size, out) && out.Flush();
+    });
+
+    RunBenchmark("pipelined", size, [&] {
+        StdioOutputFile file;
+        ThrottledOutputFile throttled(file, write_latency_us);
+        OutputSink out(throttled);
+        return file.Open(argv[2]) && CopyPipelined(source, size, out, PipelineConfig{}, nullptr, nullptr).Succeeded() && out.Flush();
+    });
+
+    // Same as above, but generating the full IVFC hash tree. This leaves a complete RomFS image in the output file.
+    RunBenchmark("romfs image", size, [&] {
+        StdioOutputFile file;
+        ThrottledOutputFile throttled(file, write_latency_us);
+        OutputSink out(throttled);
+        return file.Open(argv[2]) && WriteRomFSImage(source, size, out, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr).Succeeded() && out.Flush();
+    });
+
+    return 0;
+}
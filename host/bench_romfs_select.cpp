@@ -0,0 +1,218 @@
+// Compares dumping a few RomFS files selected by path or glob pattern to dumping the whole title.
+// Also checks the RomFS index against the synthetic file system: Every file must be found through the
+// hash tables, and pattern matches must agree with a straightforward reference implementation.
+//
+// Usage: bench_romfs_select <output directory> [RomFS size in MiB] [number of RomFS files] [read latency in us]
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+
+#include "output_file.h"
+#include "romfs_index.h"
+#include "synthetic_title.h"
+#include "title_dumper.h"
+
+// Counts the data read from a title
+class CountingTitleArchive : public TitleArchive {
+public:
+    explicit CountingTitleArchive(TitleArchive& title) : title(title) {
+    }
+
+    Result OpenExeFSSection(const std::string& name, std::unique_ptr<ArchiveFile>* file) override {
+        Result ret = title.OpenExeFSSection(name, file);
+        if (ret == 0)
+            file->reset(new CountingFile(std::move(*file), *this));
+        return ret;
+    }
+
+    Result OpenRomFS(std::unique_ptr<ArchiveFile>* file) override {
+        Result ret = title.OpenRomFS(file);
+        if (ret == 0)
+            file->reset(new CountingFile(std::move(*file), *this));
+        return ret;
+    }
+
+    std::atomic<uint64_t> bytes_read{0};
+    std::atomic<uint64_t> num_reads{0};
+
+private:
+    class CountingFile : public ArchiveFile {
+    public:
+        CountingFile(std::unique_ptr<ArchiveFile> file, CountingTitleArchive& owner) : file(std::move(file)), owner(owner) {
+        }
+
+        Result GetSize(uint64_t* size) override {
+            return file->GetSize(size);
+        }
+
+        Result Read(uint64_t offset, void* buffer, uint32_t size, uint32_t* bytes_read) override {
+            Result ret = file->Read(offset, buffer, size, bytes_read);
+            owner.bytes_read += *bytes_read;
+            ++owner.num_reads;
+            return ret;
+        }
+
+    private:
+        std::unique_ptr<ArchiveFile> file;
+        CountingTitleArchive& owner;
+    };
+
+    TitleArchive& title;
+};
+
+static std::unique_ptr<OutputFile> OpenOutput(const std::string& path, bool keep_contents, uint64_t* existing_size) {
+    std::unique_ptr<StdioOutputFile> output(new StdioOutputFile);
+    if (!output->Open(path, keep_contents))
+        std::fprintf(stderr, "Couldn't open \"%s\" for writing\n", path.c_str());
+    *existing_size = output->GetSize();
+    return std::move(output);
+}
+
+// Reference implementation of pattern matching for the patterns used below
+static bool ReferenceMatch(const std::string& pattern, const std::string& path) {
+    if (pattern.size() >= 3 && pattern.compare(pattern.size() - 3, 3, "/**") == 0)
+        return path.compare(0, pattern.size() - 2, pattern, 0, pattern.size() - 2) == 0;
+    if (pattern.size() >= 2 && pattern.compare(pattern.size() - 2, 2, "/*") == 0)
+        return path.compare(0, pattern.size() - 1, pattern, 0, pattern.size() - 1) == 0 && path.find('/', pattern.size() - 1) == std::string::npos;
+    if (pattern == "*.bin")
+        return path.find('/') == std::string::npos;
+    return pattern == path;
+}
+
+static bool CheckFile(const std::string& path, ArchiveFile& romfs, const SyntheticRomFSFile& file) {
+    FILE* output = fopen(path.c_str(), "rb");
+    if (output == nullptr)
+        return false;
+
+    std::vector<uint8_t> expected(file.size), actual(file.size + 1);
+    uint32_t bytes_read = 0;
+    bool equal = romfs.Read(file.offset, expected.data(), file.size, &bytes_read) == 0 && bytes_read == file.size &&
+                 fread(actual.data(), 1, actual.size(), output) == file.size && memcmp(expected.data(), actual.data(), file.size) == 0;
+    fclose(output);
+    return equal;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::fprintf(stderr, "Usage: %s <output directory> [RomFS size in MiB] [number of RomFS files] [read latency in us]\n", argv[0]);
+        return 1;
+    }
+
+    const std::string output_dir = argv[1];
+    mkdir(output_dir.c_str(), 0755);
+
+    SyntheticTitleConfig config;
+    config.romfs_size = ((argc > 2) ? std::atoi(argv[2]) : 256) * uint64_t{1024 * 1024};
+    config.romfs_num_files = (argc > 3) ? std::atoi(argv[3]) : 3000;
+    config.read_latency_us = (argc > 4) ? std::atoi(argv[4]) : 100;
+    SyntheticTitleArchive synthetic_title(config);
+    const auto& expected_files = synthetic_title.RomFSFiles();
+
+    // Index checks
+    bool all_ok = true;
+    std::unique_ptr<ArchiveFile> romfs;
+    RomFSIndex index;
+    if (synthetic_title.OpenRomFS(&romfs) != 0 || !index.Load(*romfs)) {
+        std::printf("Couldn't load the RomFS index\n");
+        return 1;
+    }
+
+    bool index_ok = index.Files().size() == expected_files.size();
+    for (auto& file : expected_files) {
+        auto found = index.Find(file.path);
+        index_ok &= found && found->path == file.path && found->offset == file.offset && found->size == file.size;
+    }
+    index_ok &= !index.Find("dir1/missing.bin") && !index.Find("missing/file0.bin");
+    all_ok &= index_ok;
+    std::printf("%-40s %s (%zu files, %llu bytes of tables)\n", "index lookups", index_ok ? "ok" : "FAILED",
+                index.Files().size(), static_cast<unsigned long long>(index.MetadataSize()));
+
+    const std::vector<std::string> pattern_sets[] = {
+        { "dir1/テクスチャ/*" },
+        { "dir5/**" },
+        { "*.bin" },
+        { "dir1/données.bin", "/dir1/données.bin" },
+    };
+    for (auto& patterns : pattern_sets) {
+        size_t expected_matches = 0;
+        for (auto& file : expected_files) {
+            for (auto& pattern : patterns) {
+                if (ReferenceMatch(pattern[0] == '/' ? pattern.substr(1) : pattern, file.path)) {
+                    ++expected_matches;
+                    break;
+                }
+            }
+        }
+        auto matches = index.Match(patterns);
+        bool ok = matches.size() == expected_matches && expected_matches != 0;
+        all_ok &= ok;
+        std::printf("pattern %-32s %s (%zu files)\n", patterns[0].c_str(), ok ? "ok" : "FAILED", matches.size());
+    }
+    std::printf("\n");
+
+    // Full dump compared to dumping a single directory of files
+    DumpEnvironment environment;
+    environment.open_output = OpenOutput;
+    environment.make_directory = [](const std::string& path) {
+        mkdir(path.c_str(), 0755);
+    };
+
+    struct Mode {
+        const char* name;
+        std::vector<std::string> patterns;
+    } modes[] = {
+        { "full image", {} },
+        { "selected files", { "dir1/テクスチャ/*", "dir1/données.bin" } },
+    };
+
+    std::printf("%16s %10s %12s %10s %8s\n", "mode", "seconds", "read_kib", "reads", "files");
+    for (auto& mode : modes) {
+        DumpOptions options;
+        options.resumable = false;
+        options.romfs_patterns = mode.patterns;
+        options.romfs_index = true;
+
+        TitleDumpRequest request;
+        request.title_id = 0x0004000000100000;
+        request.base_path = output_dir + "/0004000000100000";
+
+        remove((request.base_path + ".romfs_index").c_str());
+        CountingTitleArchive title(synthetic_title);
+        auto begin = std::chrono::steady_clock::now();
+        TitleDumpResult result;
+        {
+            TitleDumper dumper(options, environment);
+            result = dumper.Dump(title, request);
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+        bool ok = result.success;
+        if (!mode.patterns.empty()) {
+            for (auto match : index.Match(mode.patterns)) {
+                auto file = std::find_if(expected_files.begin(), expected_files.end(), [&](const SyntheticRomFSFile& file) {
+                    return file.path == match->path;
+                });
+                ok &= CheckFile(request.base_path + "/romfs/" + match->path, *romfs, *file);
+            }
+        }
+
+        FILE* index_file = fopen((request.base_path + ".romfs_index").c_str(), "r");
+        ok &= (index_file != nullptr);
+        if (index_file)
+            fclose(index_file);
+        all_ok &= ok;
+
+        std::printf("%16s %10.3f %12llu %10llu %8s\n", mode.name, seconds, static_cast<unsigned long long>(title.bytes_read / 1024),
+                    static_cast<unsigned long long>(title.num_reads.load()), ok ? "ok" : "FAILED");
+    }
+
+    return all_ok ? 0 : 1;
+}
@@ -0,0 +1,77 @@
+// Checks the SHA-256 implementation against the FIPS 180-2 example vectors and measures its throughput.
+//
+// Usage: bench_sha256 [buffer size in KiB] [iterations]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "sha256.h"
+
+static std::string ToHex(const uint8_t* digest) {
+    std::string ret;
+    char buf[3];
+    for (size_t i = 0; i < Sha256::digest_size; ++i) {
+        std::snprintf(buf, sizeof(buf), "%02x", digest[i]);
+        ret += buf;
+    }
+    return ret;
+}
+
+static bool CheckKnownVectors() {
+    struct {
+        std::string message;
+        size_t repeat;
+        const char* expected;
+    } vectors[] = {
+        { "", 1, "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855" },
+        { "abc", 1, "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad" },
+        { "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", 1, "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1" },
+        { "a", 1000000, "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0" },
+    };
+
+    bool success = true;
+    for (auto& vector : vectors) {
+        // Feed repeated messages one piece at a time to exercise the block buffering
+        Sha256 context;
+        for (size_t i = 0; i < vector.repeat; ++i)
+            context.Update(vector.message.data(), vector.message.size());
+
+        uint8_t digest[Sha256::digest_size];
+        context.Final(digest);
+        if (ToHex(digest) != vector.expected) {
+            std::printf("Mismatch for \"%.16s\" x %zu: got %s, expected %s\n", vector.message.c_str(),
+                        vector.repeat, ToHex(digest).c_str(), vector.expected);
+            success = false;
+        }
+    }
+    return success;
+}
+
+int main(int argc, char** argv) {
+    if (!CheckKnownVectors())
+        return 1;
+
+    size_t buffer_size = ((argc > 1) ? std::atoi(argv[1]) : 1024) * 1024;
+    unsigned iterations = (argc > 2) ? std::atoi(argv[2]) : 256;
+
+    std::vector<uint8_t> buffer(buffer_size);
+    for (size_t i = 0; i < buffer.size(); ++i)
+        buffer[i] = static_cast<uint8_t>(i * 31);
+
+    Sha256 context;
+    auto begin = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < iterations; ++i)
+        context.Update(buffer.data(), buffer.size());
+    uint8_t digest[Sha256::digest_size];
+    context.Final(digest);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+    std::printf("%s\n", ToHex(digest).c_str());
+    std::printf("%.2f MiB in %.3f s: %.2f MiB/s\n", buffer_size * iterations / (1024.0 * 1024.0), seconds,
+                buffer_size * iterations / (1024.0 * 1024.0) / seconds);
+    return 0;
+}
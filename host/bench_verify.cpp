@@ -0,0 +1,217 @@
+// Checks the XXH64 implementation against reference values and compares its throughput to SHA-256.
+// Then dumps a synthetic title with verification enabled, corrupts a byte of the written image, and checks
+// that both verification against the title and verification against the checksum manifest find the
+// corrupted block.
+//
+// Usage: bench_verify <output directory> [RomFS size in MiB] [read latency in us]
+
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+
+#include "checksum_manifest.h"
+#include "dump_verifier.h"
+#include "output_file.h"
+#include "sha256.h"
+#include "stdio_archive_file.h"
+#include "synthetic_title.h"
+#include "title_dumper.h"
+#include "xxhash64.h"
+
+using Clock = std::chrono::steady_clock;
+
+static double SecondsSince(Clock::time_point begin) {
+    return std::chrono::duration<double>(Clock::now() - begin).count();
+}
+
+static bool CheckKnownVectors() {
+    // Reference values computed with the xxHash reference implementation
+    std::vector<uint8_t> long_message(1000);
+    for (size_t index = 0; index < long_message.size(); ++index)
+        long_message[index] = static_cast<uint8_t>(index * 7 + 3);
+
+    struct {
+        std::string message;
+        uint64_t seed;
+        uint64_t expected;
+    } vectors[] = {
+        { "", 0, 0xef46db3751d8e999 },
+        { "a", 0, 0xd24ec4f1a98c6e5b },
+        { "abc", 0, 0x44bc2cf5ad770999 },
+        { "Nobody inspects the spammish repetition", 0, 0xfbcea83c8a378bf1 },
+        { std::string(long_message.begin(), long_message.end()), 0, 0x5f235fa033f1a3fb },
+        { std::string(long_message.begin(), long_message.end()), 0x9e3779b97f4a7c15, 0x442acd0a822e86f6 },
+    };
+
+    bool success = true;
+    for (auto& vector : vectors) {
+        // Feed the message in pieces of varying size to exercise the stripe buffering
+        for (size_t piece_size : { size_t{1}, size_t{7}, size_t{33}, vector.message.size() + 1 }) {
+            XXHash64 context(vector.seed);
+            for (size_t offset = 0; offset < vector.message.size(); offset += piece_size)
+                context.Update(vector.message.data() + offset, std::min(piece_size, vector.message.size() - offset));
+
+            if (context.Digest() != vector.expected) {
+                std::printf("Mismatch for \"%.16s\" (%zu bytes, pieces of %zu): got %016" PRIx64 ", expected %016" PRIx64 "\n",
+                            vector.message.c_str(), vector.message.size(), piece_size, context.Digest(), vector.expected);
+                success = false;
+            }
+        }
+    }
+    return success;
+}
+
+static void MeasureThroughput() {
+    std::vector<uint8_t> buffer(ChecksumManifest::default_block_size);
+    for (size_t index = 0; index < buffer.size(); ++index)
+        buffer[index] = static_cast<uint8_t>(index * 31 + (index >> 9));
+    const unsigned iterations = 256;
+
+    auto begin = Clock::now();
+    uint64_t xxhash_sum = 0;
+    for (unsigned iteration = 0; iteration < iterations; ++iteration)
+        xxhash_sum += XXHash64::Hash(buffer.data(), buffer.size(), iteration);
+    double xxhash_seconds = SecondsSince(begin);
+
+    begin = Clock::now();
+    uint8_t digest[Sha256::digest_size];
+    for (unsigned iteration = 0; iteration < iterations; ++iteration)
+        Sha256::Hash(buffer.data(), buffer.size(), digest);
+    double sha256_seconds = SecondsSince(begin);
+
+    double mib = static_cast<double>(buffer.size()) * iterations / (1024 * 1024);
+    std::printf("XXH64:   %8.1f MiB/s (checksum %016" PRIx64 ")\n", mib / xxhash_seconds, xxhash_sum);
+    std::printf("SHA-256: %8.1f MiB/s\n\n", mib / sha256_seconds);
+}
+
+static std::unique_ptr<OutputFile> OpenOutput(const std::string& path, bool keep_contents, uint64_t* existing_size) {
+    std::unique_ptr<StdioOutputFile> output(new StdioOutputFile);
+    if (!output->Open(path, keep_contents))
+        std::fprintf(stderr, "Couldn't open \"%s\" for writing\n", path.c_str());
+    *existing_size = output->GetSize();
+    return std::move(output);
+}
+
+static std::unique_ptr<ArchiveFile> OpenInput(const std::string& path) {
+    std::unique_ptr<StdioArchiveFile> input(new StdioArchiveFile);
+    if (!input->Open(path))
+        return nullptr;
+    return std::move(input);
+}
+
+static bool FlipByte(const std::string& path, uint64_t offset) {
+    FILE* file = fopen(path.c_str(), "r+b");
+    if (file == nullptr)
+        return false;
+
+    bool success = fseeko(file, offset, SEEK_SET) == 0;
+    int value = success ? fgetc(file) : EOF;
+    success &= (value != EOF) && fseeko(file, offset, SEEK_SET) == 0 && fputc(value ^ 0x5A, file) != EOF;
+    success &= (fclose(file) == 0);
+    return success;
+}
+
+// Check that verification found exactly one mismatching block, at the expected offset
+static bool CheckMismatch(const char* name, const VerifyResult& result, const ChecksumManifest::Region& region, uint64_t block_offset) {
+    bool ok = !result.success && !result.read_failed && result.mismatching_blocks == 1 &&
+              result.mismatch_region == region.name && result.mismatch_offset == block_offset;
+    std::printf("%-28s %s (%u blocks differ, first in %s at 0x%" PRIx64 ")\n", name, ok ? "ok" : "FAILED",
+                result.mismatching_blocks, result.mismatch_region.c_str(), result.mismatch_offset);
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::fprintf(stderr, "Usage: %s <output directory> [RomFS size in MiB] [read latency in us]\n", argv[0]);
+        return 1;
+    }
+
+    if (!CheckKnownVectors())
+        return 1;
+    MeasureThroughput();
+
+    const std::string output_dir = argv[1];
+    mkdir(output_dir.c_str(), 0755);
+
+    SyntheticTitleConfig config;
+    config.romfs_size = ((argc > 2) ? std::atoi(argv[2]) : 64) * uint64_t{1024 * 1024};
+    config.read_latency_us = (argc > 3) ? std::atoi(argv[3]) : 0;
+    SyntheticTitleArchive title(config);
+
+    DumpOptions options;
+    options.verify = true;
+    options.resumable = false;
+    DumpEnvironment environment;
+    environment.open_output = OpenOutput;
+    environment.open_input = OpenInput;
+
+    TitleDumpRequest request;
+    request.title_id = 0x0004000000100000;
+    request.base_path = output_dir + "/0004000000100000";
+    const std::string cxi_path = request.base_path + ".cxi";
+    const std::string manifest_path = request.base_path + ".checksums";
+    remove(manifest_path.c_str());
+
+    // Dump with verification
+    auto begin = Clock::now();
+    TitleDumpResult result;
+    {
+        TitleDumper dumper(options, environment);
+        result = dumper.Dump(title, request);
+    }
+    double dump_seconds = SecondsSince(begin);
+
+    bool all_ok = result.success && result.verified;
+    std::printf("%-28s %s (%.3f s including verification)\n", "dump and verify", all_ok ? "ok" : "FAILED", dump_seconds);
+
+    ChecksumManifest manifest;
+    if (!manifest.Read(manifest_path) || manifest.title_id != request.title_id || manifest.image_size != result.image_size) {
+        std::printf("Couldn't read back the checksum manifest\n");
+        return 1;
+    }
+    for (auto& region : manifest.regions)
+        std::printf("    %-20s 0x%010" PRIx64 " %10" PRIu64 " bytes\n", region.name.c_str(), region.offset, region.size);
+
+    StdioArchiveFile image;
+    if (!image.Open(cxi_path)) {
+        std::printf("Couldn't open %s\n", cxi_path.c_str());
+        return 1;
+    }
+
+    // Verification of the intact image against the manifest
+    begin = Clock::now();
+    auto manifest_result = VerifyManifest(image, manifest, nullptr, PrintTo(std::cerr));
+    double manifest_seconds = SecondsSince(begin);
+    all_ok &= manifest_result.success;
+    std::printf("%-28s %s (%.3f s)\n", "intact image, manifest", manifest_result.success ? "ok" : "FAILED", manifest_seconds);
+
+    // Corrupt a byte in the middle of the RomFS, which must be detected in the block containing it
+    auto romfs = manifest.FindRegion("romfs/level3");
+    if (romfs == nullptr || romfs->size < 6 * uint64_t{manifest.block_size}) {
+        std::printf("RomFS region missing or too small\n");
+        return 1;
+    }
+    const uint64_t block_offset = romfs->offset + 5 * uint64_t{manifest.block_size};
+    if (!FlipByte(cxi_path, block_offset + 123)) {
+        std::printf("Couldn't modify %s\n", cxi_path.c_str());
+        return 1;
+    }
+
+    all_ok &= CheckMismatch("corrupted image, manifest", VerifyManifest(image, manifest, nullptr, PrintTo(std::cerr)), *romfs, block_offset);
+
+    begin = Clock::now();
+    ChecksumManifest new_manifest;
+    auto title_result = VerifyDump(title, image, request.title_id, manifest.block_size, &new_manifest, nullptr, PrintTo(std::cerr));
+    double title_seconds = SecondsSince(begin);
+    all_ok &= CheckMismatch("corrupted image, title", title_result, *romfs, block_offset);
+    std::printf("%-28s %.3f s, %.1f MiB/s\n", "verification against title", title_seconds,
+                title_result.bytes_verified / (1024.0 * 1024.0) / title_seconds);
+
+    return all_ok ? 0 : 1;
+}
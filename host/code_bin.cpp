@@ -0,0 +1,80 @@
+// Decompresses or compresses an ExeFS .code section (e.g. exefs/code.bin extracted by extract_cxi), using
+// braindump's BLZ codec. Compressing allows repacking modified code; the compressed file can be
+// decompressed in place by the 3DS loader.
+//
+// Usage: code_bin <compress|decompress> <input> <output>
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "blz.h"
+
+static bool ReadFile(const std::string& path, std::vector<uint8_t>* data) {
+    FILE* file = fopen(path.c_str(), "rb");
+    if (file == nullptr)
+        return false;
+    bool success = fseeko(file, 0, SEEK_END) == 0;
+    if (success) {
+        data->resize(ftello(file));
+        success = fseeko(file, 0, SEEK_SET) == 0 && fread(data->data(), 1, data->size(), file) == data->size();
+    }
+    fclose(file);
+    return success;
+}
+
+static bool WriteFile(const std::string& path, const uint8_t* data, size_t size) {
+    FILE* file = fopen(path.c_str(), "wb");
+    if (file == nullptr)
+        return false;
+    bool success = fwrite(data, 1, size, file) == size;
+    success &= (fclose(file) == 0);
+    return success;
+}
+
+int main(int argc, char** argv) {
+    const std::string mode = (argc > 1) ? argv[1] : "";
+    if (argc < 4 || (mode != "compress" && mode != "decompress")) {
+        std::cerr << "Usage: " << argv[0] << " <compress|decompress> <input> <output>" << std::endl;
+        return 1;
+    }
+
+    std::vector<uint8_t> input;
+    if (!ReadFile(argv[2], &input) || input.size() > UINT32_MAX) {
+        std::cerr << "Couldn't read " << argv[2] << std::endl;
+        return 1;
+    }
+
+    std::vector<uint8_t> output;
+    if (mode == "compress") {
+        output.resize(input.size());
+        size_t compressed_size = BlzCompressor().Compress(input.data(), input.size(), output.data(), output.size());
+        if (compressed_size == 0) {
+            std::cerr << "The data doesn't compress; store it uncompressed and clear the CompressExefsCode flag in the ExHeader" << std::endl;
+            return 1;
+        }
+        output.resize(compressed_size);
+    } else {
+        BlzFooter footer;
+        uint32_t decompressed_size = 0;
+        if (input.size() >= sizeof(footer)) {
+            memcpy(&footer, input.data() + input.size() - sizeof(footer), sizeof(footer));
+            decompressed_size = BlzDecompressedSize(footer, static_cast<uint32_t>(input.size()));
+        }
+        output = input;
+        output.resize(decompressed_size);
+        if (decompressed_size == 0 || !BlzDecompress(output.data(), static_cast<uint32_t>(input.size()), decompressed_size)) {
+            std::cerr << argv[2] << " isn't BLZ-compressed" << std::endl;
+            return 1;
+        }
+    }
+
+    if (!WriteFile(argv[3], output.data(), output.size())) {
+        std::cerr << "Couldn't write " << argv[3] << std::endl;
+        return 1;
+    }
+    std::printf("%s %zu bytes to %zu bytes\n", mode == "compress" ? "Compressed" : "Decompressed", input.size(), output.size());
+    return 0;
+}
@@ -0,0 +1,331 @@
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "blz.h"
+#include "cxi_extractor.h"
+#include "ivfc.h"
+#include "ncch.h"
+
+namespace {
+
+// Read-only mapping of a whole file
+class MappedFile {
+public:
+    ~MappedFile() {
+        if (data)
+            munmap(const_cast<uint8_t*>(data), size);
+    }
+
+    bool Open(const std::string& path) {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            void* mapping = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapping != MAP_FAILED) {
+                data = static_cast<const uint8_t*>(mapping);
+                size = st.st_size;
+            }
+        }
+        close(fd);
+        return data != nullptr;
+    }
+
+    // Pointer to "length" bytes at "offset", or null if that's out of bounds
+    const uint8_t* At(uint64_t offset, uint64_t length) const {
+        return (offset <= size && length <= size - offset) ? data + offset : nullptr;
+    }
+
+private:
+    const uint8_t* data = nullptr;
+    uint64_t size = 0;
+};
+
+// Output file along with the mapped data it's written from
+struct FileJob {
+    std::string path;
+    const uint8_t* data;
+    uint64_t size;
+};
+
+// Parses the RomFS level 3 tables in place and collects the directories and files to create
+class RomFSWalker {
+public:
+    RomFSWalker(const uint8_t* level3, uint64_t level3_size) : level3(level3), level3_size(level3_size) {
+    }
+
+    bool Walk(const std::string& root_path, std::vector<std::string>* directories, std::vector<FileJob>* files) {
+        if (level3_size < sizeof(header))
+            return false;
+        memcpy(&header, level3, sizeof(header));
+        if (header.headersize != sizeof(header) || header.dataoffset > level3_size)
+            return false;
+        for (auto& section : header.section) {
+            if (section.offset > level3_size || section.size > level3_size - section.offset)
+                return false;
+        }
+
+        this->directories = directories;
+        this->files = files;
+        directories->push_back(root_path);
+        return WalkDirectory(0, root_path, 0);
+    }
+
+private:
+    // Entries are copied out, since they are only 4-byte aligned
+    bool ReadEntry(RomFSSection section, uint32_t offset, void* entry, size_t entry_size, std::string* name) {
+        auto& bounds = header.section[section];
+        if (offset > bounds.size || entry_size > bounds.size - offset)
+            return false;
+        const uint8_t* data = level3 + bounds.offset + offset;
+        memcpy(entry, data, entry_size);
+
+        uint32_t name_size;
+        memcpy(&name_size, data + entry_size - sizeof(name_size), sizeof(name_size));
+        if (name_size % 2 || name_size > bounds.size - offset - entry_size)
+            return false;
+        return DecodeName(data + entry_size, name_size / 2, name);
+    }
+
+    // Convert a UTF-16 entry name to UTF-8, rejecting names that would escape the output directory
+    static bool DecodeName(const uint8_t* data, uint32_t length, std::string* name) {
+        name->clear();
+        for (uint32_t index = 0; index < length; ++index) {
+            uint32_t c = data[2 * index] | (data[2 * index + 1] << 8);
+            if (c >= 0xD800 && c < 0xDC00 && index + 1 < length) {
+                uint32_t low = data[2 * index + 2] | (data[2 * index + 3] << 8);
+                if (low >= 0xDC00 && low < 0xE000) {
+                    c = 0x10000 + ((c - 0xD800) << 10) + (low - 0xDC00);
+                    ++index;
+                }
+            }
+
+            if (c == 0 || c == '/' || c == '\\')
+                return false;
+            if (c < 0x80) {
+                *name += static_cast<char>(c);
+            } else if (c < 0x800) {
+                *name += static_cast<char>(0xC0 | (c >> 6));
+                *name += static_cast<char>(0x80 | (c & 0x3F));
+            } else if (c < 0x10000) {
+                *name += static_cast<char>(0xE0 | (c >> 12));
+                *name += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+                *name += static_cast<char>(0x80 | (c & 0x3F));
+            } else {
+                *name += static_cast<char>(0xF0 | (c >> 18));
+                *name += static_cast<char>(0x80 | ((c >> 12) & 0x3F));
+                *name += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+                *name += static_cast<char>(0x80 | (c & 0x3F));
+            }
+        }
+        return *name != "." && *name != "..";
+    }
+
+    bool WalkDirectory(uint32_t offset, const std::string& path, unsigned depth) {
+        // Bound the recursion, in case of cyclic links in a corrupted image
+        if (depth > 64)
+            return false;
+
+        RomFS_DirectoryMetadata dir;
+        std::string name;
+        if (!ReadEntry(DirectoryMetadata, offset, &dir, sizeof(dir), &name))
+            return false;
+
+        size_t num_files = 0;
+        for (uint32_t file_offset = dir.first_file_offset; file_offset != romfs_invalid_offset; ) {
+            RomFS_FileMetadata file;
+            if (!ReadEntry(FileMetadata, file_offset, &file, sizeof(file), &name) || ++num_files > header.section[FileMetadata].size / sizeof(file))
+                return false;
+
+            uint64_t data_offset = header.dataoffset + file.data_offset;
+            if (file.data_offset > level3_size || data_offset > level3_size || file.data_size > level3_size - data_offset)
+                return false;
+            files->push_back(FileJob{ path + "/" + name, level3 + data_offset, file.data_size });
+            file_offset = file.next_sibling_offset;
+        }
+
+        size_t num_children = 0;
+        for (uint32_t child_offset = dir.first_child_offset; child_offset != romfs_invalid_offset; ) {
+            RomFS_DirectoryMetadata child;
+            if (!ReadEntry(DirectoryMetadata, child_offset, &child, sizeof(child), &name) || ++num_children > header.section[DirectoryMetadata].size / sizeof(child))
+                return false;
+
+            directories->push_back(path + "/" + name);
+            if (!WalkDirectory(child_offset, directories->back(), depth + 1))
+                return false;
+            child_offset = child.next_sibling_offset;
+        }
+        return true;
+    }
+
+    const uint8_t* level3;
+    uint64_t level3_size;
+    RomFSInfoHeader header;
+
+    std::vector<std::string>* directories = nullptr;
+    std::vector<FileJob>* files = nullptr;
+};
+
+} // anonymous namespace
+
+static bool WriteFile(const FileJob& job) {
+    int fd = open(job.path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return false;
+
+    bool success = true;
+    for (uint64_t offset = 0; success && offset < job.size; ) {
+        ssize_t written = write(fd, job.data + offset, std::min<uint64_t>(job.size - offset, 0x40000000));
+        if (written < 0 && errno == EINTR)
+            continue;
+        success = (written > 0);
+        offset += success ? written : 0;
+    }
+    success &= (close(fd) == 0);
+    return success;
+}
+
+static bool MakeDirectory(const std::string& path) {
+    return mkdir(path.c_str(), 0755) == 0 || errno == EEXIST;
+}
+
+bool ExtractImage(const std::string& image_path, const std::string& output_dir, unsigned num_threads, ExtractStats* stats) {
+    const uint64_t media_unit_size = 0x200;
+
+    MappedFile image;
+    if (!image.Open(image_path)) {
+        std::cerr << "Couldn't map " << image_path << std::endl;
+        return false;
+    }
+
+    NCCH_Header ncch;
+    auto ncch_data = image.At(0, sizeof(ncch));
+    if (!ncch_data || (memcpy(&ncch, ncch_data, sizeof(ncch)), memcmp(&ncch.magic, "NCCH", 4) != 0)) {
+        std::cerr << image_path << " doesn't start with an NCCH header" << std::endl;
+        return false;
+    }
+
+    std::vector<std::string> directories{ output_dir };
+    std::vector<FileJob> files;
+
+    // .code is decompressed (like ctrtool --decompresscode does) if the ExHeader marks it as compressed
+    ExHeader_Header exheader;
+    auto exheader_data = image.At(sizeof(ncch), sizeof(exheader));
+    bool code_compressed = ncch.extended_header_size != 0 && exheader_data &&
+                           (memcpy(&exheader, exheader_data, sizeof(exheader)), exheader.codeset_info.flags.flag & 1);
+    std::vector<uint8_t> code;
+
+    if (ncch.exefs_size != 0) {
+        const uint64_t exefs_begin = ncch.exefs_offset * media_unit_size;
+        auto exefs_data = image.At(exefs_begin, ncch.exefs_size * media_unit_size);
+        if (!exefs_data) {
+            std::cerr << "ExeFS exceeds the image" << std::endl;
+            return false;
+        }
+
+        ExeFs_Header exefs;
+        memcpy(&exefs, exefs_data, sizeof(exefs));
+        directories.push_back(output_dir + "/exefs");
+        for (auto& section : exefs.section) {
+            if (section.size == 0)
+                continue;
+
+            // Sections are named like ctrtool does, e.g. ".code" becomes "code.bin"
+            std::string name(section.name, strnlen(section.name, sizeof(section.name)));
+            name.erase(0, name.find_first_not_of('.'));
+            auto data = image.At(exefs_begin + sizeof(exefs) + section.offset, section.size);
+            if (name.empty() || name.find('/') != std::string::npos || !data) {
+                std::cerr << "ExeFS header is corrupted" << std::endl;
+                return false;
+            }
+            uint64_t size = section.size;
+            if (name == "code" && code_compressed) {
+                BlzFooter footer;
+                uint32_t decompressed_size = 0;
+                if (size >= sizeof(footer)) {
+                    memcpy(&footer, data + size - sizeof(footer), sizeof(footer));
+                    decompressed_size = BlzDecompressedSize(footer, section.size);
+                }
+                if (decompressed_size != 0) {
+                    code.resize(decompressed_size);
+                    std::copy(data, data + size, code.begin());
+                }
+                if (decompressed_size == 0 || !BlzDecompress(code.data(), section.size, decompressed_size)) {
+                    std::cerr << "ExHeader marks .code as compressed, but it couldn't be decompressed" << std::endl;
+                    return false;
+                }
+                data = code.data();
+                size = decompressed_size;
+            }
+            files.push_back(FileJob{ directories.back() + "/" + name + ".bin", data, size });
+        }
+    }
+
+    if (ncch.romfs_size != 0) {
+        const uint64_t romfs_begin = ncch.romfs_offset * media_unit_size;
+        RomFS_IVFCHeader ivfc;
+        auto ivfc_data = image.At(romfs_begin, sizeof(ivfc));
+        if (!ivfc_data || (memcpy(&ivfc, ivfc_data, sizeof(ivfc)), memcmp(&ivfc.magic, "IVFC", 4) != 0) || ivfc.levels[2].block_size_log2 >= 32) {
+            std::cerr << "RomFS doesn't start with an IVFC header" << std::endl;
+            return false;
+        }
+
+        auto level3 = image.At(romfs_begin + IvfcHashTree::Level3Offset(ivfc), ivfc.levels[2].hash_data_size);
+        RomFSWalker walker(level3, ivfc.levels[2].hash_data_size);
+        if (!level3 || !walker.Walk(output_dir + "/romfs", &directories, &files)) {
+            std::cerr << "RomFS file system is corrupted" << std::endl;
+            return false;
+        }
+    }
+
+    // Directories are created up front (parents first), so that files can be written in any order
+    for (auto& path : directories) {
+        if (!MakeDirectory(path)) {
+            std::cerr << "Couldn't create " << path << std::endl;
+            return false;
+        }
+    }
+
+    // Large files first, so that they don't end up being written alone at the end
+    std::sort(files.begin(), files.end(), [](const FileJob& a, const FileJob& b) {
+        return a.size > b.size;
+    });
+
+    std::atomic<size_t> next_file{0};
+    std::atomic<bool> failed{false};
+    auto write_files = [&] {
+        for (size_t index = next_file++; index < files.size() && !failed; index = next_file++) {
+            if (!WriteFile(files[index])) {
+                std::cerr << "Couldn't write " << files[index].path << std::endl;
+                failed = true;
+            }
+        }
+    };
+    std::vector<std::thread> threads;
+    for (unsigned index = 1; index < std::max(1u, num_threads); ++index)
+        threads.emplace_back(write_files);
+    write_files();
+    for (auto& thread : threads)
+        thread.join();
+
+    if (stats) {
+        stats->num_files = files.size();
+        stats->num_directories = directories.size();
+        stats->bytes = 0;
+        for (auto& file : files)
+            stats->bytes += file.size;
+    }
+    return !failed;
+}
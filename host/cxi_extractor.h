@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+struct ExtractStats {
+    uint64_t num_files = 0; // ExeFS sections and RomFS files
+    uint64_t num_directories = 0;
+    uint64_t bytes = 0;
+};
+
+// Extract the ExeFS sections and the RomFS file tree of an NCCH image to "output_dir" in a single pass:
+// "output_dir/exefs/<section>.bin" (e.g. code.bin) and "output_dir/romfs/...". If the ExHeader marks .code as
+// compressed, code.bin is stored decompressed; if it can't be decompressed, extraction fails.
+//
+// The image is memory-mapped and all headers and RomFS tables are parsed in place. Each output file is written
+// straight from the mapping, so no intermediate copies (e.g. exefs.bin or romfs.bin) are made. Files are written
+// by "num_threads" threads in parallel, largest first.
+//
+// Errors are printed to stderr. Returns false on error.
+bool ExtractImage(const std::string& image_path, const std::string& output_dir, unsigned num_threads, ExtractStats* stats);
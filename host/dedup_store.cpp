@@ -0,0 +1,117 @@
+// Manages chunk stores written by braindump on a PC.
+//
+// "import" adds a plain dump image to a store (created if needed) and writes its recipe, e.g. to collect dumps
+// made without a chunk store, or to move a library from the SD card to a store on the PC.
+// "extract" reassembles a byte-exact image from its recipe.
+//
+// Usage: dedup_store import <store directory> <image> <recipe>
+//        dedup_store extract <store directory> <recipe> <image>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include <sys/stat.h>
+
+#include "chunk_store.h"
+#include "output_file.h"
+#include "output_sink.h"
+#include "platform.h"
+
+static const size_t chunk_size = 0x100000;
+
+static std::unique_ptr<OutputFile> OpenForAppending(const std::string& path, uint64_t* size) {
+    std::unique_ptr<StdioOutputFile> output(new StdioOutputFile);
+    if (!output->Open(path, true))
+        std::cerr << "Couldn't open " << path << std::endl;
+    *size = output->GetSize();
+    return std::move(output);
+}
+
+static int Import(const std::string& store_path, const char* input_path, const char* recipe_path) {
+    FILE* input = fopen(input_path, "rb");
+    if (input == nullptr) {
+        std::cerr << "Couldn't open " << input_path << std::endl;
+        return 1;
+    }
+
+    StdioOutputFile recipe;
+    if (!recipe.Open(recipe_path)) {
+        std::cerr << "Couldn't open " << recipe_path << std::endl;
+        fclose(input);
+        return 1;
+    }
+
+    mkdir(store_path.c_str(), 0755);
+    uint64_t pack_size, index_size;
+    auto pack = OpenForAppending(store_path + "/chunks.pack", &pack_size);
+    auto index = OpenForAppending(store_path + "/chunks.index", &index_size);
+    ChunkStore store(store_path + "/chunks.index", std::move(pack), pack_size, std::move(index), index_size);
+    uint64_t chunks_before = store.NumChunks();
+
+    auto begin = std::chrono::steady_clock::now();
+    DedupImageWriter writer(store, recipe);
+    {
+        OutputSink sink(writer);
+        std::vector<uint8_t> buffer(chunk_size);
+        size_t bytes_read;
+        while ((bytes_read = fread(buffer.data(), 1, buffer.size(), input)) != 0)
+            sink.Write(buffer.data(), bytes_read);
+        fclose(input);
+        if (!sink.Flush() || !writer.Finish()) {
+            std::cerr << "Failed to write to the chunk store" << std::endl;
+            return 1;
+        }
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+    std::printf("imported %llu bytes as %llu chunks, %llu new (%llu bytes)", static_cast<unsigned long long>(writer.ImageSize()),
+                static_cast<unsigned long long>(writer.NumChunks()), static_cast<unsigned long long>(writer.NewChunks()),
+                static_cast<unsigned long long>(writer.NewBytes()));
+    if (writer.NewBytes())
+        std::printf(", dedup ratio %.2f", static_cast<double>(writer.ImageSize()) / writer.NewBytes());
+    std::printf("\n");
+    std::printf("chunking %.1f MiB/s, total %.3f s; store now holds %llu chunks (%llu before), %llu bytes\n",
+                writer.ImageSize() / (1024.0 * 1024.0) / (static_cast<double>(writer.ChunkingTicks()) / ticks_per_second), seconds,
+                static_cast<unsigned long long>(store.NumChunks()), static_cast<unsigned long long>(chunks_before),
+                static_cast<unsigned long long>(store.PackSize()));
+    return 0;
+}
+
+static int Extract(const std::string& store_path, const char* recipe_path, const char* output_path) {
+    ChunkStoreReader store;
+    if (!store.Open(store_path)) {
+        std::cerr << "Couldn't open the chunk store in " << store_path << std::endl;
+        return 1;
+    }
+
+    StdioOutputFile output;
+    if (!output.Open(output_path)) {
+        std::cerr << "Couldn't open " << output_path << std::endl;
+        return 1;
+    }
+
+    auto begin = std::chrono::steady_clock::now();
+    if (!ReassembleImage(recipe_path, store, output)) {
+        std::cerr << "Couldn't reassemble " << recipe_path << " (malformed recipe, or chunks missing from the store)" << std::endl;
+        return 1;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+    std::printf("extracted %llu bytes in %.3f s\n", static_cast<unsigned long long>(output.GetSize()), seconds);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc == 5 && strcmp(argv[1], "import") == 0) {
+        return Import(argv[2], argv[3], argv[4]);
+    } else if (argc == 5 && strcmp(argv[1], "extract") == 0) {
+        return Extract(argv[2], argv[3], argv[4]);
+    }
+
+    std::cerr << "Usage: " << argv[0] << " import <store directory> <image> <recipe>" << std::endl;
+    std::cerr << "       " << argv[0] << " extract <store directory> <recipe> <image>" << std::endl;
+    return 1;
+}
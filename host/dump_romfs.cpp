@@ -0,0 +1,58 @@
+// Dumps a file-backed stand-in for the RomFS level 3 data to a RomFS image, the same way braindump
+// does on the 3DS. Zero-filled blocks are left as holes in the output. Progress is recorded in "<output>.journal", so the dump can be killed and resumed.
+//
+// Usage: dump_romfs <level 3 input> <output> [read latency in us]
+
+#include <cstdlib>
+#include <iostream>
+
+#include "dump_journal.h"
+#include "host_archive_file.h"
+#include "output_file.h"
+#include "output_sink.h"
+#include "romfs_image.h"
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0] << " <level 3 input> <output> [read latency in us]" << std::endl;
+        return 1;
+    }
+
+    const std::string output_path = argv[2];
+    unsigned read_latency_us = (argc > 3) ? std::atoi(argv[3]) : 0;
+
+    HostArchiveFile source(argv[1], read_latency_us);
+    uint64_t size;
+    if (!source.IsOpen() || source.GetSize(&size) != 0 || size == 0) {
+        std::cerr << "Couldn't open " << argv[1] << std::endl;
+        return 1;
+    }
+
+    DumpJournal journal;
+    if (!journal.Open(output_path + ".journal", 0, output_path))
+        std::cerr << "Couldn't create dump journal" << std::endl;
+    if (journal.Resuming())
+        std::cout << "Resuming at level 3 offset " << journal.RomFS().level3_written << std::endl;
+
+    StdioOutputFile file;
+    if (!file.Open(output_path, journal.Resuming())) {
+        std::cerr << "Couldn't open " << output_path << std::endl;
+        return 1;
+    }
+
+    SparseOutputFile sparse(file, file.GetSize());
+    OutputSink out(sparse);
+    auto status = WriteRomFSImage(source, size, out, [size](uint64_t offset) {
+        std::cout << "\rDumping RomFS... " << (offset / 1024) << "/" << (size / 1024) << " KiB... " << std::flush;
+    }, nullptr, &journal, nullptr, nullptr, nullptr);
+    if (!status.Succeeded() || !out.Flush()) {
+        std::cout << std::endl << "Failed to dump RomFS" << std::endl;
+        return 1;
+    }
+
+    journal.Remove();
+    std::cout << "done!" << std::endl;
+    std::cout << "Skipped " << sparse.SkippedBytes() / 1024 << " KiB of zero blocks, wrote "
+              << sparse.WrittenBytes() / 1024 << " KiB" << std::endl;
+    return 0;
+}
@@ -0,0 +1,32 @@
+// Extracts the ExeFS sections and the RomFS file tree of a dumped NCCH image in a single pass,
+// replacing the two to three ctrtool invocations (and their intermediate exefs.bin/romfs.bin copies).
+//
+// Usage: extract_cxi <image> <output directory> [number of threads]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+
+#include "cxi_extractor.h"
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0] << " <image> <output directory> [number of threads]" << std::endl;
+        return 1;
+    }
+
+    unsigned num_threads = (argc > 3) ? std::atoi(argv[3]) : std::thread::hardware_concurrency();
+
+    auto begin = std::chrono::steady_clock::now();
+    ExtractStats stats;
+    if (!ExtractImage(argv[1], argv[2], num_threads, &stats))
+        return 1;
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+    std::printf("Extracted %llu files in %llu directories, %.1f MiB in %.3f s (%.1f MiB/s) using %u threads\n",
+                static_cast<unsigned long long>(stats.num_files), static_cast<unsigned long long>(stats.num_directories),
+                stats.bytes / (1024.0 * 1024.0), seconds, stats.bytes / (1024.0 * 1024.0) / seconds, num_threads);
+    return 0;
+}
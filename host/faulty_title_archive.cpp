@@ -0,0 +1,58 @@
+#include <algorithm>
+#include <cstring>
+#include <random>
+
+#include "faulty_title_archive.h"
+
+// Error code returned for injected failures
+static const Result injected_error = static_cast<Result>(0xC8804464);
+
+class FaultyArchiveFile : public ArchiveFile {
+public:
+    FaultyArchiveFile(std::unique_ptr<ArchiveFile> file, FaultyTitleArchive& archive)
+        : file(std::move(file)), archive(archive), random(archive.config.seed) {
+    }
+
+    Result GetSize(uint64_t* size) override {
+        return file->GetSize(size);
+    }
+
+    Result Read(uint64_t offset, void* buffer, uint32_t size, uint32_t* bytes_read) override {
+        auto& config = archive.config;
+        *bytes_read = 0;
+        if (config.transient_error_rate > 0.0 && std::uniform_real_distribution<double>()(random) < config.transient_error_rate) {
+            ++archive.injected_errors;
+            return injected_error;
+        }
+
+        // Bad units are sorted, so only the ones starting before the end of the read need to be checked
+        auto end = std::lower_bound(config.bad_units.begin(), config.bad_units.end(), offset + size);
+        auto it = std::lower_bound(config.bad_units.begin(), end, offset - std::min<uint64_t>(offset, FaultyTitleArchive::unit_size - 1));
+        if (it != end && !config.zero_bad_units) {
+            ++archive.injected_errors;
+            return injected_error;
+        }
+
+        Result ret = file->Read(offset, buffer, size, bytes_read);
+        for (; ret == 0 && it != end; ++it) {
+            uint64_t begin = std::max(offset, *it);
+            uint64_t unit_end = std::min(offset + *bytes_read, *it + FaultyTitleArchive::unit_size);
+            if (begin < unit_end)
+                memset(static_cast<uint8_t*>(buffer) + (begin - offset), 0, unit_end - begin);
+        }
+        return ret;
+    }
+
+private:
+    std::unique_ptr<ArchiveFile> file;
+    FaultyTitleArchive& archive;
+    std::mt19937_64 random;
+};
+
+Result FaultyTitleArchive::OpenRomFS(std::unique_ptr<ArchiveFile>* file) {
+    std::sort(config.bad_units.begin(), config.bad_units.end());
+    Result ret = title.OpenRomFS(file);
+    if (ret == 0)
+        file->reset(new FaultyArchiveFile(std::move(*file), *this));
+    return ret;
+}
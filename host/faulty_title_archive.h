@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "title_archive.h"
+
+// Read errors injected by FaultyTitleArchive
+struct FaultConfig {
+    // Probability of a RomFS read failing. Such errors are transient, i.e. reading the same data again may work.
+    double transient_error_rate = 0.0;
+
+    // Offsets of media units (0x200 bytes) of the RomFS level 3 data that always fail to read, like a damaged spot
+    std::vector<uint64_t> bad_units;
+
+    // Return zeros for the bad units instead of failing. This produces the data a dump of the faulty title is expected
+    // to contain after recovering from the errors.
+    bool zero_bad_units = false;
+
+    uint64_t seed = 0;
+};
+
+// TitleArchive wrapper injecting RomFS read errors, emulating a cartridge with flaky contacts or damaged data
+class FaultyTitleArchive : public TitleArchive {
+public:
+    static const uint32_t unit_size = 0x200;
+
+    FaultyTitleArchive(TitleArchive& title, const FaultConfig& config) : title(title), config(config) {
+    }
+
+    Result OpenExeFSSection(const std::string& name, std::unique_ptr<ArchiveFile>* file) override {
+        return title.OpenExeFSSection(name, file);
+    }
+
+    Result OpenRomFS(std::unique_ptr<ArchiveFile>* file) override;
+
+    // Number of reads that were failed so far
+    uint64_t InjectedErrors() const {
+        return injected_errors;
+    }
+
+private:
+    friend class FaultyArchiveFile;
+
+    TitleArchive& title;
+    FaultConfig config;
+    uint64_t injected_errors = 0;
+};
@@ -0,0 +1,39 @@
+#include <chrono>
+#include <thread>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "host_archive_file.h"
+
+HostArchiveFile::HostArchiveFile(const std::string& path, unsigned read_latency_us)
+    : fd(open(path.c_str(), O_RDONLY)), read_latency_us(read_latency_us) {
+}
+
+HostArchiveFile::~HostArchiveFile() {
+    if (fd >= 0)
+        close(fd);
+}
+
+Result HostArchiveFile::GetSize(uint64_t* size) {
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+        return -errno;
+
+    *size = st.st_size;
+    return 0;
+}
+
+Result HostArchiveFile::Read(uint64_t offset, void* buffer, uint32_t size, uint32_t* bytes_read) {
+    if (read_latency_us)
+        std::this_thread::sleep_for(std::chrono::microseconds(read_latency_us));
+
+    ssize_t ret = pread(fd, buffer, size, offset);
+    if (ret < 0)
+        return -errno;
+
+    *bytes_read = static_cast<uint32_t>(ret);
+    return 0;
+}
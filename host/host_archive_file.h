@@ -0,0 +1,24 @@
+#pragma once
+
+#include <string>
+
+#include "archive_file.h"
+
+// File-backed stand-in for a 3DS title archive file.
+// An optional fixed delay per read request can be injected to emulate slow cartridge access.
+class HostArchiveFile : public ArchiveFile {
+public:
+    explicit HostArchiveFile(const std::string& path, unsigned read_latency_us = 0);
+    ~HostArchiveFile() override;
+
+    bool IsOpen() const {
+        return fd >= 0;
+    }
+
+    Result GetSize(uint64_t* size) override;
+    Result Read(uint64_t offset, void* buffer, uint32_t size, uint32_t* bytes_read) override;
+
+private:
+    int fd;
+    unsigned read_latency_us;
+};
@@ -0,0 +1,122 @@
+// Converts between plain dump images and the block-compressed container written by braindump.
+//
+// "compress" mimics the write pattern of the 3DS side: The first 0x200 bytes (the NCCH header) are
+// written as a placeholder and patched in at the very end. "expand" restores the plain image.
+//
+// Usage: image_container compress <image> <container> [block size in KiB]
+//        image_container expand <container> <image>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include <sys/stat.h>
+
+#include "compressed_image.h"
+#include "output_file.h"
+#include "output_sink.h"
+
+static const size_t chunk_size = 0x100000;
+
+static void PrintStats(const char* what, uint64_t image_size, uint64_t container_size,
+                       std::chrono::steady_clock::time_point begin) {
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    std::printf("%s: image %llu bytes, container %llu bytes (%.1f%%) in %.3f s, %.2f MiB/s\n", what,
+                static_cast<unsigned long long>(image_size), static_cast<unsigned long long>(container_size),
+                image_size ? 100.0 * container_size / image_size : 0.0, seconds, image_size / (1024.0 * 1024.0) / seconds);
+}
+
+static int Compress(const char* input_path, const char* output_path, uint32_t block_size) {
+    FILE* input = fopen(input_path, "rb");
+    if (input == nullptr) {
+        std::cerr << "Couldn't open " << input_path << std::endl;
+        return 1;
+    }
+
+    StdioOutputFile output;
+    if (!output.Open(output_path)) {
+        std::cerr << "Couldn't open " << output_path << std::endl;
+        fclose(input);
+        return 1;
+    }
+
+    auto begin = std::chrono::steady_clock::now();
+    CompressedImageWriter writer(output, block_size);
+    OutputSink sink(writer);
+
+    std::vector<uint8_t> buffer(chunk_size);
+    uint8_t header[0x200] = {};
+    size_t header_size = 0;
+    size_t bytes_read;
+    while ((bytes_read = fread(buffer.data(), 1, buffer.size(), input)) != 0) {
+        // Write the header as a placeholder, to be patched in afterwards
+        if (sink.Tell() == 0) {
+            header_size = std::min(bytes_read, sizeof(header));
+            memcpy(header, buffer.data(), header_size);
+            memset(buffer.data(), 0, header_size);
+        }
+        sink.Write(buffer.data(), bytes_read);
+    }
+    fclose(input);
+
+    sink.Patch(0, header, header_size);
+    bool success = sink.Flush() && writer.Finish();
+    if (!success) {
+        std::cerr << "Failed to write " << output_path << std::endl;
+        return 1;
+    }
+
+    PrintStats("compressed", writer.ImageSize(), writer.ContainerSize(), begin);
+    return 0;
+}
+
+static int Expand(const char* input_path, const char* output_path) {
+    CompressedImageReader reader;
+    if (!reader.Open(input_path)) {
+        std::cerr << "Couldn't open " << input_path << " as a compressed image" << std::endl;
+        return 1;
+    }
+
+    StdioOutputFile output;
+    if (!output.Open(output_path)) {
+        std::cerr << "Couldn't open " << output_path << std::endl;
+        return 1;
+    }
+
+    auto begin = std::chrono::steady_clock::now();
+    OutputSink sink(output);
+    std::vector<uint8_t> buffer(chunk_size);
+    for (uint64_t offset = 0; offset < reader.ImageSize(); offset += buffer.size()) {
+        size_t size = static_cast<size_t>(std::min<uint64_t>(buffer.size(), reader.ImageSize() - offset));
+        if (!reader.ReadAt(offset, buffer.data(), size)) {
+            std::cerr << "Failed to read " << input_path << " at offset " << offset << std::endl;
+            return 1;
+        }
+        sink.Write(buffer.data(), size);
+    }
+    if (!sink.Flush()) {
+        std::cerr << "Failed to write " << output_path << std::endl;
+        return 1;
+    }
+
+    struct stat st;
+    PrintStats("expanded", reader.ImageSize(), (stat(input_path, &st) == 0) ? st.st_size : 0, begin);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc >= 4 && strcmp(argv[1], "compress") == 0) {
+        uint32_t block_size = (argc > 4) ? std::atoi(argv[4]) * 1024 : CompressedImageWriter::default_block_size;
+        return Compress(argv[2], argv[3], block_size);
+    } else if (argc == 4 && strcmp(argv[1], "expand") == 0) {
+        return Expand(argv[2], argv[3]);
+    }
+
+    std::cerr << "Usage: " << argv[0] << " compress <image> <container> [block size in KiB]" << std::endl;
+    std::cerr << "       " << argv[0] << " expand <container> <image>" << std::endl;
+    return 1;
+}
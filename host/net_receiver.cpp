@@ -0,0 +1,138 @@
+// Receives dump output files streamed by braindump over the network (see socket_output_file.h) and
+// writes them to a local directory. Each connection is handled on its own thread.
+//
+// Usage: net_receiver <output directory> [port]
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "output_file.h"
+#include "socket_output_file.h"
+
+static std::mutex print_mutex;
+
+static bool ReceiveAll(int sock, void* data, size_t size) {
+    auto bytes = static_cast<uint8_t*>(data);
+    while (size > 0) {
+        ssize_t received = recv(sock, bytes, size, 0);
+        if (received <= 0)
+            return false;
+        bytes += received;
+        size -= received;
+    }
+    return true;
+}
+
+// Reject names that would escape the output directory
+static bool IsSafeName(const std::string& name) {
+    return !name.empty() && name[0] != '/' && name.find("..") == std::string::npos;
+}
+
+// Create the directories leading up to "path"
+static void CreateParentDirectories(const std::string& path) {
+    for (size_t pos = path.find('/'); pos != std::string::npos; pos = path.find('/', pos + 1))
+        mkdir(path.substr(0, pos).c_str(), 0755);
+}
+
+static void HandleConnection(int sock, std::string output_dir) {
+    auto begin = std::chrono::steady_clock::now();
+    StdioOutputFile file;
+    std::string name;
+    std::vector<uint8_t> payload;
+    uint64_t bytes_received = 0;
+    bool good = true;
+    bool closed = false;
+
+    NetFrameHeader header;
+    while (!closed && ReceiveAll(sock, &header, sizeof(header))) {
+        if (header.size > net_max_frame_size)
+            break;
+        payload.resize(header.size);
+        if (!ReceiveAll(sock, payload.data(), payload.size()))
+            break;
+        bytes_received += sizeof(header) + payload.size();
+
+        switch (static_cast<NetFrameType>(header.type)) {
+        case NetFrameType::Open:
+            name.assign(payload.begin(), payload.end());
+            if (!IsSafeName(name) || file.IsOpen()) {
+                closed = true;
+                break;
+            }
+            CreateParentDirectories(output_dir + "/" + name);
+            good = file.Open(output_dir + "/" + name);
+            break;
+
+        case NetFrameType::Write:
+            good &= file.WriteAt(header.offset, payload.data(), payload.size());
+            break;
+
+        case NetFrameType::SetSize:
+            good &= file.SetSize(header.offset);
+            break;
+
+        case NetFrameType::Flush: {
+            good &= file.Flush();
+            int32_t status = good ? 0 : -1;
+            if (send(sock, &status, sizeof(status), 0) != sizeof(status))
+                closed = true;
+            break;
+        }
+
+        case NetFrameType::Close:
+        default:
+            closed = true;
+            break;
+        }
+    }
+
+    good &= file.Flush();
+    close(sock);
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    std::lock_guard<std::mutex> lock(print_mutex);
+    std::printf("%s: %s, received %llu bytes in %.3f s, %.2f MiB/s\n", name.c_str(), good ? "ok" : "FAILED",
+                static_cast<unsigned long long>(bytes_received), seconds, bytes_received / (1024.0 * 1024.0) / seconds);
+    std::fflush(stdout);
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <output directory> [port]" << std::endl;
+        return 1;
+    }
+
+    uint16_t port = (argc > 2) ? std::atoi(argv[2]) : 5000;
+
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    int reuse = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind(listener, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || listen(listener, 4) != 0) {
+        std::cerr << "Couldn't listen on port " << port << std::endl;
+        return 1;
+    }
+
+    std::cout << "Waiting for dumps on port " << port << std::endl;
+    for (;;) {
+        int sock = accept(listener, nullptr, nullptr);
+        if (sock < 0)
+            continue;
+        std::thread(HandleConnection, sock, std::string(argv[1])).detach();
+    }
+}
@@ -0,0 +1,60 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "posix_output_file.h"
+
+PosixOutputFile::~PosixOutputFile() {
+    Close();
+}
+
+bool PosixOutputFile::Open(const std::string& path, bool keep_contents) {
+    Close();
+
+    fd = open(path.c_str(), O_WRONLY | O_CREAT | (keep_contents ? 0 : O_TRUNC), 0644);
+    return fd >= 0;
+}
+
+void PosixOutputFile::Close() {
+    if (fd < 0)
+        return;
+
+    close(fd);
+    fd = -1;
+}
+
+uint64_t PosixOutputFile::GetSize() const {
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0)
+        return 0;
+    return st.st_size;
+}
+
+bool PosixOutputFile::WriteAt(uint64_t offset, const void* data, size_t size) {
+    auto bytes = static_cast<const uint8_t*>(data);
+    while (fd >= 0 && size != 0) {
+        ssize_t written = pwrite(fd, bytes, size, offset);
+        if (written < 0 && errno == EINTR)
+            continue;
+        if (written <= 0)
+            return false;
+
+        bytes += written;
+        offset += written;
+        size -= written;
+    }
+    return fd >= 0;
+}
+
+bool PosixOutputFile::Flush() {
+    return fd >= 0 && fdatasync(fd) == 0;
+}
+
+bool PosixOutputFile::SetSize(uint64_t size) {
+    return fd >= 0 && ftruncate(fd, size) == 0;
+}
+
+bool PosixOutputFile::Preallocate(uint64_t size) {
+    return fd >= 0 && posix_fallocate(fd, 0, size) == 0;
+}
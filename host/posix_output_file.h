@@ -0,0 +1,41 @@
+#pragma once
+
+#include <string>
+
+#include "output_file.h"
+
+// Host stand-in for FSOutputFile: Data is written to the file descriptor with pwrite, without any buffering
+// in between, and space is preallocated with posix_fallocate. Flushing commits the data to the disk.
+class PosixOutputFile : public OutputFile {
+public:
+    PosixOutputFile() = default;
+    ~PosixOutputFile() override;
+
+    PosixOutputFile(const PosixOutputFile&) = delete;
+    PosixOutputFile& operator=(const PosixOutputFile&) = delete;
+
+    // Open the file at "path" for writing. The file is created if it doesn't exist.
+    // Existing contents are discarded unless "keep_contents" is set.
+    bool Open(const std::string& path, bool keep_contents = false);
+    void Close();
+
+    bool IsOpen() const {
+        return fd >= 0;
+    }
+
+    // Current size of the file on disk
+    uint64_t GetSize() const;
+
+    bool WriteAt(uint64_t offset, const void* data, size_t size) override;
+    bool Flush() override;
+    bool SetSize(uint64_t size) override;
+    bool Preallocate(uint64_t size) override;
+
+    // posix_fallocate never shrinks the file, and space it allocates reads back as zeros, just like gaps
+    bool ZeroFillsGaps() const override {
+        return true;
+    }
+
+private:
+    int fd = -1;
+};
@@ -0,0 +1,271 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+#include "ncch.h"
+#include "synthetic_title.h"
+
+// SplitMix64 finalizer
+static uint64_t Mix(uint64_t value) {
+    value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ull;
+    value = (value ^ (value >> 27)) * 0x94D049BB133111EBull;
+    return value ^ (value >> 31);
+}
+
+namespace {
+
+class SyntheticArchiveFile : public ArchiveFile {
+public:
+    // If "prefix" is given, its contents are returned for the beginning of the file instead of generated data
+    SyntheticArchiveFile(uint64_t seed, uint64_t size, unsigned read_latency_us,
+                         std::shared_ptr<const std::vector<uint8_t>> prefix = nullptr)
+        : seed(seed), size(size), read_latency_us(read_latency_us), prefix(prefix) {
+    }
+
+    Result GetSize(uint64_t* size) override {
+        *size = this->size;
+        return 0;
+    }
+
+    Result Read(uint64_t offset, void* buffer, uint32_t size, uint32_t* bytes_read) override {
+        if (read_latency_us)
+            std::this_thread::sleep_for(std::chrono::microseconds(read_latency_us));
+
+        if (offset > this->size)
+            return -1;
+        size = static_cast<uint32_t>(std::min<uint64_t>(size, this->size - offset));
+
+        auto out = static_cast<uint8_t*>(buffer);
+        uint64_t pos = offset;
+        if (prefix && pos < prefix->size()) {
+            uint32_t num_bytes = static_cast<uint32_t>(std::min<uint64_t>(size, prefix->size() - pos));
+            memcpy(out, prefix->data() + pos, num_bytes);
+            out += num_bytes;
+            pos += num_bytes;
+        }
+        while (pos < offset + size) {
+            // Generate one 64-bit word at a time, copying only the part that was requested
+            uint64_t word_index = pos / sizeof(uint64_t);
+            uint64_t word = ((word_index * sizeof(uint64_t) / 0x1000) % 4 == 3) ? 0 : Mix(seed + word_index);
+            uint32_t word_offset = pos % sizeof(uint64_t);
+            uint32_t num_bytes = static_cast<uint32_t>(std::min<uint64_t>(sizeof(word) - word_offset, offset + size - pos));
+            memcpy(out, reinterpret_cast<uint8_t*>(&word) + word_offset, num_bytes);
+            out += num_bytes;
+            pos += num_bytes;
+        }
+
+        *bytes_read = size;
+        return 0;
+    }
+
+private:
+    uint64_t seed;
+    uint64_t size;
+    unsigned read_latency_us;
+    std::shared_ptr<const std::vector<uint8_t>> prefix;
+};
+
+struct Directory {
+    std::u16string name;
+    size_t parent;
+    std::vector<size_t> children;
+    std::vector<size_t> files;
+    uint32_t metadata_offset = 0;
+};
+
+struct File {
+    std::u16string name;
+    size_t parent;
+    uint64_t data_offset = 0; // Relative to the file data
+    uint64_t size = 0;
+    uint32_t metadata_offset = 0;
+};
+
+} // anonymous namespace
+
+static std::u16string ToUtf16(const std::string& ascii) {
+    return std::u16string(ascii.begin(), ascii.end());
+}
+
+static std::string ToUtf8(const std::u16string& text) {
+    std::string ret;
+    for (char16_t c : text) {
+        // Synthetic names don't use characters outside of the basic multilingual plane
+        if (c < 0x80) {
+            ret += static_cast<char>(c);
+        } else if (c < 0x800) {
+            ret += static_cast<char>(0xC0 | (c >> 6));
+            ret += static_cast<char>(0x80 | (c & 0x3F));
+        } else {
+            ret += static_cast<char>(0xE0 | (c >> 12));
+            ret += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+            ret += static_cast<char>(0x80 | (c & 0x3F));
+        }
+    }
+    return ret;
+}
+
+static uint32_t AlignUp(uint32_t value, uint32_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+static uint32_t NumHashBuckets(size_t num_entries) {
+    return (num_entries < 3) ? 3 : static_cast<uint32_t>(num_entries | 1);
+}
+
+// Lay out a RomFS level 3 file system of "level3_size" bytes, with "num_files" files spread across nested directories.
+// Returns everything up to the file data (i.e. the header and the tables), and the list of files in "files".
+static std::vector<uint8_t> BuildRomFSMetadata(unsigned num_files, uint64_t level3_size, uint64_t seed, std::vector<SyntheticRomFSFile>* files) {
+    // Every fourth directory is placed in the root, the others are nested in the preceding one.
+    // A few names use non-ASCII characters, like those found in Japanese titles.
+    std::vector<Directory> dirs(1 + std::max(1u, num_files / 16));
+    dirs[0].parent = 0;
+    for (size_t index = 1; index < dirs.size(); ++index) {
+        dirs[index].name = (index == 2) ? u"テクスチャ" : ToUtf16("dir" + std::to_string(index));
+        dirs[index].parent = (index % 4 == 1) ? 0 : index - 1;
+        dirs[dirs[index].parent].children.push_back(index);
+    }
+
+    std::vector<File> file_entries(num_files);
+    for (size_t index = 0; index < file_entries.size(); ++index) {
+        file_entries[index].name = (index == 1) ? u"données.bin" : ToUtf16("file" + std::to_string(index) + ".bin");
+        file_entries[index].parent = index % dirs.size();
+        dirs[file_entries[index].parent].files.push_back(index);
+    }
+
+    // Assign metadata offsets
+    uint32_t dir_metadata_size = 0;
+    for (auto& dir : dirs) {
+        dir.metadata_offset = dir_metadata_size;
+        dir_metadata_size += sizeof(RomFS_DirectoryMetadata) + AlignUp(dir.name.size() * 2, 4);
+    }
+    uint32_t file_metadata_size = 0;
+    for (auto& file : file_entries) {
+        file.metadata_offset = file_metadata_size;
+        file_metadata_size += sizeof(RomFS_FileMetadata) + AlignUp(file.name.size() * 2, 4);
+    }
+
+    RomFSInfoHeader header;
+    const uint32_t dir_buckets = NumHashBuckets(dirs.size());
+    const uint32_t file_buckets = NumHashBuckets(file_entries.size());
+    header.headersize = sizeof(header);
+    header.section[DirectoryHashTable] = { sizeof(header), dir_buckets * 4 };
+    header.section[DirectoryMetadata] = { header.section[DirectoryHashTable].offset + header.section[DirectoryHashTable].size, dir_metadata_size };
+    header.section[FileHashTable] = { header.section[DirectoryMetadata].offset + dir_metadata_size, file_buckets * 4 };
+    header.section[FileMetadata] = { header.section[FileHashTable].offset + header.section[FileHashTable].size, file_metadata_size };
+    header.dataoffset = AlignUp(header.section[FileMetadata].offset + file_metadata_size, 0x10);
+
+    // Distribute the remaining space across files, with varying sizes that aren't necessarily aligned
+    const uint64_t data_size = (level3_size > header.dataoffset) ? level3_size - header.dataoffset : 0;
+    std::vector<uint64_t> weights(file_entries.size());
+    uint64_t total_weight = 0;
+    for (size_t index = 0; index < weights.size(); ++index)
+        total_weight += weights[index] = 1 + Mix(seed + index) % 16;
+    uint64_t data_offset = 0;
+    for (size_t index = 0; index < file_entries.size(); ++index) {
+        auto& file = file_entries[index];
+        file.data_offset = data_offset;
+        if (index + 1 == file_entries.size())
+            file.size = data_size - data_offset;
+        else
+            file.size = std::min(data_size - data_offset, data_size * weights[index] / total_weight / 0x10 * 0x10 + index % 16);
+        data_offset = std::min<uint64_t>(data_size, (data_offset + file.size + 0xF) / 0x10 * 0x10);
+    }
+
+    std::vector<uint8_t> metadata(header.dataoffset);
+    memcpy(metadata.data(), &header, sizeof(header));
+
+    // Hash tables start out empty
+    auto dir_hash_table = reinterpret_cast<uint32_t*>(&metadata[header.section[DirectoryHashTable].offset]);
+    auto file_hash_table = reinterpret_cast<uint32_t*>(&metadata[header.section[FileHashTable].offset]);
+    std::fill(dir_hash_table, dir_hash_table + dir_buckets, romfs_invalid_offset);
+    std::fill(file_hash_table, file_hash_table + file_buckets, romfs_invalid_offset);
+
+    for (auto& dir : dirs) {
+        RomFS_DirectoryMetadata entry;
+        entry.parent_offset = dirs[dir.parent].metadata_offset;
+        entry.next_sibling_offset = romfs_invalid_offset;
+        auto& siblings = dirs[dir.parent].children;
+        auto it = std::find(siblings.begin(), siblings.end(), &dir - dirs.data());
+        if (it != siblings.end() && it + 1 != siblings.end())
+            entry.next_sibling_offset = dirs[*(it + 1)].metadata_offset;
+        entry.first_child_offset = dir.children.empty() ? romfs_invalid_offset : dirs[dir.children[0]].metadata_offset;
+        entry.first_file_offset = dir.files.empty() ? romfs_invalid_offset : file_entries[dir.files[0]].metadata_offset;
+        uint32_t bucket = RomFSPathHash(entry.parent_offset, reinterpret_cast<const uint16_t*>(dir.name.data()), dir.name.size()) % dir_buckets;
+        entry.next_in_bucket_offset = dir_hash_table[bucket];
+        dir_hash_table[bucket] = dir.metadata_offset;
+        entry.name_size = dir.name.size() * 2;
+
+        uint8_t* out = &metadata[header.section[DirectoryMetadata].offset + dir.metadata_offset];
+        memcpy(out, &entry, sizeof(entry));
+        memcpy(out + sizeof(entry), dir.name.data(), entry.name_size);
+    }
+
+    for (auto& file : file_entries) {
+        RomFS_FileMetadata entry;
+        entry.parent_offset = dirs[file.parent].metadata_offset;
+        entry.next_sibling_offset = romfs_invalid_offset;
+        auto& siblings = dirs[file.parent].files;
+        auto it = std::find(siblings.begin(), siblings.end(), &file - file_entries.data());
+        if (it + 1 != siblings.end())
+            entry.next_sibling_offset = file_entries[*(it + 1)].metadata_offset;
+        entry.data_offset = file.data_offset;
+        entry.data_size = file.size;
+        uint32_t bucket = RomFSPathHash(entry.parent_offset, reinterpret_cast<const uint16_t*>(file.name.data()), file.name.size()) % file_buckets;
+        entry.next_in_bucket_offset = file_hash_table[bucket];
+        file_hash_table[bucket] = file.metadata_offset;
+        entry.name_size = file.name.size() * 2;
+
+        uint8_t* out = &metadata[header.section[FileMetadata].offset + file.metadata_offset];
+        memcpy(out, &entry, sizeof(entry));
+        memcpy(out + sizeof(entry), file.name.data(), entry.name_size);
+
+        // Build the path from the innermost directory outwards
+        std::string path = ToUtf8(file.name);
+        for (size_t dir = file.parent; dir != 0; dir = dirs[dir].parent)
+            path = ToUtf8(dirs[dir].name) + "/" + path;
+        files->push_back(SyntheticRomFSFile{ path, header.dataoffset + file.data_offset, file.size });
+    }
+
+    return metadata;
+}
+
+SyntheticTitleArchive::SyntheticTitleArchive(const SyntheticTitleConfig& config) : config(config) {
+    if (config.romfs_num_files) {
+        romfs_metadata = std::make_shared<std::vector<uint8_t>>(BuildRomFSMetadata(config.romfs_num_files, config.romfs_size, config.seed, &romfs_files));
+        this->config.romfs_size = std::max<uint64_t>(config.romfs_size, romfs_metadata->size());
+    }
+}
+
+uint64_t SyntheticTitleArchive::ContentSize() const {
+    return uint64_t { config.code_size } + config.banner_size + config.icon_size + config.logo_size + config.romfs_size;
+}
+
+Result SyntheticTitleArchive::OpenExeFSSection(const std::string& name, std::unique_ptr<ArchiveFile>* file) {
+    uint32_t size;
+    uint64_t seed;
+    if (name == ".code") {
+        size = config.code_size;
+        seed = 1ull << 60;
+    } else if (name == "banner") {
+        size = config.banner_size;
+        seed = 2ull << 60;
+    } else if (name == "icon") {
+        size = config.icon_size;
+        seed = 3ull << 60;
+    } else if (name == "logo") {
+        size = config.logo_size;
+        seed = 4ull << 60;
+    } else {
+        return -1;
+    }
+
+    file->reset(new SyntheticArchiveFile(seed ^ config.seed, size, config.read_latency_us));
+    return 0;
+}
+
+Result SyntheticTitleArchive::OpenRomFS(std::unique_ptr<ArchiveFile>* file) {
+    file->reset(new SyntheticArchiveFile(config.seed, config.romfs_size, config.read_latency_us, romfs_metadata));
+    return 0;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "title_archive.h"
+
+// Parameters of a synthetic title used to benchmark the dump engine without a 3DS
+struct SyntheticTitleConfig {
+    uint32_t code_size = 0x200000;
+    uint32_t banner_size = 0x40000;
+    uint32_t icon_size = 0x36C0;
+    uint32_t logo_size = 0x2000;
+    uint64_t romfs_size = 0x1000000;
+    unsigned read_latency_us = 0; // Injected per read request, emulating cartridge access times
+    uint64_t seed = 0;            // Titles with different seeds have different contents
+
+    // If non-zero, the RomFS level 3 data is a valid file system with this many files spread across nested
+    // directories, rather than just random data. File contents are generated like the rest of the data.
+    unsigned romfs_num_files = 0;
+};
+
+// File in the RomFS of a synthetic title
+struct SyntheticRomFSFile {
+    std::string path;   // UTF-8, relative to the RomFS root, e.g. "dir0/file3.bin"
+    uint64_t offset;    // Offset of the file data in the RomFS level 3 data
+    uint64_t size;
+};
+
+// TitleArchive generating deterministic pseudo-random title contents on the fly, so that arbitrarily
+// large titles can be dumped without needing the space to store them. Every fourth 4 KiB block is
+// zero-filled, roughly resembling the padding found in real RomFS images.
+class SyntheticTitleArchive : public TitleArchive {
+public:
+    explicit SyntheticTitleArchive(const SyntheticTitleConfig& config);
+
+    // Size of the NCCH image produced when dumping this title (approximately; ignoring the hash tree)
+    uint64_t ContentSize() const;
+
+    Result OpenExeFSSection(const std::string& name, std::unique_ptr<ArchiveFile>* file) override;
+    Result OpenRomFS(std::unique_ptr<ArchiveFile>* file) override;
+
+    // Files in the RomFS (empty unless config.romfs_num_files is set)
+    const std::vector<SyntheticRomFSFile>& RomFSFiles() const {
+        return romfs_files;
+    }
+
+private:
+    SyntheticTitleConfig config;
+
+    // RomFS level 3 header and tables, stored in front of the generated file data
+    std::shared_ptr<const std::vector<uint8_t>> romfs_metadata;
+    std::vector<SyntheticRomFSFile> romfs_files;
+};
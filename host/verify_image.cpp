@@ -0,0 +1,48 @@
+// Checks a dump image against the checksum manifest written when it was verified on the 3DS, e.g. after
+// copying it off the SD card. The title itself isn't needed for this.
+//
+// Usage: verify_image <image> <checksum manifest>
+
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <iostream>
+
+#include "checksum_manifest.h"
+#include "dump_verifier.h"
+#include "stdio_archive_file.h"
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0] << " <image> <checksum manifest>" << std::endl;
+        return 1;
+    }
+
+    StdioArchiveFile image;
+    if (!image.Open(argv[1])) {
+        std::cerr << "Couldn't open " << argv[1] << std::endl;
+        return 1;
+    }
+
+    ChecksumManifest manifest;
+    if (!manifest.Read(argv[2])) {
+        std::cerr << "Couldn't read checksum manifest " << argv[2] << std::endl;
+        return 1;
+    }
+
+    auto begin = std::chrono::steady_clock::now();
+    auto result = VerifyManifest(image, manifest, nullptr, PrintTo(std::cerr));
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    if (result.read_failed)
+        return 1;
+
+    if (!result.success) {
+        std::printf("%u blocks differ, the first one in %s at offset 0x%" PRIx64 " (0x%" PRIx64 " bytes)\n",
+                    result.mismatching_blocks, result.mismatch_region.c_str(), result.mismatch_offset, result.mismatch_size);
+        return 1;
+    }
+
+    std::printf("Title %016" PRIx64 ": %" PRIu64 " bytes match in %.3f s (%.1f MiB/s)\n", manifest.title_id,
+                result.bytes_verified, seconds, result.bytes_verified / (1024.0 * 1024.0) / seconds);
+    return 0;
+}
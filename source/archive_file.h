@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstdint>
+
+#include "platform.h"
+
+// Read-only view of a file inside a title archive (e.g. the RomFS or an ExeFS section).
+// On the 3DS, this is backed by an FS file handle; host builds use regular files instead.
+class ArchiveFile {
+public:
+    virtual ~ArchiveFile() = default;
+
+    virtual Result GetSize(uint64_t* size) = 0;
+
+    // Read up to "size" bytes starting at "offset" into "buffer"
+    virtual Result Read(uint64_t offset, void* buffer, uint32_t size, uint32_t* bytes_read) = 0;
+};
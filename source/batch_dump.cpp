@@ -0,0 +1,97 @@
+#include <cinttypes>
+#include <cstdio>
+#include <ostream>
+
+#include "batch_dump.h"
+#include "platform.h"
+
+bool ReadBatchQueue(const std::string& path, std::vector<BatchEntry>* entries) {
+    FILE* file = fopen(path.c_str(), "r");
+    if (file == nullptr)
+        return false;
+
+    bool success = true;
+    char line[128];
+    while (fgets(line, sizeof(line), file)) {
+        char first = 0;
+        if (sscanf(line, " %c", &first) != 1 || first == '#')
+            continue;
+
+        uint64_t title_id;
+        unsigned media_type;
+        if (sscanf(line, "%" SCNx64 " %u", &title_id, &media_type) != 2 || media_type > 0xFF) {
+            success = false;
+            break;
+        }
+        entries->push_back(BatchEntry{ title_id, static_cast<uint8_t>(media_type) });
+    }
+    fclose(file);
+    return success;
+}
+
+static std::string TitleIdToString(uint64_t title_id) {
+    char buffer[17];
+    snprintf(buffer, sizeof(buffer), "%016" PRIx64, title_id);
+    return buffer;
+}
+
+std::vector<BatchResult> RunBatch(TitleDumper& dumper, const std::vector<BatchEntry>& entries, const std::string& output_dir,
+                                  const TitleOpener& open_title, const std::function<void(TitleDumpRequest&)>& prepare_request,
+                                  std::ostream* console) {
+    std::vector<BatchResult> results;
+    for (size_t index = 0; index < entries.size(); ++index) {
+        auto& entry = entries[index];
+        if (console) {
+            *console << "[" << (index + 1) << "/" << entries.size() << "] Title " << TitleIdToString(entry.title_id)
+                     << ", media type " << static_cast<unsigned>(entry.media_type) << std::endl;
+        }
+
+        BatchResult result;
+        result.entry = entry;
+        auto title = open_title(entry);
+        if (title) {
+            result.opened = true;
+
+            TitleDumpRequest request;
+            request.title_id = entry.title_id;
+            request.media_type = entry.media_type;
+            request.base_path = output_dir + "/" + TitleIdToString(entry.title_id);
+            if (prepare_request)
+                prepare_request(request);
+            result.result = dumper.Dump(*title, request);
+        }
+
+        if (console)
+            *console << (result.result.success ? "Done!" : "Failed!") << std::endl;
+        results.push_back(result);
+    }
+    return results;
+}
+
+bool WriteBatchReport(const std::string& path, const std::vector<BatchResult>& results) {
+    FILE* file = fopen(path.c_str(), "w");
+    if (file == nullptr)
+        return false;
+
+    unsigned num_succeeded = 0;
+    uint64_t total_bytes = 0;
+    uint64_t total_ticks = 0;
+    fprintf(file, "# title_id        media  status     image_kib    seconds  kib_per_s  skipped_kib\n");
+    for (auto& entry : results) {
+        auto& result = entry.result;
+        const char* status = !entry.opened ? "no_access" : result.mismatching_blocks ? "mismatch" : !result.success ? "failed" : result.resumed ? "resumed" : "ok";
+        double seconds = static_cast<double>(result.ticks) / ticks_per_second;
+        fprintf(file, "%016" PRIx64 "  %5u  %-9s  %10" PRIu64 "  %9.1f  %9.1f  %11" PRIu64 "\n", entry.entry.title_id,
+                entry.entry.media_type, status, result.image_size / 1024, seconds,
+                (seconds > 0) ? result.image_size / 1024.0 / seconds : 0.0, result.skipped_bytes / 1024);
+
+        num_succeeded += result.success;
+        total_bytes += result.image_size;
+        total_ticks += result.ticks;
+    }
+
+    double total_seconds = static_cast<double>(total_ticks) / ticks_per_second;
+    fprintf(file, "# %u/%u titles dumped, %.1f MiB in %.1f s\n", num_succeeded, static_cast<unsigned>(results.size()),
+            total_bytes / (1024.0 * 1024.0), total_seconds);
+    return fclose(file) == 0;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "title_archive.h"
+#include "title_dumper.h"
+
+// Dumping a queue of titles back to back, with a single TitleDumper
+
+struct BatchEntry {
+    uint64_t title_id;
+    uint8_t media_type;
+};
+
+struct BatchResult {
+    BatchEntry entry;
+    bool opened = false; // Whether the title could be accessed at all
+    TitleDumpResult result;
+};
+
+// Read the queue file at "path". Each line holds a title ID (in hex) and a media type (0: NAND, 1: SD, 2: game card).
+// Empty lines and lines starting with '#' are ignored. Returns false if the file doesn't exist or is malformed.
+bool ReadBatchQueue(const std::string& path, std::vector<BatchEntry>* entries);
+
+// Open the title described by the given entry, or return null if it can't be accessed
+using TitleOpener = std::function<std::unique_ptr<TitleArchive>(const BatchEntry& entry)>;
+
+// Dump all given titles in order. Outputs are named after the title ID and placed in "output_dir".
+// "prepare_request", if set, may amend the dump request of each title (e.g. for the running title).
+std::vector<BatchResult> RunBatch(TitleDumper& dumper, const std::vector<BatchEntry>& entries, const std::string& output_dir,
+                                  const TitleOpener& open_title, const std::function<void(TitleDumpRequest&)>& prepare_request,
+                                  std::ostream* console);
+
+// Write a summary of the batch to the text file at "path", one line per title plus totals
+bool WriteBatchReport(const std::string& path, const std::vector<BatchResult>& results);
@@ -0,0 +1,252 @@
+#include <algorithm>
+#include <cstring>
+
+#include "blz.h"
+
+// Format constraints of match tokens
+static const uint32_t min_match = 3;
+static const uint32_t max_match = 0xF + min_match;
+static const uint32_t min_distance = 3;
+static const uint32_t max_distance = 0xFFF + min_distance;
+
+// Largest compressed size that can be described by the footer
+static const uint32_t max_top = 0xFFFFFF;
+
+static BlzFooter ReadFooter(const uint8_t* data, uint32_t size) {
+    BlzFooter footer;
+    memcpy(&footer, data + size - sizeof(footer), sizeof(footer));
+    return footer;
+}
+
+uint32_t BlzDecompressedSize(const BlzFooter& footer, uint32_t size) {
+    uint32_t top = footer.top_and_bottom & max_top;
+    uint32_t bottom = footer.top_and_bottom >> 24;
+    if (bottom < sizeof(footer) || bottom > sizeof(footer) + 3 || top < bottom || top > size || footer.size_difference > UINT32_MAX - size)
+        return 0;
+    return size + footer.size_difference;
+}
+
+// Copy a match of "length" bytes found "distance" bytes above "out" to the bytes below "out". Returns the new output position.
+// Matches may overlap the data they produce, so this must be copied top to bottom. Unless the distance is
+// shorter than a word, words can be copied at once nevertheless, since each only reads data written before.
+static inline uint8_t* CopyMatch(uint8_t* out, uint32_t distance, uint32_t length) {
+    const uint8_t* match = out + distance;
+    if (distance >= 4) {
+        for (; length >= 4; length -= 4) {
+            out -= 4;
+            match -= 4;
+            memcpy(out, match, 4);
+        }
+    }
+    while (length--)
+        *--out = *--match;
+    return out;
+}
+
+static inline void Copy8(uint8_t* dst, const uint8_t* src) {
+    uint64_t value;
+    memcpy(&value, src, sizeof(value));
+    memcpy(dst, &value, sizeof(value));
+}
+
+// Decode a group of eight tokens described by "flags", without checking bounds.
+//
+// Literal runs and matches are copied in whole words, overshooting by up to wild_copy_size bytes below the
+// output position. Those bytes are overwritten by later tokens, but must not hold input still to be read.
+static const uint32_t wild_copy_size = 24;
+static inline void DecodeGroup(uint32_t flags, const uint8_t*& in, uint8_t*& out) {
+    for (unsigned remaining = 8; ; ) {
+        // Copy the literals up to the next match. The set bit below the flags caps the count at the end of the group.
+        unsigned literals = std::min<unsigned>(remaining, __builtin_clz(((flags & 0xFF) << 24) | 0x800000));
+        Copy8(out - 8, in - 8);
+        in -= literals;
+        out -= literals;
+        remaining -= literals;
+        if (remaining == 0)
+            return;
+
+        flags <<= literals + 1;
+        in -= 2;
+        uint32_t value = in[0] | (in[1] << 8);
+        uint32_t distance = (value & 0xFFF) + min_distance;
+        uint32_t length = (value >> 12) + min_match;
+        if (distance >= 8) {
+            Copy8(out - 8, out + distance - 8);
+            Copy8(out - 16, out + distance - 16);
+            Copy8(out - 24, out + distance - 24);
+            out -= length;
+        } else {
+            out = CopyMatch(out, distance, length);
+        }
+        if (--remaining == 0)
+            return;
+    }
+}
+
+bool BlzDecompress(uint8_t* buffer, uint32_t size, uint32_t capacity) {
+    if (size < sizeof(BlzFooter))
+        return false;
+
+    BlzFooter footer = ReadFooter(buffer, size);
+    uint32_t decompressed_size = BlzDecompressedSize(footer, size);
+    if (decompressed_size == 0 || decompressed_size > capacity)
+        return false;
+
+    const uint8_t* in = buffer + size - (footer.top_and_bottom >> 24);
+    const uint8_t* const in_begin = buffer + size - (footer.top_and_bottom & max_top); // Data below is stored uncompressed
+    uint8_t* const out_end = buffer + decompressed_size;
+    uint8_t* out = out_end;
+
+    while (in > in_begin) {
+        uint8_t flags = *--in;
+
+        // A group reads at most 16 bytes of input and writes at most 8 * max_match bytes, with its matches reaching
+        // at most max_distance bytes above the output. Each match moves the output closer to the input by its
+        // length minus 2, so the gap between them must leave room for the wild copies even after eight of the
+        // longest matches. Away from the ends of the buffer, the group thus can be decoded without checking each token.
+        if (in - in_begin >= 16 + 8 && out - in >= wild_copy_size + 8 * (max_match - 2) && out - in_begin >= 8 * max_match + wild_copy_size &&
+            out_end - out >= max_distance) {
+            DecodeGroup(flags, in, out);
+            continue;
+        }
+
+        for (unsigned token = 0; token < 8 && in > in_begin; ++token, flags <<= 1) {
+            if (flags & 0x80) {
+                if (in - in_begin < 2)
+                    return false;
+                in -= 2;
+                uint32_t value = in[0] | (in[1] << 8);
+                uint32_t distance = (value & 0xFFF) + min_distance;
+                uint32_t length = (value >> 12) + min_match;
+                if (static_cast<uint32_t>(out - in_begin) < length || static_cast<uint32_t>(out_end - out) < distance)
+                    return false;
+                out = CopyMatch(out, distance, length);
+            } else {
+                if (out == in_begin)
+                    return false;
+                *--out = *--in;
+            }
+        }
+    }
+
+    // The output must end right where the uncompressed prefix begins
+    return out == in_begin;
+}
+
+BlzCompressor::BlzCompressor() : head(1 << hash_log2), chain(1 << window_log2) {
+}
+
+size_t BlzCompressor::Compress(const uint8_t* src, size_t size, uint8_t* dst, size_t capacity) {
+    if (size <= sizeof(BlzFooter) || capacity < size)
+        return 0;
+
+    std::fill(head.begin(), head.end(), 0);
+    const uint32_t window_mask = (1 << window_log2) - 1;
+
+    // Positions refer to the end of the 3-byte sequence they're hashed by, i.e. position 0 is never used
+    auto hash = [src](size_t pos) {
+        uint32_t sequence = src[pos - 3] | (src[pos - 2] << 8) | (src[pos - 1] << 16);
+        return (sequence * 2654435761u) >> (32 - hash_log2);
+    };
+
+    // Compress to the end of "dst", going backwards from the end of the input. Positions at least min_distance
+    // above the current one are inserted into the hash chains as match candidates.
+    uint8_t* out = dst + size;
+    size_t pos = size;
+    size_t inserted = size + 1; // Lowest inserted position
+    while (pos > 0) {
+        if (out == dst)
+            return 0;
+        uint8_t* flags = --out;
+        *flags = 0;
+
+        for (unsigned token = 0; token < 8 && pos > 0; ++token) {
+            for (; inserted > min_match && inserted - 1 >= pos + min_distance; --inserted) {
+                uint32_t bucket = hash(inserted - 1);
+                chain[(inserted - 1) & window_mask] = head[bucket];
+                head[bucket] = static_cast<uint32_t>(inserted - 1);
+            }
+
+            size_t best_length = 0;
+            size_t best_distance = 0;
+            if (pos >= min_match) {
+                const size_t max_length = std::min<size_t>(max_match, pos);
+                unsigned steps = 0;
+                for (size_t candidate = head[hash(pos)]; candidate != 0 && candidate - pos <= max_distance && steps < max_chain_length;
+                     candidate = chain[candidate & window_mask], ++steps) {
+                    if (src[candidate - 1 - best_length] != src[pos - 1 - best_length])
+                        continue;
+                    size_t length = 0;
+                    while (length < max_length && src[candidate - 1 - length] == src[pos - 1 - length])
+                        ++length;
+                    if (length > best_length) {
+                        best_length = length;
+                        best_distance = candidate - pos;
+                        if (length == max_length)
+                            break;
+                    }
+                }
+            }
+
+            if (best_length < min_match) {
+                if (out == dst)
+                    return 0;
+                *--out = src[--pos];
+            } else {
+                if (out - dst < 2)
+                    return 0;
+                uint32_t value = static_cast<uint32_t>(((best_length - min_match) << 12) | (best_distance - min_distance));
+                *--out = static_cast<uint8_t>(value >> 8);
+                *--out = static_cast<uint8_t>(value);
+                *flags |= 0x80 >> token;
+                pos -= best_length;
+            }
+        }
+    }
+
+    // Decompressing in place, the output eventually catches up with the input still to be read whenever the
+    // data compresses worse towards its start. Find the first point where this happens while replaying the
+    // stream; the data below it is stored uncompressed instead.
+    const uint8_t* stream = out;
+    const size_t stream_size = dst + size - out;
+    size_t remaining_output = size;
+    size_t remaining_input = stream_size;
+    size_t prefix_size = 0;
+    size_t stream_begin = 0;
+    bool overlap = false;
+    while (remaining_output > 0 && !overlap) {
+        uint8_t flags = stream[--remaining_input];
+        for (unsigned token = 0; token < 8 && remaining_output > 0; ++token, flags <<= 1) {
+            if (!(flags & 0x80)) {
+                --remaining_input;
+                --remaining_output;
+                continue;
+            }
+
+            remaining_output -= (stream[remaining_input - 1] >> 4) + min_match;
+            remaining_input -= 2;
+            if (remaining_output < remaining_input) {
+                prefix_size = remaining_output;
+                stream_begin = remaining_input;
+                overlap = true;
+                break;
+            }
+        }
+    }
+
+    const size_t packed_size = stream_size - stream_begin;
+    const size_t padding_offset = prefix_size + packed_size;
+    const size_t footer_offset = (padding_offset + 3) & ~size_t{3};
+    const size_t compressed_size = footer_offset + sizeof(BlzFooter);
+    const size_t top = compressed_size - prefix_size;
+    if (compressed_size >= size || top > max_top)
+        return 0;
+
+    // The stream is moved into place first, since the uncompressed prefix may overlap where it currently is
+    memmove(dst + prefix_size, stream + stream_begin, packed_size);
+    memcpy(dst, src, prefix_size);
+    memset(dst + padding_offset, 0xFF, footer_offset - padding_offset);
+    BlzFooter footer = { static_cast<uint32_t>(top | ((compressed_size - padding_offset) << 24)), static_cast<uint32_t>(size - compressed_size) };
+    memcpy(dst + footer_offset, &footer, sizeof(footer));
+    return compressed_size;
+}
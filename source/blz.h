@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Codec for the backward LZ77 ("BLZ") compression used for the ExeFS .code section.
+//
+// Compressed data is processed from its end towards its start, so that it can be decompressed in place: The
+// output is written from the end of the buffer downwards, trailing the input it's decoded from. Data is laid
+// out as follows:
+// - A prefix that's stored uncompressed (decompressing it in place would overwrite input that's yet to be read)
+// - The compressed stream, read backwards. Each flag byte is preceded by up to eight tokens, the most significant
+//   flag bit describing the token at the highest address. A clear bit denotes a literal byte, a set bit a 16-bit
+//   match token holding the length (minus 3) in its top 4 bits and the distance (minus 3) in its lower 12 bits.
+// - Padding with 0xFF to a multiple of four bytes
+// - BlzFooter
+//
+// Dumping only needs the footer, which gives the exact decompressed size of .code; the codec itself is used by the
+// host tools (extract_cxi, code_bin).
+struct BlzFooter {
+    uint32_t top_and_bottom;  // Size of the compressed stream plus padding and footer (bits 0-23), size of padding and footer (bits 24-31)
+    uint32_t size_difference; // Decompressed size minus compressed size
+};
+static_assert(sizeof(BlzFooter) == 8, "Incorrect structure size");
+
+// Size that "size" bytes of BLZ-compressed data ending with "footer" decompress to.
+// Returns 0 if the footer is malformed, i.e. if the data isn't BLZ-compressed.
+uint32_t BlzDecompressedSize(const BlzFooter& footer, uint32_t size);
+
+// Decompress the "size" bytes of BLZ-compressed data at the start of "buffer" in place. "buffer" must hold
+// at least "capacity" bytes, which must be no smaller than the decompressed size. Returns false if the data is malformed.
+bool BlzDecompress(uint8_t* buffer, uint32_t size, uint32_t capacity);
+
+// Compressor producing data that BlzDecompress (and the 3DS loader) can decompress in place
+class BlzCompressor {
+public:
+    BlzCompressor();
+
+    // Compress "size" bytes from "src" to "dst", which can hold "capacity" bytes; "capacity" must be at least "size".
+    // Returns the compressed size, or 0 if the data doesn't compress to fewer than "size" bytes. Such data should
+    // be stored uncompressed, clearing the CompressExefsCode flag in the ExHeader.
+    size_t Compress(const uint8_t* src, size_t size, uint8_t* dst, size_t capacity);
+
+private:
+    static const unsigned hash_log2 = 14;
+    static const unsigned window_log2 = 13; // Must cover the largest match distance
+    static const unsigned max_chain_length = 64;
+
+    // Hash chains indexed by the end position of the 3-byte sequence they're keyed by
+    std::vector<uint32_t> head;  // Lowest inserted position for each hash
+    std::vector<uint32_t> chain; // Next higher position with the same hash
+};
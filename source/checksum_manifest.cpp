@@ -0,0 +1,66 @@
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+
+#include "checksum_manifest.h"
+
+const ChecksumManifest::Region* ChecksumManifest::FindRegion(const std::string& name) const {
+    for (auto& region : regions) {
+        if (region.name == name)
+            return &region;
+    }
+    return nullptr;
+}
+
+bool ChecksumManifest::Write(const std::string& path) const {
+    FILE* file = fopen(path.c_str(), "w");
+    if (file == nullptr)
+        return false;
+
+    fprintf(file, "title_id %016" PRIx64 "\n", title_id);
+    fprintf(file, "image_size %" PRIu64 "\n", image_size);
+    fprintf(file, "block_size %" PRIu32 "\n", block_size);
+    for (auto& region : regions) {
+        fprintf(file, "region %s %" PRIu64 " %" PRIu64 "\n", region.name.c_str(), region.offset, region.size);
+        for (auto hash : region.block_hashes)
+            fprintf(file, "%016" PRIx64 "\n", hash);
+    }
+
+    bool success = !ferror(file);
+    success &= (fclose(file) == 0);
+    return success;
+}
+
+bool ChecksumManifest::Read(const std::string& path) {
+    FILE* file = fopen(path.c_str(), "r");
+    if (file == nullptr)
+        return false;
+
+    regions.clear();
+    bool success = fscanf(file, "title_id %" SCNx64 " image_size %" SCNu64 " block_size %" SCNu32, &title_id, &image_size, &block_size) == 3;
+    success &= (block_size != 0);
+
+    char line[128];
+    while (success && fgets(line, sizeof(line), file)) {
+        char name[64];
+        Region region;
+        uint64_t hash;
+        if (sscanf(line, "region %63s %" SCNu64 " %" SCNu64, name, &region.offset, &region.size) == 3) {
+            region.name = name;
+            region.block_hashes.reserve(region.NumBlocks(block_size));
+            regions.push_back(std::move(region));
+        } else if (sscanf(line, "%" SCNx64, &hash) == 1) {
+            success = !regions.empty() && regions.back().block_hashes.size() < regions.back().NumBlocks(block_size);
+            if (success)
+                regions.back().block_hashes.push_back(hash);
+        } else {
+            // Only blank lines are allowed otherwise
+            success = strspn(line, " \t\r\n") == strlen(line);
+        }
+    }
+    fclose(file);
+
+    for (auto& region : regions)
+        success &= region.block_hashes.size() == region.NumBlocks(block_size);
+    return success;
+}
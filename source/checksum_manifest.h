@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Block checksums of a dumped image, stored next to it as <titleid>.checksums.
+//
+// The image is split into regions: Data read from the title (ExeFS sections and RomFS level 3) is stored in
+// regions named after its source (e.g. "exefs/.code" or "romfs/level3"), while metadata generated by braindump
+// (headers, hash trees, padding) ends up in regions named "generated". Each region is split into blocks of
+// block_size bytes starting at the region offset, which are checksummed using XXH64. Since block boundaries
+// follow the title contents rather than the image layout, the checksums can be compared against data read
+// from the title without knowing where it ends up in the image.
+//
+// The manifest is a text file:
+//   title_id <16 hex digits>
+//   image_size <bytes>
+//   block_size <bytes>
+//   region <name> <offset> <size>
+//   <XXH64 of each block of the region, 16 hex digits per line>
+//   region ...
+struct ChecksumManifest {
+    static const uint32_t default_block_size = 0x40000;
+
+    struct Region {
+        std::string name;
+        uint64_t offset = 0; // Offset in the image
+        uint64_t size = 0;
+        std::vector<uint64_t> block_hashes;
+
+        bool HasSource() const {
+            return name != "generated";
+        }
+
+        uint64_t NumBlocks(uint32_t block_size) const {
+            return (size + block_size - 1) / block_size;
+        }
+    };
+
+    uint64_t title_id = 0;
+    uint64_t image_size = 0;
+    uint32_t block_size = default_block_size;
+    std::vector<Region> regions; // Sorted by offset, covering the whole image
+
+    // Returns null if there is no region of the given name
+    const Region* FindRegion(const std::string& name) const;
+
+    bool Write(const std::string& path) const;
+
+    // Returns false if the file doesn't exist or is malformed
+    bool Read(const std::string& path);
+};
@@ -0,0 +1,101 @@
+#include <algorithm>
+#include <cstdio>
+#include <map>
+
+#include "chunk_autotuner.h"
+
+ChunkAutotuner::ChunkAutotuner(const Config& config, Clock clock, uint32_t initial_chunk_size)
+    : config(config), clock(std::move(clock)), probe_results(config.candidates.size()), best_chunk_size(initial_chunk_size) {
+    if (std::find(config.candidates.begin(), config.candidates.end(), initial_chunk_size) == config.candidates.end())
+        StartProbing();
+}
+
+uint32_t ChunkAutotuner::MaxChunkSize() const {
+    return *std::max_element(config.candidates.begin(), config.candidates.end());
+}
+
+uint32_t ChunkAutotuner::NextChunkSize() const {
+    return probing ? config.candidates[probe_index] : best_chunk_size;
+}
+
+void ChunkAutotuner::StartProbing() {
+    probing = true;
+    probe_index = 0;
+    std::fill(probe_results.begin(), probe_results.end(), Measurement{});
+    ++num_probes;
+}
+
+void ChunkAutotuner::RecordRead(uint32_t size, uint64_t begin) {
+    // Count at least one tick per read, so that throughput stays finite with coarse clocks
+    uint64_t ticks = std::max<uint64_t>(clock() - begin, 1);
+
+    if (probing) {
+        auto& result = probe_results[probe_index];
+        result.bytes += size;
+        result.ticks += ticks;
+        if (result.bytes < config.probe_size)
+            return;
+
+        if (++probe_index < config.candidates.size())
+            return;
+
+        // All candidates probed: Settle on the fastest one. Ties go to the smaller chunk size.
+        size_t best = 0;
+        for (size_t index = 1; index < probe_results.size(); ++index) {
+            if (probe_results[index].Throughput() > probe_results[best].Throughput())
+                best = index;
+        }
+        probing = false;
+        best_chunk_size = config.candidates[best];
+        baseline = probe_results[best].Throughput();
+        window = Measurement{};
+        return;
+    }
+
+    window.bytes += size;
+    window.ticks += ticks;
+    if (window.bytes < config.window_size)
+        return;
+
+    if (baseline == 0.0) {
+        // Settled on an initial chunk size without probing; use the first window as baseline
+        baseline = window.Throughput();
+    } else if (window.Throughput() < baseline * config.drift_threshold) {
+        StartProbing();
+    }
+    window = Measurement{};
+}
+
+// The config file contains one line per media type, consisting of the media type and the chunk size (both decimal)
+static std::map<unsigned, uint32_t> LoadTunedChunkSizes(const std::string& path) {
+    std::map<unsigned, uint32_t> sizes;
+    FILE* file = fopen(path.c_str(), "r");
+    if (file == nullptr)
+        return sizes;
+
+    unsigned media_type;
+    unsigned long chunk_size;
+    while (fscanf(file, "%u %lu", &media_type, &chunk_size) == 2)
+        sizes[media_type] = static_cast<uint32_t>(chunk_size);
+    fclose(file);
+    return sizes;
+}
+
+uint32_t LoadTunedChunkSize(const std::string& path, uint8_t media_type) {
+    auto sizes = LoadTunedChunkSizes(path);
+    auto it = sizes.find(media_type);
+    return (it != sizes.end()) ? it->second : 0;
+}
+
+bool SaveTunedChunkSize(const std::string& path, uint8_t media_type, uint32_t chunk_size) {
+    auto sizes = LoadTunedChunkSizes(path);
+    sizes[media_type] = chunk_size;
+
+    FILE* file = fopen(path.c_str(), "w");
+    if (file == nullptr)
+        return false;
+
+    for (auto& entry : sizes)
+        fprintf(file, "%u %lu\n", entry.first, static_cast<unsigned long>(entry.second));
+    return fclose(file) == 0;
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Picks the read chunk size for the RomFS copy loop based on measured read throughput.
+//
+// The best chunk size depends on the medium (cartridge, NAND, SD) and the particular card, so rather
+// than hardcoding one, the tuner first probes each candidate size for a few reads and settles on the
+// fastest one. Afterwards, throughput is monitored per window of reads, and the candidates are probed
+// again if it drops noticeably below what was measured when settling.
+//
+// The tuner only sees the sizes and durations reported to it, so it's deterministic given the same
+// measurements. Durations are taken from an injectable clock for that reason.
+class ChunkAutotuner {
+public:
+    using Clock = std::function<uint64_t()>;
+
+    struct Config {
+        std::vector<uint32_t> candidates = { 0x20000, 0x40000, 0x80000, 0x100000, 0x200000 };
+
+        // Amount of data read with each candidate while probing
+        uint32_t probe_size = 0x200000;
+
+        // Amount of data after which throughput is compared against the baseline once settled
+        uint64_t window_size = 0x1000000;
+
+        // Fraction of the baseline throughput below which the candidates are probed again
+        double drift_threshold = 0.75;
+    };
+
+    // "clock" must return monotonic timestamps, e.g. GetTicks.
+    // If "initial_chunk_size" is one of the candidates (e.g. the size that won in a previous dump), probing is skipped.
+    ChunkAutotuner(const Config& config, Clock clock, uint32_t initial_chunk_size = 0);
+
+    // Size of the largest chunk that may be requested, i.e. the required buffer size
+    uint32_t MaxChunkSize() const;
+
+    // Chunk size to use for the next read
+    uint32_t NextChunkSize() const;
+
+    // Timestamp to pass to RecordRead
+    uint64_t Now() const {
+        return clock();
+    }
+
+    // Report a read of "size" bytes that started at "begin" (as returned by Now()) and just finished
+    void RecordRead(uint32_t size, uint64_t begin);
+
+    // Fastest chunk size found so far (the current one if no probe has finished yet)
+    uint32_t BestChunkSize() const {
+        return best_chunk_size;
+    }
+
+    // Number of times the candidates have been probed
+    unsigned NumProbes() const {
+        return num_probes;
+    }
+
+private:
+    struct Measurement {
+        uint64_t bytes = 0;
+        uint64_t ticks = 0;
+
+        double Throughput() const {
+            return ticks ? static_cast<double>(bytes) / ticks : 0.0;
+        }
+    };
+
+    void StartProbing();
+
+    Config config;
+    Clock clock;
+
+    bool probing = false;
+    size_t probe_index = 0;                 // Candidate currently being probed
+    std::vector<Measurement> probe_results; // One entry per candidate
+    unsigned num_probes = 0;
+
+    uint32_t best_chunk_size;
+    double baseline = 0.0; // Throughput when settling on best_chunk_size; 0 if not measured yet
+    Measurement window;
+};
+
+// Load the chunk size remembered for the given media type from the config file at "path". Returns 0 if there is none.
+uint32_t LoadTunedChunkSize(const std::string& path, uint8_t media_type);
+
+// Remember "chunk_size" for the given media type in the config file at "path", keeping entries for other media types
+bool SaveTunedChunkSize(const std::string& path, uint8_t media_type, uint32_t chunk_size);
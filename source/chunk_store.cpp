@@ -0,0 +1,253 @@
+#include <algorithm>
+#include <cstring>
+
+#include "chunk_store.h"
+#include "platform.h"
+
+static const char recipe_magic[4] = { 'B', 'D', 'C', 'R' };
+static const uint32_t recipe_version = 1;
+
+ChunkStore::ChunkStore(const std::string& index_path, std::unique_ptr<OutputFile> pack, uint64_t pack_size,
+                       std::unique_ptr<OutputFile> index, uint64_t index_size)
+    : pack(std::move(pack)), index(std::move(index)), pack_size(pack_size), index_size(0) {
+    // Only records referring to data that made it to the pack are valid
+    FILE* file = fopen(index_path.c_str(), "rb");
+    if (file == nullptr)
+        return;
+
+    ChunkStoreRecord record;
+    while (this->index_size + sizeof(record) <= index_size && fread(&record, sizeof(record), 1, file) == 1 &&
+           record.offset + record.size <= pack_size) {
+        chunks[Key(record.hash)] = record.size;
+        this->index_size += sizeof(record);
+    }
+    fclose(file);
+}
+
+uint64_t ChunkStore::Key(const uint8_t* hash) {
+    uint64_t key;
+    memcpy(&key, hash, sizeof(key));
+    return key;
+}
+
+bool ChunkStore::Add(const uint8_t* hash, const uint8_t* data, uint32_t size, bool* added) {
+    *added = false;
+    auto it = chunks.find(Key(hash));
+    if (it != chunks.end() && it->second == size)
+        return true;
+
+    ChunkStoreRecord record = {};
+    memcpy(record.hash, hash, sizeof(record.hash));
+    record.offset = pack_size;
+    record.size = size;
+    if (!pack->WriteAt(pack_size, data, size))
+        return false;
+    pack_size += size;
+    if (!index->WriteAt(index_size, &record, sizeof(record)))
+        return false;
+    index_size += sizeof(record);
+
+    chunks[Key(hash)] = size;
+    *added = true;
+    return true;
+}
+
+bool ChunkStore::Flush() {
+    // The pack goes first, so that the index never refers to missing data
+    bool success = pack->Flush();
+    success &= index->Flush();
+    return success;
+}
+
+ChunkStoreReader::~ChunkStoreReader() {
+    if (pack)
+        fclose(pack);
+}
+
+bool ChunkStoreReader::Open(const std::string& directory) {
+    pack = fopen((directory + "/chunks.pack").c_str(), "rb");
+    FILE* index = fopen((directory + "/chunks.index").c_str(), "rb");
+    bool success = pack && index && fseeko(pack, 0, SEEK_END) == 0;
+    if (success)
+        pack_size = ftello(pack);
+
+    ChunkStoreRecord record;
+    while (success && fread(&record, sizeof(record), 1, index) == 1) {
+        if (record.offset + record.size > pack_size)
+            break;
+        records_by_hash.emplace(std::string(reinterpret_cast<const char*>(record.hash), sizeof(record.hash)), records.size());
+        records.push_back(record);
+    }
+    if (index)
+        fclose(index);
+    return success;
+}
+
+bool ChunkStoreReader::ReadChunk(const uint8_t* hash, uint32_t size, uint8_t* data) {
+    auto it = records_by_hash.find(std::string(reinterpret_cast<const char*>(hash), Sha256::digest_size));
+    if (it == records_by_hash.end())
+        return false;
+
+    auto& record = records[it->second];
+    if (record.size != size || fseeko(pack, record.offset, SEEK_SET) != 0 || fread(data, 1, size, pack) != size)
+        return false;
+
+    uint8_t actual_hash[Sha256::digest_size];
+    Sha256::Hash(data, size, actual_hash);
+    return memcmp(actual_hash, hash, sizeof(actual_hash)) == 0;
+}
+
+DedupImageWriter::DedupImageWriter(ChunkStore& store, OutputFile& recipe, const ContentChunker::Config& config)
+    : store(store), recipe(recipe), chunker(config) {
+    pending.reserve(config.max_size);
+}
+
+DedupImageWriter::~DedupImageWriter() {
+    Finish();
+}
+
+void DedupImageWriter::StoreChunk(const uint8_t* data, uint32_t size) {
+    DedupRecipeChunk chunk = {};
+    Sha256::Hash(data, size, chunk.hash);
+    chunk.size = size;
+    recipe_chunks.push_back(chunk);
+    chunked_size += size;
+
+    bool added = false;
+    if (good)
+        good = store.Add(chunk.hash, data, size, &added);
+    if (added) {
+        ++new_chunks;
+        new_bytes += size;
+    }
+}
+
+void DedupImageWriter::Append(const uint8_t* data, size_t size) {
+    uint64_t begin = GetTicks();
+    while (size > 0) {
+        bool cut;
+        size_t chunk_size = chunker.Scan(data, size, &cut);
+        if (cut && pending.empty()) {
+            // The whole chunk is at hand, so it can be stored without copying it
+            StoreChunk(data, static_cast<uint32_t>(chunk_size));
+        } else {
+            pending.insert(pending.end(), data, data + chunk_size);
+            if (cut) {
+                StoreChunk(pending.data(), static_cast<uint32_t>(pending.size()));
+                pending.clear();
+            }
+        }
+        data += chunk_size;
+        size -= chunk_size;
+    }
+    chunking_ticks += GetTicks() - begin;
+}
+
+bool DedupImageWriter::WriteAt(uint64_t offset, const void* data, size_t size) {
+    if (finished)
+        return false;
+
+    auto bytes = static_cast<const uint8_t*>(data);
+    uint64_t image_end = ImageSize();
+    if (offset < image_end) {
+        // Data that has already been chunked (or at least scanned for a cut point): Record a patch
+        size_t patch_size = static_cast<size_t>(std::min<uint64_t>(size, image_end - offset));
+        patches.push_back(Patch{ offset, std::vector<uint8_t>(bytes, bytes + patch_size) });
+        offset += patch_size;
+        bytes += patch_size;
+        size -= patch_size;
+    }
+
+    // Zero-fill the gap up to the start of the data
+    static const uint8_t zeros[0x1000] = {};
+    for (uint64_t gap = offset - std::min(offset, image_end); gap > 0; ) {
+        size_t gap_size = static_cast<size_t>(std::min<uint64_t>(gap, sizeof(zeros)));
+        Append(zeros, gap_size);
+        gap -= gap_size;
+    }
+
+    Append(bytes, size);
+    return good;
+}
+
+bool DedupImageWriter::Flush() {
+    if (good)
+        good = store.Flush();
+    return good;
+}
+
+bool DedupImageWriter::Finish() {
+    if (finished)
+        return good;
+    finished = true;
+
+    if (!pending.empty()) {
+        StoreChunk(pending.data(), static_cast<uint32_t>(pending.size()));
+        pending.clear();
+    }
+    chunker.Reset();
+
+    DedupRecipeHeader header = {};
+    memcpy(header.magic, recipe_magic, sizeof(header.magic));
+    header.version = recipe_version;
+    header.image_size = chunked_size;
+    header.num_chunks = static_cast<uint32_t>(recipe_chunks.size());
+    header.num_patches = static_cast<uint32_t>(patches.size());
+
+    bool success = good;
+    uint64_t recipe_size = 0;
+    success &= recipe.WriteAt(recipe_size, &header, sizeof(header));
+    recipe_size += sizeof(header);
+    success &= recipe.WriteAt(recipe_size, recipe_chunks.data(), recipe_chunks.size() * sizeof(recipe_chunks[0]));
+    recipe_size += recipe_chunks.size() * sizeof(recipe_chunks[0]);
+    for (auto& patch : patches) {
+        DedupRecipePatch record = { patch.offset, static_cast<uint32_t>(patch.data.size()), 0 };
+        success &= recipe.WriteAt(recipe_size, &record, sizeof(record));
+        success &= recipe.WriteAt(recipe_size + sizeof(record), patch.data.data(), patch.data.size());
+        recipe_size += sizeof(record) + patch.data.size();
+    }
+
+    // The recipe must only be committed once all of its chunks are
+    success &= store.Flush();
+    success &= recipe.Flush();
+    good = success;
+    return success;
+}
+
+bool ReassembleImage(const std::string& recipe_path, ChunkStoreReader& store, OutputFile& out) {
+    FILE* file = fopen(recipe_path.c_str(), "rb");
+    if (file == nullptr)
+        return false;
+
+    DedupRecipeHeader header;
+    std::vector<DedupRecipeChunk> chunks;
+    bool success = fread(&header, sizeof(header), 1, file) == 1 && memcmp(header.magic, recipe_magic, sizeof(header.magic)) == 0 &&
+                   header.version == recipe_version;
+    if (success) {
+        chunks.resize(header.num_chunks);
+        success = fread(chunks.data(), sizeof(chunks[0]), chunks.size(), file) == chunks.size();
+    }
+
+    // Chunks are written in order, followed by the patches
+    uint64_t offset = 0;
+    std::vector<uint8_t> data;
+    for (size_t index = 0; success && index < chunks.size(); ++index) {
+        data.resize(chunks[index].size);
+        success = store.ReadChunk(chunks[index].hash, chunks[index].size, data.data()) && out.WriteAt(offset, data.data(), data.size());
+        offset += chunks[index].size;
+    }
+    success &= (offset == header.image_size);
+
+    for (uint32_t index = 0; success && index < header.num_patches; ++index) {
+        DedupRecipePatch record;
+        success = fread(&record, sizeof(record), 1, file) == 1 && record.offset + record.size <= header.image_size;
+        if (success) {
+            data.resize(record.size);
+            success = fread(data.data(), 1, data.size(), file) == data.size() && out.WriteAt(record.offset, data.data(), data.size());
+        }
+    }
+    fclose(file);
+
+    success &= out.Flush();
+    return success;
+}
@@ -0,0 +1,197 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "content_chunker.h"
+#include "output_file.h"
+#include "sha256.h"
+
+// Content-addressed store for dump images, shared by all titles.
+//
+// Images are split into content-defined chunks (see ContentChunker), and each distinct chunk is stored only once,
+// identified by its SHA-256 hash. Titles sharing data (regional variants, demos, common middleware) thus only
+// take up the space of the data that differs between them. Each image is described by a recipe listing its chunks.
+//
+// Files in the store directory:
+// - chunks.pack: Chunk data, in the order chunks were first stored
+// - chunks.index: One ChunkStoreRecord per chunk in chunks.pack
+// Both files are only ever appended to. Records are written after the chunk data, so an interrupted dump
+// leaves at most some unreferenced data at the end of the pack.
+struct ChunkStoreRecord {
+    uint8_t hash[Sha256::digest_size];
+    uint64_t offset; // Offset of the chunk data in chunks.pack
+    uint32_t size;
+    uint32_t reserved;
+};
+static_assert(sizeof(ChunkStoreRecord) == 0x30, "Incorrect structure size");
+
+// Recipe layout (<titleid>.cxi.recipe):
+// - DedupRecipeHeader
+// - DedupRecipeChunk for each chunk of the image, in order
+// - Patches: DedupRecipePatch records, each followed by its data. These overlay the
+//   chunks and are applied in order; they hold data written to chunks that had already been stored
+//   (e.g. headers filled in at the end of the dump).
+struct DedupRecipeHeader {
+    char magic[4]; // "BDCR"
+    uint32_t version;
+    uint64_t image_size;
+    uint32_t num_chunks;
+    uint32_t num_patches;
+};
+static_assert(sizeof(DedupRecipeHeader) == 0x18, "Incorrect structure size");
+
+struct DedupRecipeChunk {
+    uint8_t hash[Sha256::digest_size];
+    uint32_t size;
+    uint32_t reserved;
+};
+static_assert(sizeof(DedupRecipeChunk) == 0x28, "Incorrect structure size");
+
+struct DedupRecipePatch {
+    uint64_t offset; // Offset in the image
+    uint32_t size;
+    uint32_t reserved;
+};
+static_assert(sizeof(DedupRecipePatch) == 0x10, "Incorrect structure size");
+
+// Writer side of a chunk store
+class ChunkStore {
+public:
+    // Use the given store files for appending, with "pack_size" and "index_size" being their current sizes.
+    // Chunks stored previously are learned by reading the index from "index_path"; if it can't be read, the
+    // store starts out empty (and chunks already in it may end up stored twice).
+    ChunkStore(const std::string& index_path, std::unique_ptr<OutputFile> pack, uint64_t pack_size,
+               std::unique_ptr<OutputFile> index, uint64_t index_size);
+
+    // Store the chunk with the given hash unless it's stored already. Returns false on write errors.
+    bool Add(const uint8_t* hash, const uint8_t* data, uint32_t size, bool* added);
+
+    bool Flush();
+
+    uint64_t NumChunks() const {
+        return chunks.size();
+    }
+
+    uint64_t PackSize() const {
+        return pack_size;
+    }
+
+private:
+    // Chunks are looked up by a prefix of their hash, which keeps the in-memory index small enough for large
+    // stores on the 3DS. Reassembly verifies the full hash.
+    static uint64_t Key(const uint8_t* hash);
+
+    std::unique_ptr<OutputFile> pack;
+    std::unique_ptr<OutputFile> index;
+    uint64_t pack_size;
+    uint64_t index_size;
+
+    std::unordered_map<uint64_t, uint32_t> chunks; // Hash prefix to chunk size
+};
+
+// Reader side of a chunk store, used to reassemble images
+class ChunkStoreReader {
+public:
+    ChunkStoreReader() = default;
+    ~ChunkStoreReader();
+
+    ChunkStoreReader(const ChunkStoreReader&) = delete;
+    ChunkStoreReader& operator=(const ChunkStoreReader&) = delete;
+
+    // Open the store in the given directory
+    bool Open(const std::string& directory);
+
+    // Read the chunk with the given hash and size to "data", checking its hash. Returns false if missing or corrupted.
+    bool ReadChunk(const uint8_t* hash, uint32_t size, uint8_t* data);
+
+    uint64_t NumChunks() const {
+        return records.size();
+    }
+
+    uint64_t PackSize() const {
+        return pack_size;
+    }
+
+private:
+    FILE* pack = nullptr;
+    uint64_t pack_size = 0;
+    std::vector<ChunkStoreRecord> records;
+    std::unordered_map<std::string, size_t> records_by_hash;
+};
+
+// OutputFile that stores the written image in a chunk store, and writes a recipe for it to "recipe".
+//
+// Data is chunked and hashed as it's written; only chunks not in the store yet are written to it. Writes
+// at offsets preceding the current chunk are recorded as patches; writes past the current end of the image
+// fill the gap with zeros.
+class DedupImageWriter : public OutputFile {
+public:
+    DedupImageWriter(ChunkStore& store, OutputFile& recipe, const ContentChunker::Config& config = ContentChunker::Config{});
+    ~DedupImageWriter() override;
+
+    DedupImageWriter(const DedupImageWriter&) = delete;
+    DedupImageWriter& operator=(const DedupImageWriter&) = delete;
+
+    bool WriteAt(uint64_t offset, const void* data, size_t size) override;
+
+    // Flushes the chunk store. The current chunk and the recipe are only written by Finish.
+    bool Flush() override;
+
+    // Store the last chunk and write the recipe. No data may be written afterwards.
+    bool Finish();
+
+    // Size of the image written so far
+    uint64_t ImageSize() const {
+        return chunked_size + pending.size();
+    }
+
+    uint64_t NumChunks() const {
+        return recipe_chunks.size();
+    }
+
+    // Number of chunks and bytes that weren't in the store yet
+    uint64_t NewChunks() const {
+        return new_chunks;
+    }
+    uint64_t NewBytes() const {
+        return new_bytes;
+    }
+
+    // Time spent chunking and hashing (in GetTicks units)
+    uint64_t ChunkingTicks() const {
+        return chunking_ticks;
+    }
+
+private:
+    struct Patch {
+        uint64_t offset;
+        std::vector<uint8_t> data;
+    };
+
+    void Append(const uint8_t* data, size_t size);
+    void StoreChunk(const uint8_t* data, uint32_t size);
+
+    ChunkStore& store;
+    OutputFile& recipe;
+    ContentChunker chunker;
+
+    std::vector<uint8_t> pending; // Data of the current chunk so far
+    uint64_t chunked_size = 0;    // Image data stored as chunks so far
+    std::vector<DedupRecipeChunk> recipe_chunks;
+    std::vector<Patch> patches;
+
+    uint64_t new_chunks = 0;
+    uint64_t new_bytes = 0;
+    uint64_t chunking_ticks = 0;
+    bool good = true;
+    bool finished = false;
+};
+
+// Rebuild the image described by the recipe at "recipe_path" from "store" and write it to "out".
+// Returns false if the recipe is malformed or chunks are missing from the store.
+bool ReassembleImage(const std::string& recipe_path, ChunkStoreReader& store, OutputFile& out);
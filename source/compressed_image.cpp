@@ -0,0 +1,246 @@
+#include <algorithm>
+#include <cstring>
+
+#include "compressed_image.h"
+
+static const char container_magic[4] = { 'B', 'D', 'C', 'I' };
+static const uint32_t container_version = 1;
+
+CompressedImageWriter::CompressedImageWriter(OutputFile& file, uint32_t block_size)
+    : file(file), block_size(block_size), slots(num_slots), free_slots(num_slots, num_slots),
+      filled_slots(0, num_slots), compressed(Lz4Compressor::CompressBound(block_size)) {
+    for (auto& slot : slots)
+        slot.data.resize(block_size);
+
+    free_slots.Acquire();
+
+    // Without a worker, nothing would ever free up a slot, so the writer is finished (and failed) from the start
+    if (!worker.Start(WorkerMain, this)) {
+        good = false;
+        finished = true;
+    }
+}
+
+CompressedImageWriter::~CompressedImageWriter() {
+    Finish();
+}
+
+void CompressedImageWriter::SubmitBlock() {
+    slots[current_slot].size = block_fill;
+    filled_slots.Release();
+
+    block_begin += block_fill;
+    block_fill = 0;
+    current_slot = (current_slot + 1) % num_slots;
+    free_slots.Acquire();
+}
+
+bool CompressedImageWriter::WriteAt(uint64_t offset, const void* data, size_t size) {
+    if (finished || !good)
+        return false;
+
+    auto bytes = static_cast<const uint8_t*>(data);
+    while (size > 0) {
+        uint64_t image_end = block_begin + block_fill;
+        size_t chunk_size;
+        if (offset < block_begin) {
+            // The block containing this data has already been compressed: Record a patch
+            chunk_size = static_cast<size_t>(std::min<uint64_t>(size, block_begin - offset));
+            patches.push_back(Patch{ offset, std::vector<uint8_t>(bytes, bytes + chunk_size) });
+        } else if (offset > image_end) {
+            // Zero-fill the gap up to the start of the data
+            uint32_t gap_size = static_cast<uint32_t>(std::min<uint64_t>(offset - image_end, block_size - block_fill));
+            memset(slots[current_slot].data.data() + block_fill, 0, gap_size);
+            block_fill += gap_size;
+            if (block_fill == block_size)
+                SubmitBlock();
+            continue;
+        } else {
+            uint32_t block_offset = static_cast<uint32_t>(offset - block_begin);
+            chunk_size = std::min<size_t>(size, block_size - block_offset);
+            memcpy(slots[current_slot].data.data() + block_offset, bytes, chunk_size);
+            block_fill = std::max<uint32_t>(block_fill, block_offset + chunk_size);
+            if (block_fill == block_size)
+                SubmitBlock();
+        }
+
+        offset += chunk_size;
+        bytes += chunk_size;
+        size -= chunk_size;
+    }
+
+    return good;
+}
+
+bool CompressedImageWriter::Flush() {
+    return good && file.Flush();
+}
+
+void CompressedImageWriter::WorkerMain(void* arg) {
+    static_cast<CompressedImageWriter*>(arg)->CompressBlocks();
+}
+
+void CompressedImageWriter::CompressBlocks() {
+    for (unsigned slot_index = 0;; slot_index = (slot_index + 1) % num_slots) {
+        filled_slots.Acquire();
+        auto& slot = slots[slot_index];
+        if (slot.size == 0)
+            return;
+
+        CompressedImageBlock block = { container_size, slot.size, 0 };
+        const uint8_t* block_data = slot.data.data();
+        size_t compressed_size = compressor.Compress(slot.data.data(), slot.size, compressed.data(), slot.size - 1);
+        if (compressed_size != 0) {
+            block.stored_size = static_cast<uint32_t>(compressed_size);
+            block.flags = CompressedImageBlock::Compressed;
+            block_data = compressed.data();
+        }
+
+        if (good && !file.WriteAt(block.offset, block_data, block.stored_size))
+            good = false;
+        index.push_back(block);
+        container_size += block.stored_size;
+
+        free_slots.Release();
+    }
+}
+
+bool CompressedImageWriter::Finish() {
+    if (finished)
+        return good;
+    finished = true;
+
+    // Submit the last (partial) block, then an empty one to shut down the worker
+    uint64_t image_size = ImageSize();
+    if (block_fill != 0)
+        SubmitBlock();
+    SubmitBlock();
+    worker.Join();
+
+    bool success = good;
+    success &= file.WriteAt(container_size, index.data(), index.size() * sizeof(index[0]));
+    uint64_t index_offset = container_size;
+    container_size += index.size() * sizeof(index[0]);
+
+    uint64_t patches_offset = container_size;
+    for (auto& patch : patches) {
+        CompressedImagePatch record = { patch.offset, static_cast<uint32_t>(patch.data.size()), 0 };
+        success &= file.WriteAt(container_size, &record, sizeof(record));
+        success &= file.WriteAt(container_size + sizeof(record), patch.data.data(), patch.data.size());
+        container_size += sizeof(record) + patch.data.size();
+    }
+
+    CompressedImageFooter footer = {};
+    footer.image_size = image_size;
+    footer.index_offset = index_offset;
+    footer.patches_offset = patches_offset;
+    footer.num_blocks = static_cast<uint32_t>(index.size());
+    footer.num_patches = static_cast<uint32_t>(patches.size());
+    memcpy(footer.magic, container_magic, sizeof(footer.magic));
+    success &= file.WriteAt(container_size, &footer, sizeof(footer));
+    container_size += sizeof(footer);
+
+    CompressedImageHeader header = {};
+    memcpy(header.magic, container_magic, sizeof(header.magic));
+    header.version = container_version;
+    header.block_size = block_size;
+    success &= file.WriteAt(0, &header, sizeof(header));
+
+    success &= file.Flush();
+    good = success;
+    return success;
+}
+
+CompressedImageReader::~CompressedImageReader() {
+    if (file)
+        fclose(file);
+}
+
+bool CompressedImageReader::Open(const std::string& path) {
+    file = fopen(path.c_str(), "rb");
+    if (file == nullptr)
+        return false;
+
+    if (fread(&header, sizeof(header), 1, file) != 1 || memcmp(header.magic, container_magic, sizeof(header.magic)) != 0 ||
+        header.version != container_version || header.block_size == 0)
+        return false;
+
+    if (fseeko(file, -static_cast<off_t>(sizeof(footer)), SEEK_END) != 0 || fread(&footer, sizeof(footer), 1, file) != 1 ||
+        memcmp(footer.magic, container_magic, sizeof(footer.magic)) != 0)
+        return false;
+
+    if (footer.num_blocks != (footer.image_size + header.block_size - 1) / header.block_size)
+        return false;
+
+    index.resize(footer.num_blocks);
+    if (fseeko(file, footer.index_offset, SEEK_SET) != 0 || fread(index.data(), sizeof(index[0]), index.size(), file) != index.size())
+        return false;
+
+    if (fseeko(file, footer.patches_offset, SEEK_SET) != 0)
+        return false;
+    for (uint32_t i = 0; i < footer.num_patches; ++i) {
+        CompressedImagePatch record;
+        if (fread(&record, sizeof(record), 1, file) != 1 || record.offset + record.size > footer.image_size)
+            return false;
+
+        Patch patch = { record.offset, std::vector<uint8_t>(record.size) };
+        if (fread(patch.data.data(), 1, record.size, file) != record.size)
+            return false;
+        patches.push_back(std::move(patch));
+    }
+
+    block_data.resize(header.block_size);
+    stored_data.resize(Lz4Compressor::CompressBound(header.block_size));
+    return true;
+}
+
+bool CompressedImageReader::LoadBlock(uint32_t block) {
+    if (block == cached_block)
+        return true;
+
+    cached_block = UINT32_MAX;
+    auto& entry = index[block];
+    uint32_t size = static_cast<uint32_t>(std::min<uint64_t>(header.block_size, footer.image_size - uint64_t { block } * header.block_size));
+    if (entry.stored_size > stored_data.size() || fseeko(file, entry.offset, SEEK_SET) != 0 ||
+        fread(stored_data.data(), 1, entry.stored_size, file) != entry.stored_size)
+        return false;
+
+    if (entry.flags & CompressedImageBlock::Compressed) {
+        if (!Lz4Decompress(stored_data.data(), entry.stored_size, block_data.data(), size))
+            return false;
+    } else {
+        if (entry.stored_size != size)
+            return false;
+        memcpy(block_data.data(), stored_data.data(), size);
+    }
+
+    cached_block = block;
+    return true;
+}
+
+bool CompressedImageReader::ReadAt(uint64_t offset, void* data, size_t size) {
+    if (file == nullptr || offset > footer.image_size || size > footer.image_size - offset)
+        return false;
+
+    auto bytes = static_cast<uint8_t*>(data);
+    for (uint64_t pos = offset; pos < offset + size;) {
+        uint32_t block = static_cast<uint32_t>(pos / header.block_size);
+        if (!LoadBlock(block))
+            return false;
+
+        uint32_t block_offset = static_cast<uint32_t>(pos % header.block_size);
+        size_t chunk_size = std::min<uint64_t>(offset + size - pos, header.block_size - block_offset);
+        memcpy(bytes + (pos - offset), block_data.data() + block_offset, chunk_size);
+        pos += chunk_size;
+    }
+
+    // Overlay patched data
+    for (auto& patch : patches) {
+        uint64_t begin = std::max(offset, patch.offset);
+        uint64_t end = std::min(offset + size, patch.offset + patch.data.size());
+        if (begin < end)
+            memcpy(bytes + (begin - offset), patch.data.data() + (begin - patch.offset), end - begin);
+    }
+
+    return true;
+}
@@ -0,0 +1,177 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "lz4_block.h"
+#include "output_file.h"
+#include "platform.h"
+
+// Container for dump images, storing the image in fixed-size blocks that are LZ4-compressed independently.
+//
+// Layout:
+// - CompressedImageHeader
+// - Block data (each block either LZ4-compressed or stored, if compression didn't help)
+// - Block index (one CompressedImageBlock per block)
+// - Patches: CompressedImagePatch records, each followed by its data. These overlay the blocks
+//   and are applied in order; they hold data written to blocks that had already been compressed
+//   (e.g. headers filled in at the end of the dump).
+// - CompressedImageFooter
+//
+// The footer and index allow decompressing any block without touching the rest of the container.
+
+struct CompressedImageHeader {
+    char magic[4]; // "BDCI"
+    uint32_t version;
+    uint32_t block_size;
+    uint32_t reserved;
+};
+static_assert(sizeof(CompressedImageHeader) == 0x10, "Incorrect structure size");
+
+struct CompressedImageBlock {
+    enum : uint32_t {
+        Compressed = 1,
+    };
+
+    uint64_t offset; // Offset of the block data in the container
+    uint32_t stored_size;
+    uint32_t flags;
+};
+static_assert(sizeof(CompressedImageBlock) == 0x10, "Incorrect structure size");
+
+struct CompressedImagePatch {
+    uint64_t offset; // Offset in the image
+    uint32_t size;
+    uint32_t reserved;
+};
+static_assert(sizeof(CompressedImagePatch) == 0x10, "Incorrect structure size");
+
+struct CompressedImageFooter {
+    uint64_t image_size;
+    uint64_t index_offset;
+    uint64_t patches_offset;
+    uint32_t num_blocks;
+    uint32_t num_patches;
+    char magic[4]; // "BDCI"
+    uint32_t reserved;
+};
+static_assert(sizeof(CompressedImageFooter) == 0x28, "Incorrect structure size");
+
+// OutputFile that stores the written image in a compressed container.
+//
+// Data is staged in block-sized buffers, which are compressed and written out on a worker thread
+// while the next block is being filled. Writes at offsets preceding the current block are recorded
+// as patches; writes past the current end of the image fill the gap with zeros.
+class CompressedImageWriter : public OutputFile {
+public:
+    static const uint32_t default_block_size = 0x40000;
+
+    CompressedImageWriter(OutputFile& file, uint32_t block_size = default_block_size);
+    ~CompressedImageWriter() override;
+
+    CompressedImageWriter(const CompressedImageWriter&) = delete;
+    CompressedImageWriter& operator=(const CompressedImageWriter&) = delete;
+
+    bool WriteAt(uint64_t offset, const void* data, size_t size) override;
+
+    // Flushes the container file. Data of the current block is only written by Finish.
+    bool Flush() override;
+
+    // Compress any remaining data and write the block index and footer. No data may be written afterwards.
+    bool Finish();
+
+    // Size of the (uncompressed) image written so far
+    uint64_t ImageSize() const {
+        return block_begin + block_fill;
+    }
+
+    // Size of the container. Only accurate after Finish.
+    uint64_t ContainerSize() const {
+        return container_size;
+    }
+
+private:
+    static const unsigned num_slots = 3;
+
+    struct Slot {
+        std::vector<uint8_t> data;
+        uint32_t size = 0; // Number of valid bytes; 0 tells the worker to quit
+    };
+
+    struct Patch {
+        uint64_t offset;
+        std::vector<uint8_t> data;
+    };
+
+    static void WorkerMain(void* arg);
+    void CompressBlocks();
+
+    // Hand the current block to the worker and start a new one
+    void SubmitBlock();
+
+    OutputFile& file;
+    uint32_t block_size;
+
+    // Writer state
+    std::vector<Slot> slots;
+    unsigned current_slot = 0;
+    uint64_t block_begin = 0; // Image offset of the current block
+    uint32_t block_fill = 0;
+    std::vector<Patch> patches;
+    bool finished = false;
+
+    // Worker state
+    Semaphore free_slots;
+    Semaphore filled_slots;
+    WorkerThread worker;
+    Lz4Compressor compressor;
+    std::vector<uint8_t> compressed;
+    std::vector<CompressedImageBlock> index;
+    uint64_t container_size = sizeof(CompressedImageHeader);
+    std::atomic<bool> good{true};
+};
+
+// Random-access reader for images stored with CompressedImageWriter
+class CompressedImageReader {
+public:
+    CompressedImageReader() = default;
+    ~CompressedImageReader();
+
+    CompressedImageReader(const CompressedImageReader&) = delete;
+    CompressedImageReader& operator=(const CompressedImageReader&) = delete;
+
+    bool Open(const std::string& path);
+
+    uint64_t ImageSize() const {
+        return footer.image_size;
+    }
+
+    uint32_t BlockSize() const {
+        return header.block_size;
+    }
+
+    // Read "size" bytes of the image starting at "offset". Returns false on error or if the range is out of bounds.
+    bool ReadAt(uint64_t offset, void* data, size_t size);
+
+private:
+    struct Patch {
+        uint64_t offset;
+        std::vector<uint8_t> data;
+    };
+
+    bool LoadBlock(uint32_t block);
+
+    FILE* file = nullptr;
+    CompressedImageHeader header;
+    CompressedImageFooter footer;
+    std::vector<CompressedImageBlock> index;
+    std::vector<Patch> patches;
+
+    // Most recently decompressed block
+    uint32_t cached_block = UINT32_MAX;
+    std::vector<uint8_t> block_data;
+    std::vector<uint8_t> stored_data;
+};
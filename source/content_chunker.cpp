@@ -0,0 +1,76 @@
+#include <algorithm>
+#include <array>
+
+#include "content_chunker.h"
+
+// Random values for each byte value. These define the cut points, so changing them invalidates existing chunk stores.
+static const std::array<uint64_t, 256>& GearTable() {
+    static const std::array<uint64_t, 256> table = [] {
+        std::array<uint64_t, 256> values;
+        uint64_t state = 0x6272616964756d70; // splitmix64
+        for (auto& value : values) {
+            uint64_t z = (state += 0x9E3779B97F4A7C15);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EB;
+            value = z ^ (z >> 31);
+        }
+        return values;
+    }();
+    return table;
+}
+
+// Mask with "bits" bits set, spread over the upper half of the hash (whose bits depend on more input bytes)
+static uint64_t SpreadMask(unsigned bits) {
+    uint64_t mask = 0;
+    for (unsigned bit = 0; bit < bits; ++bit)
+        mask |= uint64_t{1} << (63 - bit * 2);
+    return mask;
+}
+
+ContentChunker::ContentChunker(const Config& config) : config(config) {
+    unsigned avg_bits = 0;
+    while ((uint32_t{1} << (avg_bits + 1)) <= config.avg_size)
+        ++avg_bits;
+    mask_small = SpreadMask(std::min(avg_bits + 2, 31u));
+    mask_large = SpreadMask(avg_bits - 2);
+}
+
+size_t ContentChunker::Scan(const uint8_t* data, size_t size, bool* cut) {
+    const auto& gear = GearTable();
+    size_t pos = 0;
+
+    // Cut points below the minimum chunk size aren't considered, so the hash doesn't need to be updated there.
+    // The gear hash only depends on the last 64 bytes, so it's started just before it matters.
+    const uint32_t hash_begin = config.min_size - std::min<uint32_t>(config.min_size, 64);
+    if (chunk_size < hash_begin) {
+        size_t skip = std::min<size_t>(size, hash_begin - chunk_size);
+        pos += skip;
+        chunk_size += skip;
+    }
+
+    for (; pos < size && chunk_size < config.min_size; ++pos, ++chunk_size)
+        hash = (hash << 1) + gear[data[pos]];
+
+    for (; pos < size && chunk_size < config.avg_size; ++pos) {
+        hash = (hash << 1) + gear[data[pos]];
+        ++chunk_size;
+        if (!(hash & mask_small)) {
+            *cut = true;
+            Reset();
+            return pos + 1;
+        }
+    }
+
+    for (; pos < size; ++pos) {
+        hash = (hash << 1) + gear[data[pos]];
+        ++chunk_size;
+        if (!(hash & mask_large) || chunk_size == config.max_size) {
+            *cut = true;
+            Reset();
+            return pos + 1;
+        }
+    }
+
+    *cut = false;
+    return size;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Splits a data stream into content-defined chunks using a gear rolling hash (as in FastCDC).
+//
+// Cut points depend only on the data preceding them within the chunk, so data shared between two streams
+// (e.g. the same middleware assets in two titles) is split into identical chunks even if it's found at
+// different offsets. Below the average chunk size, a stricter mask makes cuts less likely, which keeps
+// chunk sizes close to the average ("normalized chunking").
+class ContentChunker {
+public:
+    struct Config {
+        uint32_t min_size = 0x8000;
+        uint32_t avg_size = 0x20000; // Must be a power of two
+        uint32_t max_size = 0x80000;
+    };
+
+    explicit ContentChunker(const Config& config);
+
+    // Scan "data" for the end of the current chunk. Returns the number of bytes belonging to the current chunk,
+    // and sets "cut" if the chunk ends there. Otherwise, all of "data" belongs to the chunk, which continues in
+    // the next call.
+    size_t Scan(const uint8_t* data, size_t size, bool* cut);
+
+    // Start a new chunk, e.g. at the end of the stream
+    void Reset() {
+        chunk_size = 0;
+        hash = 0;
+    }
+
+    const Config& GetConfig() const {
+        return config;
+    }
+
+private:
+    Config config;
+    uint64_t mask_small; // Used below avg_size
+    uint64_t mask_large; // Used from avg_size on
+
+    uint32_t chunk_size = 0; // Bytes in the current chunk so far
+    uint64_t hash = 0;
+};
@@ -0,0 +1,73 @@
+#include <algorithm>
+#include <new>
+
+#include "dump_arena.h"
+#include "platform.h"
+
+DumpArena::DumpArena(size_t capacity, bool linear) {
+    Reserve(capacity, linear);
+}
+
+DumpArena::~DumpArena() {
+    Free();
+}
+
+void DumpArena::Free() {
+    if (linear && memory)
+        FreeLinear(memory);
+    heap_storage.reset();
+    memory = nullptr;
+    capacity = used = 0;
+}
+
+bool DumpArena::Reserve(size_t capacity, bool linear) {
+    Free();
+    if (capacity == 0)
+        return true;
+
+    this->linear = linear;
+    if (linear) {
+        memory = static_cast<uint8_t*>(AllocateLinear(capacity, alignment));
+    } else {
+        heap_storage.reset(new uint8_t[capacity + alignment - 1]);
+        auto address = reinterpret_cast<uintptr_t>(heap_storage.get());
+        memory = heap_storage.get() + ((alignment - address % alignment) % alignment);
+    }
+    if (memory == nullptr)
+        return false;
+
+    this->capacity = capacity;
+    return true;
+}
+
+uint8_t* DumpArena::Allocate(size_t size) {
+    size_t aligned_size = (size + alignment - 1) / alignment * alignment;
+    if (aligned_size > capacity - used) {
+        ++failed_allocations;
+        return nullptr;
+    }
+
+    uint8_t* buffer = memory + used;
+    used += aligned_size;
+    high_water_mark = std::max(high_water_mark, used);
+    return buffer;
+}
+
+void DumpArena::Release(size_t mark) {
+    used = std::min(used, mark);
+}
+
+ArenaBuffer::ArenaBuffer(DumpArena* arena, size_t size) : arena(arena), mark(arena ? arena->Mark() : 0) {
+    // Empty buffers take no memory at all, rather than a heap block for the alignment slack
+    data = (arena && size) ? arena->Allocate(size) : nullptr;
+    if (data == nullptr && size != 0) {
+        heap_storage.reset(new (std::nothrow) uint8_t[size + DumpArena::alignment - 1]);
+        auto address = reinterpret_cast<uintptr_t>(heap_storage.get());
+        data = heap_storage.get() + ((DumpArena::alignment - address % DumpArena::alignment) % DumpArena::alignment);
+    }
+}
+
+ArenaBuffer::~ArenaBuffer() {
+    if (arena)
+        arena->Release(mark);
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// Memory for the buffers used while dumping, reserved once per session.
+//
+// Allocating and freeing large buffers for each title and phase fragments the 3DS application heap, until
+// dumps of large titles fail to allocate their buffers. Instead, the arena reserves a single block up front
+// and hands out pieces of it in stack order: Each phase takes its buffers on top of the ones still in use
+// and releases them when it's done (see DumpArena::Scope), so the same memory is reused by every phase.
+//
+// The arena is not thread-safe. Buffers may be used by other threads, but must be allocated and released
+// by the thread owning the arena.
+class DumpArena {
+public:
+    // Alignment of all allocations, suiting both OutputSink and DMA transfers
+    static const size_t alignment = 0x1000;
+
+    // Releases the buffers taken from the arena on destruction
+    class Scope {
+    public:
+        explicit Scope(DumpArena& arena) : arena(arena), mark(arena.Mark()) {
+        }
+
+        ~Scope() {
+            arena.Release(mark);
+        }
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        DumpArena& arena;
+        size_t mark;
+    };
+
+    DumpArena() = default;
+
+    // Reserve "capacity" bytes right away (see Reserve)
+    DumpArena(size_t capacity, bool linear);
+
+    ~DumpArena();
+
+    DumpArena(const DumpArena&) = delete;
+    DumpArena& operator=(const DumpArena&) = delete;
+
+    // Reserve "capacity" bytes. If "linear" is set, the memory is allocated such that DMA transfers may
+    // target it (see AllocateLinear), otherwise it's taken from the heap. Returns false on failure.
+    bool Reserve(size_t capacity, bool linear);
+
+    // Take "size" bytes from the arena, aligned to "alignment". Returns null if the arena is exhausted.
+    uint8_t* Allocate(size_t size);
+
+    // Position to pass to Release to free all buffers allocated after this call
+    size_t Mark() const {
+        return used;
+    }
+
+    void Release(size_t mark);
+
+    size_t Capacity() const {
+        return capacity;
+    }
+
+    // Number of bytes currently allocated
+    size_t Used() const {
+        return used;
+    }
+
+    // Largest number of bytes allocated at any time
+    size_t HighWaterMark() const {
+        return high_water_mark;
+    }
+
+    // Number of allocations that didn't fit into the arena
+    unsigned FailedAllocations() const {
+        return failed_allocations;
+    }
+
+private:
+    void Free();
+
+    uint8_t* memory = nullptr; // Aligned to "alignment"
+    std::unique_ptr<uint8_t[]> heap_storage;
+    bool linear = false;
+
+    size_t capacity = 0;
+    size_t used = 0;
+    size_t high_water_mark = 0;
+    unsigned failed_allocations = 0;
+};
+
+// Buffer taken from an arena, or from the heap if no arena is given or it's exhausted. Either way, it's aligned
+// to DumpArena::alignment, or null if the heap is exhausted as well. Empty buffers are null, too. Arena memory is released
+// on destruction, along with everything allocated from the arena after it.
+class ArenaBuffer {
+public:
+    ArenaBuffer(DumpArena* arena, size_t size);
+    ~ArenaBuffer();
+
+    ArenaBuffer(const ArenaBuffer&) = delete;
+    ArenaBuffer& operator=(const ArenaBuffer&) = delete;
+
+    uint8_t* Data() const {
+        return data;
+    }
+
+private:
+    DumpArena* arena;
+    size_t mark;
+    uint8_t* data;
+    std::unique_ptr<uint8_t[]> heap_storage;
+};
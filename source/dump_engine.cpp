@@ -0,0 +1,281 @@
+#include <algorithm>
+#include <array>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <sstream>
+#include <vector>
+
+#include "blz.h"
+#include "dump_engine.h"
+#include "ivfc.h"
+#include "sha256.h"
+
+std::string ResultToString(Result res) {
+    char buffer[16];
+    snprintf(buffer, sizeof(buffer), "0x%08" PRIx32, static_cast<uint32_t>(res));
+    return buffer;
+}
+
+uint32_t RoundUpToMediaUnit(uint32_t value) {
+    return (value + 0x1FF) / 0x200 * 0x200;
+}
+
+uint32_t BytesToMediaUnits(uint32_t value) {
+    return RoundUpToMediaUnit(value) / 0x200;
+}
+
+void PadToNextMediaUnit(OutputSink& sink, uint64_t base) {
+    sink.PadTo(0x200, base);
+}
+
+// ExeFS sections dumped, in the order they are stored in
+static const char* const exefs_section_names[] = { ".code", "banner", "icon", "logo" };
+
+bool PredictImageLayout(TitleArchive& title, ImageLayout* layout) {
+    layout->exefs_size = sizeof(ExeFs_Header);
+    for (auto name : exefs_section_names) {
+        std::unique_ptr<ArchiveFile> file;
+        uint64_t size;
+        if (title.OpenExeFSSection(name, &file) != 0 || file->GetSize(&size) != 0)
+            return false;
+        layout->exefs_size += RoundUpToMediaUnit(size);
+    }
+
+    std::unique_ptr<ArchiveFile> romfs_file;
+    uint64_t level3_size;
+    if (title.OpenRomFS(&romfs_file) != 0 || romfs_file->GetSize(&level3_size) != 0)
+        return false;
+    layout->romfs_size = IvfcHashTree::ImageSize(level3_size);
+
+    // The NCCH header and the ExHeader are followed by the ExeFS and the RomFS, all aligned to media units
+    layout->image_size = RoundUpToMediaUnit(sizeof(NCCH_Header) + sizeof(ExHeader_Header)) + layout->exefs_size +
+                         RoundUpToMediaUnit(layout->romfs_size);
+    return true;
+}
+
+// Size of the chunks in which ExeFS sections are streamed. This bounds the memory used for dumping ExeFS
+// and determines how often progress is updated.
+static const uint32_t exefs_chunk_size = 0x10000;
+
+// Stream the given ExeFS section to "out" in chunks of exefs_chunk_size bytes, invoking "on_chunk" for each chunk.
+// Returns the number of bytes written, or 0 on error.
+static uint64_t StreamExeFSSection(TitleArchive& title, OutputSink& out, const char* name, const ChunkCallback& on_chunk, DumpProgress* progress,
+                                   const MessageCallback& print, DumpArena* arena) {
+    std::unique_ptr<ArchiveFile> file;
+    Result ret = title.OpenExeFSSection(name, &file);
+    if (ret != 0) {
+        PrintMessage(print, "Couldn't open \"ExeFS/" + std::string(name) + "\" for reading (error " + ResultToString(ret) + ")");
+        return 0;
+    }
+
+    uint64_t size;
+    ret = file->GetSize(&size);
+    if (ret != 0 || !size) {
+        PrintMessage(print, "Couldn't get file size for \"ExeFS/" + std::string(name) + "\" (error " + ResultToString(ret) + ")");
+        return 0;
+    }
+
+    if (progress)
+        progress->BeginPhase(name, size);
+
+    const uint32_t buffer_size = static_cast<uint32_t>(std::min<uint64_t>(size, exefs_chunk_size));
+    ArenaBuffer buffer(arena, buffer_size);
+    if (!buffer.Data()) {
+        PrintMessage(print, "Not enough memory to read \"ExeFS/" + std::string(name) + "\"");
+        return 0;
+    }
+
+    uint64_t offset = 0;
+    while (offset != size) {
+        uint32_t bytes_to_read = static_cast<uint32_t>(std::min<uint64_t>(buffer_size, size - offset));
+        uint32_t bytes_read;
+        ret = file->Read(offset, buffer.Data(), bytes_to_read, &bytes_read);
+        if (ret != 0 || bytes_read != bytes_to_read) {
+            std::stringstream message;
+            message << "Expected to read " << bytes_to_read << " bytes at offset " << offset << ", read " << bytes_read << " (error " << ResultToString(ret) << ")";
+            PrintMessage(print, message.str());
+            return 0;
+        }
+
+        if (!out.Write(buffer.Data(), bytes_read)) {
+            PrintMessage(print, "Error while writing output... is your SD card full?");
+            return 0;
+        }
+
+        if (on_chunk)
+            on_chunk(buffer.Data(), bytes_read);
+
+        offset += bytes_read;
+        if (progress)
+            progress->SetDone(offset);
+    }
+
+    if (progress)
+        progress->EndPhase();
+    return size;
+}
+
+bool WriteSection(TitleArchive& title, const char* section_name, OutputSink& exefs_file, uint64_t exefs_header_end,
+                  ExeFs_SectionHeader& header, const ChunkCallback& on_chunk, DumpProgress* progress, const MessageCallback& print, DumpArena* arena) {
+    // Write section data to file
+    const auto section_begin = exefs_file.Tell();
+    uint32_t size = StreamExeFSSection(title, exefs_file, section_name, on_chunk, progress, print, arena);
+    if (size == 0)
+        return false;
+
+    // Pad with zeros to media unit size
+    if (!exefs_file.FillZero(RoundUpToMediaUnit(size) - size))
+        return false;
+
+    // Build header - don't include padding in the reported size
+    header = ExeFs_SectionHeader{{}, (uint32_t)(section_begin - exefs_header_end), size };
+    std::strcpy(header.name, section_name);
+    return true;
+}
+
+uint32_t DumpExeFS(TitleArchive& title, OutputSink& exefs_file, uint8_t* header_hash, DumpJournal* journal, PerfTelemetry* perf,
+                   DumpProgress* progress, const MessageCallback& print, DumpArena* arena, bool* code_compressed) {
+    // Generate dummy ExeFS header to fill in later
+    const auto exefs_header_begin = exefs_file.Tell();
+    exefs_file.FillZero(sizeof(ExeFs_Header));
+    const auto exefs_header_end = exefs_file.Tell();
+
+    // Write content sections
+    ExeFs_Header exefs_header;
+    memset(&exefs_header, 0, sizeof(exefs_header));
+
+    // Whether .code is compressed and the size it decompresses to are determined by its BLZ footer (see BlzFooter).
+    // Since sections are streamed, keep track of the last eight bytes seen so far.
+    std::array<uint8_t, sizeof(BlzFooter)> code_tail{};
+    auto track_code_tail = [&code_tail](const uint8_t* data, uint32_t size) {
+        uint32_t num_new = std::min<uint32_t>(size, code_tail.size());
+        std::copy(code_tail.begin() + num_new, code_tail.end(), code_tail.begin());
+        std::copy(data + size - num_new, data + size, code_tail.end() - num_new);
+    };
+
+    const unsigned num_hashes = std::extent<decltype(exefs_header.hashes)>::value;
+    for (unsigned index = 0; index < std::extent<decltype(exefs_section_names)>::value; ++index) {
+        if (journal && index < journal->ExeFSSections().size()) {
+            // Section has been dumped by a previous run already
+            const auto& section = journal->ExeFSSections()[index];
+            exefs_header.section[index] = section.header;
+            std::copy(std::begin(section.hash), std::end(section.hash), exefs_header.hashes[num_hashes - 1 - index]);
+            if (index == 0)
+                std::copy(std::begin(section.code_tail), std::end(section.code_tail), code_tail.begin());
+            exefs_file.Seek(section.end_offset);
+            if (progress)
+                progress->SkipPhase(exefs_section_names[index], section.header.size);
+            continue;
+        }
+
+        uint64_t section_begin = GetTicks();
+
+        // Hash section data while it's being written.
+        Sha256 section_hash;
+        auto on_chunk = [&](const uint8_t* data, uint32_t size) {
+            section_hash.Update(data, size);
+            if (index == 0)
+                track_code_tail(data, size);
+        };
+        if (!WriteSection(title, exefs_section_names[index], exefs_file, exefs_header_end, exefs_header.section[index], on_chunk, progress, print, arena))
+            return 0;
+
+        if (perf)
+            perf->RecordPhase(std::string("exefs/") + exefs_section_names[index], section_begin, exefs_header.section[index].size);
+
+        // Hashes are stored in reverse order, i.e. the hash for the first section is stored last
+        section_hash.Final(exefs_header.hashes[num_hashes - 1 - index]);
+
+        // Record the section once its data is safely stored
+        if (journal && exefs_file.Flush()) {
+            DumpJournal::ExeFSSection record;
+            record.index = index;
+            record.header = exefs_header.section[index];
+            std::copy(std::begin(exefs_header.hashes[num_hashes - 1 - index]), std::end(exefs_header.hashes[num_hashes - 1 - index]), record.hash);
+            std::copy(code_tail.begin(), code_tail.end(), record.code_tail);
+            record.end_offset = exefs_file.Tell();
+            journal->AppendExeFSSection(record);
+        }
+    }
+
+    // Uncompressed .code doesn't end with a valid footer. A footer that's valid by chance can't be told apart
+    // without decompressing, which would need a buffer as large as the decompressed code.
+    BlzFooter footer;
+    memcpy(&footer, code_tail.data(), sizeof(footer));
+    uint32_t size_decompressed_code = BlzDecompressedSize(footer, exefs_header.section[0].size);
+    if (code_compressed)
+        *code_compressed = (size_decompressed_code != 0);
+    if (size_decompressed_code == 0)
+        size_decompressed_code = exefs_header.section[0].size;
+
+    // Fill in ExeFS header
+    if (header_hash)
+        Sha256::Hash(&exefs_header, sizeof(exefs_header), header_hash);
+    if (!exefs_file.Patch(exefs_header_begin, &exefs_header, sizeof(exefs_header)))
+        return 0;
+
+    return size_decompressed_code;
+}
+
+bool DumpRomFS(TitleArchive& title, OutputSink& out_file, RomFSSuperblockInfo* superblock_info, DumpJournal* journal, PerfTelemetry* perf,
+               ChunkAutotuner* autotuner, DumpProgress* progress, const MessageCallback& print, DumpArena* arena, ReadRecovery* recovery) {
+    std::unique_ptr<ArchiveFile> romfs_file;
+    Result ret = title.OpenRomFS(&romfs_file);
+    if (ret != 0) {
+        PrintMessage(print, "Couldn't open RomFS for reading (error " + ResultToString(ret) + ")");
+        return false;
+    }
+
+    uint64_t size;
+    ret = romfs_file->GetSize(&size);
+    if (ret != 0 || !size) {
+        PrintMessage(print, "Couldn't get RomFS size (error " + ResultToString(ret) + ")");
+        return false;
+    }
+
+    uint64_t begin = GetTicks();
+    if (progress)
+        progress->BeginPhase("RomFS", size);
+    auto status = WriteRomFSImage(*romfs_file, size, out_file, [progress](uint64_t offset) {
+        if (progress)
+            progress->SetDone(offset);
+    }, superblock_info, journal, autotuner, arena, recovery);
+    if (progress)
+        progress->EndPhase();
+    if (perf) {
+        perf->RecordPhase("romfs", begin, size);
+        perf->RecordStalls("romfs/writer_waiting_for_data", status.writer_stalls, status.writer_stall_ticks);
+        perf->RecordStalls("romfs/reader_waiting_for_buffers", status.reader_stalls, status.reader_stall_ticks);
+    }
+    if (recovery && recovery->retried_reads != 0) {
+        std::stringstream message;
+        message << "Retried " << recovery->retried_reads << " RomFS reads";
+        if (recovery->unreadable_size != 0)
+            message << ", " << recovery->unreadable_size / 1024 << " KiB couldn't be read and were zero-filled";
+        PrintMessage(print, message.str());
+    }
+    if (status.read_failed) {
+        PrintMessage(print, "Error while reading RomFS (error " + ResultToString(status.read_result) + ")");
+        return false;
+    }
+    if (status.write_failed) {
+        PrintMessage(print, "Error while writing output... is your SD card full?");
+        return false;
+    }
+
+    return true;
+}
+
+bool WriteUnreadableRanges(const std::string& path, const std::vector<ReadRecovery::Range>& ranges) {
+    FILE* file = fopen(path.c_str(), "w");
+    if (file == nullptr)
+        return false;
+
+    // Offsets are given both in the image and in the RomFS level 3 data, all in hex
+    fprintf(file, "# image_offset   size     level3_offset\n");
+    for (auto& range : ranges)
+        fprintf(file, "%016" PRIx64 " %08" PRIx32 " %016" PRIx64 "\n", range.dest_offset, range.size, range.source_offset);
+    return fclose(file) == 0;
+}
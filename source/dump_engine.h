@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "dump_arena.h"
+#include "dump_journal.h"
+#include "dump_pipeline.h"
+#include "dump_progress.h"
+#include "ncch.h"
+#include "output_sink.h"
+#include "perf_telemetry.h"
+#include "romfs_image.h"
+#include "title_archive.h"
+
+// Platform-independent parts of the title dumping logic. These read title contents through a
+// TitleArchive, so they can be driven by synthetic titles on the host for benchmarking.
+
+std::string ResultToString(Result res);
+
+uint32_t RoundUpToMediaUnit(uint32_t value);
+uint32_t BytesToMediaUnits(uint32_t value);
+
+// Append dummy bytes to "sink" until the offset with respect to the given "base" is a multiple of the media unit size.
+void PadToNextMediaUnit(OutputSink& sink, uint64_t base);
+
+// Stream the given ExeFS section from the title to "exefs_file" and fill in its section header.
+// "on_chunk" is invoked for each chunk of section data written. Returns false on error.
+// If "progress" is non-null, the section is reported as a phase named "section_name", which must outlive it.
+// Errors are reported through "print".
+// If "arena" is non-null, the streaming buffer is taken from it.
+bool WriteSection(TitleArchive& title, const char* section_name, OutputSink& exefs_file, uint64_t exefs_header_end,
+                  ExeFs_SectionHeader& header, const ChunkCallback& on_chunk, DumpProgress* progress, const MessageCallback& print, DumpArena* arena);
+
+// Sizes of the images DumpExeFS and DumpRomFS produce for a title
+struct ImageLayout {
+    uint64_t exefs_size = 0; // ExeFS image, including the ExeFS header
+    uint64_t romfs_size = 0; // RomFS image, including the IVFC hash tree
+    uint64_t image_size = 0; // Full NCCH image
+};
+
+// Compute the image sizes from the sizes of the title's ExeFS sections and its RomFS, without reading any data.
+// This allows output files to be preallocated. Returns false if any of the sizes can't be queried.
+bool PredictImageLayout(TitleArchive& title, ImageLayout* layout);
+
+// Dump the ExeFS of the title. Returns the size of the decompressed .code section, or 0 on error.
+// If "header_hash" is non-null, the SHA-256 hash of the ExeFS header is stored there.
+// If "journal" is non-null, completed sections are recorded in it, and sections recorded by a previous run are skipped.
+// If "perf" is non-null, the time taken by each section is recorded in it.
+// If "progress" is non-null, each section is reported as a phase of it.
+// Errors are reported through "print".
+// If "arena" is non-null, the streaming buffer is taken from it.
+// If "code_compressed" is non-null, it's set to whether the .code section ends with a valid BLZ footer.
+uint32_t DumpExeFS(TitleArchive& title, OutputSink& exefs_file, uint8_t* header_hash, DumpJournal* journal, PerfTelemetry* perf,
+                   DumpProgress* progress, const MessageCallback& print, DumpArena* arena, bool* code_compressed);
+
+// Dump the RomFS and generate its IVFC hash tree.
+// If "superblock_info" is non-null, it's filled with the information needed for the NCCH header.
+// If "journal" is non-null, progress is recorded in it, and the dump is resumed from the last recorded checkpoint.
+// If "perf" is non-null, the time taken and pipeline stalls are recorded in it.
+// If "autotuner" is non-null, it picks the size of RomFS reads.
+// If "progress" is non-null, the RomFS is reported as a phase of it.
+// Errors and read retries are reported through "print".
+// If "arena" is non-null, the pipeline buffers are taken from it.
+// If "recovery" is non-null, failed reads are retried, and data that can't be read is zero-filled and listed in it.
+bool DumpRomFS(TitleArchive& title, OutputSink& out_file, RomFSSuperblockInfo* superblock_info, DumpJournal* journal, PerfTelemetry* perf,
+               ChunkAutotuner* autotuner, DumpProgress* progress, const MessageCallback& print, DumpArena* arena, ReadRecovery* recovery);
+
+// Write the ranges of an image that couldn't be read (as listed by ReadRecovery) to a text file at "path"
+bool WriteUnreadableRanges(const std::string& path, const std::vector<ReadRecovery::Range>& ranges);
@@ -0,0 +1,341 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+#include "dump_journal.h"
+#include "sha256.h"
+
+enum class DumpJournal::RecordType : uint32_t {
+    Begin = 1,
+    ExeFSSection = 2,
+    RomFSCheckpoint = 3,
+    UnreadableRanges = 4, // Applies to the RomFS checkpoint following it
+};
+
+namespace {
+
+const uint32_t journal_version = 2;
+const uint32_t level3_block_size = 0x1000;
+
+struct RecordHeader {
+    uint32_t type;
+    uint32_t size;
+    uint8_t checksum[8]; // Leading bytes of the SHA-256 hash of the payload
+};
+
+struct BeginRecord {
+    uint64_t title_id;
+    uint32_t version;
+    uint32_t reserved;
+};
+
+// Followed by the level 2 hashes for level 3 data between level3_previous and level3_written
+struct RomFSCheckpointRecord {
+    uint64_t romfs_offset;
+    uint64_t level3_offset;
+    uint64_t level3_size;
+    uint64_t level3_previous;
+    uint64_t level3_written;
+};
+
+// Records the full list of unreadable ranges as one array
+struct UnreadableRangeRecord {
+    uint64_t source_offset;
+    uint64_t dest_offset;
+    uint32_t size;
+    uint32_t reserved;
+};
+
+uint64_t UnreadableSize(const std::vector<ReadRecovery::Range>& ranges) {
+    uint64_t size = 0;
+    for (auto& range : ranges)
+        size += range.size;
+    return size;
+}
+
+// The checksum covers the record header (except for the checksum itself) and the payload
+void ComputeChecksum(const RecordHeader& header, const void* data1, size_t size1, const void* data2, size_t size2, uint8_t* checksum) {
+    Sha256 hash;
+    hash.Update(&header, offsetof(RecordHeader, checksum));
+    hash.Update(data1, size1);
+    hash.Update(data2, size2);
+
+    uint8_t digest[Sha256::digest_size];
+    hash.Final(digest);
+    memcpy(checksum, digest, sizeof(RecordHeader::checksum));
+}
+
+uint64_t Level2HashesSize(uint64_t level3_size) {
+    return level3_size / level3_block_size * Sha256::digest_size;
+}
+
+// Largest record, i.e. a checkpoint covering all level 3 data of a RomFS filling the largest game card (8 GiB)
+const uint64_t max_record_size = sizeof(RomFSCheckpointRecord) + Level2HashesSize(uint64_t{8} << 30);
+
+} // anonymous namespace
+
+DumpJournal::~DumpJournal() {
+    if (file)
+        fclose(file);
+}
+
+bool DumpJournal::Open(const std::string& path, uint64_t title_id, const std::string& output_path) {
+    this->path = path;
+    resuming = Load(title_id) && Validate(output_path);
+    if (!resuming) {
+        exefs_sections.clear();
+        romfs = RomFSProgress{};
+    }
+
+    // Start over with a compacted journal. This also drops any incomplete trailing record.
+    return Rewrite(title_id);
+}
+
+void DumpJournal::Remove() {
+    if (file) {
+        fclose(file);
+        file = nullptr;
+    }
+    remove(path.c_str());
+}
+
+bool DumpJournal::Load(uint64_t title_id) {
+    FILE* in = fopen(path.c_str(), "rb");
+    if (in == nullptr)
+        return false;
+
+    uint64_t journal_size = 0;
+    if (fseeko(in, 0, SEEK_END) == 0)
+        journal_size = ftello(in);
+    fseeko(in, 0, SEEK_SET);
+
+    bool began = false;
+    std::vector<ReadRecovery::Range> unreadable;
+    std::vector<uint8_t> payload;
+    RecordHeader header;
+    while (fread(&header, sizeof(header), 1, in) == 1) {
+        // Don't trust a corrupted size with allocating the payload, which can't extend past the end of the journal anyway
+        if (header.size > max_record_size || header.size > journal_size - ftello(in))
+            break;
+        payload.resize(header.size);
+        if (fread(payload.data(), 1, payload.size(), in) != payload.size())
+            break;
+
+        uint8_t checksum[sizeof(header.checksum)];
+        ComputeChecksum(header, payload.data(), payload.size(), nullptr, 0, checksum);
+        if (memcmp(checksum, header.checksum, sizeof(checksum)) != 0)
+            break;
+
+        switch (static_cast<RecordType>(header.type)) {
+        case RecordType::Begin: {
+            BeginRecord record;
+            if (began || payload.size() != sizeof(record))
+                goto done;
+            memcpy(&record, payload.data(), sizeof(record));
+            if (record.version != journal_version || record.title_id != title_id)
+                goto done;
+            began = true;
+            break;
+        }
+
+        case RecordType::ExeFSSection: {
+            ExeFSSection section;
+            if (!began || payload.size() != sizeof(section))
+                goto done;
+            memcpy(&section, payload.data(), sizeof(section));
+            if (section.index != exefs_sections.size())
+                goto done;
+            exefs_sections.push_back(section);
+            break;
+        }
+
+        case RecordType::RomFSCheckpoint: {
+            RomFSCheckpointRecord record;
+            if (!began || payload.size() < sizeof(record))
+                goto done;
+            memcpy(&record, payload.data(), sizeof(record));
+
+            // Each checkpoint continues where the previous one left off
+            if (record.level3_previous != romfs.level3_written ||
+                (romfs.level3_written != 0 && (record.romfs_offset != romfs.romfs_offset ||
+                                               record.level3_offset != romfs.level3_offset ||
+                                               record.level3_size != romfs.level3_size)) ||
+                record.level3_written > record.level3_size ||
+                payload.size() - sizeof(record) != Level2HashesSize(record.level3_written) - Level2HashesSize(record.level3_previous))
+                goto done;
+
+            romfs.romfs_offset = record.romfs_offset;
+            romfs.level3_offset = record.level3_offset;
+            romfs.level3_size = record.level3_size;
+            romfs.level3_written = record.level3_written;
+            romfs.level2_hashes.insert(romfs.level2_hashes.end(), payload.begin() + sizeof(record), payload.end());
+            romfs.unreadable = unreadable;
+            break;
+        }
+
+        case RecordType::UnreadableRanges: {
+            if (!began || payload.size() % sizeof(UnreadableRangeRecord) != 0)
+                goto done;
+
+            unreadable.clear();
+            for (size_t offset = 0; offset < payload.size(); offset += sizeof(UnreadableRangeRecord)) {
+                UnreadableRangeRecord record;
+                memcpy(&record, payload.data() + offset, sizeof(record));
+                unreadable.push_back(ReadRecovery::Range{ record.source_offset, record.dest_offset, record.size });
+            }
+            break;
+        }
+
+        default:
+            goto done;
+        }
+    }
+
+done:
+    fclose(in);
+    return began && (!exefs_sections.empty() || romfs.level3_written != 0);
+}
+
+bool DumpJournal::Validate(const std::string& output_path) const {
+    FILE* out = fopen(output_path.c_str(), "rb");
+    if (out == nullptr)
+        return false;
+
+    bool valid = false;
+    if (fseeko(out, 0, SEEK_END) == 0) {
+        uint64_t size = ftello(out);
+
+        // Make sure the last ExeFS section recorded actually made it to the output file. Its size alone doesn't
+        // tell, since the file may have been preallocated.
+        valid = true;
+        if (!exefs_sections.empty()) {
+            const auto& section = exefs_sections.back();
+            const uint64_t section_size = (section.header.size + uint64_t{0x1FF}) / 0x200 * 0x200;
+            Sha256 hash;
+            std::vector<uint8_t> chunk(level3_block_size);
+            valid = section.end_offset <= size && section_size <= section.end_offset &&
+                    fseeko(out, section.end_offset - section_size, SEEK_SET) == 0;
+            for (uint64_t remaining = section.header.size; valid && remaining != 0; ) {
+                size_t chunk_size = static_cast<size_t>(std::min<uint64_t>(remaining, chunk.size()));
+                valid = fread(chunk.data(), 1, chunk_size, out) == chunk_size;
+                hash.Update(chunk.data(), chunk_size);
+                remaining -= chunk_size;
+            }
+            uint8_t digest[Sha256::digest_size];
+            if (valid) {
+                hash.Final(digest);
+                valid = std::equal(digest, digest + sizeof(digest), section.hash);
+            }
+        }
+
+        // Make sure the last level 3 block recorded actually made it to the output file
+        if (valid && romfs.level3_written >= level3_block_size) {
+            uint64_t block_offset = romfs.romfs_offset + romfs.level3_offset + romfs.level3_written - level3_block_size;
+            std::vector<uint8_t> block(level3_block_size);
+            uint8_t digest[Sha256::digest_size];
+
+            valid = block_offset + block.size() <= size &&
+                    fseeko(out, block_offset, SEEK_SET) == 0 &&
+                    fread(block.data(), 1, block.size(), out) == block.size();
+            if (valid) {
+                Sha256::Hash(block.data(), block.size(), digest);
+                valid = std::equal(digest, digest + sizeof(digest), romfs.level2_hashes.end() - Sha256::digest_size);
+            }
+        }
+    }
+
+    fclose(out);
+    return valid;
+}
+
+bool DumpJournal::Rewrite(uint64_t title_id) {
+    if (file) {
+        fclose(file);
+        file = nullptr;
+    }
+
+    std::string temp_path = path + ".tmp";
+    file = fopen(temp_path.c_str(), "wb");
+    if (file == nullptr)
+        return false;
+
+    BeginRecord begin{ title_id, journal_version, 0 };
+    bool success = AppendRecord(RecordType::Begin, &begin, sizeof(begin));
+    for (auto& section : exefs_sections)
+        success &= AppendRecord(RecordType::ExeFSSection, &section, sizeof(section));
+    if (romfs.level3_written != 0) {
+        if (!romfs.unreadable.empty())
+            success &= AppendUnreadableRanges(romfs.unreadable);
+        RomFSCheckpointRecord record{ romfs.romfs_offset, romfs.level3_offset, romfs.level3_size, 0, romfs.level3_written };
+        success &= AppendRecord(RecordType::RomFSCheckpoint, &record, sizeof(record), romfs.level2_hashes.data(), romfs.level2_hashes.size());
+    }
+
+    fclose(file);
+    file = nullptr;
+    if (!success)
+        return false;
+
+    remove(path.c_str());
+    if (rename(temp_path.c_str(), path.c_str()) != 0)
+        return false;
+
+    file = fopen(path.c_str(), "ab");
+    return file != nullptr;
+}
+
+bool DumpJournal::AppendRecord(RecordType type, const void* data, size_t size) {
+    return AppendRecord(type, data, size, nullptr, 0);
+}
+
+bool DumpJournal::AppendRecord(RecordType type, const void* data1, size_t size1, const void* data2, size_t size2) {
+    if (file == nullptr)
+        return false;
+
+    RecordHeader header;
+    header.type = static_cast<uint32_t>(type);
+    header.size = size1 + size2;
+    ComputeChecksum(header, data1, size1, data2, size2, header.checksum);
+
+    return fwrite(&header, sizeof(header), 1, file) == 1 &&
+           fwrite(data1, 1, size1, file) == size1 &&
+           (size2 == 0 || fwrite(data2, 1, size2, file) == size2) &&
+           fflush(file) == 0;
+}
+
+bool DumpJournal::AppendUnreadableRanges(const std::vector<ReadRecovery::Range>& ranges) {
+    std::vector<UnreadableRangeRecord> records;
+    for (auto& range : ranges)
+        records.push_back(UnreadableRangeRecord{ range.source_offset, range.dest_offset, range.size, 0 });
+    return AppendRecord(RecordType::UnreadableRanges, records.data(), records.size() * sizeof(records[0]));
+}
+
+bool DumpJournal::AppendExeFSSection(const ExeFSSection& section) {
+    if (!AppendRecord(RecordType::ExeFSSection, &section, sizeof(section)))
+        return false;
+
+    exefs_sections.push_back(section);
+    return true;
+}
+
+bool DumpJournal::AppendRomFSCheckpoint(const RomFSProgress& progress, const uint8_t* level2_hashes) {
+    if (romfs.romfs_offset != progress.romfs_offset || romfs.level3_offset != progress.level3_offset ||
+        romfs.level3_size != progress.level3_size) {
+        // First checkpoint of this RomFS
+        romfs = RomFSProgress{ progress.romfs_offset, progress.level3_offset, progress.level3_size, 0, {}, {} };
+    }
+
+    // Ranges are only ever added or extended, so any change shows in their total size
+    if (UnreadableSize(progress.unreadable) != UnreadableSize(romfs.unreadable) && !AppendUnreadableRanges(progress.unreadable))
+        return false;
+
+    auto hashes_begin = level2_hashes + Level2HashesSize(romfs.level3_written);
+    auto hashes_end = level2_hashes + Level2HashesSize(progress.level3_written);
+    RomFSCheckpointRecord record{ romfs.romfs_offset, romfs.level3_offset, romfs.level3_size, romfs.level3_written, progress.level3_written };
+    if (!AppendRecord(RecordType::RomFSCheckpoint, &record, sizeof(record), hashes_begin, hashes_end - hashes_begin))
+        return false;
+
+    romfs.level3_written = progress.level3_written;
+    romfs.level2_hashes.insert(romfs.level2_hashes.end(), hashes_begin, hashes_end);
+    romfs.unreadable = progress.unreadable;
+    return true;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "dump_pipeline.h"
+#include "ncch.h"
+
+// Append-only journal stored next to a dump in progress, used to resume interrupted dumps.
+//
+// Each record is only appended once the data it describes has been flushed to the output file.
+// When reopening a journal, records up to the first incomplete or corrupted one are used, and the
+// output file is checked to be consistent with them before resuming.
+class DumpJournal {
+public:
+    struct ExeFSSection {
+        uint32_t index;
+        ExeFs_SectionHeader header;
+        uint8_t hash[0x20];
+        uint8_t code_tail[8]; // Last eight bytes of the section (only used for .code)
+        uint64_t end_offset;  // Output file offset following the section (including padding)
+    };
+
+    struct RomFSProgress {
+        uint64_t romfs_offset = 0;   // Output file offset of the RomFS image
+        uint64_t level3_offset = 0;  // Offset of the level 3 data within the RomFS image
+        uint64_t level3_size = 0;
+        uint64_t level3_written = 0; // Number of level 3 bytes written and hashed
+        std::vector<uint8_t> level2_hashes; // Hashes of the level 3 blocks written so far
+        std::vector<ReadRecovery::Range> unreadable; // Level 3 data written so far that couldn't be read
+    };
+
+    DumpJournal() = default;
+    ~DumpJournal();
+
+    DumpJournal(const DumpJournal&) = delete;
+    DumpJournal& operator=(const DumpJournal&) = delete;
+
+    // Open the journal at "path" for the dump of "title_id" to "output_path".
+    // If a valid journal for the same title exists and the output file is consistent with it, its state
+    // is restored and Resuming() returns true. Otherwise, a new journal is started.
+    // Returns false if the journal couldn't be written.
+    bool Open(const std::string& path, uint64_t title_id, const std::string& output_path);
+
+    // Delete the journal once the dump has completed
+    void Remove();
+
+    bool Resuming() const {
+        return resuming;
+    }
+
+    const std::vector<ExeFSSection>& ExeFSSections() const {
+        return exefs_sections;
+    }
+
+    const RomFSProgress& RomFS() const {
+        return romfs;
+    }
+
+    bool AppendExeFSSection(const ExeFSSection& section);
+
+    // Record that "progress.level3_written" bytes of level 3 data have been written.
+    // "level2_hashes" must contain the hashes of all level 3 data written so far; progress.level2_hashes is ignored.
+    // "progress.unreadable" must list all unreadable ranges within that data.
+    bool AppendRomFSCheckpoint(const RomFSProgress& progress, const uint8_t* level2_hashes);
+
+private:
+    enum class RecordType : uint32_t;
+
+    bool Load(uint64_t title_id);
+    bool Validate(const std::string& output_path) const;
+    bool Rewrite(uint64_t title_id);
+    bool AppendRecord(RecordType type, const void* data, size_t size);
+    bool AppendRecord(RecordType type, const void* data1, size_t size1, const void* data2, size_t size2);
+    bool AppendUnreadableRanges(const std::vector<ReadRecovery::Range>& ranges);
+
+    std::string path;
+    FILE* file = nullptr;
+    bool resuming = false;
+
+    std::vector<ExeFSSection> exefs_sections;
+    RomFSProgress romfs;
+};
@@ -0,0 +1,252 @@
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <vector>
+
+#include "dump_pipeline.h"
+
+namespace {
+
+// Waits longer than this are counted as pipeline stalls
+const uint64_t stall_threshold = ticks_per_second / 1000;
+
+// Acquire "semaphore", recording the wait as a stall if it took noticeably long
+void AcquireTimed(Semaphore& semaphore, uint32_t& stalls, uint64_t& stall_ticks) {
+    uint64_t begin = GetTicks();
+    semaphore.Acquire();
+    uint64_t ticks = GetTicks() - begin;
+    if (ticks > stall_threshold) {
+        ++stalls;
+        stall_ticks += ticks;
+    }
+}
+
+struct Slot {
+    uint8_t* data = nullptr;
+    uint32_t capacity = 0;
+    std::vector<uint8_t> storage; // Backs "data" if it couldn't be taken from the arena
+    uint32_t size = 0; // Number of valid bytes; 0 signals that the reader gave up
+    std::vector<ReadRecovery::Range> unreadable; // Zero-filled parts of the data, passed on to the writer along with it
+
+    // Number of consumers (writer and processor) that are still using this slot
+    std::atomic<unsigned> pending_consumers{0};
+};
+
+struct PipelineState {
+    ArchiveFile& source;
+    DumpArena* arena;
+    size_t arena_mark;
+    ReadRecovery* recovery;
+    uint64_t dest_base = 0; // Destination offset corresponding to source offset 0
+    uint64_t start_offset;
+    uint64_t size;
+    ChunkAutotuner* autotuner;
+    const ChunkCallback& process;
+    unsigned num_consumers;
+
+    std::vector<Slot> slots;
+    Semaphore free_slots;
+    Semaphore filled_slots;   // Slots ready to be written
+    Semaphore unprocessed_slots; // Slots ready to be processed
+    std::atomic<bool> abort{false};
+    PipelineStatus status;
+
+    PipelineState(ArchiveFile& source, uint64_t size, const PipelineConfig& config, const ChunkCallback& process)
+        : source(source), arena(config.arena), arena_mark(arena ? arena->Mark() : 0), recovery(config.recovery),
+          start_offset(config.start_offset), size(size),
+          autotuner(config.autotuner), process(process),
+          num_consumers(process ? 2 : 1), slots(config.num_buffers),
+          free_slots(config.num_buffers, config.num_buffers), filled_slots(0, config.num_buffers),
+          unprocessed_slots(0, config.num_buffers) {
+        for (auto& slot : slots) {
+            slot.capacity = autotuner ? autotuner->MaxChunkSize() : config.chunk_size;
+            slot.data = arena ? arena->Allocate(slot.capacity) : nullptr;
+            if (slot.data == nullptr) {
+                slot.storage.resize(slot.capacity);
+                slot.data = slot.storage.data();
+            }
+        }
+    }
+
+    ~PipelineState() {
+        if (arena)
+            arena->Release(arena_mark);
+    }
+
+    Slot& GetSlot(size_t index) {
+        return slots[index % slots.size()];
+    }
+
+    // Hand a slot over to its consumers
+    void PublishSlot(Slot& slot) {
+        slot.pending_consumers = num_consumers;
+        filled_slots.Release();
+        if (process)
+            unprocessed_slots.Release();
+    }
+
+    // Called by each consumer once it's done with a slot. The last one returns it to the reader.
+    void ReleaseSlot(Slot& slot) {
+        if (--slot.pending_consumers == 0)
+            free_slots.Release();
+    }
+};
+
+// Append "range" to "ranges", merging it with the last range if they're adjacent
+void AddUnreadableRange(std::vector<ReadRecovery::Range>& ranges, const ReadRecovery::Range& range) {
+    if (!ranges.empty() && ranges.back().source_offset + ranges.back().size == range.source_offset)
+        ranges.back().size += range.size;
+    else
+        ranges.push_back(range);
+}
+
+// Read "size" bytes at "offset" after a read of them failed: Retry with backoff, then bisect. Data that can't be read
+// is zero-filled and recorded in "unreadable". Returns false if the copy should be aborted.
+bool RecoverRead(PipelineState& state, uint64_t offset, uint8_t* data, uint32_t size, bool whole_chunk,
+                 std::vector<ReadRecovery::Range>& unreadable) {
+    auto& recovery = *state.recovery;
+    const auto& config = recovery.config;
+
+    // The whole chunk has been attempted once already. Halves get a single attempt, unless they can't be split further:
+    // Most of them are readable, and retrying is left to the smallest pieces that actually contain the bad spot.
+    const bool smallest = size <= config.min_read_size;
+    const unsigned attempts = (whole_chunk || smallest) ? config.max_attempts : 1;
+    uint32_t backoff_us = config.initial_backoff_us;
+    for (unsigned attempt = whole_chunk ? 1 : 0; attempt < attempts; ++attempt) {
+        if (attempt != 0) {
+            ++recovery.retried_reads;
+            SleepMicroseconds(backoff_us);
+            backoff_us *= 2;
+        }
+        if (state.abort)
+            return false;
+
+        uint32_t bytes_read = 0;
+        if (state.source.Read(offset, data, size, &bytes_read) == 0 && bytes_read == size)
+            return true;
+    }
+
+    if (!smallest) {
+        uint32_t half = (size / 2 + config.min_read_size - 1) / config.min_read_size * config.min_read_size;
+        return RecoverRead(state, offset, data, half, false, unreadable) &&
+               RecoverRead(state, offset + half, data + half, size - half, false, unreadable);
+    }
+
+    memset(data, 0, size);
+    AddUnreadableRange(unreadable, ReadRecovery::Range{ offset, state.dest_base + offset, size });
+    recovery.unreadable_size += size;
+    return recovery.unreadable_size <= config.max_unreadable_size;
+}
+
+void ReaderThreadMain(void* arg) {
+    auto& state = *static_cast<PipelineState*>(arg);
+
+    uint64_t offset = state.start_offset;
+    for (size_t index = 0; offset != state.size; ++index) {
+        AcquireTimed(state.free_slots, state.status.reader_stalls, state.status.reader_stall_ticks);
+        if (state.abort)
+            return;
+
+        auto& slot = state.GetSlot(index);
+        uint32_t chunk_size = state.autotuner ? state.autotuner->NextChunkSize() : slot.capacity;
+        uint32_t bytes_to_read = static_cast<uint32_t>(std::min<uint64_t>(chunk_size, state.size - offset));
+        uint32_t bytes_read = 0;
+        slot.unreadable.clear();
+        uint64_t read_begin = state.autotuner ? state.autotuner->Now() : 0;
+        Result ret = state.source.Read(offset, slot.data, bytes_to_read, &bytes_read);
+        if (state.autotuner && ret == 0)
+            state.autotuner->RecordRead(bytes_read, read_begin);
+        if ((ret != 0 || bytes_read == 0) && state.recovery && RecoverRead(state, offset, slot.data, bytes_to_read, true, slot.unreadable)) {
+            ret = 0;
+            bytes_read = bytes_to_read;
+        }
+        if (ret != 0 || bytes_read == 0) {
+            state.status.read_failed = true;
+            state.status.read_result = ret;
+            slot.size = 0;
+            state.PublishSlot(slot);
+            return;
+        }
+
+        slot.size = bytes_read;
+        offset += bytes_read;
+        state.PublishSlot(slot);
+    }
+}
+
+void ProcessorThreadMain(void* arg) {
+    auto& state = *static_cast<PipelineState*>(arg);
+
+    uint64_t offset = state.start_offset;
+    for (size_t index = 0; offset != state.size; ++index) {
+        state.unprocessed_slots.Acquire();
+        if (state.abort)
+            return;
+
+        auto& slot = state.GetSlot(index);
+        if (slot.size == 0)
+            return;
+
+        state.process(slot.data, slot.size);
+        offset += slot.size;
+        state.ReleaseSlot(slot);
+    }
+}
+
+} // anonymous namespace
+
+PipelineStatus CopyPipelined(ArchiveFile& source, uint64_t size, OutputSink& dest,
+                             const PipelineConfig& config,
+                             const ChunkCallback& process,
+                             const std::function<void(uint64_t)>& on_progress) {
+    PipelineState state(source, size, config, process);
+    state.dest_base = dest.Tell() - config.start_offset;
+
+    // Processing (i.e. hashing) is CPU-bound, and must not hold up the reads and writes
+    WorkerThread processor;
+    if (process && !processor.Start(ProcessorThreadMain, &state, WorkerThread::Kind::Compute)) {
+        state.status.read_failed = true;
+        return state.status;
+    }
+
+    WorkerThread reader;
+    if (!reader.Start(ReaderThreadMain, &state)) {
+        state.abort = true;
+        state.unprocessed_slots.Release();
+        state.status.read_failed = true;
+        return state.status;
+    }
+
+    uint64_t offset = config.start_offset;
+    for (size_t index = 0; offset != size; ++index) {
+        AcquireTimed(state.filled_slots, state.status.writer_stalls, state.status.writer_stall_ticks);
+
+        auto& slot = state.GetSlot(index);
+        if (slot.size == 0)
+            break;
+
+        if (!dest.Write(slot.data, slot.size)) {
+            state.status.write_failed = true;
+            state.abort = true;
+            state.free_slots.Release();
+            state.unprocessed_slots.Release();
+            break;
+        }
+
+        // Only the writer touches the results, so they can be inspected while the copy is running
+        if (state.recovery) {
+            for (auto& range : slot.unreadable)
+                AddUnreadableRange(state.recovery->unreadable, range);
+        }
+
+        offset += slot.size;
+        state.ReleaseSlot(slot);
+
+        if (on_progress)
+            on_progress(offset);
+    }
+
+    reader.Join();
+    processor.Join();
+    return state.status;
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "archive_file.h"
+#include "chunk_autotuner.h"
+#include "dump_arena.h"
+#include "output_sink.h"
+
+// Recovery from failed reads, e.g. due to flaky cartridge contacts.
+//
+// A failed read is retried a few times, waiting longer before each attempt. If it keeps failing, it's split in
+// halves, which are read separately, down to reads of config.min_read_size bytes. Data that can't be read even
+// then is zero-filled and recorded in "unreadable", such that a single bad spot costs a few small reads rather
+// than the whole dump.
+struct ReadRecovery {
+    struct Config {
+        unsigned max_attempts = 4;        // Attempts for a chunk and for the smallest reads before giving up on them
+        uint32_t initial_backoff_us = 2000; // Wait before the first retry; doubled for each further one
+        uint32_t min_read_size = 0x200;   // Smallest read issued when bisecting (one media unit)
+
+        // If more data than this can't be read, the copy is aborted: The card was probably removed, and narrowing down
+        // each unreadable spot would take ages
+        uint64_t max_unreadable_size = 0x40000;
+    };
+
+    struct Range {
+        uint64_t source_offset;
+        uint64_t dest_offset; // Offset in the destination sink that the zero-filled data was written to
+        uint32_t size;
+    };
+
+    Config config;
+
+    // Results: Unreadable ranges (sorted by offset, adjacent ones merged) and the number of reads retried.
+    // Ranges are added once the data containing them has been written, so "on_progress" may inspect them.
+    // Ranges that are already present when a copy starts (e.g. from before resuming) are kept.
+    std::vector<Range> unreadable;
+    uint64_t unreadable_size = 0;
+    uint32_t retried_reads = 0;
+};
+
+struct PipelineConfig {
+    uint32_t chunk_size = 1024 * 1024;
+    unsigned num_buffers = 3;
+
+    // Source offset to start copying at, e.g. when resuming an interrupted dump
+    uint64_t start_offset = 0;
+
+    // If set, the size of each read is picked by the autotuner instead of using chunk_size
+    ChunkAutotuner* autotuner = nullptr;
+
+    // If set, buffers are taken from this arena (and released once the copy is done) instead of the heap
+    DumpArena* arena = nullptr;
+
+    // If set, failed reads are recovered from as configured, and the results are stored in it.
+    // Otherwise, the first failed read aborts the copy.
+    ReadRecovery* recovery = nullptr;
+};
+
+struct PipelineStatus {
+    bool read_failed = false;
+    bool write_failed = false;
+    Result read_result = 0; // Error code of the failed read, if any
+
+    // Waits of more than a millisecond on the other end of the pipeline (durations in GetTicks units).
+    // Reader stalls mean the consumers (output or processing) are the bottleneck, writer stalls mean the input is.
+    // If both occur frequently, processing is the bottleneck.
+    uint32_t reader_stalls = 0;
+    uint64_t reader_stall_ticks = 0;
+    uint32_t writer_stalls = 0;
+    uint64_t writer_stall_ticks = 0;
+
+    bool Succeeded() const {
+        return !read_failed && !write_failed;
+    }
+};
+
+// Callback used to inspect data while it's being copied
+using ChunkCallback = std::function<void(const uint8_t* data, uint32_t size)>;
+
+// Copy the first "size" bytes of "source" (starting at config.start_offset) to "dest".
+// Reads are issued from a worker thread that fills a ring of buffers, while the calling thread
+// drains the ring into "dest". This way, reading from the card and writing to the SD card overlap.
+// If "process" is given, it's invoked for each chunk in order on another worker thread, in parallel
+// to the chunk being written (e.g. to hash the data).
+// "on_progress" is invoked from the calling thread with the source offset up to which data has been written.
+PipelineStatus CopyPipelined(ArchiveFile& source, uint64_t size, OutputSink& dest,
+                             const PipelineConfig& config,
+                             const ChunkCallback& process,
+                             const std::function<void(uint64_t)>& on_progress);
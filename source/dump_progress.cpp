@@ -0,0 +1,189 @@
+#include <cinttypes>
+#include <cstdio>
+#include <string>
+
+#include "dump_progress.h"
+
+void DumpProgress::BeginPhase(const char* name, uint64_t total, const char* action) {
+    sequence.fetch_add(1, std::memory_order_acq_rel);
+    phase_action.store(action, std::memory_order_relaxed);
+    phase_name.store(name, std::memory_order_relaxed);
+    phase_total.store(total, std::memory_order_relaxed);
+    phase_begin.store(GetTicks(), std::memory_order_relaxed);
+    phase_done.store(0, std::memory_order_relaxed);
+    phase_active.store(true, std::memory_order_relaxed);
+    phase_serial.fetch_add(1, std::memory_order_relaxed);
+    sequence.fetch_add(1, std::memory_order_release);
+}
+
+void DumpProgress::EndPhase() {
+    CompletedPhase phase;
+    phase.action = phase_action.load(std::memory_order_relaxed);
+    phase.name = phase_name.load(std::memory_order_relaxed);
+    phase.bytes = phase_done.load(std::memory_order_relaxed);
+    phase.ticks = GetTicks() - phase_begin.load(std::memory_order_relaxed);
+
+    // Retire the status line before the phase shows up as completed, so it's never rendered after its summary
+    sequence.fetch_add(1, std::memory_order_acq_rel);
+    phase_active.store(false, std::memory_order_relaxed);
+    sequence.fetch_add(1, std::memory_order_release);
+    PushCompleted(phase);
+}
+
+void DumpProgress::SkipPhase(const char* name, uint64_t bytes) {
+    CompletedPhase phase;
+    phase.name = name;
+    phase.bytes = bytes;
+    phase.skipped = true;
+    PushCompleted(phase);
+}
+
+void DumpProgress::PushCompleted(const CompletedPhase& phase) {
+    uint32_t index = num_completed.load(std::memory_order_relaxed);
+    completed[index % max_queued_phases] = phase;
+    num_completed.store(index + 1, std::memory_order_release);
+}
+
+DumpProgress::PhaseSnapshot DumpProgress::Snapshot() const {
+    PhaseSnapshot snapshot;
+    while (true) {
+        uint32_t before = sequence.load(std::memory_order_acquire);
+        if (before & 1) {
+            // Phase is being changed right now. The writer may be waiting to run on this very core, so yield to it
+            // rather than spinning.
+            SleepMicroseconds(100);
+            continue;
+        }
+
+        bool active = phase_active.load(std::memory_order_relaxed);
+        snapshot.serial = phase_serial.load(std::memory_order_relaxed);
+        snapshot.action = phase_action.load(std::memory_order_relaxed);
+        snapshot.name = active ? phase_name.load(std::memory_order_relaxed) : nullptr;
+        snapshot.total = phase_total.load(std::memory_order_relaxed);
+        snapshot.begin = phase_begin.load(std::memory_order_relaxed);
+        snapshot.done = phase_done.load(std::memory_order_relaxed);
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (sequence.load(std::memory_order_relaxed) == before)
+            return snapshot;
+    }
+}
+
+MessageCallback PrintTo(std::ostream& out) {
+    return [&out](const std::string& message) {
+        out << message << std::endl;
+    };
+}
+
+ProgressRenderer::ProgressRenderer(const DumpProgress& progress, std::ostream& out, PerfTelemetry* perf)
+    : progress(progress), out(out), perf(perf) {
+}
+
+void ProgressRenderer::Render() {
+    // Lines are assembled first and printed at once, since console output is the expensive part
+    std::string text;
+    char line[128];
+
+    // "\x1b[K" clears the rest of the status line
+    for (uint32_t num_completed = progress.NumCompleted(); num_printed < num_completed; ++num_printed) {
+        auto phase = progress.Completed(num_printed);
+        if (phase.skipped) {
+            snprintf(line, sizeof(line), "\r\tSkipping %s (dumped previously)\x1b[K\n", phase.name);
+        } else {
+            double seconds = static_cast<double>(phase.ticks) / ticks_per_second;
+            snprintf(line, sizeof(line), "\r\t%s %s... %" PRIu64 " KiB... done! (%.0f KiB/s)\x1b[K\n", phase.action, phase.name,
+                     phase.bytes / 1024, (seconds > 0) ? phase.bytes / 1024.0 / seconds : 0.0);
+        }
+        text += line;
+        status_line_shown = false;
+    }
+
+    auto phase = progress.Snapshot();
+    if (phase.name) {
+        uint64_t now = GetTicks();
+        if (phase.serial != phase_serial) {
+            phase_serial = phase.serial;
+            last_done = 0;
+            last_sample = phase.begin;
+            bytes_per_second = 0;
+        }
+
+        // Update the throughput estimate every half second, smoothing out short hiccups
+        if (now - last_sample >= ticks_per_second / 2) {
+            double current = static_cast<double>(phase.done - last_done) * ticks_per_second / (now - last_sample);
+            bytes_per_second = (bytes_per_second > 0) ? (bytes_per_second + current) / 2 : current;
+            last_done = phase.done;
+            last_sample = now;
+        }
+
+        if (!status_line_shown || phase.done != last_printed_done) {
+            int length = snprintf(line, sizeof(line), "\r\t%s %s... %" PRIu64 "/%" PRIu64 " KiB... ", phase.action, phase.name,
+                                  phase.done / 1024, phase.total / 1024);
+            if (bytes_per_second > 0 && phase.total >= phase.done) {
+                uint64_t seconds_left = static_cast<uint64_t>((phase.total - phase.done) / bytes_per_second);
+                snprintf(line + length, sizeof(line) - length, "%.0f KiB/s, %" PRIu64 ":%02u left\x1b[K",
+                         bytes_per_second / 1024, seconds_left / 60, static_cast<unsigned>(seconds_left % 60));
+            } else {
+                snprintf(line + length, sizeof(line) - length, "\x1b[K");
+            }
+            text += line;
+            status_line_shown = true;
+            last_printed_done = phase.done;
+        }
+    }
+
+    if (!text.empty()) {
+        ScopedOperation print_progress(perf, PerfTelemetry::Operation::ConsoleOutput);
+        out << text << std::flush;
+    }
+}
+
+void ProgressRenderer::Print(const std::string& message) {
+    // The message replaces the status line, if any
+    ScopedOperation print_message(perf, PerfTelemetry::Operation::ConsoleOutput);
+    out << '\r' << message << "\x1b[K" << std::endl;
+    status_line_shown = false;
+}
+
+ProgressDisplay::ProgressDisplay(const DumpProgress& progress, std::ostream& out, PerfTelemetry* perf)
+    : renderer(progress, out, perf) {
+}
+
+ProgressDisplay::~ProgressDisplay() {
+    Stop();
+}
+
+bool ProgressDisplay::Start() {
+    stop = false;
+    return thread.Start(ThreadMain, this);
+}
+
+void ProgressDisplay::Stop() {
+    stop = true;
+    thread.Join();
+    Flush();
+}
+
+void ProgressDisplay::Flush() {
+    ScopedLock lock(mutex);
+    renderer.Render();
+}
+
+void ProgressDisplay::Print(const std::string& message) {
+    ScopedLock lock(mutex);
+    renderer.Render();
+    renderer.Print(message);
+}
+
+void ProgressDisplay::SetPerf(PerfTelemetry* perf) {
+    ScopedLock lock(mutex);
+    renderer.SetPerf(perf);
+}
+
+void ProgressDisplay::ThreadMain(void* arg) {
+    auto& display = *static_cast<ProgressDisplay*>(arg);
+    while (!display.stop) {
+        WaitForVBlank();
+        display.Flush();
+    }
+}
@@ -0,0 +1,161 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+
+#include "perf_telemetry.h"
+#include "platform.h"
+
+// Progress of a dump, published by the threads doing I/O and read by the thread rendering it.
+// Updating progress only stores a few atomic counters, so it's cheap enough to do for every chunk.
+//
+// A dump consists of a sequence of phases (e.g. ExeFS sections). Phases must be begun and ended
+// by a single thread at a time, whereas Snapshot and Completed may be called from any thread.
+class DumpProgress {
+public:
+    // Phase names must outlive the DumpProgress (typically, they are string literals)
+    struct CompletedPhase {
+        const char* action = nullptr; // e.g. "Dumping"
+        const char* name = nullptr;
+        uint64_t bytes = 0;
+        uint64_t ticks = 0;
+        bool skipped = false; // Dumped by a previous run
+    };
+
+    struct PhaseSnapshot {
+        uint32_t serial = 0; // Number of phases begun so far, 0 if none was
+        const char* action = nullptr;
+        const char* name = nullptr;
+        uint64_t done = 0;
+        uint64_t total = 0;
+        uint64_t begin = 0; // GetTicks timestamp
+    };
+
+    // Number of completed phases that can be queued up for rendering
+    static const unsigned max_queued_phases = 16;
+
+    // "action" describes what's being done with the data, and must outlive the DumpProgress too
+    void BeginPhase(const char* name, uint64_t total, const char* action = "Dumping");
+
+    // Called by the I/O threads whenever data has been written
+    void SetDone(uint64_t done) {
+        phase_done.store(done, std::memory_order_relaxed);
+    }
+    void AddDone(uint64_t bytes) {
+        phase_done.fetch_add(bytes, std::memory_order_relaxed);
+    }
+
+    void EndPhase();
+
+    // Record a phase that doesn't need to be dumped again
+    void SkipPhase(const char* name, uint64_t bytes);
+
+    // Phase that is currently in progress, if any
+    PhaseSnapshot Snapshot() const;
+
+    // Number of phases completed so far, and the given one of them (valid for the last max_queued_phases phases)
+    uint32_t NumCompleted() const {
+        return num_completed.load(std::memory_order_acquire);
+    }
+    CompletedPhase Completed(uint32_t index) const {
+        return completed[index % max_queued_phases];
+    }
+
+private:
+    void PushCompleted(const CompletedPhase& phase);
+
+    // Incremented before and after changing the phase fields, such that readers can detect concurrent changes
+    std::atomic<uint32_t> sequence{0};
+    std::atomic<uint32_t> phase_serial{0};
+    std::atomic<const char*> phase_action{nullptr};
+    std::atomic<const char*> phase_name{nullptr};
+    std::atomic<uint64_t> phase_total{0};
+    std::atomic<uint64_t> phase_begin{0};
+    std::atomic<bool> phase_active{false};
+    std::atomic<uint64_t> phase_done{0};
+
+    CompletedPhase completed[max_queued_phases];
+    std::atomic<uint32_t> num_completed{0};
+};
+
+// Receives console messages (e.g. errors) from the dump engine, one line per call without the line break.
+// Messages are dropped if the callback is empty.
+using MessageCallback = std::function<void(const std::string& message)>;
+
+inline void PrintMessage(const MessageCallback& print, const std::string& message) {
+    if (print)
+        print(message);
+}
+
+// MessageCallback printing messages straight to "out"
+MessageCallback PrintTo(std::ostream& out);
+
+// Formats DumpProgress to a console: A line for each completed phase, and a status line for the
+// current phase that is updated in place with throughput and estimated time remaining.
+class ProgressRenderer {
+public:
+    // If "perf" is non-null, the time spent writing to "out" is recorded as console output
+    ProgressRenderer(const DumpProgress& progress, std::ostream& out, PerfTelemetry* perf);
+
+    // Print any changes since the last call
+    void Render();
+
+    // Print "message" on a line of its own. The status line is redrawn below it on the next call to Render.
+    void Print(const std::string& message);
+
+    void SetPerf(PerfTelemetry* perf) {
+        this->perf = perf;
+    }
+
+private:
+    const DumpProgress& progress;
+    std::ostream& out;
+    PerfTelemetry* perf;
+
+    uint32_t num_printed = 0;
+    bool status_line_shown = false;
+
+    // Throughput estimation for the current phase
+    uint32_t phase_serial = 0;
+    uint64_t last_done = 0;
+    uint64_t last_sample = 0;
+    double bytes_per_second = 0;
+    uint64_t last_printed_done = UINT64_MAX;
+};
+
+// Renders DumpProgress on a worker thread, at most once per display refresh.
+// The display may be kept running across several dumps. It renders at any time while progress is being
+// published, so other console output must go through Print then, which serializes it with the rendering.
+class ProgressDisplay {
+public:
+    ProgressDisplay(const DumpProgress& progress, std::ostream& out, PerfTelemetry* perf);
+    ~ProgressDisplay();
+
+    ProgressDisplay(const ProgressDisplay&) = delete;
+    ProgressDisplay& operator=(const ProgressDisplay&) = delete;
+
+    bool Start();
+
+    // Render the final state and stop the thread. Other console output should only be printed while stopped.
+    void Stop();
+
+    // Render everything published so far from the calling thread
+    void Flush();
+
+    // Render everything published so far, followed by "message" on a line of its own
+    void Print(const std::string& message);
+
+    // Record console output in "perf" from now on (may be null)
+    void SetPerf(PerfTelemetry* perf);
+
+private:
+    static void ThreadMain(void* arg);
+
+    Mutex mutex; // Serializes rendering
+    ProgressRenderer renderer;
+    std::atomic<bool> stop{false};
+    WorkerThread thread;
+};
@@ -0,0 +1,356 @@
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "dump_engine.h"
+#include "dump_verifier.h"
+#include "ivfc.h"
+#include "ncch.h"
+#include "platform.h"
+#include "xxhash64.h"
+
+namespace {
+
+// Region of the image, along with the title data it's expected to contain
+struct PlannedRegion {
+    enum class Source {
+        None,         // Generated by braindump
+        ExeFSSection,
+        RomFS,
+    };
+
+    ChecksumManifest::Region region;
+    Source source = Source::None;
+    std::string exefs_section;
+};
+
+// Reads a range of a file and checksums each block of it. Runs either on the calling thread or on a worker.
+struct BlockHasher {
+    ArchiveFile* file = nullptr;
+    uint64_t offset = 0;
+    uint64_t size = 0;
+    uint32_t block_size = 0;
+    DumpProgress* progress = nullptr; // Receives the number of bytes read
+
+    std::vector<uint64_t> hashes;
+    Result result = 0;
+    bool failed = false;
+
+    void Run() {
+        std::vector<uint8_t> buffer(static_cast<size_t>(std::min<uint64_t>(block_size, size)));
+        hashes.reserve((size + block_size - 1) / block_size);
+        for (uint64_t done = 0; done < size; ) {
+            uint32_t bytes_to_read = static_cast<uint32_t>(std::min<uint64_t>(block_size, size - done));
+            uint32_t bytes_read = 0;
+            result = file->Read(offset + done, buffer.data(), bytes_to_read, &bytes_read);
+            if (result != 0 || bytes_read != bytes_to_read) {
+                failed = true;
+                return;
+            }
+
+            hashes.push_back(XXHash64::Hash(buffer.data(), bytes_read));
+            done += bytes_read;
+            if (progress)
+                progress->AddDone(bytes_read);
+        }
+    }
+
+    static void ThreadMain(void* arg) {
+        static_cast<BlockHasher*>(arg)->Run();
+    }
+};
+
+} // anonymous namespace
+
+static bool ReadExact(ArchiveFile& file, uint64_t offset, void* buffer, uint32_t size) {
+    uint32_t bytes_read = 0;
+    return file.Read(offset, buffer, size, &bytes_read) == 0 && bytes_read == size;
+}
+
+static const char* PhaseName(PlannedRegion::Source source) {
+    switch (source) {
+    case PlannedRegion::Source::ExeFSSection:
+        return "ExeFS";
+    case PlannedRegion::Source::RomFS:
+        return "RomFS";
+    default:
+        return nullptr;
+    }
+}
+
+static PlannedRegion MakeRegion(const std::string& name, uint64_t offset, uint64_t size,
+                                PlannedRegion::Source source = PlannedRegion::Source::None, const std::string& exefs_section = "") {
+    PlannedRegion planned;
+    planned.region.name = name;
+    planned.region.offset = offset;
+    planned.region.size = size;
+    planned.source = source;
+    planned.exefs_section = exefs_section;
+    return planned;
+}
+
+// Split the image into regions based on its headers. Gaps between regions containing title data are
+// covered by generated regions, such that the regions span the whole image.
+static bool PlanRegions(ArchiveFile& image, uint64_t image_size, std::vector<PlannedRegion>* regions, const MessageCallback& print) {
+    const uint64_t media_unit_size = 0x200;
+
+    NCCH_Header ncch;
+    if (!ReadExact(image, 0, &ncch, sizeof(ncch)) || memcmp(&ncch.magic, "NCCH", 4) != 0) {
+        PrintMessage(print, "Image doesn't start with an NCCH header");
+        return false;
+    }
+
+    std::vector<PlannedRegion> data_regions;
+
+    if (ncch.exefs_size != 0) {
+        const uint64_t exefs_begin = ncch.exefs_offset * media_unit_size;
+        const uint64_t exefs_end = exefs_begin + ncch.exefs_size * media_unit_size;
+        ExeFs_Header exefs;
+        if (!ReadExact(image, exefs_begin, &exefs, sizeof(exefs))) {
+            PrintMessage(print, "Couldn't read the ExeFS header");
+            return false;
+        }
+
+        for (auto& section : exefs.section) {
+            if (section.size == 0)
+                continue;
+
+            std::string name(section.name, strnlen(section.name, sizeof(section.name)));
+            uint64_t offset = exefs_begin + sizeof(ExeFs_Header) + section.offset;
+            if (name.empty() || name.find_first_of(" \t\r\n") != std::string::npos || offset + section.size > exefs_end) {
+                PrintMessage(print, "ExeFS header is corrupted");
+                return false;
+            }
+            data_regions.push_back(MakeRegion("exefs/" + name, offset, section.size, PlannedRegion::Source::ExeFSSection, name));
+        }
+    }
+
+    if (ncch.romfs_size != 0) {
+        const uint64_t romfs_begin = ncch.romfs_offset * media_unit_size;
+        const uint64_t romfs_end = romfs_begin + ncch.romfs_size * media_unit_size;
+        RomFS_IVFCHeader ivfc;
+        if (!ReadExact(image, romfs_begin, &ivfc, sizeof(ivfc)) || memcmp(&ivfc.magic, "IVFC", 4) != 0 ||
+            ivfc.levels[2].block_size_log2 >= 32) {
+            PrintMessage(print, "RomFS doesn't start with an IVFC header");
+            return false;
+        }
+
+        const uint64_t level3_offset = IvfcHashTree::Level3Offset(ivfc);
+        const uint64_t level3_size = ivfc.levels[2].hash_data_size;
+        if (romfs_begin + level3_offset + level3_size > romfs_end) {
+            PrintMessage(print, "IVFC header is corrupted");
+            return false;
+        }
+        data_regions.push_back(MakeRegion("romfs/level3", romfs_begin + level3_offset, level3_size, PlannedRegion::Source::RomFS));
+    }
+
+    std::sort(data_regions.begin(), data_regions.end(), [](const PlannedRegion& a, const PlannedRegion& b) {
+        return a.region.offset < b.region.offset;
+    });
+
+    regions->clear();
+    uint64_t offset = 0;
+    for (auto& planned : data_regions) {
+        if (planned.region.offset < offset || planned.region.offset + planned.region.size > image_size) {
+            PrintMessage(print, "Image headers are inconsistent with the image size");
+            return false;
+        }
+        if (planned.region.offset != offset)
+            regions->push_back(MakeRegion("generated", offset, planned.region.offset - offset));
+        regions->push_back(planned);
+        offset = planned.region.offset + planned.region.size;
+    }
+    if (offset != image_size)
+        regions->push_back(MakeRegion("generated", offset, image_size - offset));
+    return true;
+}
+
+// Compare the block checksums of a region to those of another copy of it, recording the first mismatching block
+static void CompareBlocks(const ChecksumManifest::Region& region, const std::vector<uint64_t>& other_hashes, uint32_t block_size, VerifyResult& result) {
+    for (size_t block = 0; block < region.block_hashes.size(); ++block) {
+        if (block < other_hashes.size() && region.block_hashes[block] == other_hashes[block])
+            continue;
+
+        if (result.mismatching_blocks++ == 0) {
+            result.mismatch_region = region.name;
+            result.mismatch_offset = region.offset + block * uint64_t{block_size};
+            result.mismatch_size = std::min<uint64_t>(block_size, region.size - block * uint64_t{block_size});
+        }
+    }
+}
+
+static Result OpenSource(TitleArchive& title, const PlannedRegion& planned, std::unique_ptr<ArchiveFile>* file) {
+    if (planned.source == PlannedRegion::Source::ExeFSSection)
+        return title.OpenExeFSSection(planned.exefs_section, file);
+    return title.OpenRomFS(file);
+}
+
+VerifyResult VerifyDump(TitleArchive& title, ArchiveFile& image, uint64_t title_id, uint32_t block_size,
+                        ChecksumManifest* manifest, DumpProgress* progress, const MessageCallback& print) {
+    VerifyResult result;
+    uint64_t begin = GetTicks();
+
+    uint64_t image_size = 0;
+    std::vector<PlannedRegion> regions;
+    if (image.GetSize(&image_size) != 0 || !PlanRegions(image, image_size, &regions, print)) {
+        result.read_failed = true;
+        return result;
+    }
+
+    const char* current_phase = nullptr;
+    for (size_t index = 0; index < regions.size() && !result.read_failed; ++index) {
+        auto& planned = regions[index];
+
+        // Title data is reported as ExeFS and RomFS phases, generated regions are small enough to go unreported
+        const char* phase = PhaseName(planned.source);
+        if (progress && phase && phase != current_phase) {
+            if (current_phase)
+                progress->EndPhase();
+            uint64_t total = 0;
+            for (auto& other : regions)
+                total += (PhaseName(other.source) == phase) ? other.region.size : 0;
+            progress->BeginPhase(phase, total, "Verifying");
+            current_phase = phase;
+        }
+
+        BlockHasher image_hasher;
+        image_hasher.file = &image;
+        image_hasher.offset = planned.region.offset;
+        image_hasher.size = planned.region.size;
+        image_hasher.block_size = block_size;
+
+        // Read the title data on a worker thread, while the image is read on this one
+        std::unique_ptr<ArchiveFile> source_file;
+        BlockHasher source_hasher;
+        WorkerThread source_thread;
+        bool source_size_matches = false;
+        if (planned.source != PlannedRegion::Source::None) {
+            Result ret = OpenSource(title, planned, &source_file);
+            uint64_t source_size = 0;
+            if (ret == 0)
+                ret = source_file->GetSize(&source_size);
+            if (ret != 0) {
+                PrintMessage(print, "Couldn't open " + planned.region.name + " for verification (error " + ResultToString(ret) + ")");
+                result.read_failed = true;
+                break;
+            }
+
+            source_size_matches = (source_size == planned.region.size);
+            if (source_size_matches) {
+                source_hasher.file = source_file.get();
+                source_hasher.size = source_size;
+                source_hasher.block_size = block_size;
+                source_hasher.progress = progress;
+                if (!source_thread.Start(BlockHasher::ThreadMain, &source_hasher))
+                    source_hasher.Run();
+            }
+        }
+
+        image_hasher.Run();
+        source_thread.Join();
+
+        if (image_hasher.failed || source_hasher.failed) {
+            PrintMessage(print, "Error while reading " + planned.region.name + " from the " + (image_hasher.failed ? "image" : "title") +
+                                " (error " + ResultToString(image_hasher.failed ? image_hasher.result : source_hasher.result) + ")");
+            result.read_failed = true;
+            break;
+        }
+
+        result.bytes_verified += planned.region.size;
+        planned.region.block_hashes = std::move(image_hasher.hashes);
+        if (planned.source != PlannedRegion::Source::None)
+            CompareBlocks(planned.region, source_hasher.hashes, block_size, result);
+    }
+    if (progress && current_phase)
+        progress->EndPhase();
+
+    if (manifest && !result.read_failed) {
+        manifest->title_id = title_id;
+        manifest->image_size = image_size;
+        manifest->block_size = block_size;
+        manifest->regions.clear();
+        for (auto& planned : regions)
+            manifest->regions.push_back(std::move(planned.region));
+    }
+
+    result.success = !result.read_failed && result.mismatching_blocks == 0;
+    result.ticks = GetTicks() - begin;
+    return result;
+}
+
+VerifyResult VerifyManifest(ArchiveFile& image, const ChecksumManifest& manifest, DumpProgress* progress, const MessageCallback& print) {
+    VerifyResult result;
+    uint64_t begin = GetTicks();
+
+    uint64_t image_size = 0;
+    if (image.GetSize(&image_size) != 0 || image_size != manifest.image_size) {
+        PrintMessage(print, "Image size doesn't match the checksum manifest");
+        result.read_failed = true;
+        return result;
+    }
+
+    if (progress)
+        progress->BeginPhase("image", image_size, "Verifying");
+    for (auto& region : manifest.regions) {
+        BlockHasher image_hasher;
+        image_hasher.file = &image;
+        image_hasher.offset = region.offset;
+        image_hasher.size = region.size;
+        image_hasher.block_size = manifest.block_size;
+        image_hasher.progress = progress;
+        image_hasher.Run();
+        if (image_hasher.failed) {
+            PrintMessage(print, "Error while reading " + region.name + " from the image (error " + ResultToString(image_hasher.result) + ")");
+            result.read_failed = true;
+            break;
+        }
+
+        result.bytes_verified += region.size;
+        CompareBlocks(region, image_hasher.hashes, manifest.block_size, result);
+    }
+    if (progress)
+        progress->EndPhase();
+
+    result.success = !result.read_failed && result.mismatching_blocks == 0;
+    result.ticks = GetTicks() - begin;
+    return result;
+}
+
+bool HashImage(ArchiveFile& image, uint64_t title_id, uint32_t block_size,
+               const std::function<bool(uint64_t offset, uint64_t size, uint64_t* hash)>& known_hash, ChecksumManifest* manifest,
+               const MessageCallback& print) {
+    uint64_t image_size = 0;
+    std::vector<PlannedRegion> regions;
+    if (image.GetSize(&image_size) != 0 || !PlanRegions(image, image_size, &regions, print))
+        return false;
+
+    manifest->title_id = title_id;
+    manifest->image_size = image_size;
+    manifest->block_size = block_size;
+    manifest->regions.clear();
+    for (auto& planned : regions) {
+        auto& region = planned.region;
+        for (uint64_t offset = 0; offset < region.size; offset += block_size) {
+            uint64_t size = std::min<uint64_t>(block_size, region.size - offset);
+            uint64_t hash;
+            if (known_hash && known_hash(region.offset + offset, size, &hash)) {
+                region.block_hashes.push_back(hash);
+                continue;
+            }
+
+            BlockHasher image_hasher;
+            image_hasher.file = &image;
+            image_hasher.offset = region.offset + offset;
+            image_hasher.size = size;
+            image_hasher.block_size = block_size;
+            image_hasher.Run();
+            if (image_hasher.failed) {
+                PrintMessage(print, "Error while reading " + region.name + " from the image (error " + ResultToString(image_hasher.result) + ")");
+                return false;
+            }
+            region.block_hashes.push_back(image_hasher.hashes[0]);
+        }
+        manifest->regions.push_back(std::move(region));
+    }
+    return true;
+}
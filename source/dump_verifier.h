@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+
+#include "archive_file.h"
+#include "checksum_manifest.h"
+#include "dump_progress.h"
+#include "title_archive.h"
+
+struct VerifyResult {
+    bool success = false;       // All data could be read and matched
+    bool read_failed = false;   // The title or the image couldn't be read (details are reported through the MessageCallback)
+
+    // First block that differs between the title and the image, if any
+    uint32_t mismatching_blocks = 0;
+    std::string mismatch_region;
+    uint64_t mismatch_offset = 0; // Image offset of the block
+    uint64_t mismatch_size = 0;
+
+    uint64_t bytes_verified = 0; // Bytes read from the image
+    uint64_t ticks = 0;
+};
+
+// Check a dumped NCCH image against the title it was dumped from.
+//
+// The image is split into regions at the offsets recorded in its NCCH, ExeFS and IVFC headers. Regions
+// containing title data are read again from "title" and compared to the image block by block, with the
+// title and the image each being read and checksummed on a thread of their own. Regions generated while
+// dumping are read from the image only.
+//
+// If "manifest" is non-null, it's filled with the checksums of all image blocks.
+// If "progress" is non-null, the ExeFS and RomFS are reported as phases of it.
+// Errors are reported through "print".
+VerifyResult VerifyDump(TitleArchive& title, ArchiveFile& image, uint64_t title_id, uint32_t block_size,
+                        ChecksumManifest* manifest, DumpProgress* progress, const MessageCallback& print);
+
+// Check a dumped image against the checksums recorded in a manifest, without accessing the title
+VerifyResult VerifyManifest(ArchiveFile& image, const ChecksumManifest& manifest, DumpProgress* progress, const MessageCallback& print);
+
+// Build the checksum manifest of an image without accessing the title. Blocks for which "known_hash" returns true
+// (e.g. because they were checksummed while being written) aren't read back from the image. Returns false on error,
+// which is reported through "print".
+bool HashImage(ArchiveFile& image, uint64_t title_id, uint32_t block_size,
+               const std::function<bool(uint64_t offset, uint64_t size, uint64_t* hash)>& known_hash, ChecksumManifest* manifest,
+               const MessageCallback& print);
@@ -0,0 +1,154 @@
+#include <algorithm>
+#include <atomic>
+#include <cinttypes>
+#include <cstdio>
+
+#include "fcram_dump.h"
+#include "platform.h"
+
+std::vector<MemoryRegion> EnumerateDumpableRegions(DmaBackend& backend, uint32_t begin, uint32_t end) {
+    std::vector<MemoryRegion> regions;
+    uint32_t address = begin;
+    while (address < end) {
+        MemoryRegion region;
+        if (!backend.QueryRegion(address, &region) || region.size == 0)
+            break;
+
+        // Clip to the requested range
+        uint32_t region_end = region.address + region.size;
+        if (region_end <= address)
+            break; // Wrapped around the address space
+        region.address = address;
+        region.size = std::min(region_end, end) - address;
+        address += region.size;
+
+        if (!backend.IsDumpable(region))
+            continue;
+
+        if (!regions.empty()) {
+            auto& last = regions.back();
+            if (last.address + last.size == region.address && last.permission == region.permission && last.state == region.state) {
+                last.size += region.size;
+                continue;
+            }
+        }
+        regions.push_back(region);
+    }
+    return regions;
+}
+
+namespace {
+
+struct Buffer {
+    uint8_t* data = nullptr;
+    uint32_t address = 0;
+    uint32_t size = 0; // 0 signals the end of the dump
+};
+
+struct WriterState {
+    OutputFile& out;
+    uint32_t base;
+    std::vector<Buffer> buffers;
+    Semaphore free_buffers;
+    Semaphore filled_buffers;
+    std::atomic<bool> write_failed{false};
+    DumpProgress* progress;
+
+    WriterState(OutputFile& out, uint32_t base, unsigned num_buffers, DumpProgress* progress)
+        : out(out), base(base), buffers(num_buffers), free_buffers(num_buffers, num_buffers),
+          filled_buffers(0, num_buffers), progress(progress) {
+    }
+};
+
+void WriterThreadMain(void* arg) {
+    auto& state = *static_cast<WriterState*>(arg);
+
+    uint64_t bytes_written = 0;
+    for (size_t index = 0;; ++index) {
+        state.filled_buffers.Acquire();
+        auto& buffer = state.buffers[index % state.buffers.size()];
+        if (buffer.size == 0)
+            return;
+
+        // Once a write failed, keep draining buffers so that the DMA side doesn't block
+        if (!state.write_failed && !state.out.WriteAt(buffer.address - state.base, buffer.data, buffer.size))
+            state.write_failed = true;
+        bytes_written += buffer.size;
+        if (state.progress)
+            state.progress->SetDone(bytes_written);
+        state.free_buffers.Release();
+    }
+}
+
+} // anonymous namespace
+
+FcramDumpResult DumpFcram(DmaBackend& backend, uint32_t begin, uint32_t end, OutputFile& out, const FcramDumpConfig& config,
+                          DumpProgress* progress) {
+    FcramDumpResult result;
+    result.regions = EnumerateDumpableRegions(backend, begin, end);
+
+    uint64_t total_size = 0;
+    for (auto& region : result.regions)
+        total_size += region.size;
+    if (progress)
+        progress->BeginPhase("FCRAM", total_size);
+
+    WriterState state(out, begin, config.num_buffers, progress);
+    for (auto& buffer : state.buffers) {
+        buffer.data = backend.AllocateBuffer(config.transfer_size);
+        result.transfer_failed |= (buffer.data == nullptr);
+    }
+
+    WorkerThread writer;
+    bool writer_running = !result.transfer_failed && writer.Start(WriterThreadMain, &state);
+    result.transfer_failed |= !writer_running;
+
+    // Fill buffers one after another on this thread, while the writer drains them
+    size_t index = 0;
+    for (auto& region : result.regions) {
+        for (uint32_t offset = 0; offset < region.size && !result.transfer_failed && !state.write_failed; ++index) {
+            state.free_buffers.Acquire();
+            auto& buffer = state.buffers[index % state.buffers.size()];
+            buffer.address = region.address + offset;
+            buffer.size = std::min(config.transfer_size, region.size - offset);
+            if (!backend.StartTransfer(buffer.address, buffer.data, buffer.size) || !backend.FinishTransfer(buffer.data, buffer.size)) {
+                result.transfer_failed = true;
+                state.free_buffers.Release();
+                break;
+            }
+
+            offset += buffer.size;
+            result.bytes_copied += buffer.size;
+            state.filled_buffers.Release();
+        }
+    }
+
+    // Tell the writer to stop once it has drained all filled buffers
+    if (writer_running) {
+        state.free_buffers.Acquire();
+        state.buffers[index % state.buffers.size()].size = 0;
+        state.filled_buffers.Release();
+    }
+    writer.Join();
+
+    for (auto& buffer : state.buffers) {
+        if (buffer.data)
+            backend.FreeBuffer(buffer.data);
+    }
+
+    // Cover the full range, even if it ends in an unmapped region
+    result.write_failed = state.write_failed || !out.SetSize(end - begin) || !out.Flush();
+    if (progress)
+        progress->EndPhase();
+    return result;
+}
+
+bool WriteRegionIndex(const std::string& path, const std::vector<MemoryRegion>& regions) {
+    FILE* file = fopen(path.c_str(), "w");
+    if (file == nullptr)
+        return false;
+
+    for (auto& region : regions)
+        fprintf(file, "%08" PRIx32 " %08" PRIx32 " %" PRIx32 " %" PRIx32 "\n", region.address, region.size, region.permission, region.state);
+    return fclose(file) == 0;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "dump_progress.h"
+#include "output_file.h"
+
+// Pipelined dumping of FCRAM using the GPU's DMA engine. Only regions that are mapped into the
+// process are copied; the rest of the output is left zero (sparse, if the output supports it),
+// so that file offsets keep corresponding to addresses. While one buffer is being filled by DMA,
+// the previously filled ones are written out on a worker thread.
+
+struct MemoryRegion {
+    uint32_t address;
+    uint32_t size;
+    uint32_t permission; // MemPerm flags
+    uint32_t state;      // MemState
+};
+
+// Access to the memory to be dumped. On the 3DS, this is implemented using svcQueryMemory and
+// GX_TextureCopy, and on the host by a mock for benchmarking the pipeline logic.
+class DmaBackend {
+public:
+    virtual ~DmaBackend() = default;
+
+    // Get the region containing "address". Returns false on error.
+    virtual bool QueryRegion(uint32_t address, MemoryRegion* region) = 0;
+
+    // Whether the given region can be read by DMA transfers
+    virtual bool IsDumpable(const MemoryRegion& region) = 0;
+
+    // Allocate/free a buffer that transfers may target
+    virtual uint8_t* AllocateBuffer(uint32_t size) = 0;
+    virtual void FreeBuffer(uint8_t* buffer) = 0;
+
+    // Start copying "size" bytes at "address" to "buffer". Only one transfer may be in flight at a time.
+    virtual bool StartTransfer(uint32_t address, uint8_t* buffer, uint32_t size) = 0;
+
+    // Wait for the transfer started last to complete, and make its data visible to the CPU
+    virtual bool FinishTransfer(uint8_t* buffer, uint32_t size) = 0;
+};
+
+struct FcramDumpConfig {
+    uint32_t transfer_size = 0x40000;
+    unsigned num_buffers = 4;
+};
+
+struct FcramDumpResult {
+    bool transfer_failed = false;
+    bool write_failed = false;
+    std::vector<MemoryRegion> regions; // Regions that were dumped
+    uint64_t bytes_copied = 0;
+
+    bool Succeeded() const {
+        return !transfer_failed && !write_failed;
+    }
+};
+
+// List the dumpable regions in [begin, end), clipped to that range. Adjacent regions with the same attributes are merged.
+std::vector<MemoryRegion> EnumerateDumpableRegions(DmaBackend& backend, uint32_t begin, uint32_t end);
+
+// Dump the memory in [begin, end) to "out", with offset 0 corresponding to "begin".
+// If "progress" is non-null, the dump is reported as a phase of it.
+FcramDumpResult DumpFcram(DmaBackend& backend, uint32_t begin, uint32_t end, OutputFile& out, const FcramDumpConfig& config,
+                          DumpProgress* progress);
+
+// Write the list of dumped regions to a text file, one "address size permission state" line (in hex) per region
+bool WriteRegionIndex(const std::string& path, const std::vector<MemoryRegion>& regions);
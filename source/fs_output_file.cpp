@@ -0,0 +1,79 @@
+#include <algorithm>
+#include <cstring>
+
+#include "fs_output_file.h"
+
+FSOutputFile::~FSOutputFile() {
+    Close();
+}
+
+Result FSOutputFile::Open(const std::string& path, bool keep_contents) {
+    Close();
+
+    std::string sd_path = path;
+    if (sd_path.compare(0, strlen("sdmc:"), "sdmc:") == 0)
+        sd_path = sd_path.substr(strlen("sdmc:"));
+
+    Result ret = FSUSER_OpenFileDirectly(&handle, ARCHIVE_SDMC, fsMakePath(PATH_EMPTY, ""), fsMakePath(PATH_ASCII, sd_path.c_str()),
+                                         FS_OPEN_WRITE | FS_OPEN_CREATE, 0);
+    if (ret != 0) {
+        handle = 0;
+        return ret;
+    }
+
+    if (!keep_contents && (ret = FSFILE_SetSize(handle, 0)) != 0)
+        Close();
+    return ret;
+}
+
+void FSOutputFile::Close() {
+    if (handle == 0)
+        return;
+
+    FSFILE_Close(handle);
+    handle = 0;
+}
+
+uint64_t FSOutputFile::GetSize() const {
+    u64 size;
+    if (handle == 0 || FSFILE_GetSize(handle, &size) != 0)
+        return 0;
+    return size;
+}
+
+bool FSOutputFile::WriteAt(uint64_t offset, const void* data, size_t size) {
+    if (handle == 0)
+        return false;
+
+    u32 written;
+    return FSFILE_Write(handle, &written, offset, data, size, 0) == 0 && written == size;
+}
+
+bool FSOutputFile::Flush() {
+    return handle != 0 && FSFILE_Flush(handle) == 0;
+}
+
+bool FSOutputFile::SetSize(uint64_t size) {
+    if (handle == 0)
+        return false;
+
+    uint64_t old_size = GetSize();
+    if (FSFILE_SetSize(handle, size) != 0)
+        return false;
+
+    // FSFILE_SetSize leaves stale data in the added clusters, so zeros are written over them
+    static const uint8_t zeros[0x10000] = {};
+    for (uint64_t offset = old_size; offset < size; offset += sizeof(zeros)) {
+        if (!WriteAt(offset, zeros, std::min<uint64_t>(sizeof(zeros), size - offset)))
+            return false;
+    }
+    return true;
+}
+
+bool FSOutputFile::Preallocate(uint64_t size) {
+    if (handle == 0)
+        return false;
+
+    // Never truncate here, since the file may hold data of an interrupted dump
+    return size <= GetSize() || FSFILE_SetSize(handle, size) == 0;
+}
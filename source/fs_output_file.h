@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include <3ds.h>
+
+#include "output_file.h"
+
+// OutputFile writing to the SD card through the FS service directly.
+//
+// Compared to going through newlib's sdmc: devoptab (see StdioOutputFile), writes are issued to the FS service
+// as they come in from OutputSink, without further buffering or copying. Files can be preallocated, such that the
+// SD card's FAT is updated once rather than every time the file grows by a cluster.
+class FSOutputFile : public OutputFile {
+public:
+    FSOutputFile() = default;
+    ~FSOutputFile() override;
+
+    FSOutputFile(const FSOutputFile&) = delete;
+    FSOutputFile& operator=(const FSOutputFile&) = delete;
+
+    // Open the file at "path" (optionally prefixed with "sdmc:") for writing. The file is created if it doesn't exist.
+    // Existing contents are discarded unless "keep_contents" is set.
+    Result Open(const std::string& path, bool keep_contents = false);
+    void Close();
+
+    bool IsOpen() const {
+        return handle != 0;
+    }
+
+    // Current size of the file on the SD card
+    uint64_t GetSize() const;
+
+    bool WriteAt(uint64_t offset, const void* data, size_t size) override;
+    bool Flush() override;
+    // Space added to the file is zero-filled explicitly, which is as slow as writing it
+    bool SetSize(uint64_t size) override;
+
+    // Extends the file with FSFILE_SetSize. The added space isn't zero-filled, so it must be written in full
+    // afterwards (see SparseOutputFile).
+    bool Preallocate(uint64_t size) override;
+
+private:
+    Handle handle = 0;
+};
@@ -0,0 +1,176 @@
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstring>
+
+#include <3ds.h>
+
+#include "fs_title_archive.h"
+
+namespace {
+
+// ArchiveFile backed by an FS file handle. The handle (and optionally the FS session it was opened from)
+// is closed when this object is destroyed.
+class FSArchiveFile : public ArchiveFile {
+    Handle file_handle;
+    Handle session_handle;
+
+public:
+    FSArchiveFile(Handle file_handle, Handle session_handle = 0) : file_handle(file_handle), session_handle(session_handle) {}
+
+    ~FSArchiveFile() override {
+        FSFILE_Close(file_handle);
+        if (session_handle)
+            svcCloseHandle(session_handle);
+    }
+
+    Result GetSize(uint64_t* size) override {
+        return FSFILE_GetSize(file_handle, size);
+    }
+
+    Result Read(uint64_t offset, void* buffer, uint32_t size, uint32_t* bytes_read) override {
+        return FSFILE_Read(file_handle, bytes_read, offset, buffer, size);
+    }
+};
+
+enum class ContentType : uint32_t {
+    ROMFS = 0,
+    EXEFS = 2,
+};
+
+} // anonymous namespace
+
+static Result OpenTitleContent(Handle* file_handle, uint64_t title_id, uint8_t media_type, ContentType type, const std::string& name) {
+    uint32_t archivePath[] = { (uint32_t)(title_id & 0xFFFFFFFF), (uint32_t)(title_id >> 32), media_type, 0x00000000};
+    FS_Path fs_archive_path = { PATH_BINARY, 0x10, (u8*)archivePath };
+
+    struct LowPathData {
+        uint32_t unk[3];
+        std::array<char, 8> filename; // NOTE: Archive 0x2345678a expects this particular size!
+    } data = { { 0, 0, static_cast<uint32_t>(type) }, {} };
+
+    // Copy filename including null terminator
+    assert(name.size() + 1 <= data.filename.size());
+    std::fill(data.filename.begin(), data.filename.end(), 0);
+    std::copy(name.c_str(), name.c_str() + name.size() + 1, data.filename.begin());
+
+    return FSUSER_OpenFileDirectly(file_handle,
+                                   (FS_ArchiveID)0x2345678a,
+                                   fs_archive_path,
+                                   (FS_Path){ PATH_BINARY, sizeof(data), (u8*)&data },
+                                   FS_OPEN_READ,
+                                   0);
+}
+
+static Result
+MYFSUSER_OpenFileDirectly(Handle fsuHandle,
+                        Handle     *out,
+                        FS_ArchiveID id,
+                        FS_Path    archivePath,
+                        FS_Path    filePath,
+                        u32        openFlags,
+                        u32        attributes) noexcept {
+    u32 *cmdbuf = getThreadCommandBuffer();
+
+    cmdbuf[ 0] = IPC_MakeHeader(0x803,8,4); // 0x8030204
+    cmdbuf[ 1] = 0;
+    cmdbuf[ 2] = id;
+    cmdbuf[ 3] = archivePath.type;
+    cmdbuf[ 4] = archivePath.size;
+    cmdbuf[ 5] = filePath.type;
+    cmdbuf[ 6] = filePath.size;
+    cmdbuf[ 7] = openFlags;
+    cmdbuf[ 8] = attributes;
+    cmdbuf[ 9] = IPC_Desc_StaticBuffer(archivePath.size,2);
+    cmdbuf[10] = (u32)archivePath.data;
+    cmdbuf[11] = IPC_Desc_StaticBuffer(filePath.size,0);
+    cmdbuf[12] = (u32)filePath.data;
+
+    Result ret = 0;
+    if((ret = svcSendSyncRequest(fsuHandle)))
+        return ret;
+
+    if(out)
+        *out = cmdbuf[3];
+
+    return cmdbuf[1];
+}
+
+Result FSTitleArchive::OpenExeFSSection(const std::string& name, std::unique_ptr<ArchiveFile>* file) {
+    Handle file_handle;
+    Result ret = OpenTitleContent(&file_handle, title_id, media_type, ContentType::EXEFS, name);
+    if (ret != 0)
+        return ret;
+
+    file->reset(new FSArchiveFile(file_handle));
+    return 0;
+}
+
+FSSession::~FSSession() {
+    if (handle)
+        svcCloseHandle(handle);
+}
+
+Result FSSession::Open() {
+    Result ret = srvGetServiceHandleDirect(&handle, "fs:USER");
+    if (ret != 0) {
+        handle = 0;
+        return ret;
+    }
+
+    ret = FSUSER_Initialize(handle);
+    if (ret != 0) {
+        svcCloseHandle(handle);
+        handle = 0;
+    }
+    return ret;
+}
+
+Result FSTitleArchive::OpenRomFS(std::unique_ptr<ArchiveFile>* file) {
+    if (!running_title) {
+        // Other titles only provide their level 3 data through the title content archive
+        Handle file_handle;
+        Result ret = OpenTitleContent(&file_handle, title_id, media_type, ContentType::ROMFS, "");
+        if (ret != 0)
+            return ret;
+
+        file->reset(new FSArchiveFile(file_handle));
+        return 0;
+    }
+
+    // Read level 3 partition data
+    char arch_path[] = "";
+    FS_Path fs_archive_path = FS_Path{ PATH_EMPTY, 1, (u8*)arch_path };
+    char low_path[0xc];
+    memset(low_path, 0, sizeof(low_path));
+
+    Handle local_fs_handle = session ? session->GetHandle() : 0;
+    if (!session) {
+        Result ret = srvGetServiceHandleDirect(&local_fs_handle, "fs:USER");
+        if (ret != 0)
+            return ret;
+
+        ret = FSUSER_Initialize(local_fs_handle);
+        if (ret != 0) {
+            svcCloseHandle(local_fs_handle);
+            return ret;
+        }
+    }
+
+    Handle file_handle;
+    Result ret = MYFSUSER_OpenFileDirectly(local_fs_handle,
+                                    &file_handle,
+                                    ARCHIVE_ROMFS,
+                                    fs_archive_path,
+                                    (FS_Path) { PATH_BINARY, sizeof(low_path), (u8*)low_path },
+                                    FS_OPEN_READ,
+                                    0);
+    if (ret != 0) {
+        if (!session)
+            svcCloseHandle(local_fs_handle);
+        return ret;
+    }
+
+    file->reset(new FSArchiveFile(file_handle, session ? 0 : local_fs_handle));
+    return 0;
+}
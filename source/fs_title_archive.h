@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+
+#include <3ds.h>
+
+#include "title_archive.h"
+
+// Session with the fs:USER service, opened once and shared by all titles dumped in a session
+class FSSession {
+public:
+    FSSession() = default;
+    ~FSSession();
+
+    FSSession(const FSSession&) = delete;
+    FSSession& operator=(const FSSession&) = delete;
+
+    Result Open();
+
+    Handle GetHandle() const {
+        return handle;
+    }
+
+private:
+    Handle handle = 0;
+};
+
+// TitleArchive backed by the FS service, giving access to the contents of an installed title.
+// The RomFS of the currently running title is read through its own RomFS archive, which requires an
+// fs:USER session that is not used otherwise; if "session" is null, a temporary one is opened.
+class FSTitleArchive : public TitleArchive {
+public:
+    FSTitleArchive(uint64_t title_id, uint8_t media_type, bool running_title, FSSession* session = nullptr)
+        : title_id(title_id), media_type(media_type), running_title(running_title), session(session) {
+    }
+
+    Result OpenExeFSSection(const std::string& name, std::unique_ptr<ArchiveFile>* file) override;
+    Result OpenRomFS(std::unique_ptr<ArchiveFile>* file) override;
+
+private:
+    uint64_t title_id;
+    uint8_t media_type;
+    bool running_title;
+    FSSession* session;
+};
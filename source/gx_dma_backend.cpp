@@ -0,0 +1,37 @@
+#include <3ds.h>
+
+#include "gx_dma_backend.h"
+
+bool GXDmaBackend::QueryRegion(uint32_t address, MemoryRegion* region) {
+    MemInfo info;
+    PageInfo page;
+    if (svcQueryMemory(&info, &page, address) != 0)
+        return false;
+
+    *region = MemoryRegion{ info.base_addr, info.size, info.perm, info.state };
+    return true;
+}
+
+bool GXDmaBackend::IsDumpable(const MemoryRegion& region) {
+    return region.state != MEMSTATE_FREE && (region.permission & MEMPERM_READ);
+}
+
+uint8_t* GXDmaBackend::AllocateBuffer(uint32_t size) {
+    return static_cast<uint8_t*>(linearAlloc(size));
+}
+
+void GXDmaBackend::FreeBuffer(uint8_t* buffer) {
+    linearFree(buffer);
+}
+
+bool GXDmaBackend::StartTransfer(uint32_t address, uint8_t* buffer, uint32_t size) {
+    // Make sure pending CPU writes to the source are visible to the GPU
+    GSPGPU_FlushDataCache(reinterpret_cast<void*>(address), size);
+    return GX_TextureCopy(reinterpret_cast<u32*>(address), 0, reinterpret_cast<u32*>(buffer), 0, size, 8) == 0;
+}
+
+bool GXDmaBackend::FinishTransfer(uint8_t* buffer, uint32_t size) {
+    gspWaitForPPF();
+    GSPGPU_InvalidateDataCache(buffer, size);
+    return true;
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "fcram_dump.h"
+
+// DmaBackend for the current process' address space, using svcQueryMemory to find mapped regions
+// and the GPU's TextureCopy transfers (which can read any memory the GPU has access to) to copy them
+class GXDmaBackend : public DmaBackend {
+public:
+    bool QueryRegion(uint32_t address, MemoryRegion* region) override;
+    bool IsDumpable(const MemoryRegion& region) override;
+
+    uint8_t* AllocateBuffer(uint32_t size) override;
+    void FreeBuffer(uint8_t* buffer) override;
+
+    bool StartTransfer(uint32_t address, uint8_t* buffer, uint32_t size) override;
+    bool FinishTransfer(uint8_t* buffer, uint32_t size) override;
+};
@@ -0,0 +1,132 @@
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+
+#include "incremental_output_file.h"
+#include "xxhash64.h"
+
+IncrementalOutputFile::IncrementalOutputFile(OutputFile& file, const ChecksumManifest& previous)
+    : file(file), staging(new uint8_t[previous.block_size]) {
+    for (auto& region : previous.regions) {
+        for (size_t index = 0; index < region.block_hashes.size(); ++index) {
+            Block block;
+            block.offset = region.offset + index * uint64_t{previous.block_size};
+            block.size = static_cast<uint32_t>(std::min<uint64_t>(previous.block_size, region.size - index * uint64_t{previous.block_size}));
+            block.previous_hash = region.block_hashes[index];
+            blocks.push_back(block);
+        }
+    }
+}
+
+size_t IncrementalOutputFile::FindBlock(uint64_t offset) const {
+    auto it = std::upper_bound(blocks.begin(), blocks.end(), offset, [](uint64_t offset, const Block& block) {
+        return offset < block.offset;
+    });
+    if (it == blocks.begin() || offset >= std::prev(it)->offset + std::prev(it)->size)
+        return blocks.size();
+    return std::prev(it) - blocks.begin();
+}
+
+bool IncrementalOutputFile::KnownHash(uint64_t offset, uint64_t size, uint64_t* hash) const {
+    size_t index = FindBlock(offset);
+    if (index == blocks.size() || blocks[index].offset != offset || blocks[index].size != size || !blocks[index].hashed)
+        return false;
+
+    *hash = blocks[index].hash;
+    return true;
+}
+
+bool IncrementalOutputFile::WriteThrough(uint64_t offset, const uint8_t* data, size_t size) {
+    written_bytes += size;
+    return file.WriteAt(offset, data, size);
+}
+
+bool IncrementalOutputFile::WriteBlock(Block& block, const uint8_t* data) {
+    block.hash = XXHash64::Hash(data, block.size);
+    block.hashed = true;
+    if (!block.modified && block.hash == block.previous_hash) {
+        unchanged_bytes += block.size;
+        return true;
+    }
+
+    block.modified = true;
+    return WriteThrough(block.offset, data, block.size);
+}
+
+bool IncrementalOutputFile::FlushStaged() {
+    if (staged_size == 0)
+        return true;
+
+    auto& block = blocks[staged_block];
+    block.hashed = false;
+    block.modified = true;
+    uint32_t size = staged_size;
+    staged_size = 0;
+    return WriteThrough(block.offset, staging.get(), size);
+}
+
+bool IncrementalOutputFile::WriteAt(uint64_t offset, const void* data, size_t size) {
+    auto bytes = static_cast<const uint8_t*>(data);
+    bool success = true;
+
+    while (size != 0) {
+        size_t index = FindBlock(offset);
+        if (index == blocks.size()) {
+            // Past the end of the previous image (or in a gap of it), so there's nothing to compare against up to
+            // the next block of it
+            auto next = std::upper_bound(blocks.begin(), blocks.end(), offset, [](uint64_t offset, const Block& block) {
+                return offset < block.offset;
+            });
+            size_t piece = (next == blocks.end()) ? size : static_cast<size_t>(std::min<uint64_t>(size, next->offset - offset));
+            success &= FlushStaged();
+            success &= WriteThrough(offset, bytes, piece);
+            offset += piece;
+            bytes += piece;
+            size -= piece;
+            continue;
+        }
+
+        auto& block = blocks[index];
+        size_t piece = static_cast<size_t>(std::min<uint64_t>(size, block.offset + block.size - offset));
+        if (staged_size != 0 && staged_block == index && offset == block.offset + staged_size) {
+            // Continue collecting the block
+            memcpy(staging.get() + staged_size, bytes, piece);
+            staged_size += piece;
+            if (staged_size == block.size) {
+                staged_size = 0;
+                success &= WriteBlock(block, staging.get());
+            }
+        } else {
+            // Staged data is written first, since this write may overlap it
+            success &= FlushStaged();
+            if (offset == block.offset && piece == block.size) {
+                success &= WriteBlock(block, bytes);
+            } else if (offset == block.offset) {
+                memcpy(staging.get(), bytes, piece);
+                staged_block = index;
+                staged_size = piece;
+            } else {
+                block.hashed = false;
+                block.modified = true;
+                success &= WriteThrough(offset, bytes, piece);
+            }
+        }
+
+        offset += piece;
+        bytes += piece;
+        size -= piece;
+    }
+    return success;
+}
+
+bool IncrementalOutputFile::Flush() {
+    bool success = FlushStaged();
+    success &= file.Flush();
+    return success;
+}
+
+bool IncrementalOutputFile::SetSize(uint64_t size) {
+    bool success = FlushStaged();
+    success &= file.SetSize(size);
+    return success;
+}
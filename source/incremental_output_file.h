@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "checksum_manifest.h"
+#include "output_file.h"
+
+// OutputFile that patches an earlier dump in place, writing only the blocks that changed since then.
+//
+// The file is expected to contain the image described by "previous", i.e. the checksum manifest written
+// alongside the earlier dump. Data written is collected into the manifest's blocks and checksummed; blocks
+// whose checksum matches the manifest are dropped instead of being written, so re-dumping a title that
+// changed little costs mostly reads and hashing rather than SD card writes.
+//
+// Writes that don't cover a whole block (e.g. header patches) are passed on as they are. Data past the
+// end of the previous image is always written.
+class IncrementalOutputFile : public OutputFile {
+public:
+    IncrementalOutputFile(OutputFile& file, const ChecksumManifest& previous);
+
+    // Number of bytes that matched the previous dump and weren't written
+    uint64_t UnchangedBytes() const {
+        return unchanged_bytes;
+    }
+
+    // Number of bytes passed on to the underlying file
+    uint64_t WrittenBytes() const {
+        return written_bytes;
+    }
+
+    // Checksum of the final contents of the given range, if it's a block that was written as a whole
+    // (and not modified afterwards). Used to build the new manifest without reading these blocks back.
+    bool KnownHash(uint64_t offset, uint64_t size, uint64_t* hash) const;
+
+    bool WriteAt(uint64_t offset, const void* data, size_t size) override;
+    bool Flush() override;
+    bool SetSize(uint64_t size) override;
+
+private:
+    struct Block {
+        uint64_t offset;
+        uint32_t size;
+        uint64_t previous_hash;
+        uint64_t hash = 0;
+        bool hashed = false;   // "hash" describes the current contents of the block
+        bool modified = false; // Data was written to the block, so it may no longer match previous_hash
+    };
+
+    // Index of the block containing "offset", or blocks.size() if past the end of the previous image
+    size_t FindBlock(uint64_t offset) const;
+
+    // Write a whole block unless it matches the previous dump
+    bool WriteBlock(Block& block, const uint8_t* data);
+
+    // Pass on partially collected block data
+    bool FlushStaged();
+
+    bool WriteThrough(uint64_t offset, const uint8_t* data, size_t size);
+
+    OutputFile& file;
+    std::vector<Block> blocks; // Sorted by offset, covering the previous image
+
+    std::unique_ptr<uint8_t[]> staging; // Data collected for the block at staged_block so far
+    size_t staged_block = 0;
+    uint32_t staged_size = 0;
+
+    uint64_t unchanged_bytes = 0;
+    uint64_t written_bytes = 0;
+};
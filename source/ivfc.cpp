@@ -0,0 +1,104 @@
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+#include "ivfc.h"
+
+static uint64_t AlignUp(uint64_t value, uint64_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+IvfcHashTree::IvfcHashTree(uint64_t level3_size) : level3_size(level3_size) {
+    uint64_t level2_size = HashDataSize(level3_size);
+    uint64_t level1_size = HashDataSize(level2_size);
+    master_hash.resize(HashDataSize(level1_size));
+    level2.reserve(level2_size);
+    level1.reserve(level1_size);
+
+    level3_offset = AlignUp(SuperblockSize(), block_size);
+}
+
+uint64_t IvfcHashTree::ImageSize(uint64_t level3_size) {
+    uint64_t level2_size = HashDataSize(level3_size);
+    uint64_t level1_size = HashDataSize(level2_size);
+    uint64_t level3_offset = AlignUp(header_size + HashDataSize(level1_size), block_size);
+    return AlignUp(level3_offset + level3_size, block_size) + AlignUp(level1_size, block_size) + AlignUp(level2_size, block_size);
+}
+
+void IvfcHashTree::AddLevel3Data(const uint8_t* data, size_t size) {
+    while (size != 0) {
+        uint32_t chunk = std::min<size_t>(size, block_size - block_fill);
+        block_hash.Update(data, chunk);
+        block_fill += chunk;
+        data += chunk;
+        size -= chunk;
+
+        if (block_fill == block_size) {
+            // level2 has enough capacity reserved, so this never moves previously computed hashes
+            level2.resize(level2.size() + Sha256::digest_size);
+            block_hash.Final(&level2[level2.size() - Sha256::digest_size]);
+            block_hash.Reset();
+            block_fill = 0;
+            hashed_blocks.fetch_add(1, std::memory_order_release);
+        }
+    }
+}
+
+void IvfcHashTree::RestoreLevel2(const uint8_t* hashes, size_t size) {
+    assert(block_fill == 0 && level2.size() + size <= level2.capacity());
+    level2.insert(level2.end(), hashes, hashes + size);
+    hashed_blocks.store(level2.size() / Sha256::digest_size, std::memory_order_release);
+}
+
+void IvfcHashTree::HashBlocks(const std::vector<uint8_t>& data, std::vector<uint8_t>& hashes) {
+    std::vector<uint8_t> block(block_size);
+    for (size_t offset = 0; offset < data.size(); offset += block_size) {
+        // The last block is zero-padded
+        size_t size = std::min<size_t>(block_size, data.size() - offset);
+        std::fill(std::copy(data.begin() + offset, data.begin() + offset + size, block.begin()), block.end(), 0);
+
+        hashes.resize(hashes.size() + Sha256::digest_size);
+        Sha256::Hash(block.data(), block.size(), &hashes[hashes.size() - Sha256::digest_size]);
+    }
+}
+
+void IvfcHashTree::Finish() {
+    // Hash the zero-padded trailing level 3 block
+    if (block_fill != 0) {
+        std::vector<uint8_t> zeros(block_size - block_fill);
+        AddLevel3Data(zeros.data(), zeros.size());
+    }
+    assert(level2.size() == HashDataSize(level3_size));
+
+    HashBlocks(level2, level1);
+
+    std::vector<uint8_t> master;
+    HashBlocks(level1, master);
+    assert(master.size() == master_hash.size());
+    master_hash = std::move(master);
+}
+
+std::vector<uint8_t> IvfcHashTree::BuildSuperblock() const {
+    RomFS_IVFCHeader header;
+    memset(&header, 0, sizeof(header));
+
+    header.magic = 'I' | ('V' << 8) | ('F' << 16) | ('C' << 24);
+    header.magic_number = 0x10000;
+    header.master_hash_size = master_hash.size();
+
+    // Logical offsets describe the levels as if they were laid out in order
+    const uint64_t level_sizes[] = { level1.size(), level2.size(), level3_size };
+    uint64_t logical_offset = 0;
+    for (unsigned level = 0; level < 3; ++level) {
+        header.levels[level].logical_offset = logical_offset;
+        header.levels[level].hash_data_size = level_sizes[level];
+        header.levels[level].block_size_log2 = block_size_log2;
+        logical_offset = AlignUp(logical_offset + level_sizes[level], block_size);
+    }
+    header.optional_info_size = sizeof(header);
+
+    std::vector<uint8_t> superblock(SuperblockSize());
+    memcpy(superblock.data(), &header, sizeof(header));
+    std::copy(master_hash.begin(), master_hash.end(), superblock.begin() + header_size);
+    return superblock;
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include "ncch.h"
+#include "sha256.h"
+
+// Incrementally builds the IVFC hash tree protecting a RomFS.
+//
+// The RomFS image starts with the IVFC header and the master hash (which covers level 1).
+// It's followed by the level 3 data (i.e. the actual file system), then level 1 (hashes of
+// level 2 blocks) and level 2 (hashes of level 3 blocks). Level 3 data is hashed while it's
+// being streamed, so only the comparatively small hash levels need to be kept in memory.
+class IvfcHashTree {
+public:
+    static const uint32_t block_size_log2 = 12;
+    static const uint32_t block_size = 1 << block_size_log2;
+    static const uint32_t header_size = 0x60; // Size of the IVFC header, rounded up to the hash size
+
+    explicit IvfcHashTree(uint64_t level3_size);
+
+    // Offset of the level 3 data relative to the beginning of the RomFS
+    uint64_t Level3Offset() const {
+        return level3_offset;
+    }
+
+    // Offset of the level 3 data relative to the beginning of the RomFS described by an existing header
+    static uint64_t Level3Offset(const RomFS_IVFCHeader& header) {
+        const uint64_t level3_block_size = uint64_t{1} << header.levels[2].block_size_log2;
+        return (header_size + header.master_hash_size + level3_block_size - 1) / level3_block_size * level3_block_size;
+    }
+
+    // Size of the complete RomFS image: superblock, level 3, level 1 and level 2, each padded to the block size.
+    static uint64_t ImageSize(uint64_t level3_size);
+
+    // Number of bytes at the beginning of the RomFS covered by the superblock hash (IVFC header and master hash)
+    uint32_t SuperblockSize() const {
+        return header_size + master_hash.size();
+    }
+
+    // Feed the next piece of level 3 data. May be called with arbitrarily sized pieces.
+    void AddLevel3Data(const uint8_t* data, size_t size);
+
+    // Number of level 3 bytes covered by Level2 so far.
+    // This may be queried from a different thread than the one adding level 3 data.
+    uint64_t HashedSize() const {
+        return hashed_blocks.load(std::memory_order_acquire) * block_size;
+    }
+
+    // Level 2 hashes for the first HashedSize() bytes. These are never modified once computed.
+    const uint8_t* Level2Hashes() const {
+        return level2.data();
+    }
+
+    // Restore level 2 hashes computed in a previous run, e.g. when resuming a dump.
+    // Level 3 data must be added starting at HashedSize() afterwards.
+    void RestoreLevel2(const uint8_t* hashes, size_t size);
+
+    // Finish hashing level 3 and compute the upper levels.
+    // Must be called after all level 3 data has been added.
+    void Finish();
+
+    // IVFC header followed by the master hash, padded to SuperblockSize()
+    std::vector<uint8_t> BuildSuperblock() const;
+
+    const std::vector<uint8_t>& Level1() const {
+        return level1;
+    }
+
+    const std::vector<uint8_t>& Level2() const {
+        return level2;
+    }
+
+private:
+    static uint64_t HashDataSize(uint64_t data_size) {
+        return (data_size + block_size - 1) / block_size * Sha256::digest_size;
+    }
+
+    // Append the hashes of all (zero-padded) blocks of "data" to "hashes"
+    static void HashBlocks(const std::vector<uint8_t>& data, std::vector<uint8_t>& hashes);
+
+    uint64_t level3_size;
+    uint64_t level3_offset;
+
+    std::vector<uint8_t> master_hash;
+    std::vector<uint8_t> level1;
+    std::vector<uint8_t> level2;
+
+    // Level 3 block that is currently being hashed
+    Sha256 block_hash;
+    uint32_t block_fill = 0;
+
+    std::atomic<uint64_t> hashed_blocks{0};
+};
@@ -0,0 +1,162 @@
+#include <algorithm>
+#include <cstring>
+
+#include "lz4_block.h"
+
+// Format constraints of LZ4 blocks
+static const size_t min_match = 4;
+static const size_t last_literals = 5;  // The last 5 bytes are always encoded as literals
+static const size_t match_safe_distance = 12; // No match may start within the last 12 bytes
+static const size_t max_offset = 0xFFFF;
+
+static uint32_t Read32(const uint8_t* data) {
+    uint32_t value;
+    memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+Lz4Compressor::Lz4Compressor() : hash_table(1 << hash_log2) {
+}
+
+// Append "length" as a sequence of 255-valued bytes terminated by the remainder.
+// Used for literal and match lengths that don't fit in their 4-bit token field.
+static uint8_t* WriteLength(uint8_t* out, size_t length) {
+    for (; length >= 255; length -= 255)
+        *out++ = 255;
+    *out++ = static_cast<uint8_t>(length);
+    return out;
+}
+
+// Emit a sequence consisting of the literals [literals, literals + num_literals), followed by a match
+// of "match_length" bytes at distance "offset". match_length == 0 denotes the final, literal-only sequence.
+static uint8_t* WriteSequence(uint8_t* out, uint8_t* out_end, const uint8_t* literals, size_t num_literals,
+                              size_t offset, size_t match_length) {
+    // Worst-case size of this sequence
+    if (static_cast<size_t>(out_end - out) < 1 + num_literals + num_literals / 255 + 1 + 2 + match_length / 255 + 1)
+        return nullptr;
+
+    uint8_t* token = out++;
+    *token = static_cast<uint8_t>(std::min<size_t>(num_literals, 15) << 4);
+    if (num_literals >= 15)
+        out = WriteLength(out, num_literals - 15);
+    memcpy(out, literals, num_literals);
+    out += num_literals;
+
+    if (match_length == 0)
+        return out;
+
+    *out++ = static_cast<uint8_t>(offset);
+    *out++ = static_cast<uint8_t>(offset >> 8);
+    size_t encoded_length = match_length - min_match;
+    *token |= static_cast<uint8_t>(std::min<size_t>(encoded_length, 15));
+    if (encoded_length >= 15)
+        out = WriteLength(out, encoded_length - 15);
+    return out;
+}
+
+size_t Lz4Compressor::Compress(const uint8_t* src, size_t size, uint8_t* dst, size_t capacity) {
+    uint8_t* out = dst;
+    uint8_t* out_end = dst + capacity;
+    size_t anchor = 0; // Start of the pending literals
+
+    if (size > match_safe_distance) {
+        std::fill(hash_table.begin(), hash_table.end(), 0);
+
+        const size_t match_limit = size - last_literals;
+        const size_t search_limit = size - match_safe_distance;
+        size_t pos = 0;
+        unsigned misses = 0;
+        while (pos < search_limit) {
+            uint32_t sequence = Read32(src + pos);
+            uint32_t hash = (sequence * 2654435761u) >> (32 - hash_log2);
+            size_t candidate = hash_table[hash];
+            hash_table[hash] = static_cast<uint32_t>(pos);
+
+            if (candidate >= pos || pos - candidate > max_offset || Read32(src + candidate) != sequence) {
+                // Skip ahead faster the longer no match has been found. This quickly gets over incompressible data.
+                pos += 1 + (misses++ >> 6);
+                continue;
+            }
+
+            // Extend the match backwards into the pending literals, then forwards
+            while (pos > anchor && candidate > 0 && src[pos - 1] == src[candidate - 1]) {
+                --pos;
+                --candidate;
+            }
+            size_t length = min_match;
+            while (pos + length < match_limit && src[pos + length] == src[candidate + length])
+                ++length;
+
+            out = WriteSequence(out, out_end, src + anchor, pos - anchor, pos - candidate, length);
+            if (out == nullptr)
+                return 0;
+
+            pos += length;
+            anchor = pos;
+            misses = 0;
+        }
+    }
+
+    out = WriteSequence(out, out_end, src + anchor, size - anchor, 0, 0);
+    if (out == nullptr)
+        return 0;
+    return out - dst;
+}
+
+// Read an extended length field (see WriteLength). Returns false if the input ends prematurely.
+static bool ReadLength(const uint8_t*& in, const uint8_t* in_end, size_t& length) {
+    uint8_t value;
+    do {
+        if (in == in_end)
+            return false;
+        value = *in++;
+        length += value;
+    } while (value == 255);
+    return true;
+}
+
+bool Lz4Decompress(const uint8_t* src, size_t src_size, uint8_t* dst, size_t dst_size) {
+    const uint8_t* in = src;
+    const uint8_t* in_end = src + src_size;
+    uint8_t* out = dst;
+    uint8_t* out_end = dst + dst_size;
+
+    while (in != in_end) {
+        uint8_t token = *in++;
+
+        size_t num_literals = token >> 4;
+        if (num_literals == 15 && !ReadLength(in, in_end, num_literals))
+            return false;
+        if (static_cast<size_t>(in_end - in) < num_literals || static_cast<size_t>(out_end - out) < num_literals)
+            return false;
+        memcpy(out, in, num_literals);
+        in += num_literals;
+        out += num_literals;
+
+        // The final sequence ends after its literals
+        if (in == in_end)
+            break;
+
+        if (in_end - in < 2)
+            return false;
+        size_t offset = in[0] | (in[1] << 8);
+        in += 2;
+        if (offset == 0 || offset > static_cast<size_t>(out - dst))
+            return false;
+
+        size_t length = token & 0xF;
+        if (length == 15 && !ReadLength(in, in_end, length))
+            return false;
+        length += min_match;
+        if (static_cast<size_t>(out_end - out) < length)
+            return false;
+
+        // Matches may overlap the data they produce, so this must be copied front to back
+        const uint8_t* match = out - offset;
+        for (size_t i = 0; i < length; ++i)
+            out[i] = match[i];
+        out += length;
+    }
+
+    return out == out_end;
+}
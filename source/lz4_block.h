@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Compressor for the LZ4 block format (without the LZ4 frame wrapper).
+// This favors speed over compression ratio: The 3DS CPU needs to keep up with SD card writes.
+class Lz4Compressor {
+public:
+    Lz4Compressor();
+
+    // Upper bound for the compressed size of "size" bytes of input
+    static size_t CompressBound(size_t size) {
+        return size + size / 255 + 16;
+    }
+
+    // Compress "size" bytes from "src" to "dst", which can hold "capacity" bytes.
+    // Returns the compressed size, or 0 if the compressed data doesn't fit in "dst".
+    size_t Compress(const uint8_t* src, size_t size, uint8_t* dst, size_t capacity);
+
+private:
+    static const unsigned hash_log2 = 12;
+
+    std::vector<uint32_t> hash_table; // Most recent input position for each hashed 4-byte sequence
+};
+
+// Decompress an LZ4 block of "src_size" bytes to "dst". Returns false unless the block decompresses
+// to exactly "dst_size" bytes.
+bool Lz4Decompress(const uint8_t* src, size_t src_size, uint8_t* dst, size_t dst_size);
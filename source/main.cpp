@@ -2,20 +2,34 @@
 #include <array>
 #include <cassert>
 #include <cstring>
-#include <fstream>
+#include <functional>
 #include <iostream>
 #include <iomanip>
-#include <iterator>
+#include <memory>
 #include <sstream>
 #include <vector>
 #include <inttypes.h>
 
+#include <malloc.h>
 #include <sys/stat.h>
 #include <errno.h>
 
 #include <3ds.h>
 
-#include "ncch.h"
+#include "batch_dump.h"
+#include "dump_arena.h"
+#include "dump_engine.h"
+#include "dump_progress.h"
+#include "fcram_dump.h"
+#include "fs_output_file.h"
+#include "fs_title_archive.h"
+#include "gx_dma_backend.h"
+#include "output_file.h"
+#include "output_sink.h"
+#include "romfs_index.h"
+#include "socket_output_file.h"
+#include "stdio_archive_file.h"
+#include "title_dumper.h"
 
 // Utility function to convert a value to a fixed-width string of (sizeof(T)*2+2) digits, e.g. "0x0123" for a uint16_t argument.
 template<typename T>
@@ -31,27 +45,6 @@ static std::string fixed_width_hex(T value) {
     return ss.str();
 }
 
-class WriteResult {
-    Result res;
-
-public:
-    WriteResult(Result res) : res(res) {}
-	friend std::ostream& operator<<(std::ostream& os, const WriteResult& result);
-};
-
-std::ostream& operator<<(std::ostream& os, const WriteResult& result) {
-    std::ios::fmtflags f( os.flags() );
-    os << fixed_width_hex(result.res);
-    os.flags(f);
-    return os;
-}
-
-static std::string ResultToString(Result res) {
-    std::stringstream ss;
-    ss << WriteResult(res);
-    return ss.str();
-}
-
 static Result MYFSUSER_GetMediaType(Handle fsuHandle, u8* mediatype) {
     u32* cmdbuf = getThreadCommandBuffer();
 
@@ -67,35 +60,16 @@ static Result MYFSUSER_GetMediaType(Handle fsuHandle, u8* mediatype) {
     return cmdbuf[1];
 }
 
-static Result GetTitleInformation(u8* mediatype, uint64_t* tid) {
+static Result GetTitleInformation(FSSession& fs_session, u8* mediatype, uint64_t* tid) {
     Result ret = 0;
 
     if(mediatype) {
-        Handle localFsHandle;
-
-        // Create temporary FS handle to get the proper media type
-        ret = srvGetServiceHandleDirect(&localFsHandle, "fs:USER");
-        if(ret) {
-            svcCloseHandle(localFsHandle);
-            std::cout << "srvGetServiceHandleDirect error: " << ResultToString(ret) << std::endl;
-            return ret;
-        }
-
-        ret = FSUSER_Initialize(localFsHandle);
-        if(ret) {
-            svcCloseHandle(localFsHandle);
-            std::cout << "FSUSER_Initialize error: " << ResultToString(ret) << std::endl;
-            return ret;
-        }
-
-        ret = MYFSUSER_GetMediaType(localFsHandle, mediatype);
+        // The shared FS session is opened directly rather than through libctru's fsUserHandle, so it reports the proper media type
+        ret = MYFSUSER_GetMediaType(fs_session.GetHandle(), mediatype);
         if (ret != 0) {
-            svcCloseHandle(localFsHandle);
             std::cout << "FSUSER_GetMediaType error: " << ResultToString(ret) << std::endl;
             return ret;
         }
-
-        svcCloseHandle(localFsHandle);
     }
 
     if(tid) {
@@ -107,307 +81,111 @@ static Result GetTitleInformation(u8* mediatype, uint64_t* tid) {
     return ret;
 }
 
-enum class ContentType : uint32_t {
-    ROMFS = 0,
-    EXEFS = 2,
-};
-
-static std::vector<uint8_t> ReadTitleContent(uint64_t title_id, uint8_t media_type, ContentType type, const std::string& name) {
-    uint32_t archivePath[] = { (uint32_t)(title_id & 0xFFFFFFFF), (uint32_t)(title_id >> 32), media_type, 0x00000000};
-    FS_Path fs_archive_path = { PATH_BINARY, 0x10, (u8*)archivePath };
-
-    struct LowPathData {
-        uint32_t unk[3];
-        std::array<char, 8> filename; // NOTE: Archive 0x2345678a expects this particular size!
-    } data = { { 0, 0, static_cast<uint32_t>(type) }, {} };
-
-    // Copy filename including null terminator
-    assert(name.size() + 1 <= data.filename.size());
-    std::fill(data.filename.begin(), data.filename.end(), 0);
-    std::copy(name.c_str(), name.c_str() + name.size() + 1, data.filename.begin());
-
-    Handle file_handle;
-    Result ret = FSUSER_OpenFileDirectly(&file_handle,
-                                         (FS_ArchiveID)0x2345678a,
-                                         fs_archive_path,
-                                         (FS_Path){ PATH_BINARY, sizeof(data), (u8*)&data },
-                                         FS_OPEN_READ,
-                                         0);
-
+// Get the size of the memory region that contains the virtual address "address" (as returned by svcQueryMemory).
+// We use this to estimate the size of the various application sections.
+static uint32_t GetRegionSize(uint32_t address) {
+    MemInfo mem_info;
+    PageInfo page_info;
+    Result ret = svcQueryMemory(&mem_info, &page_info, address);
     if (ret != 0) {
-        std::cout << "Couldn't open \"ExeFS/" << name << "\" for reading (error " << ResultToString(ret) << ")" << std::endl;
-        return {};
-    }
-
-    uint64_t size;
-    ret = FSFILE_GetSize(file_handle, &size);
-    if (ret != 0 || !size) {
-        std::cout << "Couldn't get file size for \"ExeFS/" << name << "\" (error " << ResultToString(ret) << ")" << std::endl;
-        FSFILE_Close(file_handle);
-        return {};
-    } else {
-        std::cout << (size / 1024) << " KiB... " << std::flush;
-    }
-
-    std::vector<uint8_t> content(size);
-
-    uint32_t bytes_read;
-    ret = FSFILE_Read(file_handle, &bytes_read, 0, content.data(), size);
-    if (ret != 0 || bytes_read != size) {
-        std::cout << "Expected to read " << size << " bytes, read" << bytes_read << std::endl;
-        FSFILE_Close(file_handle);
-        return {};
-    } else {
+        return 0;
     }
 
-    FSFILE_Close(file_handle);
-    return content;
-}
-
-static uint32_t RoundUpToMediaUnit(uint32_t value) {
-    return (value + 0x1FF) / 0x200 * 0x200;
+    return mem_info.size;
 }
 
-static uint32_t BytesToMediaUnits(uint32_t value) {
-    return RoundUpToMediaUnit(value) / 0x200;
-}
 
-static uint32_t RoundUpToPageSize(uint32_t value) {
-    return (value + 0xFFF) / 0x1000 * 0x1000;
-}
-
-template<typename Container>
-static ExeFs_SectionHeader WriteSection(const Container& cont, const std::string& section_name, std::ofstream& exefs_file, std::ofstream::pos_type exefs_header_end) {
-    // Write section data to file
-    const auto section_begin = exefs_file.tellp();
-    std::copy(cont.begin(), cont.end(), std::ostream_iterator<uint8_t>(exefs_file));
-    const auto section_end = exefs_file.tellp();
-
-    // Pad with zeros to media unit size
-    uint32_t size = section_end - section_begin;
-    uint32_t padding = RoundUpToMediaUnit(size) - size;
-    std::generate_n(std::ostream_iterator<char>(exefs_file), padding, [] { return 0; }); // TODO: Use WriteDummyBytes instead
-
-    // Build and return header - don't include padding in the reported size
-    ExeFs_SectionHeader ret{{}, (uint32_t)(section_begin - exefs_header_end), size };
-    std::strcpy(ret.name, section_name.c_str());
-    return ret;
+// Stream dumps to a host running host/net_receiver instead of writing them to the SD card
+const bool dump_to_network = false;
+const char network_receiver_address[] = "192.168.0.2";
+const uint16_t network_receiver_port = 5000;
+
+// RomFS read chunk sizes that performed best in previous dumps, per media type
+const char autotune_config_path[] = "sdmc:/3ds/braindump/autotune.cfg";
+
+// If this file lists any titles, they are dumped instead of the running title, and a summary is written to the report file
+const char batch_queue_path[] = "sdmc:/3ds/braindump/queue.txt";
+const char batch_report_path[] = "sdmc:/3ds/braindump/batch_report.txt";
+
+// If this file lists any RomFS paths or glob patterns (e.g. "font/*.bcfnt"), only the matching files are dumped
+const char romfs_filter_path[] = "sdmc:/3ds/braindump/romfs_files.txt";
+
+// What to produce for each dumped title
+static DumpOptions GetDumpOptions() {
+    DumpOptions options;
+    options.standalone_exefs = false;
+    options.standalone_romfs = false;
+    options.full_image = true;
+    options.compress_full_image = false; // Store the full image in a block-compressed container (not resumable)
+    options.chunk_store_path = ""; // e.g. "sdmc:/3ds/braindump/chunks" to store images deduplicated against each other
+    options.resumable = !dump_to_network;
+    options.verify = false; // Read the title and the image back and compare them (only for dumps to the SD card)
+    options.recover_read_errors = true; // Zero-fill RomFS data that can't be read, listing it in <titleid>.bad_ranges
+    options.incremental = false; // Only rewrite blocks of an existing <titleid>.cxi that changed (needs <titleid>.checksums)
+    options.autotune_config_path = autotune_config_path;
+    options.romfs_index = false; // Write <titleid>.romfs_index listing all RomFS files
+    ReadPathList(romfs_filter_path, &options.romfs_patterns);
+    return options;
 }
 
-// Returns the size of the decompressed .code section
-static uint32_t DumpExeFS(std::ofstream& exefs_file, uint64_t title_id, uint8_t mediatype) {
-    // Generate dummy ExeFS header to fill in later
-    const auto exefs_header_begin = exefs_file.tellp();
-    std::generate_n(std::ostream_iterator<uint8_t>(exefs_file), sizeof(ExeFs_Header), []{return 0;}); // TODO: Use WriteDummyBytes instead
-    const auto exefs_header_end = exefs_file.tellp();
-
-    // Write content sections
-    ExeFs_Header exefs_header;
-    auto exefs_section_header_it = std::begin(exefs_header.section);
-
-    uint32_t size_decompressed_code;
-
-    {
-        // Load decompressed code data
-        std::cout << "\tDumping code... " << std::flush;
-        auto contents = ReadTitleContent(title_id, mediatype, ContentType::EXEFS, ".code");
-        if (contents.empty())
-            return 0;
-        *exefs_section_header_it++ = WriteSection(contents, ".code", exefs_file, exefs_header_end);
-        std::cout << "done!" << std::endl;
-
-        u8* size_diff_ptr = &contents[contents.size() - 4];
-        u32 size_diff = size_diff_ptr[0] | (size_diff_ptr[1] << 8) | (size_diff_ptr[2] << 16) | (size_diff_ptr[3] << 24);
-        size_decompressed_code = contents.size() + size_diff;
-    }
-
-    {
-        std::cout << "\tDumping banner... " << std::flush;
-        auto contents = ReadTitleContent(title_id, mediatype, ContentType::EXEFS, "banner");
-        if (contents.empty())
-            return 0;
-        *exefs_section_header_it++ = WriteSection(contents, "banner", exefs_file, exefs_header_end);
-        std::cout << "done!" << std::endl;
-    }
-
-    {
-        std::cout << "\tDumping icon... " << std::flush;
-        auto contents = ReadTitleContent(title_id, mediatype, ContentType::EXEFS, "icon");
-        if (contents.empty())
-            return 0;
-        *exefs_section_header_it++ = WriteSection(contents, "icon", exefs_file, exefs_header_end);
-        std::cout << "done!" << std::endl;
-    }
+const bool dump_fcram = false;
 
-    {
-        std::cout << "\tDumping logo... " << std::flush;
-        auto contents = ReadTitleContent(title_id, mediatype, ContentType::EXEFS, "logo");
-        if (contents.empty())
-            return 0;
-        *exefs_section_header_it++ = WriteSection(contents, "logo", exefs_file, exefs_header_end);
-        std::cout << "done!" << std::endl;
+// Open the dump output file at "path" (on the SD card), or the corresponding file on the network receiver.
+// If "keep_contents" is set, existing data is preserved and its size is returned in "existing_size".
+static std::unique_ptr<OutputFile> OpenOutput(const std::string& path, bool keep_contents, uint64_t* existing_size) {
+    *existing_size = 0;
+
+    if (dump_to_network) {
+        // The receiver mirrors the SD card layout
+        const std::string name = path.substr(strlen("sdmc:/"));
+        std::unique_ptr<SocketOutputFile> output(new SocketOutputFile);
+        if (!output->Open(network_receiver_address, network_receiver_port, name))
+            std::cout << "Couldn't connect to " << network_receiver_address << ":" << network_receiver_port << " to send \"" << name << "\"" << std::endl;
+        else
+            std::cout << "Dumping to \"" << name << "\" on " << network_receiver_address << std::endl;
+        return std::move(output);
     }
 
-    // Seek back and write ExeFS header
-    auto end_pos = exefs_file.tellp();
-    exefs_file.seekp(exefs_header_begin);
-    // TODO: Compute file hashes!
-    exefs_file.write(reinterpret_cast<char*>(&exefs_header), sizeof(exefs_header));
-    exefs_file.seekp(end_pos);
-
-    return size_decompressed_code;
-}
-
-static Result
-MYFSUSER_OpenFileDirectly(Handle fsuHandle,
-                        Handle     *out,
-                        FS_ArchiveID id,
-                        FS_Path    archivePath,
-                        FS_Path    filePath,
-                        u32        openFlags,
-                        u32        attributes) noexcept {
-    u32 *cmdbuf = getThreadCommandBuffer();
-
-    cmdbuf[ 0] = IPC_MakeHeader(0x803,8,4); // 0x8030204
-    cmdbuf[ 1] = 0;
-    cmdbuf[ 2] = id;
-    cmdbuf[ 3] = archivePath.type;
-    cmdbuf[ 4] = archivePath.size;
-    cmdbuf[ 5] = filePath.type;
-    cmdbuf[ 6] = filePath.size;
-    cmdbuf[ 7] = openFlags;
-    cmdbuf[ 8] = attributes;
-    cmdbuf[ 9] = IPC_Desc_StaticBuffer(archivePath.size,2);
-    cmdbuf[10] = (u32)archivePath.data;
-    cmdbuf[11] = IPC_Desc_StaticBuffer(filePath.size,0);
-    cmdbuf[12] = (u32)filePath.data;
-
-    Result ret = 0;
-    if((ret = svcSendSyncRequest(fsuHandle)))
-        return ret;
-
-    if(out)
-        *out = cmdbuf[3];
-
-    return cmdbuf[1];
+    // Files are written through the FS service directly, bypassing newlib's buffering and allowing preallocation
+    std::unique_ptr<FSOutputFile> output(new FSOutputFile);
+    Result ret = output->Open(path, keep_contents);
+    if (ret != 0)
+        std::cout << "Couldn't open \"" << path << "\" for writing (error " << ResultToString(ret) << ")" << std::endl;
+    else if (keep_contents)
+        std::cout << "Resuming interrupted dump to \"" << path << "\"" << std::endl;
+    else
+        std::cout << "Dumping to \"" << path << "\"" << std::endl;
+    *existing_size = output->GetSize();
+    return std::move(output);
 }
 
-static bool DumpRomFS(std::ofstream& out_file, uint64_t title_id, uint8_t mediatype) {
-    bool success = false;
-
-    // Write the magic word and some padding bytes to act as a dummy info block
-    out_file.write("IVFC", 4);
-    std::generate_n(std::ostream_iterator<uint8_t>(out_file), 0xFFC, []{return 0;}); // TODO: Use WriteDummyBytes instead
-
-    // Read level 3 partition data
-    char arch_path[] = "";
-    FS_Path fs_archive_path = FS_Path{ PATH_EMPTY, 1, (u8*)arch_path };
-    char low_path[0xc];
-    memset(low_path, 0, sizeof(low_path));
-
-    Handle local_fs_handle;
-    Result ret = srvGetServiceHandleDirect(&local_fs_handle, "fs:USER");
-    if (ret != 0) {
-        std::cout << "Failed to get fs:USER handle (error " << ResultToString(ret) << ")" << std::endl;
-        return success;
-    }
-
-
-    ret = FSUSER_Initialize(local_fs_handle);
-    Handle file_handle;
-    if (ret != 0) {
-        std::cout << "Failed to initialize fs:USER handle (error " << ResultToString(ret) << ")" << std::endl;
-        goto cleanup2;
-    }
-
-    ret = MYFSUSER_OpenFileDirectly(local_fs_handle,
-                                    &file_handle,
-                                    ARCHIVE_ROMFS,
-                                    fs_archive_path,
-                                    (FS_Path) { PATH_BINARY, sizeof(low_path), (u8*)low_path },
-                                    FS_OPEN_READ,
-                                    0);
-
-    if (ret != 0) {
-        std::cout << "Couldn't open RomFS for reading (error " << ResultToString(ret) << ")" << std::endl;
-        goto cleanup2;
-    }
-
-    {
-    uint64_t size;
-    uint64_t offset = 0;
-    ret = FSFILE_GetSize(file_handle, &size);
-    if (ret != 0 || !size) {
-        std::cout << "Couldn't get RomFS size (error " << ResultToString(ret) << ")" << std::endl;
-        goto cleanup;
+// Keeps the SOC service, which SocketOutputFile needs, initialized while in scope
+class SocSession {
+public:
+    SocSession() = default;
+    ~SocSession() {
+        if (buffer == nullptr)
+            return;
+        socExit();
+        free(buffer);
     }
 
-    std::vector<char> read_buffer(1024*1024);
-    while (offset != size) {
-        uint32_t bytes_read;
+    SocSession(const SocSession&) = delete;
+    SocSession& operator=(const SocSession&) = delete;
 
-        ret = FSFILE_Read(file_handle, &bytes_read, offset, read_buffer.data(), read_buffer.size() * sizeof(read_buffer[0]));
-        if (ret != 0 || bytes_read == 0) {
-            std::cout << "Error while reading RomFS (error " << ResultToString(ret) << ")" << std::endl;
-            goto cleanup;
-        }
-        out_file.write(read_buffer.data(), bytes_read);
-        if (!out_file.good()) {
-            std::cout << "Error while writing output... is your SD card full?" << std::endl;
-            goto cleanup;
+    bool Init() {
+        static const u32 buffer_size = 0x100000;
+        buffer = static_cast<u32*>(memalign(0x1000, buffer_size));
+        if (buffer != nullptr && socInit(buffer, buffer_size) != 0) {
+            free(buffer);
+            buffer = nullptr;
         }
-        offset += bytes_read;
-
-        std::cout << "\rDumping RomFS... " << (offset / 1024) << "/" << (size / 1024) << " KiB... " << std::flush;
-    }
-    success = true;
-
+        return buffer != nullptr;
     }
 
-
-cleanup:
-    FSFILE_Close(file_handle);
-
-cleanup2:
-    svcCloseHandle(local_fs_handle);
-
-    return success;
-}
-
-// Get the size of the memory region that contains the virtual address "address" (as returned by svcQueryMemory).
-// We use this to estimate the size of the various application sections.
-static uint32_t GetRegionSize(uint32_t address) {
-    MemInfo mem_info;
-    PageInfo page_info;
-    Result ret = svcQueryMemory(&mem_info, &page_info, address);
-    if (ret != 0) {
-        return 0;
-    }
-
-    return mem_info.size;
-}
-
-// Write "num" placeholder bytes into the output stream
-static void WriteDummyBytes(std::ofstream& file, unsigned num) {
-    std::generate_n(std::ostream_iterator<char>(file), num, [] { return 0; });
-}
-
-// Append dummy bytes to "stream" until the offset with respect to the given "base" is a multiple of the media unit size.
-static void PadToNextMediaUnit(std::ofstream& stream, std::ofstream::pos_type base) {
-    auto cur_pos = stream.tellp();
-    auto diff = cur_pos - base;
-    WriteDummyBytes(stream, RoundUpToMediaUnit(diff) - diff);
-}
-
-// Encode four characters as a (little-endian) uint32_t value
-static inline uint32_t MakeMagic(char a, char b, char c, char d) {
-    return a | b << 8 | c << 16 | d << 24;
-}
-
-const bool dump_standalone_exefs = false;
-const bool dump_standalone_romfs = false;
-const bool dump_full_image = true;
-const bool dump_fcram = false;
+private:
+    u32* buffer = nullptr;
+};
 
 int main(int argc, char **argv) {
     gfxInitDefault();
@@ -415,9 +193,23 @@ int main(int argc, char **argv) {
 
     std::cout << "Hi! Welcome to braindump <3" << std::endl << std::endl;
 
+    SocSession soc_session;
+    if (dump_to_network && !soc_session.Init()) {
+        std::cout << "Failed to initialize networking!" << std::endl;
+        return 1;
+    }
+
+    // The FS session is shared by all titles dumped
+    FSSession fs_session;
+    Result ret = fs_session.Open();
+    if (ret != 0) {
+        std::cout << "Couldn't open FS session: " << ResultToString(ret) << std::endl;
+        return 1;
+    }
+
     uint64_t title_id;
     uint8_t mediatype;
-    Result ret = GetTitleInformation(&mediatype, &title_id);
+    ret = GetTitleInformation(fs_session, &mediatype, &title_id);
     if (ret != 0) {
         // TODO: Error
         std::cout << "Failed to obtain information about the currently running title!" << std::endl;
@@ -437,174 +229,81 @@ int main(int argc, char **argv) {
             // TODO: Error
         }
 
-        std::ofstream out_file;
-        out_file.open(filename_ss.str() + "/fcram.bin", std::ios_base::binary | std::ios_base::out | std::ios_base::trunc);
-        std::cout << "Dumping FCRAM to \"" << filename_ss.str() << "/fcram.bin\"" << std::endl;
-
-        uint8_t* buf = (uint8_t*)linearAlloc(0x10000);
-        for (uint8_t* src = (uint8_t*)0x14000000; src < (uint8_t*)(0x14000000 + 0x06800000); src += 0x10000) {
-            GSPGPU_FlushDataCache(src, 0x10000);
-            Result res = GX_TextureCopy((u32*)src, 0x0, (u32*)buf, 0x0, 0x10000, 8);
-            if (res != 0)
-                std::cout << "ERROR!" << std::endl;
-            gspWaitForPPF();
-            GSPGPU_InvalidateDataCache((void*)buf, 0x10000);
-            std::cout << "\rDumping FCRAM: " << std::hex << (u32)src << " " << std::hex << (u32)buf << std::dec << std::flush;
-
-            out_file.write((char*)buf, 0x10000);
-        }
-        linearFree((void*)buf);
-    }
-
-    // Dump ExeFS to its own file
-    if (dump_standalone_exefs) {
-        int ret2 = mkdir(filename_ss.str().c_str(), 0755);
-        if (ret2 != 0 && ret2 != EEXIST) {
-            // TODO: Error
-        }
-
-        std::cout << "Dumping ExeFS to \"" << filename_ss.str() << "/exefs.bin\"" << std::endl;
-        std::cout << "Please be patient, this may take a few minutes!" << std::endl;
-        std::ofstream out_file;
-        out_file.open(filename_ss.str() + "/exefs.bin", std::ios_base::binary | std::ios_base::out | std::ios_base::trunc);
-        success &= (0 != DumpExeFS(out_file, title_id, mediatype));
-        std::cout << " done!" << std::endl;
-    }
-
-    // Dump RomFS to its own file
-    if (dump_standalone_romfs) {
-        int ret2 = mkdir(filename_ss.str().c_str(), 0755);
-        if (ret2 != 0 && ret2 != EEXIST) {
-            // TODO: Error
-        }
-
-        std::cout << "Dumping RomFS to \"" << filename_ss.str() << "/romfs.bin\"" << std::endl;
-        std::ofstream out_file;
-        out_file.open(filename_ss.str() + "/romfs.bin", std::ios_base::binary | std::ios_base::out | std::ios_base::trunc);
-        success &= DumpRomFS(out_file, title_id, mediatype);
-        std::cout << " done!" << std::endl;
+        // Only regions mapped into our address space are copied; the rest of fcram.bin is left as a hole.
+        // fcram.regions lists which parts of the file contain actual data.
+        const uint32_t fcram_begin = 0x14000000;
+        const uint32_t fcram_end = fcram_begin + 0x06800000;
+        uint64_t existing_size;
+        auto output = OpenOutput(filename_ss.str() + "/fcram.bin", false, &existing_size);
+        SparseOutputFile sparse_output(*output);
+
+        GXDmaBackend dma;
+        DumpProgress progress;
+        ProgressDisplay progress_display(progress, std::cout, nullptr);
+        progress_display.Start();
+        auto result = DumpFcram(dma, fcram_begin, fcram_end, sparse_output, FcramDumpConfig{}, &progress);
+        progress_display.Stop();
+
+        if (result.transfer_failed)
+            std::cout << "Error while copying FCRAM" << std::endl;
+        if (result.write_failed)
+            std::cout << "Error while writing output... is your SD card full?" << std::endl;
+        if (!WriteRegionIndex(filename_ss.str() + "/fcram.regions", result.regions))
+            std::cout << "Couldn't write \"" << filename_ss.str() << "/fcram.regions\"" << std::endl;
+        std::cout << "Copied " << result.regions.size() << " regions (" << result.bytes_copied / 1024 << " KiB)" << std::endl;
+        success &= result.Succeeded();
     }
 
-    // Dump a full NCCH of the current target title
-    if (dump_full_image) {
-        std::ofstream out_file;
-        out_file.open(filename_ss.str() + ".cxi", std::ios_base::binary | std::ios_base::out | std::ios_base::trunc);
-        std::cout << "Dumping title to \"" << filename_ss.str() << ".cxi\"" << std::endl;
-
-        // Write placeholder headers to be filled later
-        auto ncch_pos = out_file.tellp();
-        WriteDummyBytes(out_file, sizeof(NCCH_Header));
-
-        auto exheader_pos = out_file.tellp();
-        WriteDummyBytes(out_file, sizeof(ExHeader_Header));
-
-        PadToNextMediaUnit(out_file, ncch_pos);
-
-        // Dump ExeFS and RomFS first (since their sizes are needed to generate the ExHeader)
-        std::cout << "Dumping ExeFS..." << std::endl;
-        std::cout << "Please be patient, this may take a few minutes!" << std::endl;
-        auto exefs_pos = out_file.tellp();
-        auto decompressed_code_size = DumpExeFS(out_file, title_id, mediatype);
-        success &= (0 != decompressed_code_size);
-        auto exefs_end = out_file.tellp();
-        std::cout << " done!" << std::endl;
-        PadToNextMediaUnit(out_file, ncch_pos);
-
-        std::cout << "Dumping RomFS..." << std::flush;
-        auto romfs_pos = out_file.tellp();
-        success &= (0 != DumpRomFS(out_file, title_id, mediatype));
-        auto romfs_end = out_file.tellp();
-        std::cout << " done!" << std::endl;
-        PadToNextMediaUnit(out_file, ncch_pos);
-
-        auto ncch_end = out_file.tellp();
-
-        // Generate a fake ExHeader:
-        // There is (or rather, seems to be) no way to access the actual ExHeader,
-        // so we just craft a reasonable "fake" one here based on the metadata
-        // that we *can* access and some heuristics.
-        //
-        // TODO: The SMDH (i.e. "ExeFS/icon") provides useful information with regards to the application name and other stuff!
-        // TODO: We might get the product code of the current title using AM:GetTitleProductCode
-        // TODO: Other potentially useful service calls: PM_GetTitleExheaderFlags, APT:GetAppletInfo, APT:GetProgramInfo
-
-        ExHeader_Header exheader;
-        memset(&exheader, 0, sizeof(exheader));
-
-        // Program segment information:
-        // - Assume text starts at 0x00100000
-        // - Assume text is followed by ro
-        // - Assume ro is followed by data
-        // - Assume bss size is the difference between the total size of the text/ro/data segments and the size of the decompressed .code data
-        // - Assume old application stack is still queryable at 0x0FFFFFFC
-        // TODO: bss size is still off by a few bytes. This could be resolved by parsing the code binary (which always (?) starts with a bl to bss_clear for official content).
-        auto& codeset = exheader.codeset_info;
-        const unsigned page_size = 0x1000;
-        // codeset.name = TODO; // e.g. "CubicNin"
-        codeset.flags.flag = 1; // bit0: CompressExefsCode
-        codeset.text.address = 0x00100000;
-        codeset.text.code_size = GetRegionSize(codeset.text.address);
-        codeset.text.num_max_pages = RoundUpToPageSize(codeset.text.code_size) / page_size;
-        codeset.ro.address = codeset.text.address + codeset.text.num_max_pages * page_size;
-        codeset.ro.code_size = GetRegionSize(codeset.ro.address);
-        codeset.ro.num_max_pages = RoundUpToPageSize(codeset.ro.code_size) / page_size;
-        codeset.data.address = codeset.ro.address + codeset.ro.num_max_pages * page_size;
-
-        uint32_t data_and_bss_size = GetRegionSize(codeset.data.address);
-        codeset.bss_size = codeset.text.code_size + codeset.ro.code_size + data_and_bss_size - decompressed_code_size;
-
-        codeset.data.code_size = data_and_bss_size - codeset.bss_size;
-        codeset.data.num_max_pages = RoundUpToPageSize(codeset.data.code_size) / page_size;
-        codeset.stack_size = GetRegionSize(0x0FFFFFFC);
-
-        exheader.arm11_system_local_caps.program_id = title_id;
-
-        // Initialize ARM11 kernel capabilities to "unused" by default, then fill selected array members
-        auto& arm11_caps_descriptor = exheader.arm11_kernel_caps.descriptors;
-        std::fill(std::begin(arm11_caps_descriptor),
-                  std::end(arm11_caps_descriptor),
-                  0xFFFFFFFF);
-
-        // SVCs: Grant full access to everything \o/
-        for (unsigned svc_table_index = 0; svc_table_index < 7; ++svc_table_index) {
-            const uint32_t all_svcs = 0xffffff;
-            arm11_caps_descriptor[svc_table_index] = (0b11110 << 27) | (svc_table_index << 24) | all_svcs;
-        }
-
-        // Write fake ExHeader to file
-        out_file.seekp(exheader_pos);
-        out_file.write((char*)&exheader, sizeof(exheader));
-
-
-        // Generate a fake NCCH header, since
-        // - we cannot get the actual NCCH header
-        // - the actual NCCH header usually refers to the encrypted data anyway, while we store unencrypted data.
-        NCCH_Header header;
-        memset(&header, 0, sizeof(header));
-
-        header.magic = MakeMagic('N', 'C', 'C', 'H');
-        header.version = 2;
-        header.program_id = title_id;
-
-        // TODO: If possible, detect New3DS-only titles and set the proper flag here
-        header.flags.content_platform = NCCHContentPlatform::Old3DS;
-        header.flags.content_type = NCCHContentType::Data | NCCHContentType::Executable;
-        header.flags.crypto = NCCHCrypto::NoCrypto;
-
-        header.extended_header_size = sizeof(exheader) - sizeof(exheader.access_desc);
-
-        header.exefs_offset = BytesToMediaUnits(exefs_pos - ncch_pos);
-        header.exefs_size = BytesToMediaUnits(exefs_end - exefs_pos);
-
-        header.romfs_offset = BytesToMediaUnits(romfs_pos - ncch_pos);
-        header.romfs_size = BytesToMediaUnits(romfs_end - romfs_pos);
-
-        header.content_size = BytesToMediaUnits(ncch_end - ncch_pos);
-
-        // Write fake NCCH header
-        out_file.seekp(ncch_pos);
-        out_file.write((char*)&header, sizeof(header));
+    // Dump the title contents, either of the running title or of all titles listed in the batch queue
+    std::vector<BatchEntry> queue;
+    const bool batch_mode = ReadBatchQueue(batch_queue_path, &queue) && !queue.empty();
+    if (!batch_mode)
+        queue.push_back(BatchEntry{ title_id, mediatype });
+    else
+        std::cout << "Dumping " << queue.size() << " titles listed in " << batch_queue_path << std::endl;
+    std::cout << "Please be patient, this may take a few minutes!" << std::endl;
+
+    // Dump buffers are reserved once from linear memory, which keeps the heap from fragmenting across titles
+    DumpArena arena;
+    if (!arena.Reserve(TitleDumper::arena_size, true))
+        std::cout << "Couldn't reserve " << TitleDumper::arena_size / 1024 << " KiB of linear memory, using the heap instead" << std::endl;
+
+    DumpEnvironment environment;
+    environment.open_output = OpenOutput;
+    environment.arena = arena.Capacity() ? &arena : nullptr;
+    if (!dump_to_network) {
+        environment.open_input = [](const std::string& path) {
+            std::unique_ptr<StdioArchiveFile> input(new StdioArchiveFile);
+            if (!input->Open(path))
+                input.reset();
+            return std::unique_ptr<ArchiveFile>(std::move(input));
+        };
+        environment.make_directory = [](const std::string& path) {
+            int ret2 = mkdir(path.c_str(), 0755);
+            if (ret2 != 0 && ret2 != EEXIST) {
+                // TODO: Error
+            }
+        };
     }
+    environment.console = &std::cout;
+
+    auto results = [&] {
+        TitleDumper dumper(GetDumpOptions(), environment);
+        auto open_title = [&](const BatchEntry& entry) {
+            return std::unique_ptr<TitleArchive>(new FSTitleArchive(entry.title_id, entry.media_type, entry.title_id == title_id, &fs_session));
+        };
+        auto prepare_request = [&](TitleDumpRequest& request) {
+            // The code set layout can only be inspected for the title we're running as
+            if (request.title_id == title_id)
+                request.query_region_size = GetRegionSize;
+        };
+        return RunBatch(dumper, queue, "sdmc:", open_title, prepare_request, &std::cout);
+    }();
+
+    for (auto& result : results)
+        success &= result.result.success;
+    if (batch_mode && !WriteBatchReport(batch_report_path, results))
+        std::cout << "Couldn't write " << batch_report_path << std::endl;
 
     if (success)
         std::cout << std::endl << "Done! Thanks for being awesome!" << std::endl << "Press Start to exit." << std::endl;
@@ -9,6 +9,7 @@
 using u8 = uint8_t;
 using u16 = uint16_t;
 using u32 = uint32_t;
+using u64 = uint64_t;
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////
 /// NCCH header (Note: "NCCH" appears to be a publically unknown acronym)
@@ -27,7 +28,7 @@ enum class NCCHContentType : u8 {
 };
 
 inline NCCHContentType operator|(NCCHContentType a, NCCHContentType b) {
-    return static_cast<NCCHContentType>(static_cast<uint8_t>(a) | static_cast<uint8_t>(b));
+    return static_cast<NCCHContentType>(static_cast<u8>(a) | static_cast<u8>(b));
 }
 
 enum class NCCHCrypto : u8 {
@@ -45,7 +46,7 @@ struct NCCH_Header {
     u16 maker_code;
     u16 version;
     u8 reserved_0[4];
-    uint64_t program_id;
+    u64 program_id;
     u8 reserved_1[0x10];
     u8 logo_region_hash[0x20];
     u8 product_code[0x10];
@@ -139,7 +140,7 @@ struct ExHeader_StorageInfo {
 };
 
 struct ExHeader_ARM11_SystemLocalCaps {
-    uint64_t program_id;
+    u64 program_id;
     u32 core_version;
     u8 reserved_flags[2];
     u8 flags0;
@@ -181,17 +182,91 @@ struct ExHeader_Header {
 static_assert(sizeof(ExHeader_Header) == 0x800, "ExHeader structure size is wrong");
 
 
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// RomFS level 3 (the actual file system, located after the IVFC superblock)
+
 struct RomFSHeader {
     u8 magic[4];
 };
 
+// Level 3 header. Offsets are relative to the beginning of the level 3 data.
 struct RomFSInfoHeader {
-    u8 headersize[4];
+    u32 headersize;
     struct RomFSSectionHeader
     {
-        u8 offset[4];
-        u8 size[4];
-    } section[4];
+        u32 offset;
+        u32 size;
+    } section[4]; // Indexed by RomFSSection
 
-    u8 dataoffset[4];
+    u32 dataoffset; // Offset of the file data
 }; // at offset 0x1000
+
+static_assert(sizeof(RomFSInfoHeader) == 0x28, "RomFS level 3 header structure size is wrong");
+
+enum RomFSSection : u32 {
+    DirectoryHashTable = 0, // Offsets of the first directory metadata entry in each hash bucket
+    DirectoryMetadata = 1,
+    FileHashTable = 2,      // Offsets of the first file metadata entry in each hash bucket
+    FileMetadata = 3,
+};
+
+// Used in metadata entries and hash tables to mark the absence of an entry
+const u32 romfs_invalid_offset = 0xFFFFFFFF;
+
+// Directory metadata entry, followed by the directory name (UTF-16, padded to a multiple of 4 bytes).
+// Offsets of other entries are relative to the beginning of the directory metadata section.
+// The root directory is at offset 0 and has an empty name.
+struct RomFS_DirectoryMetadata {
+    u32 parent_offset;
+    u32 next_sibling_offset;
+    u32 first_child_offset;
+    u32 first_file_offset;
+    u32 next_in_bucket_offset; // Next entry in the same hash table bucket
+    u32 name_size;             // In bytes
+};
+
+static_assert(sizeof(RomFS_DirectoryMetadata) == 0x18, "RomFS directory metadata structure size is wrong");
+
+// File metadata entry, followed by the file name (UTF-16, padded to a multiple of 4 bytes).
+// Entries are only 4-byte aligned, hence this structure is packed.
+struct RomFS_FileMetadata {
+    u32 parent_offset;         // Relative to the directory metadata section
+    u32 next_sibling_offset;   // Relative to the file metadata section, as are the following offsets
+    u64 data_offset;           // Relative to RomFSInfoHeader::dataoffset
+    u64 data_size;
+    u32 next_in_bucket_offset;
+    u32 name_size;             // In bytes
+} __attribute__((packed));
+
+static_assert(sizeof(RomFS_FileMetadata) == 0x20, "RomFS file metadata structure size is wrong");
+
+// Hash of an entry name, used to pick its hash table bucket (modulo the number of buckets)
+inline u32 RomFSPathHash(u32 parent_offset, const u16* name, u32 name_length) {
+    u32 hash = parent_offset ^ 123456789;
+    for (u32 index = 0; index < name_length; ++index) {
+        hash = (hash >> 5) | (hash << 27);
+        hash ^= name[index];
+    }
+    return hash;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////
+// IVFC (RomFS hash tree) header
+
+struct RomFS_IVFCLevelHeader {
+    u64 logical_offset;
+    u64 hash_data_size;
+    u32 block_size_log2;
+    u8 reserved[4];
+} __attribute__((packed));
+
+struct RomFS_IVFCHeader {
+    u32 magic;
+    u32 magic_number;
+    u32 master_hash_size;
+    RomFS_IVFCLevelHeader levels[3];
+    u8 reserved[4];
+    u32 optional_info_size;
+} __attribute__((packed));
+
+static_assert(sizeof(RomFS_IVFCHeader) == 0x5C, "IVFC header structure size is wrong");
@@ -0,0 +1,197 @@
+#include <algorithm>
+#include <cstring>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "output_file.h"
+
+StdioOutputFile::~StdioOutputFile() {
+    Close();
+}
+
+bool StdioOutputFile::Open(const std::string& path, bool keep_contents) {
+    Close();
+
+    if (keep_contents)
+        file = fopen(path.c_str(), "r+b");
+    if (file == nullptr)
+        file = fopen(path.c_str(), "wb");
+    if (file == nullptr)
+        return false;
+
+    setvbuf(file, nullptr, _IONBF, 0);
+    position = 0;
+    return true;
+}
+
+void StdioOutputFile::Close() {
+    if (file == nullptr)
+        return;
+
+    fclose(file);
+    file = nullptr;
+}
+
+bool StdioOutputFile::WriteAt(uint64_t offset, const void* data, size_t size) {
+    if (file == nullptr)
+        return false;
+
+    if (offset != position) {
+        if (fseeko(file, offset, SEEK_SET) != 0)
+            return false;
+        position = offset;
+    }
+
+    size_t written = fwrite(data, 1, size, file);
+    position += written;
+    return written == size;
+}
+
+bool StdioOutputFile::Flush() {
+    return file != nullptr && fflush(file) == 0;
+}
+
+uint64_t StdioOutputFile::GetSize() const {
+    struct stat st;
+    if (file == nullptr || fstat(fileno(file), &st) != 0)
+        return 0;
+    return st.st_size;
+}
+
+bool StdioOutputFile::SetSize(uint64_t size) {
+    if (file == nullptr || fflush(file) != 0)
+        return false;
+    return ftruncate(fileno(file), size) == 0;
+}
+
+size_t TeeOutputFile::AddRoute(OutputFile& file, uint64_t begin, uint64_t end) {
+    routes.push_back(Route{ &file, begin, end });
+    return routes.size() - 1;
+}
+
+void TeeOutputFile::EndRoute(size_t route, uint64_t end) {
+    routes[route].end = end;
+}
+
+bool TeeOutputFile::WriteAt(uint64_t offset, const void* data, size_t size) {
+    bool success = true;
+    for (auto& route : routes) {
+        uint64_t begin = std::max(offset, route.begin);
+        uint64_t end = std::min(offset + size, route.end);
+        if (begin >= end)
+            continue;
+
+        success &= route.file->WriteAt(begin - route.begin, static_cast<const uint8_t*>(data) + (begin - offset), end - begin);
+    }
+    return success;
+}
+
+bool TeeOutputFile::Flush() {
+    bool success = true;
+    for (auto& route : routes)
+        success &= route.file->Flush();
+    return success;
+}
+
+SparseOutputFile::SparseOutputFile(OutputFile& file, uint64_t zero_from)
+    : file(file), skip_zeros(file.ZeroFillsGaps()), zero_from(zero_from), file_size(zero_from) {
+}
+
+// Check whether the given block consists of zeros only. This is scanned a word at a time,
+// which is the best the ARM11 can do.
+static bool IsZeroBlock(const uint8_t* data, size_t size) {
+    uint32_t accum = 0;
+    for (size_t i = 0; i < size; i += 4 * sizeof(uint32_t)) {
+        uint32_t words[4];
+        memcpy(words, data + i, sizeof(words));
+        accum |= words[0] | words[1] | words[2] | words[3];
+        if (accum != 0)
+            return false;
+    }
+    return true;
+}
+
+bool SparseOutputFile::WriteRun(uint64_t offset, const uint8_t* data, size_t size) {
+    if (size == 0)
+        return true;
+
+    written_bytes += size;
+    file_size = std::max(file_size, offset + size);
+    return file.WriteAt(offset, data, size);
+}
+
+bool SparseOutputFile::WriteZeros(uint64_t begin, uint64_t end) {
+    static const uint8_t zeros[block_size] = {};
+    bool success = true;
+    for (uint64_t pos = begin; pos < end; pos += block_size)
+        success &= WriteRun(pos, zeros, std::min<uint64_t>(block_size, end - pos));
+    return success;
+}
+
+bool SparseOutputFile::WriteAt(uint64_t offset, const void* data, size_t size) {
+    auto bytes = static_cast<const uint8_t*>(data);
+    uint64_t end = offset + size;
+    bool success = true;
+
+    if (!skip_zeros) {
+        // The underlying file may leave stale data in gaps, so they are filled in first
+        if (offset > file_size)
+            success &= WriteZeros(file_size, offset);
+        success &= WriteRun(offset, bytes, size);
+        zero_from = std::max(zero_from, end);
+        logical_size = std::max(logical_size, end);
+        return success;
+    }
+
+    // Blocks are only skipped in the known-zero region; everything before is written as-is
+    uint64_t pos = offset;
+    uint64_t run_begin = offset;
+    if (pos < zero_from)
+        pos = std::min(end, zero_from);
+    pos = std::min(end, (pos + block_size - 1) / block_size * block_size);
+
+    while (pos + block_size <= end) {
+        if (!IsZeroBlock(bytes + (pos - offset), block_size)) {
+            pos += block_size;
+            continue;
+        }
+
+        success &= WriteRun(run_begin, bytes + (run_begin - offset), pos - run_begin);
+        skipped_bytes += block_size;
+        pos += block_size;
+        run_begin = pos;
+    }
+    success &= WriteRun(run_begin, bytes + (run_begin - offset), end - run_begin);
+
+    // Data written now can't be assumed to be zero anymore
+    zero_from = std::max(zero_from, end);
+    logical_size = std::max(logical_size, end);
+    return success;
+}
+
+bool SparseOutputFile::Flush() {
+    bool success = true;
+    if (logical_size > file_size) {
+        success &= skip_zeros ? file.SetSize(logical_size) : WriteZeros(file_size, logical_size);
+        file_size = logical_size;
+    }
+    success &= file.Flush();
+    return success;
+}
+
+bool SparseOutputFile::SetSize(uint64_t size) {
+    file_size = logical_size = size;
+    zero_from = std::min(zero_from, size);
+    return file.SetSize(size);
+}
+
+bool SparseOutputFile::Preallocate(uint64_t size) {
+    if (!file.Preallocate(size))
+        return false;
+
+    // Reserved space that isn't zero-filled still counts as a gap, to be filled in if the writer skips over it
+    if (skip_zeros)
+        file_size = std::max(file_size, size);
+    return true;
+}
@@ -0,0 +1,165 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <limits>
+#include <string>
+#include <vector>
+
+// Random-access file that dump data is written to.
+// Writes are issued through an OutputSink, which takes care of buffering.
+class OutputFile {
+public:
+    virtual ~OutputFile() = default;
+
+    // Write "size" bytes at the given file offset. Returns false on error.
+    virtual bool WriteAt(uint64_t offset, const void* data, size_t size) = 0;
+
+    // Commit any data buffered by the backend. Returns false on error.
+    virtual bool Flush() {
+        return true;
+    }
+
+    // Change the file size, extending it with zeros if necessary. Returns false on error or if unsupported.
+    virtual bool SetSize(uint64_t size) {
+        return false;
+    }
+
+    // Reserve space for the file to grow to "size" bytes, such that the file system allocates it in one go rather
+    // than cluster by cluster as data is written. The file size may become "size" as a result. Returns false on
+    // error or if unsupported.
+    virtual bool Preallocate(uint64_t size) {
+        return false;
+    }
+
+    // Whether space the file grows by without being written to is guaranteed to read back as zeros. This covers
+    // gaps left by writing past the end of the file, space added by SetSize, and space reserved by Preallocate.
+    virtual bool ZeroFillsGaps() const {
+        return false;
+    }
+};
+
+// OutputFile backed by a C stdio stream. This works both with newlib's sdmc: devoptab and on the host.
+// Buffering is disabled, since OutputSink already stages data in large blocks.
+class StdioOutputFile : public OutputFile {
+public:
+    StdioOutputFile() = default;
+    ~StdioOutputFile() override;
+
+    StdioOutputFile(const StdioOutputFile&) = delete;
+    StdioOutputFile& operator=(const StdioOutputFile&) = delete;
+
+    // Open the file at "path" for writing. The file is created if it doesn't exist.
+    // Existing contents are discarded unless "keep_contents" is set.
+    bool Open(const std::string& path, bool keep_contents = false);
+    void Close();
+
+    bool IsOpen() const {
+        return file != nullptr;
+    }
+
+    // Current size of the file on disk
+    uint64_t GetSize() const;
+
+    bool WriteAt(uint64_t offset, const void* data, size_t size) override;
+    bool Flush() override;
+    bool SetSize(uint64_t size) override;
+
+    // POSIX guarantees gaps to read back as zeros. Through the sdmc: devoptab, files grow by FSFILE_SetSize, which
+    // leaves whatever the SD card held before in the added clusters.
+    bool ZeroFillsGaps() const override {
+#ifdef _3DS
+        return false;
+#else
+        return true;
+#endif
+    }
+
+private:
+    FILE* file = nullptr;
+    uint64_t position = 0; // Current position of the stdio stream, used to skip redundant seeks
+};
+
+// OutputFile that fans out writes to several files, each receiving a window of the written data.
+// This allows producing several artifacts (e.g. a full NCCH image and a standalone RomFS image)
+// from a single pass over the title contents.
+class TeeOutputFile : public OutputFile {
+public:
+    static const uint64_t open_end = std::numeric_limits<uint64_t>::max();
+
+    // Forward data written to [begin, end) to "file", with offsets translated such that "begin" maps to offset 0.
+    // Returns an identifier for the route that can be passed to EndRoute.
+    size_t AddRoute(OutputFile& file, uint64_t begin, uint64_t end = open_end);
+
+    // Set the end of a route added with an open end
+    void EndRoute(size_t route, uint64_t end);
+
+    bool WriteAt(uint64_t offset, const void* data, size_t size) override;
+    bool Flush() override;
+
+private:
+    struct Route {
+        OutputFile* file;
+        uint64_t begin;
+        uint64_t end;
+    };
+
+    std::vector<Route> routes;
+};
+
+// OutputFile that skips writing blocks consisting only of zeros, seeking past them instead.
+// Most RomFS images contain long runs of zero padding, and pushing those through the SD card
+// write path is a waste of time. On filesystems supporting it, the skipped blocks become holes.
+//
+// Skipping is only valid for blocks that are known to read back as zeros, i.e. blocks past the
+// original end of the file that haven't been written before. Zero blocks that overwrite earlier
+// data (e.g. header patches, or regions rewritten when resuming a dump) are written as usual.
+// If the underlying file doesn't zero-fill gaps, nothing is skipped, and any gaps left by the
+// writer are filled with zeros explicitly.
+class SparseOutputFile : public OutputFile {
+public:
+    // Granularity of the zero block detection. Only blocks aligned to this size are skipped.
+    static const uint32_t block_size = 0x1000;
+
+    // "zero_from" is the offset from which the file is known to contain only zeros (i.e. its current size)
+    SparseOutputFile(OutputFile& file, uint64_t zero_from = 0);
+
+    // Number of zero bytes that were skipped rather than written
+    uint64_t SkippedBytes() const {
+        return skipped_bytes;
+    }
+
+    // Number of bytes passed on to the underlying file
+    uint64_t WrittenBytes() const {
+        return written_bytes;
+    }
+
+    bool WriteAt(uint64_t offset, const void* data, size_t size) override;
+
+    // Flushes the underlying file and extends it over any trailing zero blocks
+    bool Flush() override;
+
+    bool SetSize(uint64_t size) override;
+
+    // If the underlying file doesn't zero-fill the reserved space, zero blocks aren't skipped and gaps are filled in,
+    // so any stale data in it gets overwritten as the file is written.
+    bool Preallocate(uint64_t size) override;
+
+    bool ZeroFillsGaps() const override {
+        return true;
+    }
+
+private:
+    bool WriteRun(uint64_t offset, const uint8_t* data, size_t size);
+    bool WriteZeros(uint64_t begin, uint64_t end);
+
+    OutputFile& file;
+    const bool skip_zeros; // Whether zero blocks may be left to the underlying file to fill in
+
+    uint64_t zero_from;   // All data from this offset on is known to be zero
+    uint64_t file_size;   // Size of the underlying file, taking into account writes issued so far
+    uint64_t logical_size = 0; // Size of the file as seen by the writer, including skipped blocks
+
+    uint64_t skipped_bytes = 0;
+    uint64_t written_bytes = 0;
+};
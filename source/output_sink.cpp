@@ -0,0 +1,116 @@
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+#include "output_sink.h"
+
+OutputSink::OutputSink(OutputFile& file, size_t buffer_size)
+    : file(file), buffer_storage(new uint8_t[buffer_size + buffer_alignment - 1]), buffer_size(buffer_size) {
+    auto address = reinterpret_cast<uintptr_t>(buffer_storage.get());
+    buffer = buffer_storage.get() + ((buffer_alignment - address % buffer_alignment) % buffer_alignment);
+}
+
+OutputSink::OutputSink(OutputFile& file, uint8_t* buffer, size_t buffer_size)
+    : file(file), buffer(buffer), buffer_size(buffer_size) {
+    assert(reinterpret_cast<uintptr_t>(buffer) % buffer_alignment == 0);
+}
+
+OutputSink::~OutputSink() {
+    Flush();
+}
+
+bool OutputSink::FlushBuffer() {
+    if (buffer_fill != 0 && good)
+        good = file.WriteAt(buffer_offset, buffer, buffer_fill);
+
+    buffer_offset += buffer_fill;
+    buffer_fill = 0;
+    return good;
+}
+
+bool OutputSink::Write(const void* data, size_t size) {
+    auto bytes = static_cast<const uint8_t*>(data);
+
+    // Top up the staging buffer first
+    if (buffer_fill != 0) {
+        size_t chunk = std::min(size, buffer_size - buffer_fill);
+        memcpy(buffer + buffer_fill, bytes, chunk);
+        buffer_fill += chunk;
+        bytes += chunk;
+        size -= chunk;
+
+        if (buffer_fill == buffer_size)
+            FlushBuffer();
+    }
+
+    // Hand whole blocks to the file directly rather than copying them
+    if (size >= buffer_size) {
+        size_t direct_size = size - size % buffer_size;
+        if (good)
+            good = file.WriteAt(buffer_offset, bytes, direct_size);
+        buffer_offset += direct_size;
+        bytes += direct_size;
+        size -= direct_size;
+    }
+
+    // Stage the remainder
+    memcpy(buffer + buffer_fill, bytes, size);
+    buffer_fill += size;
+
+    return good;
+}
+
+bool OutputSink::FillZero(uint64_t size) {
+    while (size != 0) {
+        size_t chunk = std::min<uint64_t>(size, buffer_size - buffer_fill);
+        memset(buffer + buffer_fill, 0, chunk);
+        buffer_fill += chunk;
+        size -= chunk;
+
+        if (buffer_fill == buffer_size)
+            FlushBuffer();
+    }
+
+    return good;
+}
+
+bool OutputSink::PadTo(uint64_t alignment, uint64_t base) {
+    uint64_t misalignment = (Tell() - base) % alignment;
+    if (misalignment == 0)
+        return good;
+
+    return FillZero(alignment - misalignment);
+}
+
+bool OutputSink::Patch(uint64_t offset, const void* data, size_t size) {
+    assert(offset + size <= Tell());
+    auto bytes = static_cast<const uint8_t*>(data);
+
+    // Part of the patch that has already been handed to the file
+    if (offset < buffer_offset) {
+        size_t flushed_size = std::min<uint64_t>(size, buffer_offset - offset);
+        if (good)
+            good = file.WriteAt(offset, bytes, flushed_size);
+        offset += flushed_size;
+        bytes += flushed_size;
+        size -= flushed_size;
+    }
+
+    // Part of the patch that is still staged
+    memcpy(buffer + (offset - buffer_offset), bytes, size);
+
+    return good;
+}
+
+bool OutputSink::Flush() {
+    FlushBuffer();
+    if (good)
+        good = file.Flush();
+    return good;
+}
+
+bool OutputSink::Seek(uint64_t offset) {
+    FlushBuffer();
+    buffer_offset = offset;
+    return good;
+}
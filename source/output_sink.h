@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+
+#include "output_file.h"
+
+// Buffered, sequential writer on top of an OutputFile.
+//
+// Data is staged in a large aligned buffer and handed to the file in blocks, so that writing
+// small pieces of data (headers, padding) doesn't cause one file system request each. Data
+// that was written before can be overwritten using Patch, e.g. to fill in headers at the end.
+class OutputSink {
+public:
+    static const size_t default_buffer_size = 0x40000;
+    static const size_t buffer_alignment = 0x1000;
+
+    explicit OutputSink(OutputFile& file, size_t buffer_size = default_buffer_size);
+
+    // Stage data in "buffer" instead of allocating a new buffer, e.g. to reuse it across several dumps.
+    // "buffer" must be aligned to buffer_alignment and outlive the sink.
+    OutputSink(OutputFile& file, uint8_t* buffer, size_t buffer_size);
+    ~OutputSink();
+
+    OutputSink(const OutputSink&) = delete;
+    OutputSink& operator=(const OutputSink&) = delete;
+
+    // Current write position, i.e. the total number of bytes written so far
+    uint64_t Tell() const {
+        return buffer_offset + buffer_fill;
+    }
+
+    // Returns false if any write to the underlying file has failed so far
+    bool Good() const {
+        return good;
+    }
+
+    bool Write(const void* data, size_t size);
+
+    // Append "size" zero bytes
+    bool FillZero(uint64_t size);
+
+    // Append zero bytes until the offset relative to "base" is a multiple of "alignment"
+    bool PadTo(uint64_t alignment, uint64_t base = 0);
+
+    // Overwrite previously written data at the given offset
+    bool Patch(uint64_t offset, const void* data, size_t size);
+
+    // Write all staged data to the file
+    bool Flush();
+
+    // Flush staged data and continue writing at the given offset.
+    // Used to skip over data that is already present in the file, e.g. when resuming a dump.
+    bool Seek(uint64_t offset);
+
+private:
+    bool FlushBuffer();
+
+    OutputFile& file;
+
+    std::unique_ptr<uint8_t[]> buffer_storage;
+    uint8_t* buffer; // buffer_storage aligned to buffer_alignment
+    size_t buffer_size;
+
+    uint64_t buffer_offset = 0; // File offset corresponding to the beginning of the buffer
+    size_t buffer_fill = 0;
+
+    bool good = true;
+};
@@ -0,0 +1,162 @@
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+
+#include "perf_telemetry.h"
+
+PerfTelemetry::PerfTelemetry() : start(GetTicks()) {
+}
+
+void PerfTelemetry::RecordOperation(Operation operation, uint64_t begin, uint64_t bytes) {
+    uint64_t end = GetTicks();
+    uint64_t ticks = end - begin;
+    uint64_t microseconds = ticks * 1000000 / ticks_per_second;
+
+    unsigned bucket = 0;
+    while (bucket + 1 < num_histogram_buckets && (microseconds >> (bucket + 1)) != 0)
+        ++bucket;
+
+    uint64_t second = (end - start) / ticks_per_second;
+
+    ScopedLock lock(mutex);
+    auto& stats = operations[static_cast<unsigned>(operation)];
+    ++stats.count;
+    stats.bytes += bytes;
+    stats.total_ticks += ticks;
+    stats.max_ticks = std::max(stats.max_ticks, ticks);
+    ++stats.histogram[bucket];
+    if (stats.bytes_per_second.size() <= second)
+        stats.bytes_per_second.resize(second + 1);
+    stats.bytes_per_second[second] += bytes;
+}
+
+void PerfTelemetry::RecordPhase(const std::string& name, uint64_t begin, uint64_t bytes) {
+    uint64_t end = GetTicks();
+    ScopedLock lock(mutex);
+    phases.push_back(Phase{ name, begin - start, end - begin, bytes });
+}
+
+void PerfTelemetry::RecordStalls(const std::string& name, uint32_t count, uint64_t ticks) {
+    ScopedLock lock(mutex);
+    stalls.push_back(Stalls{ name, count, ticks });
+}
+
+uint64_t PerfTelemetry::TotalTicks(Operation operation) const {
+    ScopedLock lock(mutex);
+    return operations[static_cast<unsigned>(operation)].total_ticks;
+}
+
+static double TicksToSeconds(uint64_t ticks) {
+    return static_cast<double>(ticks) / ticks_per_second;
+}
+
+bool PerfTelemetry::WriteJson(const std::string& path, uint64_t title_id) const {
+    FILE* file = fopen(path.c_str(), "w");
+    if (file == nullptr)
+        return false;
+
+    static const char* const operation_names[] = { "card_read", "output_write", "console_output" };
+
+    ScopedLock lock(mutex);
+    fprintf(file, "{\n");
+    fprintf(file, "  \"title_id\": \"%016" PRIx64 "\",\n", title_id);
+    fprintf(file, "  \"duration_s\": %.6f,\n", TicksToSeconds(GetTicks() - start));
+
+    fprintf(file, "  \"phases\": [");
+    for (size_t i = 0; i < phases.size(); ++i) {
+        auto& phase = phases[i];
+        double seconds = TicksToSeconds(phase.ticks);
+        fprintf(file, "%s\n    { \"name\": \"%s\", \"start_s\": %.6f, \"duration_s\": %.6f, \"bytes\": %" PRIu64 ", \"mib_per_s\": %.3f }",
+                i ? "," : "", phase.name.c_str(), TicksToSeconds(phase.begin), seconds, phase.bytes,
+                seconds > 0 ? phase.bytes / (1024.0 * 1024.0) / seconds : 0.0);
+    }
+    fprintf(file, "\n  ],\n");
+
+    fprintf(file, "  \"operations\": {");
+    for (unsigned op = 0; op < static_cast<unsigned>(Operation::Count); ++op) {
+        auto& stats = operations[op];
+        fprintf(file, "%s\n    \"%s\": {\n", op ? "," : "", operation_names[op]);
+        fprintf(file, "      \"count\": %" PRIu64 ",\n", stats.count);
+        fprintf(file, "      \"bytes\": %" PRIu64 ",\n", stats.bytes);
+        fprintf(file, "      \"total_s\": %.6f,\n", TicksToSeconds(stats.total_ticks));
+        fprintf(file, "      \"max_us\": %.1f,\n", TicksToSeconds(stats.max_ticks) * 1e6);
+
+        // Histogram bucket i counts latencies below 2^(i+1) us; trailing empty buckets are omitted
+        unsigned num_buckets = num_histogram_buckets;
+        while (num_buckets > 0 && stats.histogram[num_buckets - 1] == 0)
+            --num_buckets;
+        fprintf(file, "      \"latency_histogram_log2_us\": [");
+        for (unsigned bucket = 0; bucket < num_buckets; ++bucket)
+            fprintf(file, "%s%" PRIu64, bucket ? ", " : "", stats.histogram[bucket]);
+        fprintf(file, "],\n");
+
+        fprintf(file, "      \"bytes_per_second\": [");
+        for (size_t second = 0; second < stats.bytes_per_second.size(); ++second)
+            fprintf(file, "%s%" PRIu64, second ? ", " : "", stats.bytes_per_second[second]);
+        fprintf(file, "]\n    }");
+    }
+    fprintf(file, "\n  },\n");
+
+    fprintf(file, "  \"stalls\": [");
+    for (size_t i = 0; i < stalls.size(); ++i) {
+        fprintf(file, "%s\n    { \"name\": \"%s\", \"count\": %" PRIu32 ", \"total_s\": %.6f }",
+                i ? "," : "", stalls[i].name.c_str(), stalls[i].count, TicksToSeconds(stalls[i].ticks));
+    }
+    fprintf(file, "\n  ]\n");
+    fprintf(file, "}\n");
+
+    return fclose(file) == 0;
+}
+
+bool InstrumentedOutputFile::WriteAt(uint64_t offset, const void* data, size_t size) {
+    ScopedOperation operation(&perf, PerfTelemetry::Operation::OutputWrite, size);
+    return file.WriteAt(offset, data, size);
+}
+
+bool InstrumentedOutputFile::Flush() {
+    ScopedOperation operation(&perf, PerfTelemetry::Operation::OutputWrite);
+    return file.Flush();
+}
+
+bool InstrumentedOutputFile::SetSize(uint64_t size) {
+    return file.SetSize(size);
+}
+
+namespace {
+
+class InstrumentedArchiveFile : public ArchiveFile {
+public:
+    InstrumentedArchiveFile(std::unique_ptr<ArchiveFile> file, PerfTelemetry& perf) : file(std::move(file)), perf(perf) {
+    }
+
+    Result GetSize(uint64_t* size) override {
+        return file->GetSize(size);
+    }
+
+    Result Read(uint64_t offset, void* buffer, uint32_t size, uint32_t* bytes_read) override {
+        uint64_t begin = GetTicks();
+        Result ret = file->Read(offset, buffer, size, bytes_read);
+        perf.RecordOperation(PerfTelemetry::Operation::CardRead, begin, (ret == 0) ? *bytes_read : 0);
+        return ret;
+    }
+
+private:
+    std::unique_ptr<ArchiveFile> file;
+    PerfTelemetry& perf;
+};
+
+} // anonymous namespace
+
+Result InstrumentedTitleArchive::OpenExeFSSection(const std::string& name, std::unique_ptr<ArchiveFile>* file) {
+    Result ret = title.OpenExeFSSection(name, file);
+    if (ret == 0)
+        file->reset(new InstrumentedArchiveFile(std::move(*file), perf));
+    return ret;
+}
+
+Result InstrumentedTitleArchive::OpenRomFS(std::unique_ptr<ArchiveFile>* file) {
+    Result ret = title.OpenRomFS(file);
+    if (ret == 0)
+        file->reset(new InstrumentedArchiveFile(std::move(*file), perf));
+    return ret;
+}
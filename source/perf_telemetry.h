@@ -0,0 +1,128 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "archive_file.h"
+#include "output_file.h"
+#include "platform.h"
+#include "title_archive.h"
+
+// Collects timing information about a dump, to tell whether card reads, output writes or console
+// output are the limiting factor on a given unit. The results are written as a JSON document.
+//
+// All methods may be called from any thread.
+class PerfTelemetry {
+public:
+    enum class Operation {
+        CardRead,      // Reads from the title archive
+        OutputWrite,   // Writes to the output files (SD card or network)
+        ConsoleOutput, // Progress messages printed to the console
+        Count,
+    };
+
+    // Number of latency histogram buckets. Bucket i counts operations that took less than 2^(i+1) microseconds.
+    static const unsigned num_histogram_buckets = 24;
+
+    PerfTelemetry();
+
+    // Record an operation on "bytes" bytes that started at "begin" (a GetTicks timestamp) and just finished
+    void RecordOperation(Operation operation, uint64_t begin, uint64_t bytes);
+
+    // Record a phase of the dump (e.g. an ExeFS section) that started at "begin" and just finished
+    void RecordPhase(const std::string& name, uint64_t begin, uint64_t bytes);
+
+    // Record pipeline stalls (see PipelineStatus)
+    void RecordStalls(const std::string& name, uint32_t count, uint64_t ticks);
+
+    // Total time spent on the given operation so far, in GetTicks units
+    uint64_t TotalTicks(Operation operation) const;
+
+    bool WriteJson(const std::string& path, uint64_t title_id) const;
+
+private:
+    struct OperationStats {
+        uint64_t count = 0;
+        uint64_t bytes = 0;
+        uint64_t total_ticks = 0;
+        uint64_t max_ticks = 0;
+        uint64_t histogram[num_histogram_buckets] = {};
+        std::vector<uint64_t> bytes_per_second; // Bytes transferred during each second since the start of the dump
+    };
+
+    struct Phase {
+        std::string name;
+        uint64_t begin;
+        uint64_t ticks;
+        uint64_t bytes;
+    };
+
+    struct Stalls {
+        std::string name;
+        uint32_t count;
+        uint64_t ticks;
+    };
+
+    mutable Mutex mutex;
+    uint64_t start;
+    OperationStats operations[static_cast<unsigned>(Operation::Count)];
+    std::vector<Phase> phases;
+    std::vector<Stalls> stalls;
+};
+
+// Measures the time from its construction to its destruction as an operation
+class ScopedOperation {
+public:
+    ScopedOperation(PerfTelemetry* perf, PerfTelemetry::Operation operation, uint64_t bytes = 0)
+        : perf(perf), operation(operation), bytes(bytes), begin(perf ? GetTicks() : 0) {
+    }
+
+    ~ScopedOperation() {
+        if (perf)
+            perf->RecordOperation(operation, begin, bytes);
+    }
+
+    ScopedOperation(const ScopedOperation&) = delete;
+    ScopedOperation& operator=(const ScopedOperation&) = delete;
+
+private:
+    PerfTelemetry* perf;
+    PerfTelemetry::Operation operation;
+    uint64_t bytes;
+    uint64_t begin;
+};
+
+// OutputFile recording the latency of every write to the wrapped file
+class InstrumentedOutputFile : public OutputFile {
+public:
+    InstrumentedOutputFile(OutputFile& file, PerfTelemetry& perf) : file(file), perf(perf) {
+    }
+
+    bool WriteAt(uint64_t offset, const void* data, size_t size) override;
+    bool Flush() override;
+    bool SetSize(uint64_t size) override;
+
+    bool ZeroFillsGaps() const override {
+        return file.ZeroFillsGaps();
+    }
+
+private:
+    OutputFile& file;
+    PerfTelemetry& perf;
+};
+
+// TitleArchive recording the latency of every read from the files opened through it
+class InstrumentedTitleArchive : public TitleArchive {
+public:
+    InstrumentedTitleArchive(TitleArchive& title, PerfTelemetry& perf) : title(title), perf(perf) {
+    }
+
+    Result OpenExeFSSection(const std::string& name, std::unique_ptr<ArchiveFile>* file) override;
+    Result OpenRomFS(std::unique_ptr<ArchiveFile>* file) override;
+
+private:
+    TitleArchive& title;
+    PerfTelemetry& perf;
+};
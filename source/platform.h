@@ -0,0 +1,267 @@
+#pragma once
+
+// Minimal platform abstraction for the pieces of braindump that need to run both on the 3DS
+// and on a Linux host (for benchmarking). On the 3DS, this maps to libctru and kernel objects,
+// on the host it maps to the C++ standard library.
+
+#ifdef _3DS
+
+#include <algorithm>
+
+#include <3ds.h>
+
+#else
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+
+using Result = int32_t;
+
+#endif
+
+// Counting semaphore used to hand buffers back and forth between pipeline stages
+class Semaphore {
+public:
+    Semaphore(int initial_count, int max_count);
+    ~Semaphore();
+
+    Semaphore(const Semaphore&) = delete;
+    Semaphore& operator=(const Semaphore&) = delete;
+
+    void Acquire();
+    void Release();
+
+private:
+#ifdef _3DS
+    Handle handle;
+#else
+    std::mutex mutex;
+    std::condition_variable cv;
+    int count;
+#endif
+};
+
+// Mutual exclusion lock, for state that is rarely contended (e.g. statistics shared between threads)
+class Mutex {
+public:
+    Mutex();
+
+    Mutex(const Mutex&) = delete;
+    Mutex& operator=(const Mutex&) = delete;
+
+    void Lock();
+    void Unlock();
+
+private:
+#ifdef _3DS
+    LightLock lock;
+#else
+    std::mutex mutex;
+#endif
+};
+
+// Holds a Mutex locked for the lifetime of this object
+class ScopedLock {
+public:
+    explicit ScopedLock(Mutex& mutex) : mutex(mutex) {
+        mutex.Lock();
+    }
+
+    ~ScopedLock() {
+        mutex.Unlock();
+    }
+
+    ScopedLock(const ScopedLock&) = delete;
+    ScopedLock& operator=(const ScopedLock&) = delete;
+
+private:
+    Mutex& mutex;
+};
+
+// Monotonic timestamp for performance measurements, counting at ticks_per_second
+uint64_t GetTicks();
+
+// Block until the next display refresh (about 60 times per second)
+void WaitForVBlank();
+
+// Block the calling thread for the given time
+void SleepMicroseconds(uint32_t microseconds);
+
+// Allocate memory that DMA transfers may target, aligned to "alignment" bytes. This is taken from the linear heap
+// on the 3DS; on the host, it's regular heap memory. Returns null on failure.
+void* AllocateLinear(size_t size, size_t alignment);
+void FreeLinear(void* memory);
+
+// Joinable thread running "entry(arg)"
+class WorkerThread {
+public:
+    // How a worker is scheduled relative to the thread spawning it
+    enum class Kind {
+        IO,      // Mostly blocked on IPC: Runs at a higher priority, so it can issue its next request right away
+        Compute, // CPU-bound: Runs at a lower priority, and on another core where available, so it doesn't delay I/O
+    };
+
+    WorkerThread() = default;
+    ~WorkerThread() { Join(); }
+
+    WorkerThread(const WorkerThread&) = delete;
+    WorkerThread& operator=(const WorkerThread&) = delete;
+
+    bool Start(void (*entry)(void*), void* arg, Kind kind = Kind::IO);
+    void Join();
+
+private:
+#ifdef _3DS
+    Thread thread = nullptr;
+#else
+    std::thread thread;
+#endif
+};
+
+#ifdef _3DS
+
+inline Semaphore::Semaphore(int initial_count, int max_count) {
+    svcCreateSemaphore(&handle, initial_count, max_count);
+}
+
+inline Semaphore::~Semaphore() {
+    svcCloseHandle(handle);
+}
+
+inline void Semaphore::Acquire() {
+    svcWaitSynchronization(handle, U64_MAX);
+}
+
+inline void Semaphore::Release() {
+    s32 previous_count;
+    svcReleaseSemaphore(&previous_count, handle, 1);
+}
+
+inline Mutex::Mutex() {
+    LightLock_Init(&lock);
+}
+
+inline void Mutex::Lock() {
+    LightLock_Lock(&lock);
+}
+
+inline void Mutex::Unlock() {
+    LightLock_Unlock(&lock);
+}
+
+static const uint64_t ticks_per_second = SYSCLOCK_ARM11;
+
+inline uint64_t GetTicks() {
+    return svcGetSystemTick();
+}
+
+inline void WaitForVBlank() {
+    gspWaitForVBlank();
+}
+
+inline void SleepMicroseconds(uint32_t microseconds) {
+    svcSleepThread(int64_t{microseconds} * 1000);
+}
+
+inline void* AllocateLinear(size_t size, size_t alignment) {
+    return linearMemAlign(size, alignment);
+}
+
+inline void FreeLinear(void* memory) {
+    linearFree(memory);
+}
+
+inline bool WorkerThread::Start(void (*entry)(void*), void* arg, Kind kind) {
+    s32 priority = 0x30;
+    svcGetThreadPriority(&priority, CUR_THREAD_HANDLE);
+    if (kind == Kind::IO) {
+        thread = threadCreate(entry, arg, 0x4000, priority - 1, -2, false);
+        return thread != nullptr;
+    }
+
+    // Lower priority values are scheduled first. Core 2 is only available on the New 3DS.
+    priority = std::min<s32>(priority + 1, 0x3F);
+    thread = threadCreate(entry, arg, 0x4000, priority, 2, false);
+    if (thread == nullptr)
+        thread = threadCreate(entry, arg, 0x4000, priority, -2, false);
+    return thread != nullptr;
+}
+
+inline void WorkerThread::Join() {
+    if (thread == nullptr)
+        return;
+
+    threadJoin(thread, U64_MAX);
+    threadFree(thread);
+    thread = nullptr;
+}
+
+#else
+
+inline Semaphore::Semaphore(int initial_count, int /* max_count */) : count(initial_count) {
+}
+
+inline Semaphore::~Semaphore() = default;
+
+inline void Semaphore::Acquire() {
+    std::unique_lock<std::mutex> lock(mutex);
+    cv.wait(lock, [this] { return count > 0; });
+    --count;
+}
+
+inline void Semaphore::Release() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ++count;
+    }
+    cv.notify_one();
+}
+
+inline Mutex::Mutex() = default;
+
+inline void Mutex::Lock() {
+    mutex.lock();
+}
+
+inline void Mutex::Unlock() {
+    mutex.unlock();
+}
+
+static const uint64_t ticks_per_second = 1000000000;
+
+inline uint64_t GetTicks() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+inline void WaitForVBlank() {
+    std::this_thread::sleep_for(std::chrono::microseconds(16715));
+}
+
+inline void SleepMicroseconds(uint32_t microseconds) {
+    std::this_thread::sleep_for(std::chrono::microseconds(microseconds));
+}
+
+inline void* AllocateLinear(size_t size, size_t alignment) {
+    void* memory;
+    return posix_memalign(&memory, alignment, size) == 0 ? memory : nullptr;
+}
+
+inline void FreeLinear(void* memory) {
+    free(memory);
+}
+
+inline bool WorkerThread::Start(void (*entry)(void*), void* arg, Kind /* kind */) {
+    thread = std::thread(entry, arg);
+    return true;
+}
+
+inline void WorkerThread::Join() {
+    if (thread.joinable())
+        thread.join();
+}
+
+#endif
@@ -0,0 +1,105 @@
+#include <algorithm>
+
+#include "ivfc.h"
+#include "romfs_image.h"
+#include "sha256.h"
+
+static const uint32_t media_unit_size = 0x200;
+
+// Amount of level 3 data written between two journal checkpoints
+static const uint64_t checkpoint_interval = 16 * 1024 * 1024;
+
+PipelineStatus WriteRomFSImage(ArchiveFile& level3, uint64_t level3_size, OutputSink& out,
+                               const std::function<void(uint64_t)>& on_progress,
+                               RomFSSuperblockInfo* superblock_info, DumpJournal* journal,
+                               ChunkAutotuner* autotuner, DumpArena* arena, ReadRecovery* recovery) {
+    const auto romfs_begin = out.Tell();
+    IvfcHashTree hash_tree(level3_size);
+
+    PipelineConfig config;
+    config.num_buffers = 4;
+    config.autotuner = autotuner;
+    config.arena = arena;
+    config.recovery = recovery;
+
+    // Pick up where a previous run left off, if possible
+    DumpJournal::RomFSProgress progress;
+    progress.romfs_offset = romfs_begin;
+    progress.level3_offset = hash_tree.Level3Offset();
+    progress.level3_size = level3_size;
+    if (journal) {
+        auto& previous = journal->RomFS();
+        if (previous.romfs_offset == progress.romfs_offset && previous.level3_offset == progress.level3_offset &&
+            previous.level3_size == progress.level3_size && previous.level3_written != 0) {
+            hash_tree.RestoreLevel2(previous.level2_hashes.data(), previous.level2_hashes.size());
+            progress.level3_written = previous.level3_written;
+            config.start_offset = previous.level3_written;
+
+            // The data already written keeps the zeros filled in for unreadable ranges, so they still need listing
+            if (recovery) {
+                recovery->unreadable = previous.unreadable;
+                for (auto& range : recovery->unreadable)
+                    recovery->unreadable_size += range.size;
+            }
+        }
+    }
+
+    if (config.start_offset == 0) {
+        // Reserve space for the IVFC header and the master hash, which are filled in once level 3 has been hashed
+        out.FillZero(hash_tree.Level3Offset());
+    } else {
+        out.Seek(romfs_begin + hash_tree.Level3Offset() + config.start_offset);
+    }
+
+    uint64_t next_checkpoint = config.start_offset + checkpoint_interval;
+    auto on_written = [&](uint64_t offset) {
+        if (journal && offset >= next_checkpoint) {
+            // Only record data that has been both written and hashed
+            progress.level3_written = std::min(offset, hash_tree.HashedSize()) / IvfcHashTree::block_size * IvfcHashTree::block_size;
+            // Along with the unreadable ranges in that data
+            progress.unreadable.clear();
+            for (size_t index = 0; recovery && index < recovery->unreadable.size(); ++index) {
+                auto range = recovery->unreadable[index];
+                if (range.source_offset >= progress.level3_written)
+                    break;
+                range.size = static_cast<uint32_t>(std::min<uint64_t>(range.size, progress.level3_written - range.source_offset));
+                progress.unreadable.push_back(range);
+            }
+            if (out.Flush())
+                journal->AppendRomFSCheckpoint(progress, hash_tree.Level2Hashes());
+            next_checkpoint = offset + checkpoint_interval;
+        }
+
+        if (on_progress)
+            on_progress(offset);
+    };
+
+    // Hash level 3 data on a worker thread while it's being written, using an extra buffer to keep the writer busy
+    auto hash_level3 = [&hash_tree](const uint8_t* data, uint32_t size) {
+        hash_tree.AddLevel3Data(data, size);
+    };
+    auto status = CopyPipelined(level3, level3_size, out, config, hash_level3, on_written);
+    if (!status.Succeeded())
+        return status;
+
+    // Append the upper hash levels and fill in the superblock
+    hash_tree.Finish();
+    out.PadTo(IvfcHashTree::block_size, romfs_begin);
+    out.Write(hash_tree.Level1().data(), hash_tree.Level1().size());
+    out.PadTo(IvfcHashTree::block_size, romfs_begin);
+    out.Write(hash_tree.Level2().data(), hash_tree.Level2().size());
+    out.PadTo(IvfcHashTree::block_size, romfs_begin);
+
+    auto superblock = hash_tree.BuildSuperblock();
+    out.Patch(romfs_begin, superblock.data(), superblock.size());
+
+    // The NCCH superblock hash covers whole media units
+    if (superblock_info) {
+        superblock.resize((superblock.size() + media_unit_size - 1) / media_unit_size * media_unit_size);
+        Sha256::Hash(superblock.data(), superblock.size(), superblock_info->hash);
+        superblock_info->size = superblock.size() / media_unit_size;
+    }
+
+    status.write_failed = !out.Good();
+    return status;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+
+#include "archive_file.h"
+#include "dump_journal.h"
+#include "dump_pipeline.h"
+#include "output_sink.h"
+
+// Information about the RomFS superblock needed to fill in the NCCH header
+struct RomFSSuperblockInfo {
+    uint8_t hash[0x20]; // SHA-256 hash of the superblock, padded to whole media units
+    uint32_t size;      // Size of the superblock in media units
+};
+
+// Write a RomFS image containing the given level 3 data to "out", including the IVFC hash tree.
+// Level 3 data is copied through the read/write pipeline and hashed on a worker thread while
+// it's being written; the hash levels are appended afterwards and the IVFC header is patched in.
+// "on_progress" is called with the number of level 3 bytes written so far.
+// If "journal" is given, checkpoints are recorded in it regularly, and the dump is resumed from the
+// last checkpoint if the journal contains one for this RomFS. Unreadable ranges are recorded and restored along with it.
+// If "autotuner" is given, it picks the size of the level 3 reads.
+// If "arena" is given, the pipeline buffers are taken from it.
+// If "recovery" is given, failed level 3 reads are recovered from (see ReadRecovery) rather than aborting the dump.
+PipelineStatus WriteRomFSImage(ArchiveFile& level3, uint64_t level3_size, OutputSink& out,
+                               const std::function<void(uint64_t)>& on_progress,
+                               RomFSSuperblockInfo* superblock_info, DumpJournal* journal,
+                               ChunkAutotuner* autotuner, DumpArena* arena, ReadRecovery* recovery);
@@ -0,0 +1,270 @@
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+
+#include "romfs_index.h"
+
+static std::string ToUtf8(const std::u16string& text) {
+    std::string ret;
+    for (size_t index = 0; index < text.size(); ++index) {
+        uint32_t c = text[index];
+        if (c >= 0xD800 && c < 0xDC00 && index + 1 < text.size() && text[index + 1] >= 0xDC00 && text[index + 1] < 0xE000)
+            c = 0x10000 + ((c - 0xD800) << 10) + (text[++index] - 0xDC00);
+
+        if (c < 0x80) {
+            ret += static_cast<char>(c);
+        } else if (c < 0x800) {
+            ret += static_cast<char>(0xC0 | (c >> 6));
+            ret += static_cast<char>(0x80 | (c & 0x3F));
+        } else if (c < 0x10000) {
+            ret += static_cast<char>(0xE0 | (c >> 12));
+            ret += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+            ret += static_cast<char>(0x80 | (c & 0x3F));
+        } else {
+            ret += static_cast<char>(0xF0 | (c >> 18));
+            ret += static_cast<char>(0x80 | ((c >> 12) & 0x3F));
+            ret += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+            ret += static_cast<char>(0x80 | (c & 0x3F));
+        }
+    }
+    return ret;
+}
+
+static std::u16string ToUtf16(const std::string& text) {
+    std::u16string ret;
+    for (size_t index = 0; index < text.size(); ) {
+        uint8_t lead = text[index];
+        unsigned length = (lead < 0x80) ? 1 : (lead < 0xE0) ? 2 : (lead < 0xF0) ? 3 : 4;
+        uint32_t c = (length == 1) ? lead : (length == 2) ? (lead & 0x1F) : (length == 3) ? (lead & 0x0F) : (lead & 0x07);
+        for (unsigned byte = 1; byte < length && index + byte < text.size(); ++byte)
+            c = (c << 6) | (text[index + byte] & 0x3F);
+        index += length;
+
+        if (c >= 0x10000) {
+            ret += static_cast<char16_t>(0xD800 + ((c - 0x10000) >> 10));
+            ret += static_cast<char16_t>(0xDC00 + ((c - 0x10000) & 0x3FF));
+        } else {
+            ret += static_cast<char16_t>(c);
+        }
+    }
+    return ret;
+}
+
+template<typename Entry>
+bool RomFSIndex::ReadEntry(const std::vector<uint8_t>& table, uint32_t offset, Entry* entry, std::u16string* name) const {
+    if (offset > table.size() || sizeof(Entry) > table.size() - offset)
+        return false;
+    memcpy(entry, &table[offset], sizeof(Entry));
+    if (entry->name_size % 2 || entry->name_size > table.size() - offset - sizeof(Entry))
+        return false;
+
+    if (name) {
+        name->resize(entry->name_size / 2);
+        memcpy(&(*name)[0], &table[offset + sizeof(Entry)], entry->name_size);
+    }
+    return true;
+}
+
+// Read a table section of the level 3 data into "data"
+template<typename T>
+static bool ReadSection(ArchiveFile& level3, uint64_t level3_size, const RomFSInfoHeader::RomFSSectionHeader& section, std::vector<T>* data) {
+    if (section.offset > level3_size || section.size > level3_size - section.offset || section.size % sizeof(T))
+        return false;
+
+    data->resize(section.size / sizeof(T));
+    uint32_t bytes_read = 0;
+    return section.size == 0 || (level3.Read(section.offset, data->data(), section.size, &bytes_read) == 0 && bytes_read == section.size);
+}
+
+bool RomFSIndex::Load(ArchiveFile& level3) {
+    files.clear();
+    files_by_offset.clear();
+
+    uint64_t level3_size = 0;
+    uint32_t bytes_read = 0;
+    if (level3.GetSize(&level3_size) != 0 || level3.Read(0, &header, sizeof(header), &bytes_read) != 0 ||
+        bytes_read != sizeof(header) || header.headersize != sizeof(header) || header.dataoffset > level3_size)
+        return false;
+
+    // The tables are read with one request each
+    if (!ReadSection(level3, level3_size, header.section[DirectoryHashTable], &directory_hash_table) ||
+        !ReadSection(level3, level3_size, header.section[DirectoryMetadata], &directory_table) ||
+        !ReadSection(level3, level3_size, header.section[FileHashTable], &file_hash_table) ||
+        !ReadSection(level3, level3_size, header.section[FileMetadata], &file_table))
+        return false;
+    metadata_size = sizeof(header);
+    for (auto& section : header.section)
+        metadata_size += section.size;
+
+    if (!WalkDirectory(0, "", 0))
+        return false;
+
+    // Reject files exceeding the RomFS
+    for (auto& file : files) {
+        if (file.offset > level3_size || file.size > level3_size - file.offset)
+            return false;
+    }
+    return true;
+}
+
+bool RomFSIndex::WalkDirectory(uint32_t offset, const std::string& path, unsigned depth) {
+    // Bound the recursion, in case of cyclic links in corrupted tables
+    if (depth > 64)
+        return false;
+
+    RomFS_DirectoryMetadata dir;
+    if (!ReadEntry(directory_table, offset, &dir, nullptr))
+        return false;
+
+    std::u16string name;
+    size_t num_files = 0;
+    for (uint32_t file_offset = dir.first_file_offset; file_offset != romfs_invalid_offset; ) {
+        RomFS_FileMetadata file;
+        if (!ReadEntry(file_table, file_offset, &file, &name) || ++num_files > file_table.size() / sizeof(file))
+            return false;
+
+        files_by_offset[file_offset] = files.size();
+        files.push_back(File{ path + ToUtf8(name), header.dataoffset + file.data_offset, file.data_size });
+        file_offset = file.next_sibling_offset;
+    }
+
+    size_t num_children = 0;
+    for (uint32_t child_offset = dir.first_child_offset; child_offset != romfs_invalid_offset; ) {
+        RomFS_DirectoryMetadata child;
+        if (!ReadEntry(directory_table, child_offset, &child, &name) || ++num_children > directory_table.size() / sizeof(child))
+            return false;
+
+        if (!WalkDirectory(child_offset, path + ToUtf8(name) + "/", depth + 1))
+            return false;
+        child_offset = child.next_sibling_offset;
+    }
+    return true;
+}
+
+template<typename Entry>
+uint32_t RomFSIndex::Lookup(const std::vector<uint32_t>& hash_table, const std::vector<uint8_t>& table, uint32_t parent_offset,
+                            const std::u16string& name) const {
+    if (hash_table.empty())
+        return romfs_invalid_offset;
+
+    uint32_t hash = RomFSPathHash(parent_offset, reinterpret_cast<const uint16_t*>(name.data()), name.size());
+    uint32_t offset = hash_table[hash % hash_table.size()];
+    std::u16string entry_name;
+    for (size_t steps = 0; offset != romfs_invalid_offset && steps < table.size() / sizeof(Entry); ++steps) {
+        Entry entry;
+        if (!ReadEntry(table, offset, &entry, &entry_name))
+            return romfs_invalid_offset;
+        if (entry.parent_offset == parent_offset && entry_name == name)
+            return offset;
+        offset = entry.next_in_bucket_offset;
+    }
+    return romfs_invalid_offset;
+}
+
+const RomFSIndex::File* RomFSIndex::Find(const std::string& path) const {
+    uint32_t dir_offset = 0;
+    size_t begin = path.find_first_not_of('/');
+    while (begin != std::string::npos) {
+        size_t end = path.find('/', begin);
+        auto name = ToUtf16(path.substr(begin, end - begin));
+        if (end == std::string::npos) {
+            uint32_t file_offset = Lookup<RomFS_FileMetadata>(file_hash_table, file_table, dir_offset, name);
+            auto it = files_by_offset.find(file_offset);
+            return (it != files_by_offset.end()) ? &files[it->second] : nullptr;
+        }
+
+        dir_offset = Lookup<RomFS_DirectoryMetadata>(directory_hash_table, directory_table, dir_offset, name);
+        if (dir_offset == romfs_invalid_offset)
+            return nullptr;
+        begin = end + 1;
+    }
+    return nullptr;
+}
+
+// Match "text" against a glob pattern
+static bool MatchGlob(const char* pattern, const char* text) {
+    for (; *pattern; ++pattern, ++text) {
+        if (pattern[0] == '*') {
+            // "**" may span directories, "*" may not
+            bool any_depth = (pattern[1] == '*');
+            const char* rest = pattern + (any_depth ? 2 : 1);
+
+            // "**/" also matches no directory at all
+            if (any_depth && *rest == '/' && MatchGlob(rest + 1, text))
+                return true;
+            for (const char* candidate = text; ; ++candidate) {
+                if (MatchGlob(rest, candidate))
+                    return true;
+                if (*candidate == 0 || (*candidate == '/' && !any_depth))
+                    return false;
+            }
+        }
+
+        if (*text == 0 || (*pattern == '?' ? *text == '/' : *pattern != *text))
+            return false;
+    }
+    return *text == 0;
+}
+
+std::vector<const RomFSIndex::File*> RomFSIndex::Match(const std::vector<std::string>& patterns) const {
+    std::vector<const File*> matches;
+    std::vector<std::string> globs;
+    for (auto& pattern : patterns) {
+        // Plain paths are looked up through the hash tables, so that they don't need a scan over all files
+        auto path = pattern.substr(std::min(pattern.size(), pattern.find_first_not_of('/')));
+        if (path.find_first_of("*?") == std::string::npos) {
+            if (auto file = Find(path))
+                matches.push_back(file);
+        } else {
+            globs.push_back(path);
+        }
+    }
+
+    if (!globs.empty()) {
+        for (auto& file : files) {
+            for (auto& glob : globs) {
+                if (MatchGlob(glob.c_str(), file.path.c_str())) {
+                    matches.push_back(&file);
+                    break;
+                }
+            }
+        }
+    }
+
+    // Restore directory order and drop files matched by several patterns
+    std::sort(matches.begin(), matches.end());
+    matches.erase(std::unique(matches.begin(), matches.end()), matches.end());
+    return matches;
+}
+
+bool RomFSIndex::WriteIndexFile(const std::string& path) const {
+    FILE* file = fopen(path.c_str(), "w");
+    if (file == nullptr)
+        return false;
+
+    fprintf(file, "# offset (within RomFS level 3) size path\n");
+    for (auto& entry : files)
+        fprintf(file, "%010" PRIx64 " %10" PRIu64 " %s\n", entry.offset, entry.size, entry.path.c_str());
+
+    bool success = !ferror(file);
+    success &= (fclose(file) == 0);
+    return success;
+}
+
+bool ReadPathList(const std::string& path, std::vector<std::string>* patterns) {
+    FILE* file = fopen(path.c_str(), "r");
+    if (file == nullptr)
+        return false;
+
+    char line[512];
+    while (fgets(line, sizeof(line), file)) {
+        std::string pattern = line;
+        pattern.erase(pattern.find_last_not_of(" \t\r\n") + 1);
+        pattern.erase(0, pattern.find_first_not_of(" \t"));
+        if (!pattern.empty() && pattern[0] != '#')
+            patterns->push_back(pattern);
+    }
+    fclose(file);
+    return true;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "archive_file.h"
+#include "ncch.h"
+
+// In-memory index of the file system stored in RomFS level 3.
+//
+// Only the level 3 header and the directory and file tables are read (usually well below a MiB even for
+// large titles), which allows dumping individual files with targeted reads instead of copying the whole RomFS.
+class RomFSIndex {
+public:
+    struct File {
+        std::string path; // UTF-8, relative to the RomFS root without leading slash, e.g. "font/cbf_std.bcfnt"
+        uint64_t offset;  // Offset of the file data within the level 3 data
+        uint64_t size;
+    };
+
+    // Read the level 3 header and tables from "level3". Returns false if they are malformed or couldn't be read.
+    bool Load(ArchiveFile& level3);
+
+    // All files, in directory order
+    const std::vector<File>& Files() const {
+        return files;
+    }
+
+    // Number of bytes read from the RomFS to build the index
+    uint64_t MetadataSize() const {
+        return metadata_size;
+    }
+
+    // Look up a file by its path through the hash tables, like the FS module does. Returns null if not found.
+    const File* Find(const std::string& path) const;
+
+    // Files matching any of the given paths or glob patterns, in directory order.
+    // In patterns, "*" and "?" match any characters (or a single character) within a path component,
+    // while "**" also matches across components. Leading slashes are ignored.
+    std::vector<const File*> Match(const std::vector<std::string>& patterns) const;
+
+    // Write the list of files along with their offsets and sizes to a text file
+    bool WriteIndexFile(const std::string& path) const;
+
+private:
+    // Copy the fixed-size part of a metadata entry and its name. Returns false if out of bounds.
+    template<typename Entry>
+    bool ReadEntry(const std::vector<uint8_t>& table, uint32_t offset, Entry* entry, std::u16string* name) const;
+
+    bool WalkDirectory(uint32_t offset, const std::string& path, unsigned depth);
+
+    // Offset of the entry named "name" in the given parent directory, or romfs_invalid_offset
+    template<typename Entry>
+    uint32_t Lookup(const std::vector<uint32_t>& hash_table, const std::vector<uint8_t>& table, uint32_t parent_offset, const std::u16string& name) const;
+
+    RomFSInfoHeader header;
+    std::vector<uint32_t> directory_hash_table;
+    std::vector<uint8_t> directory_table;
+    std::vector<uint32_t> file_hash_table;
+    std::vector<uint8_t> file_table;
+    uint64_t metadata_size = 0;
+
+    std::vector<File> files;
+    std::unordered_map<uint32_t, size_t> files_by_offset; // File metadata offset to index into "files"
+};
+
+// Read a list of paths or glob patterns, one per line. Empty lines and lines starting with '#' are ignored.
+// Returns false if the file doesn't exist.
+bool ReadPathList(const std::string& path, std::vector<std::string>* patterns);
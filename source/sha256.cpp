@@ -0,0 +1,219 @@
+#include <algorithm>
+#include <cstring>
+
+#include "sha256.h"
+
+// The compression function is fully unrolled, with round constants encoded as immediates rather than
+// loaded from a table. The working variables are never shuffled; instead, each round is expanded with
+// the roles of the variables rotated. The message schedule is kept in a 16-word circular window.
+// Everything works on plain 32-bit words, so the ARM11 (which lacks NEON) can keep most of the state
+// in registers; a NEON or SHA extension version of ProcessBlocks can be dropped in for other targets.
+
+static inline uint32_t RotateRight(uint32_t value, unsigned amount) {
+    return (value >> amount) | (value << (32 - amount));
+}
+
+static inline uint32_t LoadBigEndian32(const uint8_t* data) {
+    return (uint32_t(data[0]) << 24) | (uint32_t(data[1]) << 16) | (uint32_t(data[2]) << 8) | data[3];
+}
+
+static inline void StoreBigEndian32(uint8_t* data, uint32_t value) {
+    data[0] = value >> 24;
+    data[1] = value >> 16;
+    data[2] = value >> 8;
+    data[3] = value;
+}
+
+static inline uint32_t BigSigma0(uint32_t x) {
+    return RotateRight(x, 2) ^ RotateRight(x, 13) ^ RotateRight(x, 22);
+}
+
+static inline uint32_t BigSigma1(uint32_t x) {
+    return RotateRight(x, 6) ^ RotateRight(x, 11) ^ RotateRight(x, 25);
+}
+
+static inline uint32_t SmallSigma0(uint32_t x) {
+    return RotateRight(x, 7) ^ RotateRight(x, 18) ^ (x >> 3);
+}
+
+static inline uint32_t SmallSigma1(uint32_t x) {
+    return RotateRight(x, 17) ^ RotateRight(x, 19) ^ (x >> 10);
+}
+
+#define ROUND(a, b, c, d, e, f, g, h, k, w)                                \
+    do {                                                                   \
+        uint32_t t1 = h + BigSigma1(e) + (g ^ (e & (f ^ g))) + k + (w);    \
+        uint32_t t2 = BigSigma0(a) + ((a & b) | (c & (a | b)));            \
+        d += t1;                                                           \
+        h = t1 + t2;                                                       \
+    } while (0)
+
+// Compute the next message schedule word in place (for rounds 16 to 63)
+#define SCHEDULE(i) \
+    (w[i] += SmallSigma1(w[(i + 14) & 15]) + w[(i + 9) & 15] + SmallSigma0(w[(i + 1) & 15]))
+
+void Sha256::Reset() {
+    state[0] = 0x6a09e667;
+    state[1] = 0xbb67ae85;
+    state[2] = 0x3c6ef372;
+    state[3] = 0xa54ff53a;
+    state[4] = 0x510e527f;
+    state[5] = 0x9b05688c;
+    state[6] = 0x1f83d9ab;
+    state[7] = 0x5be0cd19;
+    total_size = 0;
+    block_fill = 0;
+}
+
+void Sha256::ProcessBlocks(const uint8_t* data, size_t num_blocks) {
+    for (; num_blocks != 0; --num_blocks, data += block_size) {
+        uint32_t w[16];
+        for (unsigned i = 0; i < 16; ++i)
+            w[i] = LoadBigEndian32(data + 4 * i);
+
+        uint32_t a = state[0];
+        uint32_t b = state[1];
+        uint32_t c = state[2];
+        uint32_t d = state[3];
+        uint32_t e = state[4];
+        uint32_t f = state[5];
+        uint32_t g = state[6];
+        uint32_t h = state[7];
+
+        ROUND(a, b, c, d, e, f, g, h, 0x428a2f98, w[0]);
+        ROUND(h, a, b, c, d, e, f, g, 0x71374491, w[1]);
+        ROUND(g, h, a, b, c, d, e, f, 0xb5c0fbcf, w[2]);
+        ROUND(f, g, h, a, b, c, d, e, 0xe9b5dba5, w[3]);
+        ROUND(e, f, g, h, a, b, c, d, 0x3956c25b, w[4]);
+        ROUND(d, e, f, g, h, a, b, c, 0x59f111f1, w[5]);
+        ROUND(c, d, e, f, g, h, a, b, 0x923f82a4, w[6]);
+        ROUND(b, c, d, e, f, g, h, a, 0xab1c5ed5, w[7]);
+
+        ROUND(a, b, c, d, e, f, g, h, 0xd807aa98, w[8]);
+        ROUND(h, a, b, c, d, e, f, g, 0x12835b01, w[9]);
+        ROUND(g, h, a, b, c, d, e, f, 0x243185be, w[10]);
+        ROUND(f, g, h, a, b, c, d, e, 0x550c7dc3, w[11]);
+        ROUND(e, f, g, h, a, b, c, d, 0x72be5d74, w[12]);
+        ROUND(d, e, f, g, h, a, b, c, 0x80deb1fe, w[13]);
+        ROUND(c, d, e, f, g, h, a, b, 0x9bdc06a7, w[14]);
+        ROUND(b, c, d, e, f, g, h, a, 0xc19bf174, w[15]);
+
+        ROUND(a, b, c, d, e, f, g, h, 0xe49b69c1, SCHEDULE(0));
+        ROUND(h, a, b, c, d, e, f, g, 0xefbe4786, SCHEDULE(1));
+        ROUND(g, h, a, b, c, d, e, f, 0x0fc19dc6, SCHEDULE(2));
+        ROUND(f, g, h, a, b, c, d, e, 0x240ca1cc, SCHEDULE(3));
+        ROUND(e, f, g, h, a, b, c, d, 0x2de92c6f, SCHEDULE(4));
+        ROUND(d, e, f, g, h, a, b, c, 0x4a7484aa, SCHEDULE(5));
+        ROUND(c, d, e, f, g, h, a, b, 0x5cb0a9dc, SCHEDULE(6));
+        ROUND(b, c, d, e, f, g, h, a, 0x76f988da, SCHEDULE(7));
+
+        ROUND(a, b, c, d, e, f, g, h, 0x983e5152, SCHEDULE(8));
+        ROUND(h, a, b, c, d, e, f, g, 0xa831c66d, SCHEDULE(9));
+        ROUND(g, h, a, b, c, d, e, f, 0xb00327c8, SCHEDULE(10));
+        ROUND(f, g, h, a, b, c, d, e, 0xbf597fc7, SCHEDULE(11));
+        ROUND(e, f, g, h, a, b, c, d, 0xc6e00bf3, SCHEDULE(12));
+        ROUND(d, e, f, g, h, a, b, c, 0xd5a79147, SCHEDULE(13));
+        ROUND(c, d, e, f, g, h, a, b, 0x06ca6351, SCHEDULE(14));
+        ROUND(b, c, d, e, f, g, h, a, 0x14292967, SCHEDULE(15));
+
+        ROUND(a, b, c, d, e, f, g, h, 0x27b70a85, SCHEDULE(0));
+        ROUND(h, a, b, c, d, e, f, g, 0x2e1b2138, SCHEDULE(1));
+        ROUND(g, h, a, b, c, d, e, f, 0x4d2c6dfc, SCHEDULE(2));
+        ROUND(f, g, h, a, b, c, d, e, 0x53380d13, SCHEDULE(3));
+        ROUND(e, f, g, h, a, b, c, d, 0x650a7354, SCHEDULE(4));
+        ROUND(d, e, f, g, h, a, b, c, 0x766a0abb, SCHEDULE(5));
+        ROUND(c, d, e, f, g, h, a, b, 0x81c2c92e, SCHEDULE(6));
+        ROUND(b, c, d, e, f, g, h, a, 0x92722c85, SCHEDULE(7));
+
+        ROUND(a, b, c, d, e, f, g, h, 0xa2bfe8a1, SCHEDULE(8));
+        ROUND(h, a, b, c, d, e, f, g, 0xa81a664b, SCHEDULE(9));
+        ROUND(g, h, a, b, c, d, e, f, 0xc24b8b70, SCHEDULE(10));
+        ROUND(f, g, h, a, b, c, d, e, 0xc76c51a3, SCHEDULE(11));
+        ROUND(e, f, g, h, a, b, c, d, 0xd192e819, SCHEDULE(12));
+        ROUND(d, e, f, g, h, a, b, c, 0xd6990624, SCHEDULE(13));
+        ROUND(c, d, e, f, g, h, a, b, 0xf40e3585, SCHEDULE(14));
+        ROUND(b, c, d, e, f, g, h, a, 0x106aa070, SCHEDULE(15));
+
+        ROUND(a, b, c, d, e, f, g, h, 0x19a4c116, SCHEDULE(0));
+        ROUND(h, a, b, c, d, e, f, g, 0x1e376c08, SCHEDULE(1));
+        ROUND(g, h, a, b, c, d, e, f, 0x2748774c, SCHEDULE(2));
+        ROUND(f, g, h, a, b, c, d, e, 0x34b0bcb5, SCHEDULE(3));
+        ROUND(e, f, g, h, a, b, c, d, 0x391c0cb3, SCHEDULE(4));
+        ROUND(d, e, f, g, h, a, b, c, 0x4ed8aa4a, SCHEDULE(5));
+        ROUND(c, d, e, f, g, h, a, b, 0x5b9cca4f, SCHEDULE(6));
+        ROUND(b, c, d, e, f, g, h, a, 0x682e6ff3, SCHEDULE(7));
+
+        ROUND(a, b, c, d, e, f, g, h, 0x748f82ee, SCHEDULE(8));
+        ROUND(h, a, b, c, d, e, f, g, 0x78a5636f, SCHEDULE(9));
+        ROUND(g, h, a, b, c, d, e, f, 0x84c87814, SCHEDULE(10));
+        ROUND(f, g, h, a, b, c, d, e, 0x8cc70208, SCHEDULE(11));
+        ROUND(e, f, g, h, a, b, c, d, 0x90befffa, SCHEDULE(12));
+        ROUND(d, e, f, g, h, a, b, c, 0xa4506ceb, SCHEDULE(13));
+        ROUND(c, d, e, f, g, h, a, b, 0xbef9a3f7, SCHEDULE(14));
+        ROUND(b, c, d, e, f, g, h, a, 0xc67178f2, SCHEDULE(15));
+
+        state[0] += a;
+        state[1] += b;
+        state[2] += c;
+        state[3] += d;
+        state[4] += e;
+        state[5] += f;
+        state[6] += g;
+        state[7] += h;
+    }
+}
+
+#undef SCHEDULE
+#undef ROUND
+
+void Sha256::Update(const void* data, size_t size) {
+    auto bytes = static_cast<const uint8_t*>(data);
+    total_size += size;
+
+    if (block_fill != 0) {
+        size_t chunk = std::min(size, block_size - block_fill);
+        memcpy(block + block_fill, bytes, chunk);
+        block_fill += chunk;
+        bytes += chunk;
+        size -= chunk;
+
+        if (block_fill != block_size)
+            return;
+
+        ProcessBlocks(block, 1);
+        block_fill = 0;
+    }
+
+    // Hash full blocks straight from the input buffer
+    ProcessBlocks(bytes, size / block_size);
+    bytes += size - size % block_size;
+    size %= block_size;
+
+    memcpy(block, bytes, size);
+    block_fill = size;
+}
+
+void Sha256::Final(uint8_t* digest) {
+    const uint64_t total_bits = total_size * 8;
+
+    // Append the terminating 1 bit, pad with zeros and finish with the message length
+    block[block_fill++] = 0x80;
+    if (block_fill > block_size - 8) {
+        memset(block + block_fill, 0, block_size - block_fill);
+        ProcessBlocks(block, 1);
+        block_fill = 0;
+    }
+    memset(block + block_fill, 0, block_size - 8 - block_fill);
+    StoreBigEndian32(block + block_size - 8, static_cast<uint32_t>(total_bits >> 32));
+    StoreBigEndian32(block + block_size - 4, static_cast<uint32_t>(total_bits));
+    ProcessBlocks(block, 1);
+
+    for (unsigned i = 0; i < 8; ++i)
+        StoreBigEndian32(digest + 4 * i, state[i]);
+}
+
+void Sha256::Hash(const void* data, size_t size, uint8_t* digest) {
+    Sha256 context;
+    context.Update(data, size);
+    context.Final(digest);
+}
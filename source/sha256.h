@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Incremental SHA-256 context.
+// Data can be fed in pieces of arbitrary size, which allows hashing sections while they are streamed to the output.
+class Sha256 {
+public:
+    static const size_t digest_size = 32;
+    static const size_t block_size = 64;
+
+    Sha256() {
+        Reset();
+    }
+
+    void Reset();
+
+    void Update(const void* data, size_t size);
+
+    // Write the digest of all data passed to Update so far to "digest" (digest_size bytes).
+    // The context must be Reset before it can be reused.
+    void Final(uint8_t* digest);
+
+    // Convenience function to hash a single buffer
+    static void Hash(const void* data, size_t size, uint8_t* digest);
+
+private:
+    void ProcessBlocks(const uint8_t* data, size_t num_blocks);
+
+    uint32_t state[8];
+    uint64_t total_size;
+    uint8_t block[block_size];
+    size_t block_fill;
+};
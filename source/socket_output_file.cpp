@@ -0,0 +1,121 @@
+#include <algorithm>
+#include <cstring>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "socket_output_file.h"
+
+// Frames up to this size are copied into a single buffer along with their header before sending
+static const uint32_t coalesce_size = 0x10000;
+
+// Report a lost connection as an error rather than raising SIGPIPE, where supported
+#ifdef MSG_NOSIGNAL
+static const int send_flags = MSG_NOSIGNAL;
+#else
+static const int send_flags = 0;
+#endif
+
+SocketOutputFile::~SocketOutputFile() {
+    Close();
+}
+
+bool SocketOutputFile::Open(const std::string& address, uint16_t port, const std::string& name) {
+    Close();
+
+    sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (sock < 0)
+        return false;
+
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = inet_addr(address.c_str());
+    if (connect(sock, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        close(sock);
+        sock = -1;
+        return false;
+    }
+
+    // Headers are coalesced with their payload already, so there is nothing to gain from Nagle's algorithm
+    int nodelay = 1;
+    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+
+    if (!SendFrame(NetFrameType::Open, 0, name.data(), static_cast<uint32_t>(name.size()))) {
+        close(sock);
+        sock = -1;
+        return false;
+    }
+    return true;
+}
+
+void SocketOutputFile::Close() {
+    if (sock < 0)
+        return;
+
+    SendFrame(NetFrameType::Close, 0, nullptr, 0);
+    close(sock);
+    sock = -1;
+}
+
+bool SocketOutputFile::SendAll(const void* data, size_t size) {
+    auto bytes = static_cast<const uint8_t*>(data);
+    while (size > 0) {
+        ssize_t sent = send(sock, bytes, size, send_flags);
+        if (sent <= 0)
+            return false;
+        bytes += sent;
+        size -= sent;
+    }
+    return true;
+}
+
+bool SocketOutputFile::SendFrame(NetFrameType type, uint64_t offset, const void* data, uint32_t size) {
+    if (sock < 0)
+        return false;
+
+    NetFrameHeader header = { static_cast<uint32_t>(type), size, offset };
+    if (size > coalesce_size)
+        return SendAll(&header, sizeof(header)) && SendAll(data, size);
+
+    staging.resize(sizeof(header) + size);
+    memcpy(staging.data(), &header, sizeof(header));
+    if (size != 0)
+        memcpy(staging.data() + sizeof(header), data, size);
+    return SendAll(staging.data(), staging.size());
+}
+
+bool SocketOutputFile::WriteAt(uint64_t offset, const void* data, size_t size) {
+    auto bytes = static_cast<const uint8_t*>(data);
+    while (size > 0) {
+        uint32_t frame_size = static_cast<uint32_t>(std::min<size_t>(size, net_max_frame_size));
+        if (!SendFrame(NetFrameType::Write, offset, bytes, frame_size))
+            return false;
+        offset += frame_size;
+        bytes += frame_size;
+        size -= frame_size;
+    }
+    return true;
+}
+
+bool SocketOutputFile::Flush() {
+    if (!SendFrame(NetFrameType::Flush, 0, nullptr, 0))
+        return false;
+
+    int32_t status;
+    auto bytes = reinterpret_cast<uint8_t*>(&status);
+    for (size_t received = 0; received < sizeof(status);) {
+        ssize_t ret = recv(sock, bytes + received, sizeof(status) - received, 0);
+        if (ret <= 0)
+            return false;
+        received += ret;
+    }
+    return status == 0;
+}
+
+bool SocketOutputFile::SetSize(uint64_t size) {
+    return SendFrame(NetFrameType::SetSize, size, nullptr, 0);
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "output_file.h"
+
+// Protocol used to stream dump output files to a receiver on the network (see host/net_receiver.cpp).
+//
+// Each output file uses its own TCP connection. The sender issues a sequence of frames, each consisting
+// of a NetFrameHeader followed by "size" bytes of payload. All fields are little-endian.
+//
+// - Open: Payload is the name of the file relative to the receiver's output directory. Must come first.
+// - Write: Payload is written to the file at "offset".
+// - SetSize: Resizes the file to "offset" bytes.
+// - Flush: Commits the file. The receiver replies with a 32-bit status, 0 meaning all frames so far succeeded.
+// - Close: Ends the connection.
+enum class NetFrameType : uint32_t {
+    Open = 1,
+    Write = 2,
+    SetSize = 3,
+    Flush = 4,
+    Close = 5,
+};
+
+struct NetFrameHeader {
+    uint32_t type;
+    uint32_t size;
+    uint64_t offset;
+};
+static_assert(sizeof(NetFrameHeader) == 0x10, "Incorrect structure size");
+
+// Largest payload sent in a single frame. Larger writes are split up.
+static const uint32_t net_max_frame_size = 0x100000;
+
+// OutputFile that forwards all writes to a receiver over TCP, so that dumps don't need to go through the SD card.
+// On the 3DS, the SOC service needs to be initialized before using this.
+class SocketOutputFile : public OutputFile {
+public:
+    SocketOutputFile() = default;
+    ~SocketOutputFile() override;
+
+    SocketOutputFile(const SocketOutputFile&) = delete;
+    SocketOutputFile& operator=(const SocketOutputFile&) = delete;
+
+    // Connect to the receiver at "address" (IPv4, dotted notation) and ask it to create the file "name"
+    bool Open(const std::string& address, uint16_t port, const std::string& name);
+    void Close();
+
+    bool IsOpen() const {
+        return sock >= 0;
+    }
+
+    bool WriteAt(uint64_t offset, const void* data, size_t size) override;
+
+    // Waits for the receiver to confirm that all data sent so far has been written
+    bool Flush() override;
+
+    bool SetSize(uint64_t size) override;
+
+    // The receiver writes to a file on the host, where gaps read back as zeros
+    bool ZeroFillsGaps() const override {
+        return true;
+    }
+
+private:
+    bool SendFrame(NetFrameType type, uint64_t offset, const void* data, uint32_t size);
+    bool SendAll(const void* data, size_t size);
+
+    int sock = -1;
+    std::vector<uint8_t> staging; // Used to coalesce small frames with their header into a single send
+};
@@ -0,0 +1,44 @@
+#include <errno.h>
+#include <sys/stat.h>
+
+#include "stdio_archive_file.h"
+
+StdioArchiveFile::~StdioArchiveFile() {
+    if (file)
+        fclose(file);
+}
+
+bool StdioArchiveFile::Open(const std::string& path) {
+    if (file)
+        fclose(file);
+
+    file = fopen(path.c_str(), "rb");
+    position = 0;
+    return file != nullptr;
+}
+
+Result StdioArchiveFile::GetSize(uint64_t* size) {
+    struct stat st;
+    if (file == nullptr || fstat(fileno(file), &st) != 0)
+        return -EIO;
+
+    *size = st.st_size;
+    return 0;
+}
+
+Result StdioArchiveFile::Read(uint64_t offset, void* buffer, uint32_t size, uint32_t* bytes_read) {
+    if (file == nullptr)
+        return -EIO;
+
+    if (offset != position) {
+        if (fseeko(file, offset, SEEK_SET) != 0)
+            return -EIO;
+        position = offset;
+    }
+
+    *bytes_read = static_cast<uint32_t>(fread(buffer, 1, size, file));
+    position += *bytes_read;
+    if (*bytes_read != size && ferror(file))
+        return -EIO;
+    return 0;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdio>
+#include <string>
+
+#include "archive_file.h"
+
+// ArchiveFile backed by a C stdio stream, used to read back files braindump has written (e.g. to verify a dump).
+// This works both with newlib's sdmc: devoptab and on the host. Each instance has its own stream, so
+// separate instances may be read from different threads.
+class StdioArchiveFile : public ArchiveFile {
+public:
+    StdioArchiveFile() = default;
+    ~StdioArchiveFile() override;
+
+    StdioArchiveFile(const StdioArchiveFile&) = delete;
+    StdioArchiveFile& operator=(const StdioArchiveFile&) = delete;
+
+    bool Open(const std::string& path);
+
+    Result GetSize(uint64_t* size) override;
+    Result Read(uint64_t offset, void* buffer, uint32_t size, uint32_t* bytes_read) override;
+
+private:
+    FILE* file = nullptr;
+    uint64_t position = 0; // Current position of the stdio stream, used to skip redundant seeks
+};
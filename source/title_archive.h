@@ -0,0 +1,19 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include "archive_file.h"
+
+// Provides access to the contents of the title being dumped.
+// On the 3DS, this is backed by the FS service (see fs_title_archive.h); host builds use synthetic titles.
+class TitleArchive {
+public:
+    virtual ~TitleArchive() = default;
+
+    // Open the ExeFS section "name" (e.g. ".code")
+    virtual Result OpenExeFSSection(const std::string& name, std::unique_ptr<ArchiveFile>* file) = 0;
+
+    // Open the RomFS level 3 data (i.e. the actual file system)
+    virtual Result OpenRomFS(std::unique_ptr<ArchiveFile>* file) = 0;
+};
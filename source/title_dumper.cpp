@@ -0,0 +1,553 @@
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+#include <iterator>
+#include <set>
+#include <sstream>
+
+#include "checksum_manifest.h"
+#include "compressed_image.h"
+#include "dump_engine.h"
+#include "dump_journal.h"
+#include "dump_verifier.h"
+#include "incremental_output_file.h"
+#include "ncch.h"
+#include "perf_telemetry.h"
+#include "romfs_index.h"
+#include "sha256.h"
+#include "title_dumper.h"
+
+static uint32_t RoundUpToPageSize(uint32_t value) {
+    return (value + 0xFFF) / 0x1000 * 0x1000;
+}
+
+// Encode four characters as a (little-endian) uint32_t value
+static inline uint32_t MakeMagic(char a, char b, char c, char d) {
+    return a | b << 8 | c << 16 | d << 24;
+}
+
+TitleDumper::TitleDumper(const DumpOptions& options, const DumpEnvironment& environment)
+    : options(options), environment(environment), own_arena(environment.arena ? 0 : arena_size, false),
+      arena(environment.arena ? *environment.arena : own_arena), sink_buffer(&arena, OutputSink::default_buffer_size) {
+    static_assert(DumpArena::alignment % OutputSink::buffer_alignment == 0, "Arena allocations aren't suitably aligned for OutputSink");
+
+    // Progress is published through atomic counters and rendered on a separate thread once per frame,
+    // so that the console redraws don't hold up the reads and writes
+    if (environment.console) {
+        progress_display.reset(new ProgressDisplay(progress, *environment.console, nullptr));
+        if (!progress_display->Start())
+            progress_display.reset();
+    }
+}
+
+TitleDumper::~TitleDumper() {
+    if (progress_display)
+        progress_display->Stop();
+}
+
+ChunkAutotuner& TitleDumper::GetAutotuner(uint8_t media_type) {
+    auto& autotuner = autotuners[media_type];
+    if (!autotuner) {
+        uint32_t initial_chunk_size = options.autotune_config_path.empty() ? 0 : LoadTunedChunkSize(options.autotune_config_path, media_type);
+        autotuner.reset(new ChunkAutotuner(ChunkAutotuner::Config{}, GetTicks, initial_chunk_size));
+    }
+    return *autotuner;
+}
+
+ChunkStore& TitleDumper::GetChunkStore() {
+    if (!chunk_store) {
+        const std::string& path = options.chunk_store_path;
+        if (environment.make_directory)
+            environment.make_directory(path);
+
+        uint64_t pack_size, index_size;
+        auto pack = environment.open_output(path + "/chunks.pack", true, &pack_size);
+        auto index = environment.open_output(path + "/chunks.index", true, &index_size);
+        chunk_store.reset(new ChunkStore(path + "/chunks.index", std::move(pack), pack_size, std::move(index), index_size));
+    }
+    return *chunk_store;
+}
+
+void TitleDumper::Print(const std::string& message) {
+    if (!environment.console)
+        return;
+
+    if (progress_display)
+        progress_display->Print(message);
+    else
+        *environment.console << message << std::endl;
+}
+
+TitleDumpResult TitleDumper::Dump(TitleArchive& title, const TitleDumpRequest& request) {
+    uint64_t begin = GetTicks();
+    TitleDumpResult result;
+    if (!sink_buffer.Data()) {
+        Print("Not enough memory for the output buffer");
+    } else if (!options.romfs_patterns.empty()) {
+        result = DumpRomFSFiles(title, request, true);
+    } else {
+        result = WriteOutputs(title, request);
+        if (result.success && options.verify)
+            Verify(title, request, result);
+        if (result.success && options.romfs_index)
+            result.success = DumpRomFSFiles(title, request, false).success;
+    }
+    result.ticks = GetTicks() - begin;
+
+    std::stringstream message;
+    message << "Buffer memory: peak " << arena.HighWaterMark() / 1024 << " of " << arena.Capacity() / 1024 << " KiB";
+    if (arena.FailedAllocations())
+        message << ", " << arena.FailedAllocations() << " buffers allocated from the heap";
+    Print(message.str());
+    return result;
+}
+
+TitleDumpResult TitleDumper::DumpRomFSFiles(TitleArchive& title, const TitleDumpRequest& request, bool dump_files) {
+    TitleDumpResult result;
+    if (progress_display)
+        progress_display->Flush();
+
+    std::unique_ptr<ArchiveFile> romfs;
+    Result ret = title.OpenRomFS(&romfs);
+    if (ret != 0) {
+        Print("Couldn't open RomFS for reading (error " + ResultToString(ret) + ")");
+        return result;
+    }
+
+    // Only the file system tables are read here, rather than the whole RomFS
+    RomFSIndex index;
+    if (!index.Load(*romfs)) {
+        Print("Couldn't read the RomFS file tables");
+        return result;
+    }
+    if (options.romfs_index && !index.WriteIndexFile(request.base_path + ".romfs_index"))
+        Print("Couldn't write RomFS index");
+    if (!dump_files) {
+        result.success = true;
+        return result;
+    }
+
+    auto files = index.Match(options.romfs_patterns);
+    for (auto file : files)
+        result.image_size += file->size;
+    std::stringstream message;
+    message << "Dumping " << files.size() << " of " << index.Files().size() << " RomFS files (" << result.image_size / 1024 << " KiB)";
+    Print(message.str());
+
+    // Directories are created as needed, parents first
+    const std::string romfs_path = request.base_path + "/romfs";
+    std::set<std::string> directories;
+    auto make_directory = [&](const std::string& path) {
+        if (directories.insert(path).second && environment.make_directory)
+            environment.make_directory(path);
+    };
+    make_directory(request.base_path);
+    make_directory(romfs_path);
+
+    // Files are copied through the (otherwise idle) output sink buffer, using reads targeted at each file's data
+    bool success = true;
+    progress.BeginPhase("RomFS files", result.image_size);
+    for (auto file : files) {
+        for (size_t slash = file->path.find('/'); slash != std::string::npos; slash = file->path.find('/', slash + 1))
+            make_directory(romfs_path + "/" + file->path.substr(0, slash));
+
+        uint64_t existing_size;
+        auto output = environment.open_output(romfs_path + "/" + file->path, false, &existing_size);
+        for (uint64_t offset = 0; success && offset < file->size; ) {
+            uint32_t chunk = static_cast<uint32_t>(std::min(uint64_t{OutputSink::default_buffer_size}, file->size - offset));
+            uint32_t bytes_read = 0;
+            ret = romfs->Read(file->offset + offset, sink_buffer.Data(), chunk, &bytes_read);
+            if (ret != 0 || bytes_read != chunk) {
+                Print("Error while reading RomFS/" + file->path + " (error " + ResultToString(ret) + ")");
+                success = false;
+            } else if (!output->WriteAt(offset, sink_buffer.Data(), chunk)) {
+                Print("Error while writing output... is your SD card full?");
+                success = false;
+            }
+            offset += chunk;
+            progress.AddDone(chunk);
+        }
+        success &= output->Flush();
+        if (!success)
+            break;
+    }
+    progress.EndPhase();
+
+    result.success = success;
+    return result;
+}
+
+void TitleDumper::Verify(TitleArchive& title, const TitleDumpRequest& request, TitleDumpResult& result) {
+    if (!options.full_image || options.compress_full_image || !options.chunk_store_path.empty() || !environment.open_input) {
+        Print("Skipping verification, which requires an uncompressed full image on the SD card");
+        return;
+    }
+
+    const std::string cxi_path = request.base_path + ".cxi";
+    auto image = environment.open_input(cxi_path);
+    if (!image) {
+        Print("Couldn't open \"" + cxi_path + "\" for verification");
+        result.success = false;
+        return;
+    }
+
+    if (progress_display)
+        progress_display->Flush();
+    ChecksumManifest manifest;
+    auto verify_result = VerifyDump(title, *image, request.title_id, ChecksumManifest::default_block_size, &manifest, &progress, print_message);
+    result.verified = verify_result.success;
+    result.mismatching_blocks = verify_result.mismatching_blocks;
+    if (verify_result.read_failed) {
+        Print("Couldn't verify the dump");
+        result.success = false;
+        return;
+    }
+
+    if (verify_result.mismatching_blocks) {
+        // Checksums of a corrupted image are useless, so don't write a manifest
+        std::stringstream message;
+        message << "Verification failed: " << verify_result.mismatching_blocks << " blocks differ, the first one in "
+                << verify_result.mismatch_region << " at offset 0x" << std::hex << verify_result.mismatch_offset
+                << " (0x" << verify_result.mismatch_size << " bytes)";
+        Print(message.str());
+        result.success = false;
+        return;
+    }
+
+    std::stringstream message;
+    message << "Verified " << verify_result.bytes_verified / 1024 << " KiB, no differences found";
+    Print(message.str());
+    if (!manifest.Write(request.base_path + ".checksums"))
+        Print("Couldn't write checksum manifest");
+}
+
+TitleDumpResult TitleDumper::WriteOutputs(TitleArchive& fs_title, const TitleDumpRequest& request) {
+    TitleDumpResult result;
+    if (!options.full_image && !options.standalone_exefs && !options.standalone_romfs) {
+        result.success = true;
+        return result;
+    }
+
+    if (progress_display)
+        progress_display->Flush();
+
+    bool success = true;
+    if ((options.standalone_exefs || options.standalone_romfs) && environment.make_directory)
+        environment.make_directory(request.base_path);
+
+    // Keep track of progress in a journal, so that interrupted dumps can be resumed on the next launch
+    const bool dedup_full_image = options.full_image && !options.chunk_store_path.empty();
+    const bool compress_full_image = options.full_image && options.compress_full_image && !dedup_full_image;
+    const bool plain_full_image = options.full_image && !compress_full_image && !dedup_full_image;
+    const std::string cxi_path = request.base_path + (dedup_full_image ? ".cxi.recipe" : compress_full_image ? ".cxi.bdci" : ".cxi");
+    const std::string exefs_path = request.base_path + "/exefs.bin";
+    const std::string romfs_path = request.base_path + "/romfs.bin";
+    const bool use_journal = plain_full_image && options.resumable;
+    DumpJournal journal;
+    if (use_journal && !journal.Open(request.base_path + ".journal", request.title_id, cxi_path))
+        Print("Couldn't create dump journal, this dump won't be resumable");
+    DumpJournal* journal_ptr = use_journal ? &journal : nullptr;
+    result.resumed = journal.Resuming();
+
+    // For incremental dumps, the previous image is patched in place. Its manifest is removed until the dump is
+    // complete: Once blocks have been patched, it doesn't describe the image anymore.
+    const bool incremental = plain_full_image && options.incremental && !journal.Resuming();
+    const std::string manifest_path = request.base_path + ".checksums";
+    ChecksumManifest previous_manifest;
+    bool have_previous = incremental && previous_manifest.Read(manifest_path) && previous_manifest.title_id == request.title_id;
+    if (have_previous)
+        remove(manifest_path.c_str());
+    else if (incremental)
+        Print("No checksums of a previous dump found, dumping everything");
+
+    // Zero-filled blocks (padding, mostly) are skipped rather than written to the output files
+    std::unique_ptr<OutputFile> cxi_output, exefs_output, romfs_output;
+    std::unique_ptr<SparseOutputFile> cxi_sparse, exefs_sparse, romfs_sparse;
+    auto open_output = [&](const std::string& path, bool keep_contents, std::unique_ptr<OutputFile>& output, std::unique_ptr<SparseOutputFile>& sparse) {
+        uint64_t existing_size;
+        output = environment.open_output(path, keep_contents, &existing_size);
+        sparse.reset(new SparseOutputFile(*output, existing_size));
+        return existing_size;
+    };
+    std::unique_ptr<IncrementalOutputFile> cxi_incremental;
+    if (options.full_image) {
+        uint64_t existing_size = open_output(cxi_path, journal.Resuming() || have_previous, cxi_output, cxi_sparse);
+        if (have_previous && existing_size == previous_manifest.image_size)
+            cxi_incremental.reset(new IncrementalOutputFile(*cxi_sparse, previous_manifest));
+        else if (have_previous)
+            Print("Previous image doesn't match its checksums, dumping everything");
+    }
+    if (options.standalone_exefs)
+        open_output(exefs_path, journal.Resuming(), exefs_output, exefs_sparse);
+    if (options.standalone_romfs)
+        open_output(romfs_path, journal.Resuming(), romfs_output, romfs_sparse);
+
+    // Reserve space for the images up front, so that the file system can allocate it in one go rather than cluster by
+    // cluster. On backends not zero-filling it (i.e. the SD card), zero blocks are written rather than skipped in turn.
+    // Containers can't be sized in advance.
+    ImageLayout layout;
+    const bool preallocate = PredictImageLayout(fs_title, &layout);
+    uint64_t cxi_preallocated = 0, exefs_preallocated = 0, romfs_preallocated = 0;
+    auto preallocate_output = [](SparseOutputFile* sparse, uint64_t size) -> uint64_t {
+        return (sparse && sparse->Preallocate(size)) ? size : 0;
+    };
+    if (preallocate && plain_full_image)
+        cxi_preallocated = preallocate_output(cxi_sparse.get(), layout.image_size);
+    if (preallocate) {
+        exefs_preallocated = preallocate_output(exefs_sparse.get(), layout.exefs_size);
+        romfs_preallocated = preallocate_output(romfs_sparse.get(), layout.romfs_size);
+    }
+
+    // Compressed images are written to a container, with blocks compressed on a worker thread
+    std::unique_ptr<CompressedImageWriter> cxi_compressed;
+    if (compress_full_image)
+        cxi_compressed.reset(new CompressedImageWriter(*cxi_output));
+
+    // Deduplicated images are chunked as they're written, with only chunks new to the store being written to it
+    std::unique_ptr<DedupImageWriter> cxi_dedup;
+    if (dedup_full_image)
+        cxi_dedup.reset(new DedupImageWriter(GetChunkStore(), *cxi_output));
+
+    // All requested artifacts are produced in a single pass, such that the (slow) ExeFS and RomFS reads
+    // happen only once: The full NCCH image is written through a tee that additionally forwards the
+    // ExeFS and RomFS regions to their standalone files.
+    TeeOutputFile tee;
+    if (cxi_compressed)
+        tee.AddRoute(*cxi_compressed, 0);
+    else if (cxi_dedup)
+        tee.AddRoute(*cxi_dedup, 0);
+    else if (cxi_incremental)
+        tee.AddRoute(*cxi_incremental, 0);
+    else if (options.full_image)
+        tee.AddRoute(*cxi_sparse, 0);
+
+    // Record timings of all title reads and output writes, to be written to <titleid>.perf.json
+    PerfTelemetry perf;
+    InstrumentedOutputFile instrumented_output(tee, perf);
+    OutputSink out_file(instrumented_output, sink_buffer.Data(), OutputSink::default_buffer_size);
+    InstrumentedTitleArchive title(fs_title, perf);
+    if (progress_display)
+        progress_display->SetPerf(&perf);
+
+    // Write placeholder headers to be filled later
+    auto ncch_pos = out_file.Tell();
+    out_file.FillZero(sizeof(NCCH_Header));
+
+    auto exheader_pos = out_file.Tell();
+    out_file.FillZero(sizeof(ExHeader_Header));
+
+    PadToNextMediaUnit(out_file, ncch_pos);
+
+    // Dump ExeFS and RomFS first (since their sizes are needed to generate the ExHeader)
+    auto exefs_pos = out_file.Tell();
+    size_t exefs_route = 0;
+    if (options.standalone_exefs)
+        exefs_route = tee.AddRoute(*exefs_sparse, exefs_pos);
+    uint8_t exefs_header_hash[Sha256::digest_size] = {};
+    bool code_compressed = true;
+    auto decompressed_code_size = DumpExeFS(title, out_file, exefs_header_hash, journal_ptr, &perf, &progress, print_message, &arena, &code_compressed);
+    success &= (0 != decompressed_code_size);
+    auto exefs_end = out_file.Tell();
+    if (options.standalone_exefs)
+        tee.EndRoute(exefs_route, exefs_end);
+    PadToNextMediaUnit(out_file, ncch_pos);
+
+    auto romfs_pos = out_file.Tell();
+    size_t romfs_route = 0;
+    if (options.standalone_romfs)
+        romfs_route = tee.AddRoute(*romfs_sparse, romfs_pos);
+    RomFSSuperblockInfo romfs_superblock = {};
+    auto& autotuner = GetAutotuner(request.media_type);
+    ReadRecovery recovery;
+    success &= DumpRomFS(title, out_file, &romfs_superblock, journal_ptr, &perf, &autotuner, &progress, print_message, &arena,
+                         options.recover_read_errors ? &recovery : nullptr);
+    if (success && !options.autotune_config_path.empty())
+        SaveTunedChunkSize(options.autotune_config_path, request.media_type, autotuner.BestChunkSize());
+    auto romfs_end = out_file.Tell();
+    if (options.standalone_romfs)
+        tee.EndRoute(romfs_route, romfs_end);
+    PadToNextMediaUnit(out_file, ncch_pos);
+
+    if (progress_display) {
+        progress_display->Flush();
+        progress_display->SetPerf(nullptr);
+    }
+
+    auto ncch_end = out_file.Tell();
+    uint64_t headers_begin = GetTicks();
+
+    // Generate a fake ExHeader:
+    // There is (or rather, seems to be) no way to access the actual ExHeader,
+    // so we just craft a reasonable "fake" one here based on the metadata
+    // that we *can* access and some heuristics.
+    //
+    // TODO: The SMDH (i.e. "ExeFS/icon") provides useful information with regards to the application name and other stuff!
+    // TODO: We might get the product code of the current title using AM:GetTitleProductCode
+    // TODO: Other potentially useful service calls: PM_GetTitleExheaderFlags, APT:GetAppletInfo, APT:GetProgramInfo
+
+    ExHeader_Header exheader;
+    memset(&exheader, 0, sizeof(exheader));
+
+    // Program segment information:
+    // - Assume text starts at 0x00100000
+    // - Assume text is followed by ro
+    // - Assume ro is followed by data
+    // - Assume bss size is the difference between the total size of the text/ro/data segments and the size of the decompressed .code data
+    //   (taken from the BLZ footer, which is exact, so decompressing .code wouldn't improve on this)
+    // - Assume old application stack is still queryable at 0x0FFFFFFC
+    // TODO: bss size is still off by a few bytes. This could be resolved by parsing the code binary (which always (?) starts with a bl to bss_clear for official content).
+    auto& codeset = exheader.codeset_info;
+    const unsigned page_size = 0x1000;
+    // codeset.name = TODO; // e.g. "CubicNin"
+    codeset.flags.flag = code_compressed ? 1 : 0; // bit0: CompressExefsCode
+    codeset.text.address = 0x00100000;
+    if (request.query_region_size) {
+        auto& GetRegionSize = request.query_region_size;
+        codeset.text.code_size = GetRegionSize(codeset.text.address);
+        codeset.text.num_max_pages = RoundUpToPageSize(codeset.text.code_size) / page_size;
+        codeset.ro.address = codeset.text.address + codeset.text.num_max_pages * page_size;
+        codeset.ro.code_size = GetRegionSize(codeset.ro.address);
+        codeset.ro.num_max_pages = RoundUpToPageSize(codeset.ro.code_size) / page_size;
+        codeset.data.address = codeset.ro.address + codeset.ro.num_max_pages * page_size;
+
+        uint32_t data_and_bss_size = GetRegionSize(codeset.data.address);
+        codeset.bss_size = codeset.text.code_size + codeset.ro.code_size + data_and_bss_size - decompressed_code_size;
+
+        codeset.data.code_size = data_and_bss_size - codeset.bss_size;
+        codeset.data.num_max_pages = RoundUpToPageSize(codeset.data.code_size) / page_size;
+        codeset.stack_size = GetRegionSize(0x0FFFFFFC);
+    }
+
+    exheader.arm11_system_local_caps.program_id = request.title_id;
+
+    // Initialize ARM11 kernel capabilities to "unused" by default, then fill selected array members
+    auto& arm11_caps_descriptor = exheader.arm11_kernel_caps.descriptors;
+    std::fill(std::begin(arm11_caps_descriptor),
+              std::end(arm11_caps_descriptor),
+              0xFFFFFFFF);
+
+    // SVCs: Grant full access to everything \o/
+    for (unsigned svc_table_index = 0; svc_table_index < 7; ++svc_table_index) {
+        const uint32_t all_svcs = 0xffffff;
+        arm11_caps_descriptor[svc_table_index] = (0b11110 << 27) | (svc_table_index << 24) | all_svcs;
+    }
+
+    // Write fake ExHeader to file
+    out_file.Patch(exheader_pos, &exheader, sizeof(exheader));
+
+
+    // Generate a fake NCCH header, since
+    // - we cannot get the actual NCCH header
+    // - the actual NCCH header usually refers to the encrypted data anyway, while we store unencrypted data.
+    NCCH_Header header;
+    memset(&header, 0, sizeof(header));
+
+    header.magic = MakeMagic('N', 'C', 'C', 'H');
+    header.version = 2;
+    header.program_id = request.title_id;
+
+    // TODO: If possible, detect New3DS-only titles and set the proper flag here
+    header.flags.content_platform = NCCHContentPlatform::Old3DS;
+    header.flags.content_type = NCCHContentType::Data | NCCHContentType::Executable;
+    header.flags.crypto = NCCHCrypto::NoCrypto;
+
+    header.extended_header_size = sizeof(exheader) - sizeof(exheader.access_desc);
+
+    header.exefs_offset = BytesToMediaUnits(exefs_pos - ncch_pos);
+    header.exefs_size = BytesToMediaUnits(exefs_end - exefs_pos);
+    header.exefs_hash_region_size = BytesToMediaUnits(sizeof(ExeFs_Header));
+    memcpy(header.exefs_super_block_hash, exefs_header_hash, sizeof(header.exefs_super_block_hash));
+
+    header.romfs_offset = BytesToMediaUnits(romfs_pos - ncch_pos);
+    header.romfs_size = BytesToMediaUnits(romfs_end - romfs_pos);
+    header.romfs_hash_region_size = romfs_superblock.size;
+    memcpy(header.romfs_super_block_hash, romfs_superblock.hash, sizeof(header.romfs_super_block_hash));
+
+    header.content_size = BytesToMediaUnits(ncch_end - ncch_pos);
+
+    // Write fake NCCH header
+    out_file.Patch(ncch_pos, &header, sizeof(header));
+    success &= out_file.Flush();
+    perf.RecordPhase("headers", headers_begin, sizeof(exheader) + sizeof(header));
+
+    // The previous image may have been larger
+    if (cxi_incremental && previous_manifest.image_size > ncch_end - ncch_pos)
+        success &= cxi_incremental->SetSize(ncch_end - ncch_pos);
+    // Release space preallocated in excess, in case the title reported inaccurate sizes
+    if (cxi_preallocated > ncch_end - ncch_pos)
+        success &= cxi_sparse->SetSize(ncch_end - ncch_pos);
+    if (exefs_preallocated > exefs_end - exefs_pos)
+        success &= exefs_sparse->SetSize(exefs_end - exefs_pos);
+    if (romfs_preallocated > romfs_end - romfs_pos)
+        success &= romfs_sparse->SetSize(romfs_end - romfs_pos);
+    if (cxi_compressed) {
+        success &= cxi_compressed->Finish();
+        std::stringstream message;
+        message << "Compressed image to " << cxi_compressed->ContainerSize() / 1024 << "/" << cxi_compressed->ImageSize() / 1024 << " KiB";
+        Print(message.str());
+    }
+    if (cxi_dedup) {
+        success &= cxi_dedup->Finish();
+        result.stored_bytes = cxi_dedup->NewBytes();
+        double chunking_seconds = static_cast<double>(cxi_dedup->ChunkingTicks()) / ticks_per_second;
+        std::stringstream message;
+        message << "Stored " << cxi_dedup->NewChunks() << "/" << cxi_dedup->NumChunks() << " chunks (" << cxi_dedup->NewBytes() / 1024
+                << "/" << cxi_dedup->ImageSize() / 1024 << " KiB)" << std::fixed;
+        if (cxi_dedup->NewBytes())
+            message << ", dedup ratio " << std::setprecision(2) << static_cast<double>(cxi_dedup->ImageSize()) / cxi_dedup->NewBytes();
+        message << ", chunking at " << std::setprecision(1) << cxi_dedup->ImageSize() / (1024.0 * 1024.0) / std::max(chunking_seconds, 1e-6) << " MiB/s";
+        Print(message.str());
+    }
+
+    // List the data that couldn't be read, so that it can be re-dumped or at least accounted for later
+    const std::string bad_ranges_path = request.base_path + ".bad_ranges";
+    result.unreadable_bytes = recovery.unreadable_size;
+    result.retried_reads = recovery.retried_reads;
+    if (!recovery.unreadable.empty()) {
+        std::stringstream message;
+        message << result.unreadable_bytes / 1024 << " KiB of the RomFS couldn't be read, see " << bad_ranges_path;
+        Print(message.str());
+        if (!WriteUnreadableRanges(bad_ranges_path, recovery.unreadable))
+            Print("Couldn't write " + bad_ranges_path);
+    } else if (!journal.Resuming() || options.recover_read_errors) {
+        // Ranges from before resuming are restored from the journal, but only if read errors are being recovered from
+        remove(bad_ranges_path.c_str());
+    }
+
+    for (auto sparse : { cxi_sparse.get(), exefs_sparse.get(), romfs_sparse.get() })
+        result.skipped_bytes += sparse ? sparse->SkippedBytes() : 0;
+    std::stringstream skipped_message;
+    skipped_message << "Skipped writing " << result.skipped_bytes / 1024 << " KiB of zero-filled blocks";
+    Print(skipped_message.str());
+
+    if (cxi_incremental) {
+        result.unchanged_bytes = cxi_incremental->UnchangedBytes();
+        std::stringstream message;
+        message << "Rewrote " << cxi_incremental->WrittenBytes() / 1024 << " KiB, " << result.unchanged_bytes / 1024
+                << " KiB unchanged since the previous dump";
+        Print(message.str());
+    }
+
+    // Write checksums for the next incremental dump (unless verification is going to). Blocks checksummed
+    // while writing don't need to be read back, so normally this only reads the headers.
+    if (success && incremental && !options.verify) {
+        auto image = environment.open_input ? environment.open_input(cxi_path) : nullptr;
+        ChecksumManifest manifest;
+        auto known_hash = [&cxi_incremental](uint64_t offset, uint64_t size, uint64_t* hash) {
+            return cxi_incremental && cxi_incremental->KnownHash(offset, size, hash);
+        };
+        if (!image || !HashImage(*image, request.title_id, ChecksumManifest::default_block_size, known_hash, &manifest, print_message) ||
+            !manifest.Write(manifest_path))
+            Print("Couldn't write checksum manifest");
+    }
+
+    if (!perf.WriteJson(request.base_path + ".perf.json", request.title_id))
+        Print("Couldn't write performance data");
+
+    if (success && use_journal)
+        journal.Remove();
+
+    result.success = success;
+    result.image_size = ncch_end - ncch_pos;
+    return result;
+}
@@ -0,0 +1,161 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "archive_file.h"
+#include "chunk_autotuner.h"
+#include "chunk_store.h"
+#include "dump_arena.h"
+#include "dump_pipeline.h"
+#include "dump_progress.h"
+#include "output_file.h"
+#include "output_sink.h"
+#include "title_archive.h"
+
+// What to produce when dumping a title
+struct DumpOptions {
+    bool full_image = true;
+    bool compress_full_image = false; // Store the full image in a block-compressed container (not resumable)
+    bool standalone_exefs = false;
+    bool standalone_romfs = false;
+
+    // Keep a journal next to the full image, so that interrupted dumps can be resumed
+    bool resumable = true;
+
+    // Read the title and the full image back after dumping, compare them, and write a checksum manifest
+    // (<titleid>.checksums) for later integrity checks. Requires an uncompressed full image.
+    bool verify = false;
+
+    // Re-dump into an existing full image, writing only the blocks that changed since it was dumped. This needs the
+    // checksum manifest of the earlier dump (<titleid>.checksums), and an updated one is written afterwards.
+    // Without a manifest, a regular dump is done. Requires an uncompressed full image.
+    bool incremental = false;
+
+    // If non-empty, only the RomFS files matching these paths or glob patterns (see RomFSIndex::Match) are dumped,
+    // to base_path + "/romfs/<path>". No images are written in this case.
+    std::vector<std::string> romfs_patterns;
+
+    // Write a list of all RomFS files with their offsets and sizes to <titleid>.romfs_index
+    bool romfs_index = false;
+
+    // If non-empty, the full image is split into content-defined chunks, which are stored in the chunk store in this
+    // directory unless they're in it already (e.g. from another title). The image is described by a recipe
+    // (<titleid>.cxi.recipe) to reassemble it from. Takes precedence over compress_full_image (not resumable).
+    std::string chunk_store_path;
+
+    // Retry failed RomFS reads, narrowing them down to the unreadable spots. Data that can't be read is zero-filled
+    // and listed in <titleid>.bad_ranges, rather than aborting the dump.
+    bool recover_read_errors = true;
+
+    // If non-empty, RomFS read chunk sizes that performed best in previous dumps are loaded from and saved to this file
+    std::string autotune_config_path;
+};
+
+// Platform-specific services used while dumping
+struct DumpEnvironment {
+    // Open the output file at "path". If "keep_contents" is set, existing data is preserved and its size is
+    // returned in "existing_size". Errors are reported when writing to the returned file.
+    std::function<std::unique_ptr<OutputFile>(const std::string& path, bool keep_contents, uint64_t* existing_size)> open_output;
+
+    // Open a previously written output file for reading, or return null on error (only needed for verification)
+    std::function<std::unique_ptr<ArchiveFile>(const std::string& path)> open_input;
+
+    // Create the directory at "path" for the standalone outputs (optional)
+    std::function<void(const std::string& path)> make_directory;
+
+    // Console to print progress and status messages to (optional)
+    std::ostream* console = nullptr;
+
+    // Memory for the dump buffers, reserved once for the whole session (optional). It should provide at least
+    // TitleDumper::arena_size bytes, and must not be shared by dumpers running concurrently. If not set, the dumper
+    // reserves its own arena from the heap.
+    DumpArena* arena = nullptr;
+};
+
+struct TitleDumpRequest {
+    uint64_t title_id = 0;
+    uint8_t media_type = 0;
+
+    // Outputs are named after this path, e.g. base_path + ".cxi" and base_path + "/romfs.bin"
+    std::string base_path;
+
+    // Get the size of the memory region containing the given address of the title's process, which is used to
+    // guess the code set information in the ExHeader. This only works for the running title; if not set,
+    // the code set information is left blank.
+    std::function<uint32_t(uint32_t address)> query_region_size;
+};
+
+struct TitleDumpResult {
+    bool success = false;
+    bool resumed = false;       // Continued an interrupted dump
+    uint64_t image_size = 0;    // Size of the NCCH image (or of the RomFS files, if only selected files were dumped)
+    uint64_t skipped_bytes = 0; // Zero-filled blocks that weren't written
+    uint64_t unchanged_bytes = 0; // Blocks matching the previous dump that weren't written (incremental dumps only)
+    uint64_t stored_bytes = 0;    // Data added to the chunk store (dumps to a chunk store only)
+    uint64_t unreadable_bytes = 0; // RomFS data that couldn't be read and was zero-filled
+    uint32_t retried_reads = 0;    // RomFS reads that failed and were retried
+    uint64_t ticks = 0;         // Duration of the dump, including verification
+
+    bool verified = false;           // The image was read back and matched the title
+    uint32_t mismatching_blocks = 0; // Blocks of the image that differ from the title
+};
+
+// Dumps titles to NCCH images and/or standalone ExeFS and RomFS images.
+//
+// The dumper holds no global state, so several dumpers may run concurrently. Resources that are expensive to
+// set up (I/O buffers, the progress display thread, tuned RomFS read sizes) are kept across titles, which makes
+// dumping a batch of titles with a single dumper cheaper than dumping them separately.
+class TitleDumper {
+public:
+    // Buffer memory needed for dumping: The output buffer, the RomFS pipeline's buffers (4 of up to 2 MiB each)
+    // and the ExeFS streaming buffer
+    static const size_t arena_size = 0x900000;
+
+    TitleDumper(const DumpOptions& options, const DumpEnvironment& environment);
+    ~TitleDumper();
+
+    TitleDumper(const TitleDumper&) = delete;
+    TitleDumper& operator=(const TitleDumper&) = delete;
+
+    TitleDumpResult Dump(TitleArchive& title, const TitleDumpRequest& request);
+
+private:
+    // Write the requested outputs. Returns with all output files closed.
+    TitleDumpResult WriteOutputs(TitleArchive& title, const TitleDumpRequest& request);
+
+    void Verify(TitleArchive& title, const TitleDumpRequest& request, TitleDumpResult& result);
+
+    // Dump the RomFS files matching options.romfs_patterns, and/or write the RomFS index file
+    TitleDumpResult DumpRomFSFiles(TitleArchive& title, const TitleDumpRequest& request, bool dump_files);
+
+    ChunkAutotuner& GetAutotuner(uint8_t media_type);
+
+    // The chunk store is opened on first use and kept for later titles
+    ChunkStore& GetChunkStore();
+
+    // Print a status message, making sure it doesn't get mixed up with the progress display
+    void Print(const std::string& message);
+
+    DumpOptions options;
+    DumpEnvironment environment;
+
+    // The output buffer is taken from the arena first and kept for all titles; other buffers are taken
+    // on top of it for each phase
+    DumpArena own_arena; // Only reserved if the environment doesn't provide an arena
+    DumpArena& arena;
+    ArenaBuffer sink_buffer;
+    std::map<uint8_t, std::unique_ptr<ChunkAutotuner>> autotuners;
+    std::unique_ptr<ChunkStore> chunk_store;
+
+    DumpProgress progress;
+    std::unique_ptr<ProgressDisplay> progress_display;
+
+    // Passed to the dump engine, so that its messages go through Print as well
+    MessageCallback print_message = [this](const std::string& message) { Print(message); };
+};
@@ -0,0 +1,127 @@
+#include <algorithm>
+#include <cstring>
+
+#include "xxhash64.h"
+
+// Straightforward implementation of the XXH64 specification. The ARM11 has no 64-bit multiplier, so each
+// round costs a few 32-bit multiplies; that's still far faster than reading from a cartridge or SD card.
+
+static const uint64_t prime1 = 0x9E3779B185EBCA87ull;
+static const uint64_t prime2 = 0xC2B2AE3D27D4EB4Full;
+static const uint64_t prime3 = 0x165667B19E3779F9ull;
+static const uint64_t prime4 = 0x85EBCA77C2B2AE63ull;
+static const uint64_t prime5 = 0x27D4EB2F165667C5ull;
+
+static inline uint64_t RotateLeft(uint64_t value, unsigned amount) {
+    return (value << amount) | (value >> (64 - amount));
+}
+
+static inline uint64_t LoadLittleEndian64(const uint8_t* data) {
+    uint64_t value = 0;
+    for (unsigned index = 0; index < 8; ++index)
+        value |= uint64_t(data[index]) << (8 * index);
+    return value;
+}
+
+static inline uint32_t LoadLittleEndian32(const uint8_t* data) {
+    return data[0] | (uint32_t(data[1]) << 8) | (uint32_t(data[2]) << 16) | (uint32_t(data[3]) << 24);
+}
+
+static inline uint64_t Round(uint64_t accumulator, uint64_t input) {
+    accumulator += input * prime2;
+    accumulator = RotateLeft(accumulator, 31);
+    return accumulator * prime1;
+}
+
+static inline uint64_t MergeRound(uint64_t hash, uint64_t accumulator) {
+    hash ^= Round(0, accumulator);
+    return hash * prime1 + prime4;
+}
+
+static inline void ProcessStripe(uint64_t* accumulators, const uint8_t* data) {
+    accumulators[0] = Round(accumulators[0], LoadLittleEndian64(data));
+    accumulators[1] = Round(accumulators[1], LoadLittleEndian64(data + 8));
+    accumulators[2] = Round(accumulators[2], LoadLittleEndian64(data + 16));
+    accumulators[3] = Round(accumulators[3], LoadLittleEndian64(data + 24));
+}
+
+void XXHash64::Reset(uint64_t seed) {
+    this->seed = seed;
+    accumulators[0] = seed + prime1 + prime2;
+    accumulators[1] = seed + prime2;
+    accumulators[2] = seed;
+    accumulators[3] = seed - prime1;
+    total_size = 0;
+    stripe_fill = 0;
+}
+
+void XXHash64::Update(const void* data, size_t size) {
+    auto bytes = static_cast<const uint8_t*>(data);
+    total_size += size;
+
+    // Complete a partially filled stripe first
+    if (stripe_fill != 0) {
+        size_t num_bytes = std::min(size, stripe_size - stripe_fill);
+        memcpy(stripe + stripe_fill, bytes, num_bytes);
+        stripe_fill += num_bytes;
+        bytes += num_bytes;
+        size -= num_bytes;
+        if (stripe_fill != stripe_size)
+            return;
+
+        ProcessStripe(accumulators, stripe);
+        stripe_fill = 0;
+    }
+
+    // Process whole stripes directly from the input
+    for (; size >= stripe_size; bytes += stripe_size, size -= stripe_size)
+        ProcessStripe(accumulators, bytes);
+
+    memcpy(stripe, bytes, size);
+    stripe_fill = size;
+}
+
+uint64_t XXHash64::Digest() const {
+    uint64_t hash;
+    if (total_size >= stripe_size) {
+        hash = RotateLeft(accumulators[0], 1) + RotateLeft(accumulators[1], 7) +
+               RotateLeft(accumulators[2], 12) + RotateLeft(accumulators[3], 18);
+        for (auto accumulator : accumulators)
+            hash = MergeRound(hash, accumulator);
+    } else {
+        hash = seed + prime5;
+    }
+    hash += total_size;
+
+    // Mix in the remaining bytes
+    const uint8_t* bytes = stripe;
+    size_t size = stripe_fill;
+    for (; size >= 8; bytes += 8, size -= 8) {
+        hash ^= Round(0, LoadLittleEndian64(bytes));
+        hash = RotateLeft(hash, 27) * prime1 + prime4;
+    }
+    if (size >= 4) {
+        hash ^= LoadLittleEndian32(bytes) * prime1;
+        hash = RotateLeft(hash, 23) * prime2 + prime3;
+        bytes += 4;
+        size -= 4;
+    }
+    for (; size != 0; ++bytes, --size) {
+        hash ^= *bytes * prime5;
+        hash = RotateLeft(hash, 11) * prime1;
+    }
+
+    // Final avalanche
+    hash ^= hash >> 33;
+    hash *= prime2;
+    hash ^= hash >> 29;
+    hash *= prime3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+uint64_t XXHash64::Hash(const void* data, size_t size, uint64_t seed) {
+    XXHash64 context(seed);
+    context.Update(data, size);
+    return context.Digest();
+}
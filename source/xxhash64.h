@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Incremental XXH64 context (xxHash, 64-bit variant).
+// This is a fast non-cryptographic hash, used to detect accidental corruption of dumped data (e.g. bad SD
+// card writes). Use Sha256 where the hash is part of the title format or needs to resist tampering.
+class XXHash64 {
+public:
+    static const size_t stripe_size = 32;
+
+    explicit XXHash64(uint64_t seed = 0) {
+        Reset(seed);
+    }
+
+    void Reset(uint64_t seed = 0);
+
+    void Update(const void* data, size_t size);
+
+    // Digest of all data passed to Update so far. Unlike Sha256::Final, this doesn't modify the context.
+    uint64_t Digest() const;
+
+    // Convenience function to hash a single buffer
+    static uint64_t Hash(const void* data, size_t size, uint64_t seed = 0);
+
+private:
+    uint64_t seed;
+    uint64_t accumulators[4];
+    uint64_t total_size;
+    uint8_t stripe[stripe_size];
+    size_t stripe_fill;
+};